@@ -0,0 +1,180 @@
+#include "batch.h"
+#include "destinations.h"
+#include "stats.h"
+#include "textio.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BATCH_INPUT_CAPACITY (1 << 20)
+#define BATCH_OUTPUT_CAPACITY (1 << 20)
+#define BATCH_DECIMALS 6
+
+static void writeError(OutputBuffer *out, long long lineNumber, const char *message, BatchStats *stats) {
+    appendText(out, "E ", 2);
+    appendInt(out, lineNumber);
+    appendChar(out, ' ');
+    appendString(out, message);
+    appendChar(out, '\n');
+    stats->errors++;
+}
+
+static void writeVector(OutputBuffer *out, Vector3D v) {
+    appendChar(out, ' ');
+    appendFixed(out, v.x, BATCH_DECIMALS);
+    appendChar(out, ' ');
+    appendFixed(out, v.y, BATCH_DECIMALS);
+    appendChar(out, ' ');
+    appendFixed(out, v.z, BATCH_DECIMALS);
+}
+
+// Parses up to count numbers; returns how many were read.
+static int parseNumbers(const char **cursor, const char *end, double *values, int count) {
+    int parsed = 0;
+    while (parsed < count && parseDouble(cursor, end, &values[parsed]))
+        parsed++;
+    return parsed;
+}
+
+static int onlyBlanksLeft(const char *cursor, const char *end) {
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+        cursor++;
+    return cursor == end;
+}
+
+static void runCommand(const char *line, const char *end, long long lineNumber, ShipState *state,
+                       Journal *journal, OutputBuffer *out, BatchStats *stats) {
+    while (line < end && (*line == ' ' || *line == '\t'))
+        line++;
+    if (line == end || *line == '#' || *line == '\r')
+        return;
+    char command = *line++;
+    double values[5];
+    int parsed = parseNumbers(&line, end, values, 5);
+    int trailing = !onlyBlanksLeft(line, end);
+    stats->commands++;
+
+    switch (command) {
+        case 'T': case 't': {
+            if (parsed != 4 || trailing) {
+                writeError(out, lineNumber, "usage: T x y z duration", stats);
+                return;
+            }
+            Vector3D target = { values[0], values[1], values[2] };
+            SweptEncounter passes[TRAVEL_MAX_PASSES];
+            int passCount = executeTravel(state, target, values[3], passes, TRAVEL_MAX_PASSES);
+            if (journal != NULL)
+                appendJournal(journal, state->currentTime, state->shipPosition);
+            appendText(out, "T ", 2);
+            appendFixed(out, state->currentTime, BATCH_DECIMALS);
+            writeVector(out, state->shipPosition);
+            appendChar(out, ' ');
+            appendString(out, getDestinationName(state->currentDestination.id));
+            appendChar(out, '\n');
+            for (int i = 0; i < passCount && i < TRAVEL_MAX_PASSES; i++) {
+                appendText(out, "P ", 2);
+                appendFixed(out, passes[i].time, BATCH_DECIMALS);
+                appendChar(out, ' ');
+                appendFixed(out, passes[i].distance, BATCH_DECIMALS);
+                appendChar(out, ' ');
+                appendString(out, passes[i].id == SWEPT_SUN ? "Sun" : knownDestinations[passes[i].id].name);
+                appendChar(out, '\n');
+            }
+            return;
+        }
+        case 'H': case 'h': {
+            if ((parsed != 2 && parsed != 4) || trailing) {
+                writeError(out, lineNumber, "usage: H r1 r2 [x y]", stats);
+                return;
+            }
+            double days;
+            if (fabs(values[0] - values[1]) < 1e-6 && parsed == 4) {
+                Vector3D target = { values[2], values[3], 0.0 };
+                days = computePhasingTime(state->shipPosition, target, 365.25 * pow(values[0], 1.5));
+            } else {
+                days = computeHohmannTransferTime(values[0], values[1]);
+            }
+            appendText(out, "H ", 2);
+            appendFixed(out, days, BATCH_DECIMALS);
+            appendChar(out, '\n');
+            return;
+        }
+        case 'I': case 'i': {
+            if (parsed != 0 || trailing) {
+                writeError(out, lineNumber, "usage: I", stats);
+                return;
+            }
+            Vector3D p = state->shipPosition;
+            appendText(out, "I ", 2);
+            appendFixed(out, state->currentTime, BATCH_DECIMALS);
+            writeVector(out, p);
+            appendChar(out, ' ');
+            appendFixed(out, sqrt(p.x * p.x + p.y * p.y), BATCH_DECIMALS);
+            appendChar(out, ' ');
+            appendString(out, getDestinationName(state->currentDestination.id));
+            appendChar(out, '\n');
+            return;
+        }
+        default:
+            writeError(out, lineNumber, "unknown command", stats);
+    }
+}
+
+int runBatch(int inputFd, int outputFd, ShipState *state, Journal *journal, BatchStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    OutputBuffer out;
+    char *input = malloc(BATCH_INPUT_CAPACITY);
+    if (input == NULL || openOutputBuffer(&out, outputFd, BATCH_OUTPUT_CAPACITY) != 0) {
+        free(input);
+        return -1;
+    }
+
+    size_t filled = 0;
+    int readFailed = 0, skippingLongLine = 0;
+    for (;;) {
+        STATS_BEGIN_TIMED(STATS_INPUT_READ);
+        ssize_t n = read(inputFd, input + filled, BATCH_INPUT_CAPACITY - filled);
+        STATS_END(STATS_INPUT_READ);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            readFailed = 1;
+        int atEnd = n <= 0;
+        filled += n > 0 ? (size_t)n : 0;
+
+        // Run every complete line; keep a partial last line for the next read.
+        const char *cursor = input;
+        const char *limit = input + filled;
+        for (;;) {
+            const char *newline = memchr(cursor, '\n', (size_t)(limit - cursor));
+            if (newline == NULL && !(atEnd && cursor < limit))
+                break;
+            const char *lineEnd = newline != NULL ? newline : limit;
+            stats->lines++;
+            if (skippingLongLine) {
+                skippingLongLine = 0;
+            } else {
+                STATS_BEGIN(STATS_BATCH_COMMAND);
+                runCommand(cursor, lineEnd, stats->lines, state, journal, &out, stats);
+                STATS_END(STATS_BATCH_COMMAND);
+            }
+            cursor = newline != NULL ? newline + 1 : limit;
+        }
+        filled = (size_t)(limit - cursor);
+        memmove(input, cursor, filled);
+        if (filled == BATCH_INPUT_CAPACITY) {
+            // A single line filled the buffer: report it and drop the rest of it.
+            writeError(&out, stats->lines + 1, "line too long", stats);
+            filled = 0;
+            skippingLongLine = 1;
+        }
+        if (atEnd)
+            break;
+    }
+
+    free(input);
+    int writeFailed = closeOutputBuffer(&out) != 0;
+    return readFailed || writeFailed ? -1 : 0;
+}
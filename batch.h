@@ -0,0 +1,31 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "navigation.h"
+#include "journal.h"
+
+// Non-interactive command stream, one command per line:
+//   T x y z duration     travel to (x, y, z) taking duration days
+//   H r1 r2 [x y]        Hohmann (or same-orbit phasing to x, y) transfer time
+//   I                    ship state
+// Blank lines and lines starting with '#' are ignored.
+//
+// Each command writes one space-separated result line:
+//   T time x y z name          followed by one line per close pass on the way,
+//   P time distance name       the destination reached on arrival included
+//   H days
+//   I time x y z distanceFromSun name
+//   E lineNumber message       (malformed or unknown command)
+
+typedef struct {
+    long long lines;
+    long long commands;
+    long long errors;
+} BatchStats;
+
+// Runs every command read from inputFd against state, writing results to
+// outputFd through a large buffer. Travel commands are appended to journal
+// unless it is NULL. Returns 0 on success, -1 on an I/O error.
+int runBatch(int inputFd, int outputFd, ShipState *state, Journal *journal, BatchStats *stats);
+
+#endif
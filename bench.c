@@ -0,0 +1,478 @@
+// Microbenchmarks for the navigation kernels.
+//
+// Usage: navigator_bench [--output FILE] [--baseline FILE] [--threshold PERCENT] [--max-size N]
+//
+// Every benchmark runs against synthetic catalogs of 8 (the built-in planets)
+// up to 1M bodies, a decade apart from 1000 on so that a lookup turning
+// linear in the catalog shows at every step. One sample times a batch of
+// operations sized to take about BENCH_BATCH_SECONDS; ns/op percentiles are
+// taken over BENCH_SAMPLES samples.
+// Results are written as JSON, one result per line. With --baseline, each
+// median is compared with the same benchmark in an earlier output file, and
+// slowdowns beyond the threshold are reported and make the exit status 2.
+// Each catalog also checks the position kernels: the double kernel against the
+// libm reference computeBodyPositionsScalar, and the float kernel against the
+// double one. An error beyond its bound makes the exit status 3.
+#include "catalog.h"
+#include "destinations.h"
+#include "navigation.h"
+#include "planet.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_SAMPLES 200
+#define BENCH_BATCH_SECONDS 50e-6
+#define BENCH_MAX_BATCH (1 << 22)
+#define BENCH_INPUTS 4096            // power of two, cycled through by every benchmark
+#define BENCH_DEFAULT_THRESHOLD 10.0 // percent
+#define BENCH_NAME_LENGTH 64
+#define BENCH_MAX_RESULTS 64
+#define BENCH_POSITION_BLOCK 1024    // bodies per batched position call
+#define BENCH_KERNEL_ERROR 1e-12     // bound of computeBodyPositions against libm, relative to the orbit radius
+#define BENCH_FLOAT_ERROR 5e-7       // bound of computeBodyPositionsF, relative to the orbit radius
+#define BENCH_FLOAT_TIMES 16
+
+static const int catalogSizes[] = { 8, 1000, 10000, 100000, 1000000 };
+
+// Inputs shared by the benchmarks, regenerated for each catalog.
+static double inputTimes[BENCH_INPUTS];
+static Vector3D inputPositions[BENCH_INPUTS];
+static int inputBodies[BENCH_INPUTS];
+static double inputRadii[BENCH_INPUTS];
+static char inputNames[BENCH_INPUTS][32];
+
+static ShipState benchState;
+
+static BodyTableF benchTableF;
+static double positionX[BENCH_POSITION_BLOCK], positionY[BENCH_POSITION_BLOCK], positionZ[BENCH_POSITION_BLOCK];
+static double referenceX[BENCH_POSITION_BLOCK], referenceY[BENCH_POSITION_BLOCK], referenceZ[BENCH_POSITION_BLOCK];
+static float positionXF[BENCH_POSITION_BLOCK], positionYF[BENCH_POSITION_BLOCK], positionZF[BENCH_POSITION_BLOCK];
+
+// Each benchmark performs count operations starting at input 'first' and
+// returns a value derived from the results so the work cannot be elided.
+typedef double (*BenchBody)(int first, int count);
+
+static double benchGetPlanetPosition(int first, int count) {
+    double sum = 0.0;
+    for (int i = first; i < first + count; i++) {
+        int k = i & (BENCH_INPUTS - 1);
+        sum += getPlanetPosition(knownDestinations[inputBodies[k]], inputTimes[k]).x;
+    }
+    return sum;
+}
+
+static double benchCalculateDistance(int first, int count) {
+    double sum = 0.0;
+    for (int i = first; i < first + count; i++) {
+        int k = i & (BENCH_INPUTS - 1);
+        sum += calculateDistance(inputPositions[k], inputPositions[k ^ 1]);
+    }
+    return sum;
+}
+
+static double benchDetermineDestination(int first, int count) {
+    double sum = 0.0;
+    for (int i = first; i < first + count; i++) {
+        int k = i & (BENCH_INPUTS - 1);
+        determineDestination(inputPositions[k], inputTimes[k], &benchState);
+        sum += benchState.currentDestination.position.x;
+    }
+    return sum;
+}
+
+static double benchHohmannTransferTime(int first, int count) {
+    double sum = 0.0;
+    for (int i = first; i < first + count; i++) {
+        int k = i & (BENCH_INPUTS - 1);
+        sum += computeHohmannTransferTime(inputRadii[k], inputRadii[k ^ 1]);
+    }
+    return sum;
+}
+
+static double benchPhasingTime(int first, int count) {
+    double sum = 0.0;
+    for (int i = first; i < first + count; i++) {
+        int k = i & (BENCH_INPUTS - 1);
+        sum += computePhasingTime(inputPositions[k], inputPositions[k ^ 1], 365.25 * pow(inputRadii[k], 1.5));
+    }
+    return sum;
+}
+
+static double benchGetDestinationByName(int first, int count) {
+    double sum = 0.0;
+    for (int i = first; i < first + count; i++) {
+        int k = i & (BENCH_INPUTS - 1);
+        sum += getDestinationByName(inputNames[k]) != NULL;
+    }
+    return sum;
+}
+
+// One operation is one body position, evaluated a block of bodies at a time.
+static double benchComputeBodyPositions(int first, int count) {
+    const BodyTable *table = getKnownDestinationsTable();
+    double sum = 0.0;
+    for (int done = 0, n; done < count; done += n) {
+        int k = (first + done) & (BENCH_INPUTS - 1);
+        n = count - done < BENCH_POSITION_BLOCK ? count - done : BENCH_POSITION_BLOCK;
+        n = n < table->count ? n : table->count;
+        BodyTable block = bodyTableSlice(table, inputBodies[k] % (table->count - n + 1), n);
+        computeBodyPositions(&block, &inputTimes[k], 1, positionX, positionY, positionZ);
+        sum += positionX[0];
+    }
+    return sum;
+}
+
+static double benchComputeBodyPositionsF(int first, int count) {
+    double sum = 0.0;
+    for (int done = 0, n; done < count; done += n) {
+        int k = (first + done) & (BENCH_INPUTS - 1);
+        n = count - done < BENCH_POSITION_BLOCK ? count - done : BENCH_POSITION_BLOCK;
+        n = n < benchTableF.count ? n : benchTableF.count;
+        BodyTableF block = bodyTableSliceF(&benchTableF, inputBodies[k] % (benchTableF.count - n + 1), n);
+        computeBodyPositionsF(&block, &inputTimes[k], 1, positionXF, positionYF, positionZF);
+        sum += positionXF[0];
+    }
+    return sum;
+}
+
+static const struct {
+    const char *name;
+    BenchBody body;
+} benchmarks[] = {
+    { "getPlanetPosition", benchGetPlanetPosition },
+    { "calculateDistance", benchCalculateDistance },
+    { "determineDestination", benchDetermineDestination },
+    { "computeHohmannTransferTime", benchHohmannTransferTime },
+    { "computePhasingTime", benchPhasingTime },
+    { "getDestinationByName", benchGetDestinationByName },
+    { "computeBodyPositions", benchComputeBodyPositions },
+    { "computeBodyPositionsF", benchComputeBodyPositionsF },
+};
+
+typedef struct {
+    char name[BENCH_NAME_LENGTH];
+    int size;
+    double nsPerOp;        // total time / total operations
+    double opsPerSecond;
+    double p50, p90, p99, min;
+} BenchResult;
+
+static volatile double benchSink;
+static unsigned long long benchSeed = 0x9e3779b97f4a7c15ull;
+
+static unsigned long long nextRandom(void) {
+    benchSeed ^= benchSeed << 13;
+    benchSeed ^= benchSeed >> 7;
+    benchSeed ^= benchSeed << 17;
+    return benchSeed;
+}
+
+static double uniform(double low, double high) {
+    return low + (high - low) * (double)(nextRandom() >> 11) / 9007199254740992.0;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// Replaces the known destinations with the built-in planets followed by
+// size - 8 synthetic minor bodies, through a temporary catalog file.
+static int loadSyntheticCatalog(const Planet *planets, int planetCount, int size) {
+    if (size <= planetCount)
+        return 0;
+    Planet *bodies = malloc((size_t)size * sizeof(Planet));
+    if (bodies == NULL)
+        return -1;
+    memcpy(bodies, planets, (size_t)planetCount * sizeof(Planet));
+    for (int i = planetCount; i < size; i++) {
+        Planet *body = &bodies[i];
+        memset(body, 0, sizeof(*body));
+        snprintf(body->name, sizeof(body->name), "Body-%07d", i);
+        body->orbitRadius = uniform(0.5, 40.0);
+        body->orbitalPeriod = 365.25 * pow(body->orbitRadius, 1.5);
+        if (i % 2 == 0) {
+            // Half the catalog on eccentric, inclined orbits.
+            body->eccentricity = uniform(0.0, 0.3);
+            body->inclination = uniform(0.0, 20.0);
+            body->ascendingNode = uniform(0.0, 360.0);
+            body->argumentOfPeriapsis = uniform(0.0, 360.0);
+        }
+        body->meanAnomalyAtEpoch = uniform(0.0, 360.0);
+    }
+    char path[] = "/tmp/navigator_bench_XXXXXX";
+    int fd = mkstemp(path);
+    int failed = fd < 0 || writeCatalog(path, bodies, size) != 0 || loadDestinationCatalog(path) != 0;
+    if (fd >= 0) {
+        close(fd);
+        unlink(path);   // the mapping keeps the data alive
+    }
+    free(bodies);
+    return failed ? -1 : 0;
+}
+
+static void prepareInputs(void) {
+    for (int k = 0; k < BENCH_INPUTS; k++) {
+        int body = (int)(nextRandom() % (unsigned long long)knownDestinationsCount);
+        double time = uniform(5000.0, 6000.0);
+        inputBodies[k] = body;
+        inputTimes[k] = time;
+        inputRadii[k] = knownDestinations[body].orbitRadius;
+        if (k % 2 == 0) {
+            // On a body: determineDestination finds it.
+            inputPositions[k] = getPlanetPosition(knownDestinations[body], time);
+        } else {
+            Vector3D random = { uniform(-10.0, 10.0), uniform(-10.0, 10.0), uniform(-0.5, 0.5) };
+            inputPositions[k] = random;
+        }
+        // One lookup in four misses.
+        if (k % 4 == 3)
+            snprintf(inputNames[k], sizeof(inputNames[k]), "Missing-%d", k);
+        else
+            snprintf(inputNames[k], sizeof(inputNames[k]), "%s", knownDestinations[body].name);
+    }
+}
+
+// Largest distance between the double kernel and the libm reference over the
+// catalog at times centuries apart, relative to each body's orbit radius.
+static double kernelPositionError(void) {
+    const BodyTable *table = getKnownDestinationsTable();
+    double worst = 0.0;
+    for (int first = 0; first < table->count; first += BENCH_POSITION_BLOCK) {
+        int n = table->count - first < BENCH_POSITION_BLOCK ? table->count - first : BENCH_POSITION_BLOCK;
+        BodyTable block = bodyTableSlice(table, first, n);
+        for (int t = 0; t < BENCH_FLOAT_TIMES; t++) {
+            double time = uniform(-1e5, 1e5);
+            computeBodyPositions(&block, &time, 1, positionX, positionY, positionZ);
+            computeBodyPositionsScalar(&block, &time, 1, referenceX, referenceY, referenceZ);
+            for (int i = 0; i < n; i++) {
+                double dx = positionX[i] - referenceX[i];
+                double dy = positionY[i] - referenceY[i];
+                double dz = positionZ[i] - referenceZ[i];
+                double error = sqrt(dx * dx + dy * dy + dz * dz) / block.orbitRadius[i];
+                worst = error > worst ? error : worst;
+            }
+        }
+    }
+    return worst;
+}
+
+// Largest distance between the float and double kernels over the catalog at
+// times centuries apart, relative to each body's orbit radius.
+static double floatPositionError(void) {
+    const BodyTable *table = getKnownDestinationsTable();
+    double worst = 0.0;
+    for (int first = 0; first < table->count; first += BENCH_POSITION_BLOCK) {
+        int n = table->count - first < BENCH_POSITION_BLOCK ? table->count - first : BENCH_POSITION_BLOCK;
+        BodyTable block = bodyTableSlice(table, first, n);
+        BodyTableF blockF = bodyTableSliceF(&benchTableF, first, n);
+        for (int t = 0; t < BENCH_FLOAT_TIMES; t++) {
+            double time = uniform(-1e5, 1e5);
+            computeBodyPositions(&block, &time, 1, positionX, positionY, positionZ);
+            computeBodyPositionsF(&blockF, &time, 1, positionXF, positionYF, positionZF);
+            for (int i = 0; i < n; i++) {
+                double dx = positionXF[i] - positionX[i];
+                double dy = positionYF[i] - positionY[i];
+                double dz = positionZF[i] - positionZ[i];
+                double error = sqrt(dx * dx + dy * dy + dz * dz) / block.orbitRadius[i];
+                worst = error > worst ? error : worst;
+            }
+        }
+    }
+    return worst;
+}
+
+static void runBenchmark(const char *name, BenchBody body, int size, BenchResult *result) {
+    // Warm up (builds lazy indexes) and size the batch.
+    int batch = 16;
+    benchSink = body(0, batch);
+    for (;;) {
+        double start = now();
+        benchSink = body(0, batch);
+        if (now() - start >= BENCH_BATCH_SECONDS || batch >= BENCH_MAX_BATCH)
+            break;
+        batch *= 2;
+    }
+
+    double samples[BENCH_SAMPLES];
+    double total = 0.0;
+    int first = 0;
+    for (int s = 0; s < BENCH_SAMPLES; s++) {
+        double start = now();
+        benchSink = body(first, batch);
+        double seconds = now() - start;
+        first = (first + batch) & (BENCH_INPUTS - 1);
+        total += seconds;
+        samples[s] = seconds * 1e9 / batch;
+    }
+    qsort(samples, BENCH_SAMPLES, sizeof(double), compareDouble);
+
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->size = size;
+    result->nsPerOp = total * 1e9 / ((double)batch * BENCH_SAMPLES);
+    result->opsPerSecond = 1e9 / result->nsPerOp;
+    result->min = samples[0];
+    result->p50 = samples[BENCH_SAMPLES / 2];
+    result->p90 = samples[BENCH_SAMPLES * 9 / 10];
+    result->p99 = samples[BENCH_SAMPLES * 99 / 100];
+}
+
+static void writeResults(FILE *out, const BenchResult *results, int count) {
+    fprintf(out, "{\n  \"kernel\": \"%s\",\n  \"samples\": %d,\n  \"results\": [\n",
+            ephemerisKernelName(), BENCH_SAMPLES);
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"size\": %d, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f, "
+                "\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"min\": %.3f}%s\n",
+                r->name, r->size, r->nsPerOp, r->opsPerSecond, r->p50, r->p90, r->p99, r->min,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// Reads the results of an earlier writeResults. Returns the count, or -1 if the file cannot be read.
+static int readResults(const char *path, BenchResult *results, int capacity) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+        return -1;
+    char line[512];
+    int count = 0;
+    while (count < capacity && fgets(line, sizeof(line), in) != NULL) {
+        BenchResult *r = &results[count];
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"size\": %d, \"ns_per_op\": %lf, \"ops_per_sec\": %lf, "
+                         "\"p50\": %lf, \"p90\": %lf, \"p99\": %lf, \"min\": %lf",
+                   r->name, &r->size, &r->nsPerOp, &r->opsPerSecond, &r->p50, &r->p90, &r->p99, &r->min) == 8)
+            count++;
+    }
+    fclose(in);
+    return count;
+}
+
+static const BenchResult *findResult(const BenchResult *results, int count, const char *name, int size) {
+    for (int i = 0; i < count; i++) {
+        if (results[i].size == size && strcmp(results[i].name, name) == 0)
+            return &results[i];
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    const char *outputPath = NULL;
+    const char *baselinePath = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    int maxSize = catalogSizes[sizeof(catalogSizes) / sizeof(catalogSizes[0]) - 1];
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            maxSize = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--output FILE] [--baseline FILE] [--threshold PERCENT] [--max-size N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    // Keep the built-in planets to seed every synthetic catalog.
+    int planetCount = knownDestinationsCount;
+    Planet *planets = malloc((size_t)planetCount * sizeof(Planet));
+    if (planets == NULL)
+        return 1;
+    memcpy(planets, knownDestinations, (size_t)planetCount * sizeof(Planet));
+
+    BenchResult results[BENCH_MAX_RESULTS];
+    int resultCount = 0;
+    int kernelErrors = 0, floatErrors = 0;
+    int benchmarkCount = (int)(sizeof(benchmarks) / sizeof(benchmarks[0]));
+    for (size_t c = 0; c < sizeof(catalogSizes) / sizeof(catalogSizes[0]); c++) {
+        int size = catalogSizes[c];
+        if (size > maxSize)
+            break;
+        if (loadSyntheticCatalog(planets, planetCount, size) != 0) {
+            fprintf(stderr, "Error: could not create a catalog of %d bodies\n", size);
+            free(planets);
+            return 1;
+        }
+        prepareInputs();
+        freeBodyTableF(&benchTableF);
+        if (getKnownDestinationsTable() == NULL || buildBodyTableF(&benchTableF, getKnownDestinationsTable()) != 0) {
+            fprintf(stderr, "Error: could not build the body tables\n");
+            free(planets);
+            return 1;
+        }
+        double kernelError = kernelPositionError();
+        kernelErrors += kernelError > BENCH_KERNEL_ERROR;
+        fprintf(stderr, "%s positions, %d bodies: largest error %.3g of the orbit radius%s\n", ephemerisKernelName(),
+                size, kernelError, kernelError > BENCH_KERNEL_ERROR ? " (BEYOND THE BOUND)" : "");
+        double floatError = floatPositionError();
+        floatErrors += floatError > BENCH_FLOAT_ERROR;
+        fprintf(stderr, "Float positions, %d bodies: largest error %.3g of the orbit radius%s\n", size, floatError,
+                floatError > BENCH_FLOAT_ERROR ? " (BEYOND THE BOUND)" : "");
+        for (int b = 0; b < benchmarkCount && resultCount < BENCH_MAX_RESULTS; b++) {
+            BenchResult *r = &results[resultCount++];
+            runBenchmark(benchmarks[b].name, benchmarks[b].body, size, r);
+            fprintf(stderr, "%-28s %8d bodies %10.2f ns/op  p50 %9.2f  p99 %9.2f\n",
+                    r->name, r->size, r->nsPerOp, r->p50, r->p99);
+        }
+    }
+    free(planets);
+    freeBodyTableF(&benchTableF);
+
+    FILE *out = outputPath != NULL ? fopen(outputPath, "w") : stdout;
+    if (out == NULL) {
+        perror(outputPath);
+        return 1;
+    }
+    writeResults(out, results, resultCount);
+    if (out != stdout && fclose(out) != 0) {
+        perror(outputPath);
+        return 1;
+    }
+
+    if (kernelErrors > 0)
+        fprintf(stderr, "%s positions beyond the %.1g bound on %d catalog(s)\n", ephemerisKernelName(),
+                BENCH_KERNEL_ERROR, kernelErrors);
+    if (floatErrors > 0)
+        fprintf(stderr, "Float positions beyond the %.1g bound on %d catalog(s)\n", BENCH_FLOAT_ERROR, floatErrors);
+    int failure = kernelErrors > 0 || floatErrors > 0 ? 3 : 0;
+    if (baselinePath == NULL)
+        return failure;
+    BenchResult baseline[BENCH_MAX_RESULTS];
+    int baselineCount = readResults(baselinePath, baseline, BENCH_MAX_RESULTS);
+    if (baselineCount < 0) {
+        perror(baselinePath);
+        return 1;
+    }
+    int regressions = 0;
+    fprintf(stderr, "\nCompared with %s (median ns/op, threshold %.1f%%):\n", baselinePath, threshold);
+    for (int i = 0; i < resultCount; i++) {
+        const BenchResult *r = &results[i];
+        const BenchResult *base = findResult(baseline, baselineCount, r->name, r->size);
+        if (base == NULL || base->p50 <= 0.0)
+            continue;
+        double change = 100.0 * (r->p50 - base->p50) / base->p50;
+        int regressed = change > threshold;
+        regressions += regressed;
+        fprintf(stderr, "%-28s %8d bodies %9.2f -> %9.2f  %+7.1f%%%s\n",
+                r->name, r->size, base->p50, r->p50, change, regressed ? "  REGRESSION" : "");
+    }
+    if (regressions > 0) {
+        fprintf(stderr, "%d benchmark(s) slower than the baseline\n", regressions);
+        return 2;
+    }
+    return failure;
+}
@@ -1,7 +1,82 @@
 #!/bin/bash
-clang -c planet.c -o planet.o
-clang -c destinations.c -o destinations.o
-clang -c navigation.c -o navigation.o
-clang -c main.c -o main.o
-clang planet.o destinations.o navigation.o main.o -o space_navigator
-./space_navigator
+# Usage: [STATS=0] ./build.sh [release|debug|asan|tsan|bench|check]
+#
+#   release   -O3 -march=native (default)            -> space_navigator, catalog_convert,
+#                                                       navigator_loadgen
+#   debug     -O0 -g                                 -> space_navigator-debug
+#   asan      AddressSanitizer + UBSan               -> space_navigator-asan
+#   tsan      ThreadSanitizer                        -> space_navigator-tsan
+#   bench     release flags, builds and runs navigator_bench; results go to
+#             bench_output.txt and are compared with bench_baseline.json when
+#             it exists (copy bench_output.txt there to accept new numbers).
+#   check     -O2 -g with assertions, builds and runs navigator_check; fails
+#             the build when any check fails.
+#
+# Objects go to build/<mode>/. Set CC to use another compiler. Hot-path
+# statistics (stats.h) are compiled in unless STATS=0.
+set -e
+cd "$(dirname "$0")"
+
+MODE=${1:-release}
+CC=${CC:-clang}
+WARNINGS="-Wall -Wextra"
+
+case "$MODE" in
+    release|bench) CFLAGS="-O3 -march=native -DNDEBUG"; SUFFIX="" ;;
+    debug)         CFLAGS="-O0 -g"; SUFFIX="-debug" ;;
+    asan)          CFLAGS="-O1 -g -fno-omit-frame-pointer -fsanitize=address,undefined"; SUFFIX="-asan" ;;
+    tsan)          CFLAGS="-O1 -g -fsanitize=thread"; SUFFIX="-tsan" ;;
+    check)         CFLAGS="-O2 -g -march=native"; SUFFIX="-check" ;;
+    *)
+        echo "Unknown build mode: $MODE" >&2
+        echo "Usage: $0 [release|debug|asan|tsan|bench|check]" >&2
+        exit 1 ;;
+esac
+if [ "${STATS:-1}" != "0" ]; then
+    CFLAGS="$CFLAGS -DNAVIGATOR_STATS"
+fi
+
+# Every module except the programs' main files, in dependency order.
+MODULES="stats planet ephemeris spatialindex catalog ephemeriscache ephemerisexport nameindex stringarena threadpool integrator destinations
+         lambert porkchop routeplanner textio journal batch fleet dispersion conjunction scheduler snapshot server navigation
+         porkchopmode fleetmode cachemode propagatemode exportmode servemode dispersionmode conjunctionmode voyagemode"
+
+OBJDIR="build/$MODE"
+mkdir -p "$OBJDIR"
+
+compile() {
+    $CC $CFLAGS $WARNINGS -c "$1.c" -o "$OBJDIR/$1.o"
+}
+
+OBJECTS=""
+for module in $MODULES; do
+    compile "$module"
+    OBJECTS="$OBJECTS $OBJDIR/$module.o"
+done
+LIBS="-lm -lpthread"
+
+compile main
+$CC $CFLAGS $OBJECTS "$OBJDIR/main.o" $LIBS -o "space_navigator$SUFFIX"
+compile catalog_convert
+$CC $CFLAGS "$OBJDIR/catalog_convert.o" "$OBJDIR/catalog.o" "$OBJDIR/ephemeris.o" "$OBJDIR/nameindex.o" \
+    "$OBJDIR/planet.o" "$OBJDIR/stats.o" $LIBS -o "catalog_convert$SUFFIX"
+compile loadgen
+$CC $CFLAGS "$OBJDIR/loadgen.o" $LIBS -o "navigator_loadgen$SUFFIX"
+
+if [ "$MODE" = "bench" ]; then
+    compile bench
+    $CC $CFLAGS $OBJECTS "$OBJDIR/bench.o" $LIBS -o navigator_bench
+    BASELINE=""
+    if [ -f bench_baseline.json ]; then
+        BASELINE="--baseline bench_baseline.json"
+    fi
+    ./navigator_bench --output bench_output.txt $BASELINE
+fi
+
+if [ "$MODE" = "check" ]; then
+    compile check
+    $CC $CFLAGS $OBJECTS "$OBJDIR/check.o" $LIBS -o navigator_check
+    ./navigator_check
+fi
+
+echo "Built space_navigator$SUFFIX ($MODE)"
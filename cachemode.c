@@ -0,0 +1,52 @@
+#include "modes.h"
+#include "destinations.h"
+#include "ephemeriscache.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EPHEMERIS_SEGMENTS_PER_ORBIT 8
+#define EPHEMERIS_COEFFICIENTS 12
+#define EPHEMERIS_TOLERANCE 1e-9          // in AU, about 150 m
+
+int runEphemerisBuildMode(char **args, int threads) {
+    EphemerisCacheParameters parameters;
+    parameters.startTime = atof(args[1]);
+    parameters.endTime = atof(args[2]);
+    parameters.segmentsPerOrbit = EPHEMERIS_SEGMENTS_PER_ORBIT;
+    parameters.coefficientCount = EPHEMERIS_COEFFICIENTS;
+    parameters.tolerance = EPHEMERIS_TOLERANCE;
+    const BodyTable *table = getKnownDestinationsTable();
+    if (table == NULL || !(parameters.endTime > parameters.startTime)) {
+        printf("Error: invalid ephemeris span\n");
+        return 1;
+    }
+
+    ThreadPool *pool = createThreadPool(threads);
+    int workers = threadPoolSize(pool);
+    EphemerisSource source = bodyTableSource(table);
+    EphemerisCache cache;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = buildEphemerisCache(&cache, &source, &parameters, pool);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    destroyThreadPool(pool);
+    if (failed) {
+        printf("Error: could not build the ephemeris cache (largest error %.3g AU, tolerance %.3g AU)\n",
+               cache.maxError, parameters.tolerance);
+        return 1;
+    }
+    if (writeEphemerisCache(&cache, args[0]) != 0) {
+        perror(args[0]);
+        freeEphemerisCache(&cache);
+        return 1;
+    }
+    long long segments = 0;
+    for (int i = 0; i < cache.bodyCount; i++)
+        segments += cache.bodies[i].segmentCount;
+    printf("%d bodies, %lld segments in %.3f s on %d threads, written to %s\n",
+           cache.bodyCount, segments, elapsedSeconds(start, stop), workers, args[0]);
+    printf("Verified error: %.3g AU (tolerance %.3g AU)\n", cache.maxError, cache.tolerance);
+    freeEphemerisCache(&cache);
+    return 0;
+}
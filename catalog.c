@@ -0,0 +1,126 @@
+#include "catalog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + CATALOG_ALIGNMENT - 1) & ~(uint64_t)(CATALOG_ALIGNMENT - 1);
+}
+
+static int writePadding(FILE *file, uint64_t *offset, uint64_t target) {
+    static const char zeros[CATALOG_ALIGNMENT];
+    if (target > *offset && fwrite(zeros, 1, target - *offset, file) != target - *offset)
+        return -1;
+    *offset = target;
+    return 0;
+}
+
+int writeCatalog(const char *path, const Planet *planets, int count) {
+    BodyTable bodies;
+    if (buildBodyTable(&bodies, planets, count) != 0)
+        return -1;
+    CatalogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.version = CATALOG_VERSION;
+    header.headerSize = sizeof(CatalogHeader);
+    header.count = (uint64_t)count;
+    header.recordSize = sizeof(Planet);
+    header.recordsOffset = alignUp(sizeof(CatalogHeader));
+    header.columnCount = BODY_TABLE_COLUMNS;
+    header.columnsOffset = alignUp(header.recordsOffset + header.count * sizeof(Planet));
+    header.columnStride = alignUp(header.count * sizeof(double));
+    header.fileSize = header.columnsOffset + header.columnCount * header.columnStride;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        freeBodyTable(&bodies);
+        return -1;
+    }
+    uint64_t offset = sizeof(header);
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    failed = failed || writePadding(file, &offset, header.recordsOffset) != 0;
+    failed = failed || fwrite(planets, sizeof(Planet), (size_t)count, file) != (size_t)count;
+    offset += header.count * sizeof(Planet);
+    for (int k = 0; k < BODY_TABLE_COLUMNS && !failed; k++) {
+        failed = writePadding(file, &offset, header.columnsOffset + k * header.columnStride) != 0;
+        failed = failed || fwrite(bodyTableColumn(&bodies, k), sizeof(double), (size_t)count, file) != (size_t)count;
+        offset += header.count * sizeof(double);
+    }
+    failed = failed || writePadding(file, &offset, header.fileSize) != 0;
+    if (fclose(file) != 0)
+        failed = 1;
+    freeBodyTable(&bodies);
+    return failed ? -1 : 0;
+}
+
+static int sectionFits(const CatalogHeader *header, uint64_t offset, uint64_t elementSize, size_t fileSize) {
+    if (offset % CATALOG_ALIGNMENT != 0 || offset > fileSize)
+        return 0;
+    return header->count <= (fileSize - offset) / elementSize;
+}
+
+int openCatalog(MappedCatalog *catalog, const char *path) {
+    memset(catalog, 0, sizeof(*catalog));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CatalogHeader)) {
+        fprintf(stderr, "%s: not a body catalog\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    const CatalogHeader *header = base;
+    const char *problem = NULL;
+    if (memcmp(header->magic, CATALOG_MAGIC, sizeof(header->magic)) != 0)
+        problem = "bad magic";
+    else if (header->version != CATALOG_VERSION)
+        problem = "unsupported version";
+    else if (header->headerSize != sizeof(CatalogHeader) || header->recordSize != sizeof(Planet) ||
+             header->columnCount != BODY_TABLE_COLUMNS)
+        problem = "record layout mismatch";
+    else if (header->count > (uint64_t)0x7fffffff || header->fileSize > size)
+        problem = "truncated file";
+    else if (!sectionFits(header, header->recordsOffset, sizeof(Planet), size) ||
+             header->columnsOffset > size || header->columnStride > size ||
+             header->columnStride % CATALOG_ALIGNMENT != 0 ||
+             header->columnStride / sizeof(double) < header->count ||
+             !sectionFits(header, header->columnsOffset + (BODY_TABLE_COLUMNS - 1) * header->columnStride,
+                          sizeof(double), size))
+        problem = "section out of range";
+    if (problem != NULL) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        munmap(base, size);
+        return -1;
+    }
+
+    catalog->base = base;
+    catalog->size = size;
+    catalog->header = header;
+    catalog->records = (Planet *)((char *)base + header->recordsOffset);
+    bindBodyTable(&catalog->bodies, (int)header->count,
+                  (const double *)((const char *)base + header->columnsOffset),
+                  header->columnStride / sizeof(double));
+    return 0;
+}
+
+void closeCatalog(MappedCatalog *catalog) {
+    if (catalog->base != NULL)
+        munmap(catalog->base, catalog->size);
+    memset(catalog, 0, sizeof(*catalog));
+}
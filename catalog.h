@@ -0,0 +1,48 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "planet.h"
+#include "ephemeris.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CATALOG_MAGIC "SWCATLG"  // 8 bytes including the terminator
+#define CATALOG_VERSION 3        // 2: Keplerian elements and the full BodyTable columns; 3: masses
+#define CATALOG_ALIGNMENT 64     // every section starts on a cache line
+
+// On-disk header of a binary body catalog. All offsets are from the start of
+// the file. The records section holds Planet structs verbatim so it can back
+// knownDestinations directly; the BodyTable columns (per-body constants
+// precomputed by buildBodyTable) back the batched ephemeris without copying.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t count;
+    uint64_t recordSize;       // sizeof(Planet) of the writer
+    uint64_t recordsOffset;    // Planet[count]
+    uint64_t columnCount;      // BODY_TABLE_COLUMNS of the writer
+    uint64_t columnsOffset;    // first of columnCount double[count] columns, in BodyTable field order
+    uint64_t columnStride;     // bytes from the start of one column to the next
+    uint64_t fileSize;
+} CatalogHeader;
+
+// A catalog file mapped into memory.
+typedef struct {
+    void *base;
+    size_t size;
+    const CatalogHeader *header;
+    Planet *records;
+    BodyTable bodies;          // view of the mapped columns
+} MappedCatalog;
+
+// Writes planets to path in the binary catalog format. Returns 0 on success, -1 on error.
+int writeCatalog(const char *path, const Planet *planets, int count);
+
+// Maps and validates a catalog file. Records are mapped copy-on-write so the
+// page cache is shared between processes until a record is modified.
+// Returns 0 on success, -1 on error (a reason is printed to stderr).
+int openCatalog(MappedCatalog *catalog, const char *path);
+void closeCatalog(MappedCatalog *catalog);
+
+#endif
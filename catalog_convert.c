@@ -0,0 +1,185 @@
+// Converts a CSV body catalog into the binary format loaded by --catalog.
+//
+// Input lines: name,orbitRadius(AU),orbitalPeriod(days)[,e,i,node,periapsis,meanAnomaly[,mass]]
+// The optional Keplerian elements are eccentricity and angles in degrees, and
+// mass is in solar masses; missing trailing fields are zero.
+// Blank lines, lines starting with '#' and a non-numeric header row before
+// the first body are skipped. Any other row that is not a valid body, and a
+// name used twice, is reported with its line number; the catalog is then not
+// written and the exit status is 1.
+#include "catalog.h"
+#include "nameindex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_MAX_LENGTH 1024
+#define ROW_MAX_FIELDS 9
+
+// Splits line at commas into at most maxFields fields, dropping the line
+// ending. Returns the number of fields, or maxFields + 1 if there are more.
+static int splitFields(char *line, char **fields, int maxFields) {
+    line[strcspn(line, "\r\n")] = '\0';
+    int count = 0;
+    for (char *field = line;; field++) {
+        if (count == maxFields)
+            return maxFields + 1;
+        fields[count++] = field;
+        field = strchr(field, ',');
+        if (field == NULL)
+            return count;
+        *field = '\0';
+    }
+}
+
+// Parses a whole field as a number, blanks around it allowed. Returns 1 on success.
+static int parseField(const char *field, double *value) {
+    char *end;
+    *value = strtod(field, &end);
+    if (end == field)
+        return 0;
+    while (*end == ' ' || *end == '\t')
+        end++;
+    return *end == '\0';
+}
+
+// Parses one CSV row into planet. Returns NULL on success, or why the row is
+// not a body. *header is set when the row reads like a header: its radius
+// field is not a number.
+static const char *parseRow(char *line, Planet *planet, int *header) {
+    char *fields[ROW_MAX_FIELDS];
+    int fieldCount = splitFields(line, fields, ROW_MAX_FIELDS);
+    *header = 0;
+    if (fieldCount > ROW_MAX_FIELDS)
+        return "too many fields";
+    if (fieldCount < 3)
+        return "expected name,orbitRadius,orbitalPeriod";
+    memset(planet, 0, sizeof(*planet));
+    char *name = fields[0];
+    while (*name == ' ')
+        name++;
+    if (*name == '\0')
+        return "missing name";
+    if (strlen(name) >= sizeof(planet->name))
+        return "name longer than 31 characters";
+    strcpy(planet->name, name);
+    if (!parseField(fields[1], &planet->orbitRadius)) {
+        *header = 1;
+        return "orbit radius is not a number";
+    }
+    if (!(planet->orbitRadius > 0.0))
+        return "orbit radius must be positive";
+    if (!parseField(fields[2], &planet->orbitalPeriod))
+        return "orbital period is not a number";
+    if (!(planet->orbitalPeriod > 0.0))
+        return "orbital period must be positive";
+    double *elements[] = {
+        &planet->eccentricity, &planet->inclination, &planet->ascendingNode,
+        &planet->argumentOfPeriapsis, &planet->meanAnomalyAtEpoch, &planet->mass
+    };
+    for (int i = 3; i < fieldCount; i++) {
+        if (!parseField(fields[i], elements[i - 3]))
+            return "orbital element is not a number";
+    }
+    if (!(planet->eccentricity >= 0.0 && planet->eccentricity < 1.0))
+        return "eccentricity must be in [0, 1)";
+    if (!(planet->mass >= 0.0))
+        return "mass must not be negative";
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s input.csv output.cat\n", argv[0]);
+        return 1;
+    }
+    FILE *input = fopen(argv[1], "r");
+    if (input == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    int count = 0, capacity = 1024, lineNumber = 0, errors = 0, rows = 0, outOfMemory = 0;
+    Planet *planets = malloc((size_t)capacity * sizeof(Planet));
+    int *lines = malloc((size_t)capacity * sizeof(int));   // line number of each body
+    char line[LINE_MAX_LENGTH];
+    while (planets != NULL && lines != NULL && fgets(line, sizeof(line), input) != NULL) {
+        lineNumber++;
+        if (strchr(line, '\n') == NULL && !feof(input)) {
+            fprintf(stderr, "%s:%d: line longer than %d characters\n", argv[1], lineNumber, LINE_MAX_LENGTH - 2);
+            errors++;
+            int c;
+            while ((c = fgetc(input)) != EOF && c != '\n')
+                ;
+            continue;
+        }
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+        if (count == capacity) {
+            capacity *= 2;
+            Planet *grown = realloc(planets, (size_t)capacity * sizeof(Planet));
+            if (grown != NULL)
+                planets = grown;
+            int *grownLines = grown != NULL ? realloc(lines, (size_t)capacity * sizeof(int)) : NULL;
+            if (grownLines == NULL) {
+                outOfMemory = 1;
+                break;
+            }
+            lines = grownLines;
+        }
+        int header;
+        const char *problem = parseRow(line, &planets[count], &header);
+        if (problem == NULL) {
+            lines[count++] = lineNumber;
+        } else if (!(header && rows == 0)) {
+            fprintf(stderr, "%s:%d: %s\n", argv[1], lineNumber, problem);
+            errors++;
+        }
+        rows++;
+    }
+    fclose(input);
+    if (planets == NULL || lines == NULL || outOfMemory) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(planets);
+        free(lines);
+        return 1;
+    }
+
+    NameIndex names;
+    if (buildNameIndex(&names, planets, count) != 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(planets);
+        free(lines);
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        int first = findName(&names, planets[i].name);
+        if (first != i) {
+            fprintf(stderr, "%s:%d: duplicate name \"%s\" (first on line %d)\n", argv[1], lines[i],
+                    planets[i].name, lines[first]);
+            errors++;
+        }
+    }
+    freeNameIndex(&names);
+    if (count == 0 && errors == 0) {
+        fprintf(stderr, "%s: no bodies\n", argv[1]);
+        errors++;
+    }
+    if (errors > 0) {
+        fprintf(stderr, "%s: %d error(s), %s not written\n", argv[1], errors, argv[2]);
+        free(planets);
+        free(lines);
+        return 1;
+    }
+
+    if (writeCatalog(argv[2], planets, count) != 0) {
+        perror(argv[2]);
+        free(planets);
+        free(lines);
+        return 1;
+    }
+    printf("Wrote %d bodies to %s\n", count, argv[2]);
+    free(planets);
+    free(lines);
+    return 0;
+}
@@ -0,0 +1,1120 @@
+// Regression checks for the navigation modules.
+//
+// Usage: navigator_check [NAME...]
+//
+// Runs every check, or only the named ones, and prints one line per check.
+// Each check compares a fast path with a slow, obviously correct one (a libm
+// evaluation, a brute-force scan) or feeds a module input it must reject. A
+// failed check prints what differed; any failure makes the exit status 1, an
+// unknown check name 2.
+#include "catalog.h"
+#include "destinations.h"
+#include "ephemeris.h"
+#include "ephemeriscache.h"
+#include "journal.h"
+#include "planet.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "spatialindex.h"
+#include "textio.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PI 3.141592653589793
+
+#define CHECK_BODIES 2000
+#define CHECK_TIMES 16
+#define CHECK_KERNEL_ERROR 1e-12     // bound of computeBodyPositions against libm, relative to the orbit radius
+#define CHECK_INDEX_BODIES 40000   // enough for the index to band its eccentric classes
+#define CHECK_INDEX_QUERIES 400
+#define CHECK_INDEX_EPOCH 5000.0
+#define CHECK_NEAREST_K 4
+#define CHECK_CONVERTER "./catalog_convert-check"   // built next to navigator_check by build.sh check
+#define CHECK_CATALOG_BODIES 300
+#define CHECK_SCHEDULER_EVENTS 6000
+#define CHECK_SCHEDULER_BATCH 8
+#define CHECK_TEXT_VALUES 20000
+#define CHECK_JOURNAL_RECORDS 100
+#define CHECK_FINGERPRINT_BODIES 200
+#define CHECK_SNAPSHOT_SHIPS 10
+#define CHECK_CACHE_DAYS 365.0
+#define CHECK_CACHE_TOLERANCE 1e-9   // in AU, as the build-ephemeris mode fits
+#define CHECK_SWEEP_BODIES 300
+#define CHECK_SWEEP_TRANSITS 8
+#define CHECK_SWEEP_STEPS 2000       // samples of each body along a transit
+#define CHECK_SWEEP_LIMIT 0.05       // in AU
+#define CHECK_KEPLER_RESIDUAL 1e-9  // bound of |E - e sin E - M|, in radians
+#define CHECK_MAX_REPORTS 5          // failures printed per check
+
+static unsigned long long checkSeed = 0x9e3779b97f4a7c15ull;
+
+static unsigned long long nextRandom(void) {
+    checkSeed ^= checkSeed << 13;
+    checkSeed ^= checkSeed >> 7;
+    checkSeed ^= checkSeed << 17;
+    return checkSeed;
+}
+
+static double uniform(double low, double high) {
+    return low + (high - low) * (double)(nextRandom() >> 11) / 9007199254740992.0;
+}
+
+// Name and failure count of the running check.
+static const char *checkName;
+static int checkFailures;
+
+static void fail(const char *format, ...) {
+    if (checkFailures++ >= CHECK_MAX_REPORTS)
+        return;
+    va_list args;
+    va_start(args, format);
+    printf("  %s: ", checkName);
+    vprintf(format, args);
+    fputc('\n', stdout);
+    va_end(args);
+}
+
+// Fills bodies with synthetic minor bodies: a third circular and planar, a
+// third mildly eccentric and inclined, and a third up to e = 0.95 at any
+// inclination, retrograde included, all at random phases.
+static void makeBodies(Planet *bodies, int count) {
+    for (int i = 0; i < count; i++) {
+        Planet *body = &bodies[i];
+        memset(body, 0, sizeof(*body));
+        snprintf(body->name, sizeof(body->name), "Body-%07d", i);
+        body->orbitRadius = uniform(0.3, 40.0);
+        body->orbitalPeriod = 365.25 * pow(body->orbitRadius, 1.5);
+        if (i % 3 != 0) {
+            body->eccentricity = i % 3 == 1 ? uniform(0.0, 0.3) : uniform(0.3, 0.95);
+            body->inclination = i % 3 == 1 ? uniform(0.0, 40.0) : uniform(0.0, 180.0);
+            body->ascendingNode = uniform(0.0, 360.0);
+            body->argumentOfPeriapsis = uniform(0.0, 360.0);
+        }
+        body->meanAnomalyAtEpoch = uniform(0.0, 360.0);
+    }
+}
+
+// computeBodyPositions, computeBodyPositionsAtTimes and computeBodyPosition
+// against the libm reference computeBodyPositionsScalar.
+static void checkKernelPositions(void) {
+    Planet *bodies = malloc(CHECK_BODIES * sizeof(Planet));
+    double *columns = malloc(12 * CHECK_BODIES * sizeof(double));
+    BodyTable table;
+    if (bodies == NULL || columns == NULL) {
+        fail("out of memory");
+        free(bodies);
+        free(columns);
+        return;
+    }
+    makeBodies(bodies, CHECK_BODIES);
+    if (buildBodyTable(&table, bodies, CHECK_BODIES) != 0) {
+        fail("buildBodyTable failed");
+        free(bodies);
+        free(columns);
+        return;
+    }
+    double *x = columns, *y = x + CHECK_BODIES, *z = y + CHECK_BODIES;
+    double *refX = z + CHECK_BODIES, *refY = refX + CHECK_BODIES, *refZ = refY + CHECK_BODIES;
+    double *atX = refZ + CHECK_BODIES, *atY = atX + CHECK_BODIES, *atZ = atY + CHECK_BODIES;
+    double *times = atZ + CHECK_BODIES;
+    for (int t = 0; t < CHECK_TIMES; t++) {
+        double time = uniform(-1e5, 1e5);
+        computeBodyPositions(&table, &time, 1, x, y, z);
+        computeBodyPositionsScalar(&table, &time, 1, refX, refY, refZ);
+        for (int i = 0; i < CHECK_BODIES; i++)
+            times[i] = time;
+        computeBodyPositionsAtTimes(&table, times, atX, atY, atZ);
+        for (int i = 0; i < CHECK_BODIES; i++) {
+            double a = table.orbitRadius[i];
+            double error = sqrt((x[i] - refX[i]) * (x[i] - refX[i]) + (y[i] - refY[i]) * (y[i] - refY[i]) +
+                                (z[i] - refZ[i]) * (z[i] - refZ[i])) / a;
+            if (!(error <= CHECK_KERNEL_ERROR))
+                fail("%s, body %d (e = %.3f) at t = %.3f: error %.3g of the orbit radius",
+                     ephemerisKernelName(), i, bodies[i].eccentricity, time, error);
+            if (atX[i] != x[i] || atY[i] != y[i] || atZ[i] != z[i])
+                fail("computeBodyPositionsAtTimes differs from computeBodyPositions on body %d", i);
+            Vector3D single = computeBodyPosition(&table, i, time);
+            if (fabs(single.x - x[i]) > CHECK_KERNEL_ERROR * a || fabs(single.y - y[i]) > CHECK_KERNEL_ERROR * a ||
+                fabs(single.z - z[i]) > CHECK_KERNEL_ERROR * a)
+                fail("computeBodyPosition differs from computeBodyPositions on body %d", i);
+        }
+    }
+    freeBodyTable(&table);
+    free(bodies);
+    free(columns);
+}
+
+// solveKeplerEquation against Kepler's equation itself over a grid of mean
+// anomalies and eccentricities up to 0.99, then the kernels' own Kepler solve
+// against getPlanetPosition on near-parabolic bodies close to periapsis, where
+// the series guess is worst.
+static void checkKeplerSolver(void) {
+    static const double eccentricities[] = { 0.0, 1e-6, 0.1, 0.5, 0.8, 0.9, 0.95, 0.99 };
+    for (size_t k = 0; k < sizeof(eccentricities) / sizeof(eccentricities[0]); k++) {
+        double e = eccentricities[k];
+        for (int m = -1000; m <= 1000; m++) {
+            double M = PI * m / 1000.0;
+            double E = solveKeplerEquation(M, e);
+            double residual = E - e * sin(E) - M;
+            if (!(fabs(residual) <= CHECK_KEPLER_RESIDUAL))
+                fail("e = %g, M = %.6f: residual %.3g", e, M, residual);
+        }
+    }
+
+    enum { count = 256 };
+    Planet bodies[count];
+    BodyTable table;
+    for (int i = 0; i < count; i++) {
+        Planet *body = &bodies[i];
+        memset(body, 0, sizeof(*body));
+        body->orbitRadius = uniform(0.5, 5.0);
+        body->orbitalPeriod = 365.25 * pow(body->orbitRadius, 1.5);
+        body->eccentricity = uniform(0.9, 0.99);
+        body->inclination = uniform(0.0, 90.0);
+        body->ascendingNode = uniform(0.0, 360.0);
+        body->argumentOfPeriapsis = uniform(0.0, 360.0);
+        body->meanAnomalyAtEpoch = uniform(-5.0, 5.0);
+    }
+    if (buildBodyTable(&table, bodies, count) != 0) {
+        fail("buildBodyTable failed");
+        return;
+    }
+    double x[count], y[count], z[count];
+    double time = 0.0;
+    computeBodyPositions(&table, &time, 1, x, y, z);
+    for (int i = 0; i < count; i++) {
+        Vector3D reference = getPlanetPosition(bodies[i], time);
+        Vector3D position = { x[i], y[i], z[i] };
+        double error = calculateDistance(position, reference) / bodies[i].orbitRadius;
+        if (!(error <= CHECK_KERNEL_ERROR))
+            fail("%s, e = %.4f, M = %.3f deg: error %.3g of the orbit radius", ephemerisKernelName(),
+                 bodies[i].eccentricity, bodies[i].meanAnomalyAtEpoch, error);
+    }
+    freeBodyTable(&table);
+}
+
+// A catalog of CHECK_INDEX_BODIES synthetic bodies with its table, index and
+// room for one position of each, shared by the index checks.
+typedef struct {
+    Planet *bodies;
+    BodyTable table;
+    DestinationIndex index;
+    double *x, *y, *z;
+} IndexFixture;
+
+static void freeIndexFixture(IndexFixture *fixture) {
+    freeDestinationIndex(&fixture->index);
+    freeBodyTable(&fixture->table);
+    free(fixture->bodies);
+    free(fixture->x);
+}
+
+static int makeIndexFixture(IndexFixture *fixture) {
+    memset(fixture, 0, sizeof(*fixture));
+    fixture->bodies = malloc(CHECK_INDEX_BODIES * sizeof(Planet));
+    fixture->x = malloc(3 * CHECK_INDEX_BODIES * sizeof(double));
+    if (fixture->bodies == NULL || fixture->x == NULL) {
+        free(fixture->bodies);
+        free(fixture->x);
+        fail("out of memory");
+        return -1;
+    }
+    fixture->y = fixture->x + CHECK_INDEX_BODIES;
+    fixture->z = fixture->y + CHECK_INDEX_BODIES;
+    makeBodies(fixture->bodies, CHECK_INDEX_BODIES);
+    if (buildBodyTable(&fixture->table, fixture->bodies, CHECK_INDEX_BODIES) != 0) {
+        free(fixture->bodies);
+        free(fixture->x);
+        fail("buildBodyTable failed");
+        return -1;
+    }
+    if (buildDestinationIndex(&fixture->index, &fixture->table, CHECK_INDEX_EPOCH) != 0) {
+        freeBodyTable(&fixture->table);
+        free(fixture->bodies);
+        free(fixture->x);
+        fail("buildDestinationIndex failed");
+        return -1;
+    }
+    return 0;
+}
+
+// A query point at a random time within a few years of the epoch: on or
+// just off a random body for even q, anywhere in the inner system otherwise.
+static void makeQuery(const IndexFixture *fixture, int q, Vector3D *pos, double *time) {
+    *time = CHECK_INDEX_EPOCH + uniform(-3000.0, 3000.0);
+    if (q % 2 == 0) {
+        int body = (int)(nextRandom() % CHECK_INDEX_BODIES);
+        *pos = computeBodyPosition(&fixture->table, body, *time);
+        pos->x += uniform(-0.05, 0.05);
+        pos->z += uniform(-0.05, 0.05);
+    } else {
+        pos->x = uniform(-20.0, 20.0);
+        pos->y = uniform(-20.0, 20.0);
+        pos->z = uniform(-2.0, 2.0);
+    }
+}
+
+// Distances from pos to every body at time, by brute force, into distances.
+static void bruteDistances(IndexFixture *fixture, Vector3D pos, double time, double *distances) {
+    computeBodyPositions(&fixture->table, &time, 1, fixture->x, fixture->y, fixture->z);
+    for (int i = 0; i < CHECK_INDEX_BODIES; i++) {
+        Vector3D body = { fixture->x[i], fixture->y[i], fixture->z[i] };
+        distances[i] = calculateDistance(pos, body);
+    }
+}
+
+// Id of the nearest body within limit given every distance, or -1.
+static int bruteNearest(const double *distances, double limit) {
+    int nearest = -1;
+    for (int i = 0; i < CHECK_INDEX_BODIES; i++) {
+        if (distances[i] <= limit && (nearest < 0 || distances[i] < distances[nearest]))
+            nearest = i;
+    }
+    return nearest;
+}
+
+// Whether an index answer agrees with brute force: the same body, or a body
+// at the same distance.
+static int sameNearest(const double *distances, int id, int expected) {
+    if (id == expected)
+        return 1;
+    return id >= 0 && expected >= 0 && fabs(distances[id] - distances[expected]) <= 1e-12;
+}
+
+// findNearestDestination and findNearestDestinations against a brute-force
+// scan, on and off bodies, at limits from a near pass to a wide search.
+static void checkIndexNearest(void) {
+    static const double limits[] = { 0.01, 0.1, 0.5 };
+    IndexFixture fixture;
+    double *distances = malloc(CHECK_INDEX_BODIES * sizeof(double));
+    if (distances == NULL || makeIndexFixture(&fixture) != 0) {
+        if (distances == NULL)
+            fail("out of memory");
+        free(distances);
+        return;
+    }
+    for (int q = 0; q < CHECK_INDEX_QUERIES; q++) {
+        Vector3D pos;
+        double time, limit = limits[q % 3];
+        makeQuery(&fixture, q, &pos, &time);
+        bruteDistances(&fixture, pos, time, distances);
+        int expected = bruteNearest(distances, limit);
+        double distance;
+        int id = findNearestDestination(&fixture.index, pos, time, limit, &distance);
+        if (!sameNearest(distances, id, expected))
+            fail("query %d at t = %.3f, limit %g: index found %d, brute force %d (%.6g AU)", q, time, limit, id,
+                 expected, expected >= 0 ? distances[expected] : limit);
+        else if (id >= 0 && fabs(distance - distances[id]) > 1e-12)
+            fail("query %d: distance %.15g, brute force %.15g", q, distance, distances[id]);
+
+        // The k nearest: every one within the limit, nearest first, and no
+        // body left out nearer than the last one returned.
+        int ids[CHECK_NEAREST_K];
+        double nearest[CHECK_NEAREST_K];
+        int found = findNearestDestinations(&fixture.index, pos, time, limit, CHECK_NEAREST_K, ids, nearest);
+        int within = 0;
+        for (int i = 0; i < CHECK_INDEX_BODIES; i++)
+            within += distances[i] <= limit;
+        int wanted = within < CHECK_NEAREST_K ? within : CHECK_NEAREST_K;
+        if (found != wanted) {
+            fail("query %d, limit %g: %d nearest found, %d within the limit", q, limit, found, within);
+            continue;
+        }
+        for (int k = 0; k < found; k++) {
+            if (fabs(nearest[k] - distances[ids[k]]) > 1e-12 || (k > 0 && nearest[k] < nearest[k - 1]))
+                fail("query %d: nearest %d is body %d at %.15g, brute force %.15g", q, k, ids[k], nearest[k],
+                     distances[ids[k]]);
+        }
+        if (found > 0) {
+            int closer = 0;
+            for (int i = 0; i < CHECK_INDEX_BODIES; i++)
+                closer += distances[i] < nearest[found - 1] - 1e-12;
+            if (closer > found - 1)
+                fail("query %d: %d bodies nearer than the last of %d nearest", q, closer, found);
+        }
+    }
+    freeIndexFixture(&fixture);
+    free(distances);
+}
+
+// findNearestDestinationBatch against a brute-force scan per query. The
+// queries come in random time and place order, so the batch has to sort them.
+static void checkIndexBatch(void) {
+    IndexFixture fixture;
+    double *distances = malloc(CHECK_INDEX_BODIES * sizeof(double));
+    Vector3D *positions = malloc(CHECK_INDEX_QUERIES * sizeof(Vector3D));
+    double *times = malloc(CHECK_INDEX_QUERIES * sizeof(double));
+    double *found = malloc(CHECK_INDEX_QUERIES * sizeof(double));
+    int *ids = malloc(CHECK_INDEX_QUERIES * sizeof(int));
+    if (distances == NULL || positions == NULL || times == NULL || found == NULL || ids == NULL ||
+        makeIndexFixture(&fixture) != 0) {
+        if (checkFailures == 0)
+            fail("out of memory");
+        free(distances);
+        free(positions);
+        free(times);
+        free(found);
+        free(ids);
+        return;
+    }
+    double limit = 0.1;
+    for (int q = 0; q < CHECK_INDEX_QUERIES; q++)
+        makeQuery(&fixture, q, &positions[q], &times[q]);
+    findNearestDestinationBatch(&fixture.index, positions, times, CHECK_INDEX_QUERIES, limit, ids, found);
+    for (int q = 0; q < CHECK_INDEX_QUERIES; q++) {
+        bruteDistances(&fixture, positions[q], times[q], distances);
+        int expected = bruteNearest(distances, limit);
+        if (!sameNearest(distances, ids[q], expected))
+            fail("query %d at t = %.3f: batch found %d, brute force %d", q, times[q], ids[q], expected);
+        else if (ids[q] >= 0 && fabs(found[q] - distances[ids[q]]) > 1e-12)
+            fail("query %d: distance %.15g, brute force %.15g", q, found[q], distances[ids[q]]);
+    }
+    freeIndexFixture(&fixture);
+    free(distances);
+    free(positions);
+    free(times);
+    free(found);
+    free(ids);
+}
+
+// Writes text to a new temporary file named after template, which must end
+// in XXXXXX. Returns 0 on success.
+static int writeTemporary(char *template, const char *text) {
+    int fd = mkstemp(template);
+    if (fd < 0)
+        return -1;
+    size_t length = strlen(text);
+    int failed = write(fd, text, length) != (ssize_t)length;
+    return close(fd) != 0 || failed ? -1 : 0;
+}
+
+static long long fileSize(const char *path) {
+    struct stat info;
+    return stat(path, &info) == 0 ? (long long)info.st_size : -1;
+}
+
+// Runs the converter on csv, writing the catalog to output and its error
+// output to errors. Returns its exit status, or -1 if it could not be run.
+static int runConverter(const char *csv, const char *output, const char *errors) {
+    char command[512];
+    snprintf(command, sizeof(command), "%s %s %s >/dev/null 2>%s", CHECK_CONVERTER, csv, output, errors);
+    int status = system(command);
+    return status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// A CSV catalog through catalog_convert, then mapped back with openCatalog
+// and loadDestinationCatalog: every record must come back bit for bit, and
+// the mapped BodyTable columns must place every body where buildBodyTable's
+// do from the same elements. The converter may be built with other flags, so
+// the columns themselves can differ in the last bit.
+static void checkCatalogRoundTrip(void) {
+    Planet *bodies = malloc(CHECK_CATALOG_BODIES * sizeof(Planet));
+    char *text = malloc(CHECK_CATALOG_BODIES * 256 + 256);
+    if (bodies == NULL || text == NULL) {
+        fail("out of memory");
+        free(bodies);
+        free(text);
+        return;
+    }
+    makeBodies(bodies, CHECK_CATALOG_BODIES);
+    size_t length = (size_t)sprintf(text, "# synthetic catalog\nname,radius,period,e,i,node,periapsis,anomaly,mass\n\n");
+    for (int i = 0; i < CHECK_CATALOG_BODIES; i++) {
+        Planet *body = &bodies[i];
+        body->mass = i % 10 == 0 ? uniform(0.0, 1e-3) : 0.0;
+        // Some circular bodies leave off the trailing fields, which read as
+        // zero; %.17g round-trips every double.
+        if (i % 6 == 3 && body->mass == 0.0) {
+            body->meanAnomalyAtEpoch = 0.0;
+            length += (size_t)sprintf(text + length, "%s,%.17g,%.17g\n", body->name, body->orbitRadius,
+                                      body->orbitalPeriod);
+        } else if (i % 3 == 0 && body->mass == 0.0) {
+            length += (size_t)sprintf(text + length, "%s,%.17g,%.17g,0,0,0,0,%.17g\n", body->name,
+                                      body->orbitRadius, body->orbitalPeriod, body->meanAnomalyAtEpoch);
+        } else {
+            length += (size_t)sprintf(text + length, "%s,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g\n",
+                                      body->name, body->orbitRadius, body->orbitalPeriod, body->eccentricity,
+                                      body->inclination, body->ascendingNode, body->argumentOfPeriapsis,
+                                      body->meanAnomalyAtEpoch, body->mass);
+        }
+    }
+    char csv[] = "/tmp/navigator_check_XXXXXX";
+    char output[] = "/tmp/navigator_check_XXXXXX";
+    char errors[] = "/tmp/navigator_check_XXXXXX";
+    BodyTable expected;
+    if (writeTemporary(csv, text) != 0 || writeTemporary(output, "") != 0 || writeTemporary(errors, "") != 0 ||
+        buildBodyTable(&expected, bodies, CHECK_CATALOG_BODIES) != 0) {
+        fail("could not write the temporary files");
+    } else {
+        int status = runConverter(csv, output, errors);
+        MappedCatalog catalog;
+        if (status != 0) {
+            fail("%s exited with status %d", CHECK_CONVERTER, status);
+        } else if (openCatalog(&catalog, output) != 0) {
+            fail("openCatalog rejected the converted catalog");
+        } else {
+            if ((int)catalog.header->count != CHECK_CATALOG_BODIES)
+                fail("%d bodies mapped, %d written", (int)catalog.header->count, CHECK_CATALOG_BODIES);
+            for (int i = 0; i < CHECK_CATALOG_BODIES && i < (int)catalog.header->count; i++) {
+                if (memcmp(&catalog.records[i], &bodies[i], sizeof(Planet)) != 0)
+                    fail("record %d (%s) differs", i, bodies[i].name);
+            }
+            for (int t = 0; t < CHECK_TIMES && catalog.bodies.count == CHECK_CATALOG_BODIES; t++) {
+                static double x[CHECK_CATALOG_BODIES], y[CHECK_CATALOG_BODIES], z[CHECK_CATALOG_BODIES];
+                double time = uniform(-1e5, 1e5);
+                computeBodyPositions(&catalog.bodies, &time, 1, x, y, z);
+                for (int i = 0; i < CHECK_CATALOG_BODIES; i++) {
+                    Vector3D mapped = { x[i], y[i], z[i] };
+                    double error = calculateDistance(mapped, computeBodyPosition(&expected, i, time));
+                    if (!(error <= CHECK_KERNEL_ERROR * bodies[i].orbitRadius))
+                        fail("body %d (%s) at t = %.3f: mapped columns place it %.3g AU off", i, bodies[i].name,
+                             time, error);
+                }
+            }
+            closeCatalog(&catalog);
+
+            if (loadDestinationCatalog(output) != 0) {
+                fail("loadDestinationCatalog rejected the converted catalog");
+            } else {
+                const Planet *last = &bodies[CHECK_CATALOG_BODIES - 1];
+                const Planet *found = getDestinationByName(last->name);
+                if (knownDestinationsCount != CHECK_CATALOG_BODIES || found == NULL ||
+                    memcmp(found, last, sizeof(Planet)) != 0)
+                    fail("the loaded destinations do not hold the converted bodies");
+            }
+        }
+        freeBodyTable(&expected);
+    }
+    unlink(csv);
+    unlink(output);
+    unlink(errors);
+    free(bodies);
+    free(text);
+}
+
+// Rows catalog_convert must refuse, each after a header and one valid body,
+// so it is reported on line 3; and one before the first valid body.
+static void checkCatalogRejects(void) {
+    static const char *const rows[] = {
+        "Zero,0,365.25",
+        "Negative,-1.5,687",
+        "Still,1.0,0",
+        "Backwards,1.0,-365.25",
+        "TooLong-0123456789012345678901234,1.0,365.25",
+        "Earth,1.0,365.25",
+        "Hyperbolic,5.2,4332,1.2",
+        "Heavy,5.2,4332,0,0,0,0,0,-1",
+        "Extra,9.5,10759,0,0,0,0,0,0,7",
+        "Skipped,,90560",
+        "Garbage,2.77abc,1680",
+        "Short,1.0",
+        ",1.0,365.25",
+    };
+    char csv[] = "/tmp/navigator_check_XXXXXX";
+    char output[] = "/tmp/navigator_check_XXXXXX";
+    char errors[] = "/tmp/navigator_check_XXXXXX";
+    if (writeTemporary(output, "") != 0 || writeTemporary(errors, "") != 0) {
+        fail("could not write the temporary files");
+        unlink(output);
+        return;
+    }
+    for (size_t i = 0; i <= sizeof(rows) / sizeof(rows[0]); i++) {
+        // The last row is malformed before any body: only a first,
+        // non-numeric row passes as a header.
+        int beforeBodies = i == sizeof(rows) / sizeof(rows[0]);
+        const char *row = beforeBodies ? "Mercury,0.39" : rows[i];
+        const char *expected = beforeBodies ? ":2:" : ":3:";
+        char text[512];
+        if (beforeBodies)
+            snprintf(text, sizeof(text), "name,radius,period\n%s\nEarth,1.0,365.25\n", row);
+        else
+            snprintf(text, sizeof(text), "name,radius,period\nEarth,1.0,365.25\n%s\nMars,1.52,687\n", row);
+        strcpy(csv, "/tmp/navigator_check_XXXXXX");
+        if (writeTemporary(csv, text) != 0) {
+            fail("could not write the temporary files");
+            break;
+        }
+        int status = runConverter(csv, output, errors);
+        FILE *file = fopen(errors, "r");
+        char message[256] = "";
+        if (file != NULL) {
+            if (fgets(message, sizeof(message), file) == NULL)
+                message[0] = '\0';
+            fclose(file);
+        }
+        message[strcspn(message, "\n")] = '\0';
+        if (status != 1 || strstr(message, expected) == NULL)
+            fail("row \"%s\": exit status %d, \"%s\"", row, status, message);
+        else if (fileSize(output) != 0)
+            fail("row \"%s\": the catalog was written anyway", row);
+        unlink(csv);
+    }
+    unlink(output);
+    unlink(errors);
+}
+
+// A time for the scheduler check: mostly spread evenly over the coming
+// weeks, with bursts of events at one instant, whole days, the past (moved
+// up to the clock) and outliers centuries ahead that force a resize.
+static double schedulerTime(double clock) {
+    unsigned long long kind = nextRandom() % 16;
+    if (kind == 0)
+        return clock;
+    if (kind == 1)
+        return floor(clock) + (double)(nextRandom() % 8);
+    if (kind == 2)
+        return clock - uniform(0.0, 10.0);
+    if (kind == 3)
+        return clock + uniform(1e4, 1e5);
+    return clock + uniform(0.0, 30.0);
+}
+
+// The calendar queue against a linear scan over the pending events: every
+// batch must hold the earliest events, all at one time, in scheduling order,
+// while events keep being scheduled between batches.
+static void checkSchedulerOrder(void) {
+    Scheduler scheduler;
+    double *times = malloc(CHECK_SCHEDULER_EVENTS * sizeof(double));
+    char *pending = calloc(CHECK_SCHEDULER_EVENTS, 1);
+    if (times == NULL || pending == NULL || createScheduler(&scheduler, 100.0) != 0) {
+        fail("out of memory");
+        free(times);
+        free(pending);
+        return;
+    }
+    int scheduled = 0, taken = 0;
+    while (taken < CHECK_SCHEDULER_EVENTS && checkFailures == 0) {
+        // Schedule a few, take a batch; the first round fills the queue.
+        int add = scheduled == 0 ? CHECK_SCHEDULER_EVENTS / 4 : (int)(nextRandom() % 3);
+        for (int n = 0; n < add && scheduled < CHECK_SCHEDULER_EVENTS; n++, scheduled++) {
+            double time = schedulerTime(scheduler.time);
+            times[scheduled] = time > scheduler.time ? time : scheduler.time;
+            pending[scheduled] = 1;
+            if (scheduleEvent(&scheduler, time, (int)(nextRandom() % 4), scheduled) != 0) {
+                fail("scheduleEvent failed");
+                break;
+            }
+        }
+        if (scheduler.pending != scheduled - taken)
+            fail("%lld events pending, %d expected", scheduler.pending, scheduled - taken);
+
+        int capacity = 1 + (int)(nextRandom() % CHECK_SCHEDULER_BATCH);
+        int expected[CHECK_SCHEDULER_BATCH], expectedCount = 0;
+        double earliest = INFINITY;
+        for (int i = 0; i < scheduled; i++) {
+            if (pending[i] && times[i] < earliest)
+                earliest = times[i];
+        }
+        for (int i = 0; i < scheduled && expectedCount < capacity; i++) {
+            if (pending[i] && times[i] == earliest)
+                expected[expectedCount++] = i;
+        }
+        ScheduledEvent batch[CHECK_SCHEDULER_BATCH];
+        int count = nextEventBatch(&scheduler, batch, capacity);
+        if (count != expectedCount) {
+            fail("batch of %d events at t = %.9g, %d expected at t = %.9g", count, count > 0 ? batch[0].time : NAN,
+                 expectedCount, earliest);
+            break;
+        }
+        for (int k = 0; k < count; k++) {
+            if (batch[k].actor != expected[k] || batch[k].time != earliest || scheduler.time != earliest)
+                fail("event %d of a batch: actor %d at t = %.9g, expected %d at t = %.9g", k, batch[k].actor,
+                     batch[k].time, expected[k], earliest);
+            pending[expected[k]] = 0;
+        }
+        taken += count;
+        if (count == 0 && scheduled == CHECK_SCHEDULER_EVENTS)
+            break;
+    }
+    if (checkFailures == 0 && (taken != CHECK_SCHEDULER_EVENTS || scheduler.pending != 0))
+        fail("%d of %d events taken, %lld left pending", taken, CHECK_SCHEDULER_EVENTS, scheduler.pending);
+    freeScheduler(&scheduler);
+    free(times);
+    free(pending);
+}
+
+// Parses text with parseDouble, bounded at its length or at limit characters,
+// and with strtod; both must agree on the value and on where the number ends.
+static void checkParse(const char *text, size_t limit) {
+    char bounded[64];
+    size_t length = strlen(text) < limit ? strlen(text) : limit;
+    if (length >= sizeof(bounded))
+        return;
+    memcpy(bounded, text, length);
+    bounded[length] = '\0';
+    char *expectedEnd;
+    double expected = strtod(bounded, &expectedEnd);
+    const char *cursor = text;
+    double value;
+    int parsed = parseDouble(&cursor, text + length, &value);
+    if (expectedEnd == bounded) {
+        if (parsed)
+            fail("parseDouble(\"%s\") read %.17g, strtod reads no number", bounded, value);
+    } else if (!parsed) {
+        fail("parseDouble(\"%s\") read no number, strtod reads %.17g", bounded, expected);
+    } else if (memcmp(&value, &expected, sizeof(value)) != 0 || cursor - text != expectedEnd - bounded) {
+        fail("parseDouble(\"%s\") read %.17g up to %d, strtod %.17g up to %d", bounded, value,
+             (int)(cursor - text), expected, (int)(expectedEnd - bounded));
+    }
+}
+
+// Formats value with formatFixed and parses it back: the text must end where
+// it was written and read within half a unit in the last decimal of value,
+// and formatting what was read must give the same text.
+static void checkFixedRoundTrip(double value, int decimals) {
+    char text[FIXED_MAX_LENGTH], again[FIXED_MAX_LENGTH];
+    int length = formatFixed(text, value, decimals);
+    if (length <= 0 || length >= (int)sizeof(text) || (int)strlen(text) != length) {
+        fail("formatFixed(%.17g, %d) gave length %d", value, decimals, length);
+        return;
+    }
+    const char *cursor = text;
+    double parsed;
+    if (!parseDouble(&cursor, text + length, &parsed) || cursor != text + length) {
+        fail("formatFixed(%.17g, %d) gave \"%s\", which does not parse", value, decimals, text);
+        return;
+    }
+    double bound = fabs(value) * 1e-18 < 1.0 ? 0.5 * pow(10.0, -decimals) : 0.0;
+    if (!(fabs(parsed - value) <= bound * (1.0 + 1e-9) + fabs(value) * 4e-16))
+        fail("formatFixed(%.17g, %d) gave \"%s\", read back as %.17g", value, decimals, text, parsed);
+    formatFixed(again, parsed, decimals);
+    if (strcmp(again, text) != 0)
+        fail("formatFixed(%.17g, %d) gave \"%s\", then \"%s\" for what was read", value, decimals, text, again);
+}
+
+// parseDouble against strtod on printf output of random values at every
+// precision, on edge cases and on numbers cut short by the end pointer; then
+// formatFixed and parseDouble round trips.
+static void checkTextNumbers(void) {
+    static const char *const edges[] = {
+        "0", "-0", "+7", "  \t-12.5", ".5", "5.", "-.", ".", "-", "+", "e5", "1e", "1e+", "1e-", "2E-3x",
+        "1.5e308", "2e308", "1e-320", "4.9e-324", "1e-400", "123456789012345678901234567890",
+        "0.000000000000000000000000000123456789", "9007199254740993", "18446744073709551616",
+        "1.7976931348623157e308", "2.2250738585072014e-308", "0.1", "0.30000000000000004", "1e22", "1e23",
+        "12345678901234567890e-40", "00000000000000000000000012.5", "1e99999", "abc", "",
+    };
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        for (size_t limit = 0; limit <= strlen(edges[i]); limit++)
+            checkParse(edges[i], limit);
+    }
+    for (int n = 0; n < CHECK_TEXT_VALUES; n++) {
+        double value = (nextRandom() & 1 ? -1.0 : 1.0) * uniform(0.0, 1.0) * pow(10.0, uniform(-30.0, 30.0));
+        char text[64];
+        snprintf(text, sizeof(text), "%.*g", 1 + n % 17, value);
+        checkParse(text, sizeof(text));
+        snprintf(text, sizeof(text), "%.*f", n % 10, fmod(value, 1e12));
+        checkParse(text, sizeof(text));
+        snprintf(text, sizeof(text), "%.*e", n % 20, value);
+        checkParse(text, sizeof(text));
+        checkParse(text, (size_t)(n % 24));
+
+        checkFixedRoundTrip(fmod(value, 1e9), n % 10);
+    }
+    static const double fixedEdges[] = { 0.0, -0.0, 0.5, -0.5, 0.125, 1.0 - 1e-12, 9.9999999995, 1e17, 1e18, -1e18,
+                                         1e300, -4.9e-324, 123456789.987654321 };
+    for (size_t i = 0; i < sizeof(fixedEdges) / sizeof(fixedEdges[0]); i++) {
+        for (int decimals = 0; decimals <= 9; decimals++)
+            checkFixedRoundTrip(fixedEdges[i], decimals);
+    }
+}
+
+// Position of the journal check's record with the given sequence.
+static Vector3D journalPosition(uint64_t sequence) {
+    Vector3D position = { (double)sequence, -0.5 * (double)sequence, 1.0 / (double)sequence };
+    return position;
+}
+
+// Replays path after afterSequence and compares the outcome with the
+// expected number of records applied, last sequence and bytes discarded.
+static void checkReplay(const char *path, const char *stage, uint64_t afterSequence, uint64_t applied,
+                        uint64_t lastSequence, uint64_t discarded) {
+    ShipState state;
+    JournalReplay replay;
+    memset(&state, 0, sizeof(state));
+    if (replayJournal(path, afterSequence, &state, &replay) != 0) {
+        fail("%s: replayJournal failed", stage);
+        return;
+    }
+    if (replay.applied != applied || replay.lastSequence != lastSequence || replay.discarded != discarded)
+        fail("%s: %llu applied up to %llu, %llu bytes discarded; expected %llu up to %llu, %llu bytes", stage,
+             (unsigned long long)replay.applied, (unsigned long long)replay.lastSequence,
+             (unsigned long long)replay.discarded, (unsigned long long)applied, (unsigned long long)lastSequence,
+             (unsigned long long)discarded);
+    else if (applied > 0 && calculateDistance(state.shipPosition, journalPosition(lastSequence)) != 0.0)
+        fail("%s: the ship is not where record %llu left it", stage, (unsigned long long)lastSequence);
+}
+
+// A journal cut off in the middle of a record, then with a corrupt record:
+// replay must stop at the last whole valid record, and reopening must cut
+// the file back to it and continue the sequence from there.
+static void checkJournalTornTail(void) {
+    char path[] = "/tmp/navigator_check_XXXXXX";
+    if (writeTemporary(path, "") != 0) {
+        fail("could not create a temporary file");
+        return;
+    }
+    const long long header = (long long)sizeof(JournalHeader), record = (long long)sizeof(JournalRecord);
+    Journal *journal = openJournal(path, 1);
+    if (journal == NULL) {
+        fail("openJournal failed on an empty file");
+        unlink(path);
+        return;
+    }
+    for (uint64_t sequence = 1; sequence <= CHECK_JOURNAL_RECORDS; sequence++) {
+        if (appendJournal(journal, (double)sequence, journalPosition(sequence)) != sequence)
+            fail("record %llu appended out of sequence", (unsigned long long)sequence);
+    }
+    if (closeJournal(journal) != 0)
+        fail("closeJournal failed");
+    checkReplay(path, "whole journal", 0, CHECK_JOURNAL_RECORDS, CHECK_JOURNAL_RECORDS, 0);
+    checkReplay(path, "after a snapshot", 30, CHECK_JOURNAL_RECORDS - 30, CHECK_JOURNAL_RECORDS, 0);
+
+    // Torn in the middle of record 58.
+    if (truncate(path, header + 57 * record + record / 2) != 0) {
+        fail("could not truncate the journal");
+        unlink(path);
+        return;
+    }
+    checkReplay(path, "torn tail", 0, 57, 57, (uint64_t)(record / 2));
+
+    // Record 41 corrupt: everything from it on is dropped.
+    FILE *file = fopen(path, "r+b");
+    unsigned char byte = 0;
+    int corrupted = file != NULL && fseek(file, header + 40 * record + 9, SEEK_SET) == 0 &&
+                    fread(&byte, 1, 1, file) == 1 && fseek(file, -1, SEEK_CUR) == 0 &&
+                    fputc(byte ^ 0x40, file) != EOF;
+    if (file == NULL || fclose(file) != 0 || !corrupted) {
+        fail("could not corrupt a record");
+        unlink(path);
+        return;
+    }
+    checkReplay(path, "corrupt record", 0, 40, 40, (uint64_t)(17 * record + record / 2));
+
+    // Reopening drops the bad tail and continues after record 40.
+    journal = openJournal(path, 1);
+    if (journal == NULL) {
+        fail("openJournal failed on a torn journal");
+        unlink(path);
+        return;
+    }
+    if (fileSize(path) != header + 40 * record)
+        fail("reopened journal is %lld bytes, %lld expected", fileSize(path), header + 40 * record);
+    if (appendJournal(journal, 41.0, journalPosition(41)) != 41)
+        fail("the reopened journal does not continue after record 40");
+    if (closeJournal(journal) != 0)
+        fail("closeJournal failed");
+    checkReplay(path, "reopened journal", 0, 41, 41, 0);
+    unlink(path);
+}
+
+// Makes bodies the known destinations, through a temporary catalog file.
+static int loadCatalogOf(const Planet *bodies, int count) {
+    char path[] = "/tmp/navigator_check_XXXXXX";
+    if (writeTemporary(path, "") != 0)
+        return -1;
+    int failed = writeCatalog(path, bodies, count) != 0 || loadDestinationCatalog(path) != 0;
+    unlink(path);   // the mapping keeps the data alive
+    return failed ? -1 : 0;
+}
+
+// Whether openSnapshot accepts path under the current catalog; an accepted
+// snapshot must give back state, the journal sequence and the fleet.
+static int snapshotAccepted(const char *path, const ShipState *state, const Fleet *fleet) {
+    MappedSnapshot snapshot;
+    if (openSnapshot(&snapshot, path) != 0)
+        return 0;
+    if (memcmp(snapshot.state, state, sizeof(ShipState)) != 0 || snapshot.header->journalSequence != 42)
+        fail("the snapshot does not hold the saved state");
+    Fleet restored;
+    if (restoreFleet(&snapshot, &restored, 0) != 0) {
+        fail("restoreFleet failed");
+    } else {
+        int same = restored.count == fleet->count;
+        for (int k = 0; k < FLEET_COLUMNS && same; k++)
+            same = memcmp(fleetColumn(&restored, k), fleetColumn(fleet, k), fleet->count * sizeof(double)) == 0;
+        if (!same || memcmp(restored.destinationId, fleet->destinationId, fleet->count * sizeof(int)) != 0)
+            fail("the restored fleet differs from the saved one");
+        freeFleet(&restored);
+    }
+    closeSnapshot(&snapshot);
+    return 1;
+}
+
+// A snapshot holds destination ids, so it must be refused once the catalog
+// changes under it, in one body's elements or in size, and accepted again
+// under the catalog it was taken with.
+static void checkSnapshotFingerprint(void) {
+    Planet bodies[CHECK_FINGERPRINT_BODIES];
+    makeBodies(bodies, CHECK_FINGERPRINT_BODIES);
+    char path[] = "/tmp/navigator_check_XXXXXX";
+    Fleet fleet;
+    if (writeTemporary(path, "") != 0 || createFleet(&fleet, CHECK_SNAPSHOT_SHIPS) != 0) {
+        fail("could not set up the snapshot");
+        return;
+    }
+    if (loadCatalogOf(bodies, CHECK_FINGERPRINT_BODIES) != 0) {
+        fail("could not load the catalog");
+        freeFleet(&fleet);
+        unlink(path);
+        return;
+    }
+    ShipState state;
+    memset(&state, 0, sizeof(state));
+    state.currentTime = 123.5;
+    state.shipPosition = getDestinationPosition(7, state.currentTime);
+    resolveCurrentDestination(&state, state.currentTime);
+    for (int i = 0; i < CHECK_SNAPSHOT_SHIPS; i++) {
+        int ship = addShip(&fleet, getDestinationPosition(i, 100.0), 100.0);
+        fleet.destinationId[ship] = i;
+    }
+    dispatchShip(&fleet, 3, getDestinationPosition(20, 150.0), 50.0);
+    if (writeSnapshot(path, &state, 42, &fleet, 100.0) != 0) {
+        fail("writeSnapshot failed");
+    } else {
+        if (!snapshotAccepted(path, &state, &fleet))
+            fail("snapshot refused under the catalog it was taken with");
+
+        Planet changed[CHECK_FINGERPRINT_BODIES];
+        memcpy(changed, bodies, sizeof(changed));
+        changed[CHECK_FINGERPRINT_BODIES / 2].meanAnomalyAtEpoch += 1e-9;
+        if (loadCatalogOf(changed, CHECK_FINGERPRINT_BODIES) != 0)
+            fail("could not load the changed catalog");
+        else if (snapshotAccepted(path, &state, &fleet))
+            fail("snapshot accepted after one body's elements changed");
+        if (loadCatalogOf(bodies, CHECK_FINGERPRINT_BODIES - 1) != 0)
+            fail("could not load the shorter catalog");
+        else if (snapshotAccepted(path, &state, &fleet))
+            fail("snapshot accepted under a shorter catalog");
+
+        if (loadCatalogOf(bodies, CHECK_FINGERPRINT_BODIES) != 0)
+            fail("could not reload the catalog");
+        else if (!snapshotAccepted(path, &state, &fleet))
+            fail("snapshot refused after the catalog it was taken with was reloaded");
+    }
+    freeFleet(&fleet);
+    unlink(path);
+}
+
+// Whether loadDestinationEphemeris accepts path under the current catalog;
+// positions from an accepted cache must be within its tolerance of the
+// analytic model.
+static int ephemerisAccepted(const char *path) {
+    if (loadDestinationEphemeris(path) != 0)
+        return 0;
+    for (int n = 0; n < 1000; n++) {
+        int body = (int)(nextRandom() % (unsigned long long)knownDestinationsCount);
+        double time = uniform(0.0, CHECK_CACHE_DAYS);
+        Vector3D cached = getDestinationPosition(body, time);
+        Vector3D analytic = computeBodyPosition(getKnownDestinationsTable(), body, time);
+        if (!(calculateDistance(cached, analytic) <= CHECK_CACHE_TOLERANCE))
+            fail("body %d at t = %.3f: cached position %.3g AU off", body, time, calculateDistance(cached, analytic));
+    }
+    return 1;
+}
+
+// An ephemeris cache is fitted to one catalog's elements, so loading it must
+// fail once the catalog changes, in one body's elements or in size, and
+// succeed again under the catalog it was fitted to.
+static void checkEphemerisFingerprint(void) {
+    Planet bodies[CHECK_FINGERPRINT_BODIES];
+    makeBodies(bodies, CHECK_FINGERPRINT_BODIES);
+    char path[] = "/tmp/navigator_check_XXXXXX";
+    if (writeTemporary(path, "") != 0 || loadCatalogOf(bodies, CHECK_FINGERPRINT_BODIES) != 0) {
+        fail("could not set up the catalog");
+        unlink(path);
+        return;
+    }
+    EphemerisSource source = bodyTableSource(getKnownDestinationsTable());
+    EphemerisCacheParameters parameters = { 0.0, CHECK_CACHE_DAYS, 8, 12, CHECK_CACHE_TOLERANCE };
+    EphemerisCache cache;
+    int built = buildEphemerisCache(&cache, &source, &parameters, NULL) == 0;
+    if (!built || writeEphemerisCache(&cache, path) != 0) {
+        fail("could not build the cache (largest error %.3g AU)", cache.maxError);
+    } else {
+        if (!ephemerisAccepted(path))
+            fail("cache refused under the catalog it was fitted to");
+
+        Planet changed[CHECK_FINGERPRINT_BODIES];
+        memcpy(changed, bodies, sizeof(changed));
+        changed[CHECK_FINGERPRINT_BODIES / 2].meanAnomalyAtEpoch += 1e-9;
+        if (loadCatalogOf(changed, CHECK_FINGERPRINT_BODIES) != 0)
+            fail("could not load the changed catalog");
+        else if (ephemerisAccepted(path))
+            fail("cache accepted after one body's elements changed");
+        if (loadCatalogOf(bodies, CHECK_FINGERPRINT_BODIES - 1) != 0)
+            fail("could not load the shorter catalog");
+        else if (ephemerisAccepted(path))
+            fail("cache accepted under a shorter catalog");
+
+        if (loadCatalogOf(bodies, CHECK_FINGERPRINT_BODIES) != 0)
+            fail("could not reload the catalog");
+        else if (!ephemerisAccepted(path))
+            fail("cache refused after the catalog it was fitted to was reloaded");
+    }
+    if (built)
+        freeEphemerisCache(&cache);
+    unlink(path);
+}
+
+// findSweptEncounters against sampling every body along the transit: each
+// body that comes clearly within the limit must be reported, and every
+// reported encounter must be as close as sampling found at least.
+static void checkSweptEncounters(void) {
+    Planet bodies[CHECK_SWEEP_BODIES];
+    makeBodies(bodies, CHECK_SWEEP_BODIES);
+    BodyTable table;
+    DestinationIndex index;
+    if (buildBodyTable(&table, bodies, CHECK_SWEEP_BODIES) != 0) {
+        fail("buildBodyTable failed");
+        return;
+    }
+    if (buildDestinationIndex(&index, &table, CHECK_INDEX_EPOCH) != 0) {
+        fail("buildDestinationIndex failed");
+        freeBodyTable(&table);
+        return;
+    }
+    for (int transit = 0; transit < CHECK_SWEEP_TRANSITS; transit++) {
+        double fromTime = CHECK_INDEX_EPOCH + uniform(-1000.0, 1000.0), toTime = fromTime + uniform(10.0, 400.0);
+        Vector3D from = computeBodyPosition(&table, (int)(nextRandom() % CHECK_SWEEP_BODIES), fromTime);
+        Vector3D to = computeBodyPosition(&table, (int)(nextRandom() % CHECK_SWEEP_BODIES), toTime);
+        SweptEncounter encounters[CHECK_SWEEP_BODIES + 1];
+        int found = findSweptEncounters(&index, from, fromTime, to, toTime, CHECK_SWEEP_LIMIT,
+                                        CHECK_SWEEP_BODIES + 1, encounters);
+        if (found > CHECK_SWEEP_BODIES + 1) {
+            fail("transit %d: %d encounters with %d bodies", transit, found, CHECK_SWEEP_BODIES);
+            continue;
+        }
+        for (int i = 0; i < CHECK_SWEEP_BODIES; i++) {
+            double closest = INFINITY, closestTime = fromTime;
+            for (int step = 1; step <= CHECK_SWEEP_STEPS; step++) {
+                double fraction = (double)step / CHECK_SWEEP_STEPS;
+                double time = fromTime + fraction * (toTime - fromTime);
+                Vector3D ship = { from.x + fraction * (to.x - from.x), from.y + fraction * (to.y - from.y),
+                                  from.z + fraction * (to.z - from.z) };
+                double distance = calculateDistance(ship, computeBodyPosition(&table, i, time));
+                if (distance < closest) {
+                    closest = distance;
+                    closestTime = time;
+                }
+            }
+            int reported = -1;
+            for (int k = 0; k < found; k++)
+                reported = encounters[k].id == i ? k : reported;
+            // Close passes right at departure are the body being left.
+            int clear = closest < 0.98 * CHECK_SWEEP_LIMIT && closestTime > fromTime + 2 * (toTime - fromTime) /
+                                                                                  CHECK_SWEEP_STEPS;
+            if (clear && reported < 0)
+                fail("transit %d: body %d comes within %.4g AU at t = %.3f, not reported", transit, i, closest,
+                     closestTime);
+            else if (reported >= 0 && encounters[reported].distance > closest + 1e-6)
+                fail("transit %d: body %d reported at %.6g AU, sampling found %.6g AU", transit, i,
+                     encounters[reported].distance, closest);
+        }
+    }
+    freeDestinationIndex(&index);
+    freeBodyTable(&table);
+}
+
+// Appends numbers and text through output buffers of every small capacity,
+// the smallest raised to OUTPUT_MIN_CAPACITY, and compares what reaches the
+// file with the same output formatted directly.
+static void checkOutputBuffer(void) {
+    static const double values[] = { 0.0, -1.5, 123456789.123456789, -9.87654321e17, 1e300, 5e-324 };
+    char expected[4096] = "";
+    size_t length = 0;
+    for (int n = 0; n < 40; n++) {
+        double value = values[n % 6];
+        length += (size_t)formatFixed(expected + length, value, n % 10);
+        length += (size_t)sprintf(expected + length, ",%lld;", -123456789012345678ll * (n % 3 - 1));
+        if (n % 7 == 0)
+            length += (size_t)sprintf(expected + length, "%s", "a line longer than the smallest buffers hold\n");
+    }
+    for (size_t capacity = 0; capacity <= 2 * OUTPUT_MIN_CAPACITY; capacity += 7) {
+        char path[] = "/tmp/navigator_check_XXXXXX";
+        int fd = mkstemp(path);
+        OutputBuffer out;
+        if (fd < 0 || openOutputBuffer(&out, fd, capacity) != 0) {
+            fail("could not open an output buffer");
+            if (fd >= 0) {
+                close(fd);
+                unlink(path);
+            }
+            return;
+        }
+        for (int n = 0; n < 40; n++) {
+            appendFixed(&out, values[n % 6], n % 10);
+            appendChar(&out, ',');
+            appendInt(&out, -123456789012345678ll * (n % 3 - 1));
+            appendChar(&out, ';');
+            if (n % 7 == 0)
+                appendString(&out, "a line longer than the smallest buffers hold\n");
+        }
+        if (closeOutputBuffer(&out) != 0)
+            fail("capacity %zu: a write failed", capacity);
+        char written[4096];
+        ssize_t size = pread(fd, written, sizeof(written) - 1, 0);
+        close(fd);
+        unlink(path);
+        if (size != (ssize_t)length || memcmp(written, expected, length) != 0)
+            fail("capacity %zu: %zd bytes written, %zu expected, or they differ", capacity, size, length);
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} checks[] = {
+    { "kernel-positions", checkKernelPositions },
+    { "kepler-solver", checkKeplerSolver },
+    { "index-nearest", checkIndexNearest },
+    { "index-batch", checkIndexBatch },
+    { "swept-encounters", checkSweptEncounters },
+    { "catalog-round-trip", checkCatalogRoundTrip },
+    { "catalog-rejects", checkCatalogRejects },
+    { "scheduler-order", checkSchedulerOrder },
+    { "text-numbers", checkTextNumbers },
+    { "output-buffer", checkOutputBuffer },
+    { "journal-torn-tail", checkJournalTornTail },
+    { "snapshot-fingerprint", checkSnapshotFingerprint },
+    { "ephemeris-fingerprint", checkEphemerisFingerprint },
+};
+
+int main(int argc, char **argv) {
+    int checkCount = (int)(sizeof(checks) / sizeof(checks[0]));
+    for (int a = 1; a < argc; a++) {
+        int found = 0;
+        for (int c = 0; c < checkCount; c++)
+            found |= strcmp(argv[a], checks[c].name) == 0;
+        if (!found) {
+            fprintf(stderr, "Unknown check: %s\nChecks:", argv[a]);
+            for (int c = 0; c < checkCount; c++)
+                fprintf(stderr, " %s", checks[c].name);
+            fputc('\n', stderr);
+            return 2;
+        }
+    }
+    int failed = 0;
+    for (int c = 0; c < checkCount; c++) {
+        int selected = argc == 1;
+        for (int a = 1; a < argc; a++)
+            selected |= strcmp(argv[a], checks[c].name) == 0;
+        if (!selected)
+            continue;
+        checkName = checks[c].name;
+        checkFailures = 0;
+        checks[c].run();
+        printf("%s %s", checkFailures == 0 ? "ok  " : "FAIL", checks[c].name);
+        if (checkFailures > CHECK_MAX_REPORTS)
+            printf(" (%d more failures)", checkFailures - CHECK_MAX_REPORTS);
+        putchar('\n');
+        failed += checkFailures > 0;
+    }
+    if (failed > 0)
+        printf("%d check(s) failed\n", failed);
+    return failed > 0;
+}
@@ -0,0 +1,312 @@
+#include "conjunction.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.141592653589793
+#define CONJUNCTION_GRAIN 64                 // bodies per work item of the sweep
+#define CONJUNCTION_INITIAL_CAPACITY 256     // conjunctions per worker before the first growth
+#define CONJUNCTION_DISTANCE_TOLERANCE 1e-6  // in AU; closest approaches are found to within this
+#define CONJUNCTION_STACK 64                 // pending intervals of one pair
+
+// Bodies in order of periapsis distance, with what the sweep and the
+// refinement need of each.
+typedef struct {
+    const BodyTable *table;
+    double startTime, endTime;
+    double maxDistance;
+    int count;
+    int *bodyIds;             // index into table
+    double *periapsis;        // a * (1 - e), ascending
+    double *apoapsis;         // a * (1 + e)
+    double *speedMax;         // at periapsis, AU/day
+    double *accelerationMax;  // at periapsis, AU/day^2
+    double *angle;            // ecliptic longitude at startTime, radians; circular orbits in the ecliptic only
+    char *circular;
+} ConjunctionSearch;
+
+// Conjunctions found by one worker, padded to a cache line.
+typedef struct {
+    Conjunction *items;
+    long long count, capacity;
+    long long pairs, evaluations;
+    int failed;
+    char padding[64 - sizeof(Conjunction *) - 4 * sizeof(long long) - sizeof(int)];
+} ConjunctionBuffer;
+
+typedef struct {
+    const ConjunctionSearch *search;
+    ConjunctionBuffer *buffers;
+} ConjunctionJob;
+
+static int compareConjunction(const void *a, const void *b) {
+    const Conjunction *ca = a;
+    const Conjunction *cb = b;
+    if (ca->time != cb->time)
+        return ca->time < cb->time ? -1 : 1;
+    if (ca->first != cb->first)
+        return ca->first - cb->first;
+    return ca->second - cb->second;
+}
+
+// Position of the body in slot i relative to the one in slot j.
+static Vector3D pairOffset(const ConjunctionSearch *search, int i, int j, double time) {
+    Vector3D a = computeBodyPosition(search->table, search->bodyIds[i], time);
+    Vector3D b = computeBodyPosition(search->table, search->bodyIds[j], time);
+    Vector3D offset = { a.x - b.x, a.y - b.y, a.z - b.z };
+    return offset;
+}
+
+static double length(Vector3D v) {
+    return sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+}
+
+static void recordConjunction(const ConjunctionSearch *search, ConjunctionBuffer *buffer, int i, int j,
+                              double time, double distance) {
+    if (buffer->count == buffer->capacity) {
+        long long capacity = buffer->capacity > 0 ? 2 * buffer->capacity : CONJUNCTION_INITIAL_CAPACITY;
+        Conjunction *items = realloc(buffer->items, (size_t)capacity * sizeof(Conjunction));
+        if (items == NULL) {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->items = items;
+        buffer->capacity = capacity;
+    }
+    int a = search->bodyIds[i], b = search->bodyIds[j];
+    Conjunction *conjunction = &buffer->items[buffer->count++];
+    conjunction->first = a < b ? a : b;
+    conjunction->second = a < b ? b : a;
+    conjunction->time = time;
+    conjunction->distance = distance;
+}
+
+// Two circular orbits in the ecliptic: the angle between the bodies changes
+// at a constant rate, so they are closest when it next passes zero, or at
+// whichever end of the window it is smaller if it does not.
+static void refineCircularPair(const ConjunctionSearch *search, ConjunctionBuffer *buffer, int i, int j) {
+    const BodyTable *table = search->table;
+    int a = search->bodyIds[i], b = search->bodyIds[j];
+    double span = search->endTime - search->startTime;
+    double rate = 2 * PI * (table->meanMotion[a] - table->meanMotion[b]);
+    double phase = search->angle[i] - search->angle[j];
+    phase -= phase > PI ? 2 * PI : (phase <= -PI ? -2 * PI : 0.0);
+    double wait = INFINITY;
+    if (phase == 0.0)
+        wait = 0.0;
+    else if (rate > 0.0)
+        wait = ((phase > 0.0 ? 2 * PI : 0.0) - phase) / rate;
+    else if (rate < 0.0)
+        wait = ((phase > 0.0 ? 0.0 : -2 * PI) - phase) / rate;
+    double time = search->startTime;
+    if (wait <= span)
+        time += wait;
+    else if (cos(phase + rate * span) > cos(phase))
+        time = search->endTime;
+    double ra = table->orbitRadius[a], rb = table->orbitRadius[b];
+    double angle = wait <= span ? 0.0 : phase + rate * (time - search->startTime);
+    buffer->evaluations++;
+    if (ra * ra + rb * rb - 2.0 * ra * rb * cos(angle) >= search->maxDistance * search->maxDistance)
+        return;
+    // Report the distance the position kernel gives, like every other pair.
+    double distance = length(pairOffset(search, i, j, time));
+    if (distance < search->maxDistance)
+        recordConjunction(search, buffer, i, j, time, distance);
+}
+
+typedef struct {
+    double begin, end;
+    Vector3D beginOffset, endOffset;
+} PairInterval;
+
+// Closest approach of any other pair. Over an interval of length L each body
+// strays from the chord between its end positions by at most
+// accelerationMax * L^2 / 8, so the pair's distance cannot drop below the
+// closest approach of the chord of their offset less both sags. Intervals
+// whose bound cannot beat the best distance seen, or maxDistance, are dropped;
+// the rest are halved until the sag is below CONJUNCTION_DISTANCE_TOLERANCE,
+// evaluating the distance at each chord's closest approach on the way.
+static void refinePair(const ConjunctionSearch *search, ConjunctionBuffer *buffer, int i, int j) {
+    double span = search->endTime - search->startTime;
+    double speedMax = search->speedMax[i] + search->speedMax[j];
+    double accelerationMax = search->accelerationMax[i] + search->accelerationMax[j];
+
+    PairInterval stack[CONJUNCTION_STACK];
+    int top = 0;
+    stack[top].begin = search->startTime;
+    stack[top].end = search->endTime;
+    stack[top].beginOffset = pairOffset(search, i, j, search->startTime);
+    double best = length(stack[top].beginOffset), bestTime = search->startTime;
+    buffer->evaluations++;
+    // Nothing this far apart can close in during the window.
+    if (best - speedMax * span >= search->maxDistance)
+        return;
+    stack[top].endOffset = pairOffset(search, i, j, search->endTime);
+    top++;
+    while (top > 0) {
+        PairInterval interval = stack[--top];
+        double intervalLength = interval.end - interval.begin;
+        double fraction;
+        double chord = segmentDistanceFromOrigin(interval.beginOffset, interval.endOffset, &fraction);
+        double sag = 0.125 * accelerationMax * intervalLength * intervalLength;
+        if (chord - sag >= (best < search->maxDistance ? best : search->maxDistance))
+            continue;
+        double closest = fraction < 1.0 ? interval.begin + fraction * intervalLength : interval.end;
+        double distance = length(pairOffset(search, i, j, closest));
+        buffer->evaluations++;
+        if (distance < best) {
+            best = distance;
+            bestTime = closest;
+        }
+        if (sag <= CONJUNCTION_DISTANCE_TOLERANCE || top + 2 > CONJUNCTION_STACK)
+            continue;
+        double middle = interval.begin + 0.5 * intervalLength;
+        Vector3D middleOffset = pairOffset(search, i, j, middle);
+        buffer->evaluations++;
+        PairInterval early = { interval.begin, middle, interval.beginOffset, middleOffset };
+        PairInterval late = { middle, interval.end, middleOffset, interval.endOffset };
+        // Search the half holding the chord's closest approach first so best tightens early.
+        stack[top++] = fraction < 0.5 ? late : early;
+        stack[top++] = fraction < 0.5 ? early : late;
+    }
+    if (best < search->maxDistance)
+        recordConjunction(search, buffer, i, j, bestTime, best);
+}
+
+// First slot in [begin, count) whose periapsis is above limit.
+static int upperBoundPeriapsis(const ConjunctionSearch *search, int begin, double limit) {
+    int end = search->count;
+    while (begin < end) {
+        int middle = begin + (end - begin) / 2;
+        if (search->periapsis[middle] <= limit)
+            begin = middle + 1;
+        else
+            end = middle;
+    }
+    return begin;
+}
+
+// Pairs each body in slots [begin, end) with the later slots whose shells it reaches.
+static void sweepSlots(void *context, int begin, int end, int worker) {
+    ConjunctionJob *job = context;
+    const ConjunctionSearch *search = job->search;
+    ConjunctionBuffer *buffer = &job->buffers[worker];
+    for (int i = begin; i < end && !buffer->failed; i++) {
+        int last = upperBoundPeriapsis(search, i + 1, search->apoapsis[i] + search->maxDistance);
+        buffer->pairs += last - (i + 1);
+        for (int j = i + 1; j < last; j++) {
+            if (search->circular[i] && search->circular[j])
+                refineCircularPair(search, buffer, i, j);
+            else
+                refinePair(search, buffer, i, j);
+        }
+    }
+}
+
+static void freeSearch(ConjunctionSearch *search) {
+    free(search->bodyIds);
+    free(search->periapsis);
+    free(search->circular);
+}
+
+// Sorts the bodies by periapsis and fills in the per-slot columns.
+static int buildSearch(ConjunctionSearch *search, const BodyTable *table) {
+    size_t n = (size_t)(table->count > 0 ? table->count : 1);
+    search->count = table->count;
+    search->bodyIds = malloc(n * sizeof(int));
+    search->periapsis = malloc(5 * n * sizeof(double));
+    search->circular = malloc(n);
+    SortEntry *entries = malloc(n * sizeof(SortEntry));
+    double *x = malloc(2 * n * sizeof(double));
+    double *z = malloc(n * sizeof(double));
+    if (search->bodyIds == NULL || search->periapsis == NULL || search->circular == NULL ||
+        entries == NULL || x == NULL || z == NULL) {
+        freeSearch(search);
+        free(entries);
+        free(x);
+        free(z);
+        return -1;
+    }
+    search->apoapsis = search->periapsis + n;
+    search->speedMax = search->apoapsis + n;
+    search->accelerationMax = search->speedMax + n;
+    search->angle = search->accelerationMax + n;
+
+    for (int i = 0; i < table->count; i++) {
+        entries[i].key = table->orbitRadius[i] * (1.0 - table->eccentricity[i]);
+        entries[i].id = i;
+    }
+    qsort(entries, (size_t)table->count, sizeof(SortEntry), compareSortEntry);
+    double *y = x + n;
+    computeBodyPositions(table, &search->startTime, 1, x, y, z);
+    for (int s = 0; s < table->count; s++) {
+        int i = entries[s].id;
+        double a = table->orbitRadius[i];
+        double e = table->eccentricity[i];
+        double motion = 2 * PI * table->meanMotion[i];
+        search->bodyIds[s] = i;
+        search->periapsis[s] = entries[s].key;
+        search->apoapsis[s] = a * (1.0 + e);
+        search->speedMax[s] = motion * a * sqrt((1.0 + e) / (1.0 - e));
+        search->accelerationMax[s] = motion * motion * a / ((1.0 - e) * (1.0 - e));
+        search->circular[s] = (char)isPlanarCircularBody(table, i);
+        search->angle[s] = atan2(y[i], x[i]);
+    }
+    free(entries);
+    free(x);
+    free(z);
+    return 0;
+}
+
+int findConjunctions(const BodyTable *table, double startTime, double endTime, double maxDistance,
+                     ThreadPool *pool, ConjunctionList *list) {
+    memset(list, 0, sizeof(*list));
+    ConjunctionSearch search;
+    memset(&search, 0, sizeof(search));
+    search.table = table;
+    search.startTime = startTime;
+    search.endTime = endTime;
+    search.maxDistance = maxDistance;
+    if (buildSearch(&search, table) != 0)
+        return -1;
+    int workers = threadPoolSize(pool);
+    ConjunctionJob job = { &search, aligned_alloc(64, (size_t)workers * sizeof(ConjunctionBuffer)) };
+    if (job.buffers == NULL) {
+        freeSearch(&search);
+        return -1;
+    }
+    memset(job.buffers, 0, (size_t)workers * sizeof(ConjunctionBuffer));
+
+    parallelFor(pool, search.count, CONJUNCTION_GRAIN, sweepSlots, &job);
+
+    int failed = 0;
+    for (int w = 0; w < workers; w++) {
+        failed |= job.buffers[w].failed;
+        list->count += job.buffers[w].count;
+        list->pairs += job.buffers[w].pairs;
+        list->evaluations += job.buffers[w].evaluations;
+    }
+    list->items = failed ? NULL : malloc((size_t)(list->count > 0 ? list->count : 1) * sizeof(Conjunction));
+    if (list->items != NULL) {
+        long long used = 0;
+        for (int w = 0; w < workers; w++) {
+            memcpy(list->items + used, job.buffers[w].items, (size_t)job.buffers[w].count * sizeof(Conjunction));
+            used += job.buffers[w].count;
+        }
+        qsort(list->items, (size_t)list->count, sizeof(Conjunction), compareConjunction);
+    }
+    for (int w = 0; w < workers; w++)
+        free(job.buffers[w].items);
+    free(job.buffers);
+    freeSearch(&search);
+    if (list->items == NULL) {
+        memset(list, 0, sizeof(*list));
+        return -1;
+    }
+    return 0;
+}
+
+void freeConjunctionList(ConjunctionList *list) {
+    free(list->items);
+    memset(list, 0, sizeof(*list));
+}
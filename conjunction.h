@@ -0,0 +1,37 @@
+#ifndef CONJUNCTION_H
+#define CONJUNCTION_H
+
+#include "ephemeris.h"
+#include "threadpool.h"
+
+// Closest approach of a pair of bodies over a search window.
+typedef struct {
+    int first, second;        // indices into the BodyTable, first < second
+    double time;              // in days
+    double distance;          // in AU
+} Conjunction;
+
+typedef struct {
+    Conjunction *items;       // ordered by time, then by first and second
+    long long count;
+    long long pairs;          // pairs whose orbit shells come within range
+    long long evaluations;    // pair distances computed while refining them
+} ConjunctionList;
+
+// Finds every pair of bodies of table that comes within maxDistance of each
+// other during [startTime, endTime], with the time and distance of the pair's
+// closest approach in the window.
+// Bodies are sorted by periapsis distance, so sweeping that order pairs each
+// body only with those whose periapsis-apoapsis shells come within
+// maxDistance of its own; no other pair can ever get that close. Survivors
+// are refined over the window by bisection, dropping spans where the pair
+// provably stays apart, which steps finely only around close approaches. Two
+// circular orbits in the ecliptic have their closest approach solved for
+// directly. The sweep is split across pool (NULL runs single-threaded), and
+// the list is the same for any number of threads.
+// Returns 0 on success, -1 on allocation failure.
+int findConjunctions(const BodyTable *table, double startTime, double endTime, double maxDistance,
+                     ThreadPool *pool, ConjunctionList *list);
+void freeConjunctionList(ConjunctionList *list);
+
+#endif
@@ -0,0 +1,72 @@
+#include "modes.h"
+#include "conjunction.h"
+#include "destinations.h"
+#include "textio.h"
+#include "threadpool.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CONJUNCTION_DECIMALS 6
+#define CONJUNCTION_OUTPUT_BUFFER (1 << 20)
+
+int runConjunctionsMode(char **args, int threads) {
+    double startTime = atof(args[0]);
+    double endTime = atof(args[1]);
+    double maxDistance = atof(args[2]);
+    const BodyTable *table = getKnownDestinationsTable();
+    if (table == NULL || !(endTime >= startTime) || !(maxDistance > 0.0)) {
+        printf("Error: invalid conjunction search\n");
+        return 1;
+    }
+    int toStdout = strcmp(args[3], "-") == 0;
+    int fd = toStdout ? STDOUT_FILENO : open(args[3], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(args[3]);
+        return 1;
+    }
+    ThreadPool *pool = createThreadPool(threads);
+    ConjunctionList list;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = findConjunctions(table, startTime, endTime, maxDistance, pool, &list) != 0;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    int workers = threadPoolSize(pool);
+    destroyThreadPool(pool);
+
+    OutputBuffer out;
+    if (!failed && openOutputBuffer(&out, fd, CONJUNCTION_OUTPUT_BUFFER) == 0) {
+        appendString(&out, "# time_days,distance_au,first,second\n");
+        for (long long c = 0; c < list.count; c++) {
+            const Conjunction *conjunction = &list.items[c];
+            appendFixed(&out, conjunction->time, CONJUNCTION_DECIMALS);
+            appendChar(&out, ',');
+            appendFixed(&out, conjunction->distance, CONJUNCTION_DECIMALS + 3);
+            appendChar(&out, ',');
+            appendString(&out, knownDestinations[conjunction->first].name);
+            appendChar(&out, ',');
+            appendString(&out, knownDestinations[conjunction->second].name);
+            appendChar(&out, '\n');
+        }
+        failed = closeOutputBuffer(&out) != 0;
+    } else {
+        failed = 1;
+    }
+    if (!toStdout && close(fd) != 0)
+        failed = 1;
+    if (failed) {
+        fprintf(stderr, "Error: could not write the conjunctions to %s\n", args[3]);
+        freeConjunctionList(&list);
+        return 1;
+    }
+    // Report on stderr so the list can go to stdout.
+    long long bodies = knownDestinationsCount;
+    fprintf(stderr, "%lld conjunctions within %g AU in days %.2f to %.2f, in %.3f s on %d threads\n",
+            list.count, maxDistance, startTime, endTime, elapsedSeconds(start, stop), workers);
+    fprintf(stderr, "%lld of %lld pairs had orbit shells in range; %lld pair distances computed\n",
+            list.pairs, bodies * (bodies - 1) / 2, list.evaluations);
+    freeConjunctionList(&list);
+    return 0;
+}
@@ -1,20 +1,44 @@
 #include "destinations.h"
+#include "catalog.h"
+#include "nameindex.h"
+#include "stats.h"
+#include "stringarena.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
-// Define the known destinations.
-Planet knownDestinations[] = {
-    { "Mercury", 0.387, 87.97 },
-    { "Venus",   0.723, 224.70 },
-    { "Earth",   1.0,   365.25 },
-    { "Mars",    1.523, 687.0 },
-    { "Jupiter", 5.203, 4332.59 },
-    { "Saturn",  9.537, 10759.22 },
-    { "Uranus",  19.191, 30685.4 },
-    { "Neptune", 30.068, 60190 }
+#define DESTINATION_INDEX_HORIZON 3652.5  // in days
+#define DESCRIPTION_LINE_LENGTH 1024
+#define DEFAULT_DESCRIPTION "A known celestial destination."
+#define UNKNOWN_DESCRIPTION "You have arrived at an unknown celestial destination."
+
+// Built-in destinations, used until a catalog file is loaded.
+static Planet builtinDestinations[] = {
+    { .name = "Mercury", .orbitRadius = 0.387,  .orbitalPeriod = 87.97,    .mass = 1.6601e-7 },
+    { .name = "Venus",   .orbitRadius = 0.723,  .orbitalPeriod = 224.70,   .mass = 2.4478e-6 },
+    { .name = "Earth",   .orbitRadius = 1.0,    .orbitalPeriod = 365.25,   .mass = 3.0404e-6 },   // with the Moon
+    { .name = "Mars",    .orbitRadius = 1.523,  .orbitalPeriod = 687.0,    .mass = 3.2272e-7 },
+    { .name = "Jupiter", .orbitRadius = 5.203,  .orbitalPeriod = 4332.59,  .mass = 9.5479e-4 },
+    { .name = "Saturn",  .orbitRadius = 9.537,  .orbitalPeriod = 10759.22, .mass = 2.8589e-4 },
+    { .name = "Uranus",  .orbitRadius = 19.191, .orbitalPeriod = 30685.4,  .mass = 4.3662e-5 },
+    { .name = "Neptune", .orbitRadius = 30.068, .orbitalPeriod = 60190,    .mass = 5.1514e-5 }
+};
+
+// Descriptions the table starts from; a metadata file can replace them.
+static const struct {
+    const char *name;
+    const char *description;
+} builtinDescriptions[] = {
+    { "Earth",  "Earth: our vibrant blue home planet." },
+    { "Mars",   "Mars: the Red Planet, a potential destination for exploration." },
+    { "Saturn", "Saturn: adorned with magnificent rings." }
 };
 
-int knownDestinationsCount = sizeof(knownDestinations) / sizeof(knownDestinations[0]);
+Planet *knownDestinations = builtinDestinations;
+int knownDestinationsCount = sizeof(builtinDestinations) / sizeof(builtinDestinations[0]);
+
+static MappedCatalog loadedCatalog;
 
 void printDestinations(void) {
     printf("Loaded Destinations:\n");
@@ -24,12 +48,264 @@ void printDestinations(void) {
     }
 }
 
+static NameIndex knownDestinationsNames;
+static int knownDestinationsNamesBuilt = 0;
+
+// Builds the name index on first use. Returns NULL if it could not be allocated.
+static const NameIndex *getKnownDestinationsNames(void) {
+    if (!knownDestinationsNamesBuilt) {
+        if (buildNameIndex(&knownDestinationsNames, knownDestinations, knownDestinationsCount) != 0)
+            return NULL;
+        knownDestinationsNamesBuilt = 1;
+    }
+    return &knownDestinationsNames;
+}
+
 Planet *getDestinationByName(const char *name) {
-    for (int i = 0; i < knownDestinationsCount; i++) {
-        if (strcmp(knownDestinations[i].name, name) == 0) {
-            return &knownDestinations[i];
+    const NameIndex *names = getKnownDestinationsNames();
+    int id = names != NULL ? findName(names, name) : -1;
+    return id >= 0 ? &knownDestinations[id] : NULL;  // NULL if not found.
+}
+
+Planet *getDestinationByNameIgnoreCase(const char *name) {
+    const NameIndex *names = getKnownDestinationsNames();
+    int id = names != NULL ? findNameIgnoreCase(names, name) : -1;
+    return id >= 0 ? &knownDestinations[id] : NULL;
+}
+
+int findDestinationsByPrefix(const char *prefix, int *ids, int maxIds) {
+    const NameIndex *names = getKnownDestinationsNames();
+    return names != NULL ? findNamesByPrefix(names, prefix, ids, maxIds) : 0;
+}
+
+const char *getDestinationName(int id) {
+    return id >= 0 && id < knownDestinationsCount ? knownDestinations[id].name : "Unknown";
+}
+
+static StringArena destinationStrings;
+static const char **destinationDescriptions;  // [knownDestinationsCount + 1], DESTINATION_NONE first
+static int destinationDescriptionsBuilt = 0;
+
+static void freeDestinationDescriptions(void) {
+    free(destinationDescriptions);
+    destinationDescriptions = NULL;
+    freeStringArena(&destinationStrings);
+    destinationDescriptionsBuilt = 0;
+}
+
+// Points the description of the destination called name at an interned copy
+// of description. Returns 1 if it was set, 0 for an unknown name, -1 on allocation failure.
+static int setDestinationDescription(const char *name, const char *description, size_t length) {
+    Planet *planet = getDestinationByName(name);
+    if (planet == NULL)
+        return 0;
+    const char *interned = internString(&destinationStrings, description, length);
+    if (interned == NULL)
+        return -1;
+    destinationDescriptions[1 + (planet - knownDestinations)] = interned;
+    return 1;
+}
+
+// Builds the description table on first use. Returns 0 on success, -1 on allocation failure.
+static int buildDestinationDescriptions(void) {
+    if (destinationDescriptionsBuilt)
+        return 0;
+    initStringArena(&destinationStrings);
+    destinationDescriptions = malloc(((size_t)knownDestinationsCount + 1) * sizeof(const char *));
+    const char *unknown = internString(&destinationStrings, UNKNOWN_DESCRIPTION, strlen(UNKNOWN_DESCRIPTION));
+    const char *known = internString(&destinationStrings, DEFAULT_DESCRIPTION, strlen(DEFAULT_DESCRIPTION));
+    if (destinationDescriptions == NULL || unknown == NULL || known == NULL) {
+        freeDestinationDescriptions();
+        return -1;
+    }
+    destinationDescriptions[0] = unknown;
+    for (int i = 0; i < knownDestinationsCount; i++)
+        destinationDescriptions[1 + i] = known;
+    for (size_t i = 0; i < sizeof(builtinDescriptions) / sizeof(builtinDescriptions[0]); i++) {
+        const char *description = builtinDescriptions[i].description;
+        if (setDestinationDescription(builtinDescriptions[i].name, description, strlen(description)) < 0) {
+            freeDestinationDescriptions();
+            return -1;
         }
     }
-    return NULL;  // Not found.
+    destinationDescriptionsBuilt = 1;
+    return 0;
+}
+
+const char *getDestinationDescription(int id) {
+    if (buildDestinationDescriptions() != 0)
+        return NULL;
+    return destinationDescriptions[id >= 0 && id < knownDestinationsCount ? 1 + id : 0];
+}
+
+int loadDestinationDescriptions(const char *path) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+    if (buildDestinationDescriptions() != 0) {
+        fclose(in);
+        return -1;
+    }
+    char line[DESCRIPTION_LINE_LENGTH];
+    int applied = 0, failed = 0;
+    while (!failed && fgets(line, sizeof(line), in) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        line[length] = '\0';
+        char *comma = strchr(line, ',');
+        if (line[0] == '#' || comma == NULL)
+            continue;
+        *comma = '\0';
+        const char *description = comma + 1;
+        while (*description == ' ')
+            description++;
+        int set = setDestinationDescription(line, description, strlen(description));
+        failed = set < 0;
+        applied += set > 0;
+    }
+    failed = failed || ferror(in);
+    fclose(in);
+    return failed ? -1 : applied;
 }
 
+static BodyTable knownDestinationsTable;
+static int knownDestinationsTableBuilt = 0;
+
+const BodyTable *getKnownDestinationsTable(void) {
+    if (!knownDestinationsTableBuilt && loadedCatalog.base != NULL) {
+        // Columns come straight from the mapped catalog.
+        knownDestinationsTable = loadedCatalog.bodies;
+        knownDestinationsTableBuilt = 1;
+    } else if (!knownDestinationsTableBuilt) {
+        if (buildBodyTable(&knownDestinationsTable, knownDestinations, knownDestinationsCount) != 0)
+            return NULL;
+        knownDestinationsTableBuilt = 1;
+    }
+    return &knownDestinationsTable;
+}
+
+static uint64_t knownDestinationsFingerprint;
+static int knownDestinationsFingerprinted = 0;
+
+uint64_t getKnownDestinationsFingerprint(void) {
+    if (!knownDestinationsFingerprinted) {
+        const BodyTable *table = getKnownDestinationsTable();
+        if (table == NULL)
+            return 0;
+        knownDestinationsFingerprint = bodyTableFingerprint(table);
+        knownDestinationsFingerprinted = 1;
+    }
+    return knownDestinationsFingerprint;
+}
+
+static DestinationIndex knownDestinationsIndex;
+static int knownDestinationsIndexBuilt = 0;
+
+const DestinationIndex *getKnownDestinationsIndex(double time) {
+    if (knownDestinationsIndexBuilt && fabs(time - knownDestinationsIndex.epoch) <= DESTINATION_INDEX_HORIZON)
+        return &knownDestinationsIndex;
+    const BodyTable *table = getKnownDestinationsTable();
+    if (table == NULL)
+        return NULL;
+    if (knownDestinationsIndexBuilt) {
+        freeDestinationIndex(&knownDestinationsIndex);
+        knownDestinationsIndexBuilt = 0;
+    }
+    if (buildDestinationIndex(&knownDestinationsIndex, table, time) != 0)
+        return NULL;
+    knownDestinationsIndexBuilt = 1;
+    return &knownDestinationsIndex;
+}
+
+const DestinationIndex *prepareKnownDestinations(double time) {
+    // The index is built from the table, so building it builds both.
+    return getKnownDestinationsIndex(time);
+}
+
+static EphemerisCache destinationEphemeris;
+static int destinationEphemerisLoaded = 0;
+
+int loadDestinationEphemeris(const char *path) {
+    EphemerisCache cache;
+    if (openEphemerisCache(&cache, path) != 0)
+        return -1;
+    if (cache.bodyCount != knownDestinationsCount) {
+        fprintf(stderr, "%s: built for %d bodies, %d destinations are loaded\n",
+                path, cache.bodyCount, knownDestinationsCount);
+        freeEphemerisCache(&cache);
+        return -1;
+    }
+    if (cache.sourceFingerprint != getKnownDestinationsFingerprint()) {
+        fprintf(stderr, "%s: built from a different catalog than the loaded destinations\n", path);
+        freeEphemerisCache(&cache);
+        return -1;
+    }
+    if (destinationEphemerisLoaded)
+        freeEphemerisCache(&destinationEphemeris);
+    destinationEphemeris = cache;
+    destinationEphemerisLoaded = 1;
+    return 0;
+}
+
+const EphemerisCache *getDestinationEphemeris(void) {
+    return destinationEphemerisLoaded ? &destinationEphemeris : NULL;
+}
+
+Vector3D getDestinationPosition(int id, double time) {
+    if (destinationEphemerisLoaded && ephemerisCacheCovers(&destinationEphemeris, time))
+        return evaluateEphemerisCache(&destinationEphemeris, id, time);
+    return computeBodyPosition(getKnownDestinationsTable(), id, time);
+}
+
+static GravityField knownDestinationsGravity;
+static int knownDestinationsGravityBuilt = 0;
+
+GravityField *getKnownDestinationsGravity(void) {
+    if (!knownDestinationsGravityBuilt) {
+        if (buildGravityField(&knownDestinationsGravity, knownDestinations, knownDestinationsCount) != 0)
+            return NULL;
+        knownDestinationsGravityBuilt = 1;
+    }
+    return &knownDestinationsGravity;
+}
+
+int loadDestinationCatalog(const char *path) {
+    STATS_BEGIN_TIMED(STATS_CATALOG_LOAD);
+    MappedCatalog catalog;
+    int failed = openCatalog(&catalog, path) != 0;
+    STATS_END(STATS_CATALOG_LOAD);
+    if (failed)
+        return -1;
+
+    // Drop everything derived from the previous destinations.
+    if (destinationEphemerisLoaded) {
+        freeEphemerisCache(&destinationEphemeris);
+        destinationEphemerisLoaded = 0;
+    }
+    if (knownDestinationsIndexBuilt) {
+        freeDestinationIndex(&knownDestinationsIndex);
+        knownDestinationsIndexBuilt = 0;
+    }
+    if (knownDestinationsGravityBuilt) {
+        freeGravityField(&knownDestinationsGravity);
+        knownDestinationsGravityBuilt = 0;
+    }
+    if (destinationDescriptionsBuilt)
+        freeDestinationDescriptions();
+    if (knownDestinationsNamesBuilt) {
+        freeNameIndex(&knownDestinationsNames);
+        knownDestinationsNamesBuilt = 0;
+    }
+    if (knownDestinationsTableBuilt) {
+        freeBodyTable(&knownDestinationsTable);
+        knownDestinationsTableBuilt = 0;
+    }
+    knownDestinationsFingerprinted = 0;
+    closeCatalog(&loadedCatalog);
+
+    loadedCatalog = catalog;
+    knownDestinations = catalog.records;
+    knownDestinationsCount = (int)catalog.header->count;
+    return 0;
+}
@@ -2,17 +2,88 @@
 #define DESTINATIONS_H
 
 #include "planet.h"
+#include "ephemeris.h"
+#include "spatialindex.h"
+#include "ephemeriscache.h"
+#include "integrator.h"
 
 // Array of known destinations (planets, etc.)
-extern Planet knownDestinations[];
+// Points at the built-in planets or at the records of a loaded catalog.
+extern Planet *knownDestinations;
 
 // Number of known destinations.
 extern int knownDestinationsCount;
 
+// Id of "no known destination", where ids index knownDestinations.
+#define DESTINATION_NONE -1
+
+// Replaces the known destinations with a binary catalog file (see catalog.h).
+// The catalog is memory-mapped and used in place. Returns 0 on success, -1 on error.
+int loadDestinationCatalog(const char *path);
+
+// Maps a Chebyshev ephemeris cache (see ephemeriscache.h) built for the
+// current destinations. Returns 0 on success, -1 on error or when the cache
+// was built for a different number of bodies or from different elements (its
+// source fingerprint, see bodyTableFingerprint). Loading a catalog drops it.
+int loadDestinationEphemeris(const char *path);
+
+// The loaded ephemeris cache, or NULL.
+const EphemerisCache *getDestinationEphemeris(void);
+
+// Name of knownDestinations[id], or "Unknown" for DESTINATION_NONE.
+const char *getDestinationName(int id);
+
+// Description of knownDestinations[id] (or of DESTINATION_NONE) from the
+// destination metadata table. Descriptions are interned once in an arena and
+// the table keeps one pointer per destination; it is built on first use and
+// dropped with the catalog. Returns NULL if the table could not be allocated.
+const char *getDestinationDescription(int id);
+
+// Adds the descriptions of a metadata file to the table, replacing earlier
+// ones. Lines read "name,description", the description running to the end of
+// the line; blank lines and lines starting with '#' are skipped. Returns how
+// many lines named a known destination, or -1 on error.
+int loadDestinationDescriptions(const char *path);
+
 // Function to print all loaded destinations.
 void printDestinations(void);
 
 // Helper function: Find a destination by name.
+// Backed by a hash index built on first use.
 Planet *getDestinationByName(const char *name);
 
+// Same as getDestinationByName, ignoring ASCII case.
+Planet *getDestinationByNameIgnoreCase(const char *name);
+
+// Stores up to maxIds indices into knownDestinations whose names start with
+// prefix (ignoring case), in name order. Returns the number stored.
+int findDestinationsByPrefix(const char *prefix, int *ids, int maxIds);
+
+// Structure-of-arrays view of knownDestinations for the batched ephemeris.
+// Built on first use; returns NULL if the table could not be allocated.
+const BodyTable *getKnownDestinationsTable(void);
+
+// bodyTableFingerprint of that table, computed once per catalog; 0 if the
+// table could not be built. Files holding destination ids record it.
+uint64_t getKnownDestinationsFingerprint(void);
+
+// Position of knownDestinations[id] at time: from the ephemeris cache when one
+// is loaded and covers time, otherwise from the analytic model.
+Vector3D getDestinationPosition(int id, double time);
+
+// Nearest-body index over knownDestinations. Rebuilt around the query time
+// when it drifts more than DESTINATION_INDEX_HORIZON days from the index epoch.
+const DestinationIndex *getKnownDestinationsIndex(double time);
+
+// Builds, ahead of a parallel section, what the destination lookups otherwise
+// build on first use: the body table behind getDestinationPosition and the
+// nearest-body index, re-epoched to time. Workers then only read them, through
+// getDestinationPosition and the returned index, without racing a rebuild.
+// Returns NULL on allocation failure.
+const DestinationIndex *prepareKnownDestinations(double time);
+
+// Gravity of the known destinations with a mass, for the N-body travel model.
+// Built on first use; returns NULL if it could not be allocated.
+GravityField *getKnownDestinationsGravity(void);
+
 #endif
@@ -0,0 +1,211 @@
+#include "dispersion.h"
+#include "destinations.h"
+#include "navigation.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.141592653589793
+#define DISPERSION_CHUNK 1024              // samples per work item
+#define DISPERSION_DRAWS 6                 // generator outputs per sample
+#define DISPERSION_MIN_DURATION 1e-3       // travel times are clamped to at least this, days
+#define DISPERSION_TRANSFER_SPAN 5.0       // transfer histogram spans this many sigmas each way
+#define DISPERSION_MISS_LO 1e-6            // miss histogram range, AU
+#define DISPERSION_MISS_HI 1e2
+
+// Output `counter` of the stream `key`: the SplitMix64 finalizer applied to a
+// Weyl sequence. Any output can be computed directly, so a sample's draws
+// do not depend on which worker flies it or what it flew before.
+static uint64_t counterRandom(uint64_t key, uint64_t counter) {
+    uint64_t z = key + (counter + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Two independent standard normal deviates from outputs counter and counter + 1 (Box-Muller).
+static void normalPair(uint64_t key, uint64_t counter, double *a, double *b) {
+    double u = (double)((counterRandom(key, counter) >> 11) + 1) * 0x1p-53;   // (0, 1]
+    double v = (double)(counterRandom(key, counter + 1) >> 11) * 0x1p-53;     // [0, 1)
+    double r = sqrt(-2.0 * log(u));
+    *a = r * cos(2.0 * PI * v);
+    *b = r * sin(2.0 * PI * v);
+}
+
+static void initHistogram(DispersionHistogram *histogram, double lo, double hi, int logarithmic) {
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->lo = lo;
+    histogram->hi = hi;
+    histogram->logarithmic = logarithmic;
+    histogram->min = INFINITY;
+    histogram->max = -INFINITY;
+}
+
+static void addToHistogram(DispersionHistogram *histogram, double value) {
+    double f = histogram->logarithmic
+             ? log(value / histogram->lo) / log(histogram->hi / histogram->lo)
+             : (value - histogram->lo) / (histogram->hi - histogram->lo);
+    int b = !(f >= 0.0) ? 0 : f >= 1.0 ? DISPERSION_BINS + 1 : 1 + (int)(f * DISPERSION_BINS);
+    if (b == DISPERSION_BINS + 1 && f < 1.0)
+        b = DISPERSION_BINS;   // f just below 1 rounded up
+    histogram->counts[b]++;
+    histogram->min = value < histogram->min ? value : histogram->min;
+    histogram->max = value > histogram->max ? value : histogram->max;
+}
+
+static void mergeHistogram(DispersionHistogram *into, const DispersionHistogram *from) {
+    for (int b = 0; b < DISPERSION_BINS + 2; b++)
+        into->counts[b] += from->counts[b];
+    into->min = from->min < into->min ? from->min : into->min;
+    into->max = from->max > into->max ? from->max : into->max;
+}
+
+double histogramEdge(const DispersionHistogram *histogram, int b) {
+    double f = (double)(b - 1) / DISPERSION_BINS;
+    return histogram->logarithmic ? histogram->lo * pow(histogram->hi / histogram->lo, f)
+                                  : histogram->lo + f * (histogram->hi - histogram->lo);
+}
+
+double histogramPercentile(const DispersionHistogram *histogram, double p) {
+    long long total = 0;
+    for (int b = 0; b < DISPERSION_BINS + 2; b++)
+        total += histogram->counts[b];
+    if (total == 0)
+        return NAN;
+    double rank = p * (double)total, below = 0.0;
+    int b = 0;
+    while (b < DISPERSION_BINS + 1 && below + (double)histogram->counts[b] < rank)
+        below += (double)histogram->counts[b++];
+    // The outer bins reach out to the extreme samples.
+    double low = b == 0 ? histogram->min : histogramEdge(histogram, b);
+    double high = b == DISPERSION_BINS + 1 ? histogram->max : histogramEdge(histogram, b + 1);
+    double f = histogram->counts[b] > 0 ? (rank - below) / (double)histogram->counts[b] : 0.0;
+    double value = histogram->logarithmic && low > 0.0 ? low * pow(high / low, f) : low + f * (high - low);
+    return value < histogram->min ? histogram->min : value > histogram->max ? histogram->max : value;
+}
+
+// Per-worker totals, padded to whole cache lines.
+typedef struct {
+    long long atTarget, atOther, nowhere, closePasses;
+    DispersionHistogram transfer, miss;
+} DispersionCounters;
+
+#define DISPERSION_COUNTERS_STRIDE ((sizeof(DispersionCounters) + 63) & ~(size_t)63)
+
+typedef struct {
+    const DispersionMission *mission;
+    const DestinationIndex *index;
+    uint64_t key;
+    Vector3D aim;                 // nominal commanded position
+    char *counters;               // DISPERSION_COUNTERS_STRIDE bytes per worker
+    double *transferSums;         // per chunk, summed in chunk order afterwards
+    double *missSums;
+} DispersionJob;
+
+static void flyChunks(void *context, int begin, int end, int worker) {
+    DispersionJob *job = context;
+    const DispersionMission *mission = job->mission;
+    DispersionCounters *counters = (DispersionCounters *)(job->counters + (size_t)worker * DISPERSION_COUNTERS_STRIDE);
+    Vector3D arrivedAt[DISPERSION_CHUNK];
+    double arrivedTime[DISPERSION_CHUNK];
+    int arrivedId[DISPERSION_CHUNK];
+
+    for (int chunk = begin; chunk < end; chunk++) {
+        long long first = (long long)chunk * DISPERSION_CHUNK;
+        long long remaining = mission->samples - first;
+        int count = remaining < DISPERSION_CHUNK ? (int)remaining : DISPERSION_CHUNK;
+        double transferSum = 0.0, missSum = 0.0;
+        for (int k = 0; k < count; k++) {
+            uint64_t counter = (uint64_t)(first + k) * DISPERSION_DRAWS;
+            double n[DISPERSION_DRAWS];
+            for (int d = 0; d < DISPERSION_DRAWS; d += 2)
+                normalPair(job->key, counter + d, &n[d], &n[d + 1]);
+
+            double departure = mission->departureTime + mission->departureSigma * n[0];
+            double duration = mission->duration + mission->durationSigma * n[1];
+            if (duration < DISPERSION_MIN_DURATION)
+                duration = DISPERSION_MIN_DURATION;
+            Vector3D from = getDestinationPosition(mission->origin, departure);
+            Vector3D to = { job->aim.x + mission->aimSigma * n[2],
+                            job->aim.y + mission->aimSigma * n[3],
+                            job->aim.z + mission->aimSigma * n[4] };
+            double arrival = departure + duration;
+            counters->closePasses += countClosePasses(job->index, from, departure, to, arrival);
+
+            double miss = calculateDistance(to, getDestinationPosition(mission->target, arrival));
+            addToHistogram(&counters->transfer, duration);
+            addToHistogram(&counters->miss, miss);
+            transferSum += duration;
+            missSum += miss;
+            arrivedAt[k] = to;
+            arrivedTime[k] = arrival;
+        }
+        job->transferSums[chunk] = transferSum;
+        job->missSums[chunk] = missSum;
+
+        // Resolve this chunk's arrivals together.
+        determineDestinationIds(job->index, arrivedAt, arrivedTime, count, arrivedId, NULL);
+        for (int k = 0; k < count; k++) {
+            counters->atTarget += arrivedId[k] == mission->target;
+            counters->atOther += arrivedId[k] >= 0 && arrivedId[k] != mission->target;
+            counters->nowhere += arrivedId[k] < 0;
+        }
+    }
+}
+
+int runDispersion(const DispersionMission *mission, ThreadPool *pool, DispersionResult *result) {
+    memset(result, 0, sizeof(*result));
+    double spread = DISPERSION_TRANSFER_SPAN * (mission->durationSigma > 0.0 ? mission->durationSigma : 1.0);
+    initHistogram(&result->transfer, fmax(mission->duration - spread, 0.0), mission->duration + spread, 0);
+    initHistogram(&result->miss, DISPERSION_MISS_LO, DISPERSION_MISS_HI, 1);
+    result->samples = mission->samples;
+
+    int chunks = (int)((mission->samples + DISPERSION_CHUNK - 1) / DISPERSION_CHUNK);
+    int workers = threadPoolSize(pool);
+    DispersionJob job;
+    job.mission = mission;
+    job.index = prepareKnownDestinations(mission->departureTime + mission->duration);
+    if (job.index == NULL)
+        return -1;
+    job.key = counterRandom(mission->seed, 0);
+    job.aim = getDestinationPosition(mission->target, mission->departureTime + mission->duration);
+    job.counters = aligned_alloc(64, (size_t)workers * DISPERSION_COUNTERS_STRIDE);
+    job.transferSums = malloc((size_t)(chunks > 0 ? chunks : 1) * 2 * sizeof(double));
+    if (job.counters == NULL || job.transferSums == NULL) {
+        free(job.counters);
+        free(job.transferSums);
+        return -1;
+    }
+    job.missSums = job.transferSums + chunks;
+    for (int w = 0; w < workers; w++) {
+        DispersionCounters *counters = (DispersionCounters *)(job.counters + (size_t)w * DISPERSION_COUNTERS_STRIDE);
+        memset(counters, 0, sizeof(*counters));
+        counters->transfer = result->transfer;
+        counters->miss = result->miss;
+    }
+
+    parallelFor(pool, chunks, 1, flyChunks, &job);
+
+    for (int w = 0; w < workers; w++) {
+        const DispersionCounters *counters =
+            (const DispersionCounters *)(job.counters + (size_t)w * DISPERSION_COUNTERS_STRIDE);
+        result->atTarget += counters->atTarget;
+        result->atOther += counters->atOther;
+        result->nowhere += counters->nowhere;
+        result->closePasses += counters->closePasses;
+        mergeHistogram(&result->transfer, &counters->transfer);
+        mergeHistogram(&result->miss, &counters->miss);
+    }
+    double transferSum = 0.0, missSum = 0.0;
+    for (int c = 0; c < chunks; c++) {
+        transferSum += job.transferSums[c];
+        missSum += job.missSums[c];
+    }
+    if (mission->samples > 0) {
+        result->meanTransfer = transferSum / (double)mission->samples;
+        result->meanMiss = missSum / (double)mission->samples;
+    }
+    free(job.counters);
+    free(job.transferSums);
+    return 0;
+}
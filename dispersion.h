@@ -0,0 +1,62 @@
+#ifndef DISPERSION_H
+#define DISPERSION_H
+
+#include "threadpool.h"
+#include <stdint.h>
+
+#define DISPERSION_BINS 256   // histogram bins between lo and hi
+
+// A transfer flown many times with perturbed inputs. The nominal ship leaves
+// the origin on departureTime and is commanded to the target's position
+// duration days later; each sample draws normal errors in the departure time,
+// the travel time and, per axis, the commanded position, then flies the
+// straight-line travel of the console and resolves its arrival.
+typedef struct {
+    int origin;                 // ids into knownDestinations
+    int target;
+    double departureTime;       // in days
+    double duration;            // in days
+    double departureSigma;      // standard deviation of the departure time, days
+    double durationSigma;       // of the travel time, days
+    double aimSigma;            // of each coordinate of the commanded position, AU
+    long long samples;
+    uint64_t seed;
+} DispersionMission;
+
+// Histogram over [lo, hi), in equal steps of the value or, when logarithmic,
+// of its logarithm. counts[0] holds the samples below lo and
+// counts[DISPERSION_BINS + 1] those at or above hi.
+typedef struct {
+    double lo, hi;
+    int logarithmic;
+    double min, max;            // of the samples
+    long long counts[DISPERSION_BINS + 2];
+} DispersionHistogram;
+
+typedef struct {
+    long long samples;
+    long long atTarget;         // arrivals resolved to the target
+    long long atOther;          // to another known destination
+    long long nowhere;          // to no known destination
+    long long closePasses;      // bodies passed within the arrival threshold, arrivals included
+    double meanTransfer;        // travel time, days
+    double meanMiss;            // distance from the target on arrival, AU
+    DispersionHistogram transfer;
+    DispersionHistogram miss;
+} DispersionResult;
+
+// Flies the mission's samples in parallel chunks across pool (NULL runs
+// single-threaded). Sample i draws its perturbations from a counter-based
+// generator keyed by the seed and i alone, and the totals are combined in
+// sample order, so the result is bit-identical for any number of threads.
+// Returns 0 on success, -1 on allocation failure.
+int runDispersion(const DispersionMission *mission, ThreadPool *pool, DispersionResult *result);
+
+// Value below which the fraction p (0 <= p <= 1) of the samples fall,
+// interpolated within its bin and clamped to the samples' range.
+double histogramPercentile(const DispersionHistogram *histogram, double p);
+
+// Lower edge of bin b, for 1 <= b <= DISPERSION_BINS + 1.
+double histogramEdge(const DispersionHistogram *histogram, int b);
+
+#endif
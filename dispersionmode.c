@@ -0,0 +1,99 @@
+#include "modes.h"
+#include "destinations.h"
+#include "dispersion.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DISPERSION_HISTOGRAM_ROWS 16
+#define DISPERSION_BAR_WIDTH 50
+
+// Prints the histogram's bins in DISPERSION_HISTOGRAM_ROWS rows, from the
+// first row with samples to the last, with the outer bins on rows of their own.
+static void printDispersionHistogram(const DispersionHistogram *histogram, const char *unit) {
+    const int perRow = DISPERSION_BINS / DISPERSION_HISTOGRAM_ROWS;
+    long long rows[DISPERSION_HISTOGRAM_ROWS + 2] = { 0 }, largest = 1;
+    rows[0] = histogram->counts[0];
+    rows[DISPERSION_HISTOGRAM_ROWS + 1] = histogram->counts[DISPERSION_BINS + 1];
+    for (int b = 1; b <= DISPERSION_BINS; b++)
+        rows[1 + (b - 1) / perRow] += histogram->counts[b];
+    int first = DISPERSION_HISTOGRAM_ROWS + 2, last = -1;
+    for (int r = 0; r < DISPERSION_HISTOGRAM_ROWS + 2; r++) {
+        if (rows[r] == 0)
+            continue;
+        first = r < first ? r : first;
+        last = r;
+        largest = rows[r] > largest ? rows[r] : largest;
+    }
+    for (int r = first; r <= last; r++) {
+        char bar[DISPERSION_BAR_WIDTH + 1];
+        int width = (int)((double)rows[r] / (double)largest * DISPERSION_BAR_WIDTH + 0.5);
+        memset(bar, '#', (size_t)width);
+        bar[width] = '\0';
+        if (r == 0)
+            printf("          < %-11.4g %s %12lld %s\n", histogram->lo, unit, rows[r], bar);
+        else if (r == DISPERSION_HISTOGRAM_ROWS + 1)
+            printf("         >= %-11.4g %s %12lld %s\n", histogram->hi, unit, rows[r], bar);
+        else
+            printf("%11.4g - %-11.4g %s %12lld %s\n", histogramEdge(histogram, 1 + (r - 1) * perRow),
+                   histogramEdge(histogram, 1 + r * perRow), unit, rows[r], bar);
+    }
+}
+
+static void printDispersionSummary(const char *title, const DispersionHistogram *histogram, double mean) {
+    printf("%s: mean %.6g, min %.6g, p1 %.6g, p5 %.6g, p50 %.6g, p95 %.6g, p99 %.6g, max %.6g\n", title, mean,
+           histogram->min, histogramPercentile(histogram, 0.01), histogramPercentile(histogram, 0.05),
+           histogramPercentile(histogram, 0.5), histogramPercentile(histogram, 0.95),
+           histogramPercentile(histogram, 0.99), histogram->max);
+}
+
+int runDispersionMode(char **args, int threads) {
+    Planet *from = getDestinationByName(args[0]);
+    Planet *to = getDestinationByName(args[1]);
+    if (from == NULL || to == NULL) {
+        printf("Error: unknown destination %s\n", from == NULL ? args[0] : args[1]);
+        return 1;
+    }
+    DispersionMission mission;
+    mission.origin = (int)(from - knownDestinations);
+    mission.target = (int)(to - knownDestinations);
+    mission.departureTime = atof(args[2]);
+    mission.duration = atof(args[3]);
+    mission.departureSigma = atof(args[4]);
+    mission.durationSigma = atof(args[5]);
+    mission.aimSigma = atof(args[6]);
+    mission.samples = atoll(args[7]);
+    mission.seed = strtoull(args[8], NULL, 0);
+    if (!(mission.duration > 0.0) || !(mission.departureSigma >= 0.0) || !(mission.durationSigma >= 0.0) ||
+        !(mission.aimSigma >= 0.0) || mission.samples <= 0 || mission.samples > 1000000000000ll) {
+        printf("Error: invalid dispersion analysis\n");
+        return 1;
+    }
+
+    ThreadPool *pool = createThreadPool(threads);
+    DispersionResult result;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = runDispersion(&mission, pool, &result) != 0;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    int workers = threadPoolSize(pool);
+    destroyThreadPool(pool);
+    if (failed) {
+        printf("Error: not enough memory for %lld samples\n", mission.samples);
+        return 1;
+    }
+    double seconds = elapsedSeconds(start, stop);
+    printf("%s -> %s: %lld samples in %.3f s on %d threads (%.0f samples/s)\n", from->name, to->name,
+           result.samples, seconds, workers, seconds > 0.0 ? result.samples / seconds : 0.0);
+    printf("Arrived at %s: %lld (%.4f%%), at other destinations: %lld, nowhere known: %lld\n", to->name,
+           result.atTarget, 100.0 * result.atTarget / result.samples, result.atOther, result.nowhere);
+    printf("Close passes on the way: %lld\n", result.closePasses);
+    printDispersionSummary("Transfer time (days)", &result.transfer, result.meanTransfer);
+    printDispersionSummary("Miss distance (AU)", &result.miss, result.meanMiss);
+    printf("\nTransfer time:\n");
+    printDispersionHistogram(&result.transfer, "days");
+    printf("\nMiss distance:\n");
+    printDispersionHistogram(&result.miss, "AU  ");
+    return 0;
+}
@@ -0,0 +1,330 @@
+#include "ephemeris.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define PI 3.141592653589793
+#define TWO_PI (2 * PI)
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+// Adding and subtracting 1.5 * 2^52 rounds a double to the nearest integer, 1.5 * 2^23 a float.
+#define ROUND_MAGIC 6755399441055744.0
+#define ROUND_MAGIC_FLOAT 12582912.0f
+#define KEPLER_TOLERANCE_FLOAT 1e-6f   // in revolutions; a few float ulps of E
+
+// Minimax coefficients for sin and cos on [-PI/4, PI/4] (Cephes).
+#define SIN_C0  1.58962301576546568060E-10
+#define SIN_C1 -2.50507477628578072866E-8
+#define SIN_C2  2.75573136213857245213E-6
+#define SIN_C3 -1.98412698295895385996E-4
+#define SIN_C4  8.33333333332211858878E-3
+#define SIN_C5 -1.66666666666666307295E-1
+#define COS_C0 -1.13585365213876817300E-11
+#define COS_C1  2.08757008419747316778E-9
+#define COS_C2 -2.75573141792967388112E-7
+#define COS_C3  2.48015872888517045348E-5
+#define COS_C4 -1.38888888888730564116E-3
+#define COS_C5  4.16666666666665929218E-2
+
+// The table's column pointers in field order.
+static void columnPointers(BodyTable *table, const double **columns[BODY_TABLE_COLUMNS]) {
+    const double **fields[BODY_TABLE_COLUMNS] = {
+        &table->orbitRadius, &table->meanMotion, &table->epochPhase, &table->eccentricity,
+        &table->periapsisX, &table->periapsisY, &table->periapsisZ,
+        &table->quadratureX, &table->quadratureY, &table->quadratureZ
+    };
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++)
+        columns[k] = fields[k];
+}
+
+int buildBodyTable(BodyTable *table, const Planet *planets, int count) {
+    size_t n = (size_t)(count > 0 ? count : 1);
+    double *storage = malloc(BODY_TABLE_COLUMNS * n * sizeof(double));
+    if (storage == NULL)
+        return -1;
+    for (int i = 0; i < count; i++) {
+        const Planet *planet = &planets[i];
+        Vector3D p, q;
+        getPlanetOrbitFrame(*planet, &p, &q);
+        double a = planet->orbitRadius;
+        double e = planet->eccentricity;
+        double b = a * sqrt(1.0 - e * e);
+        double phase = planet->meanAnomalyAtEpoch / 360.0;
+        double values[BODY_TABLE_COLUMNS] = {
+            a, 1.0 / planet->orbitalPeriod, phase - floor(phase), e,
+            a * p.x, a * p.y, a * p.z, b * q.x, b * q.y, b * q.z
+        };
+        for (int k = 0; k < BODY_TABLE_COLUMNS; k++)
+            storage[k * n + i] = values[k];
+    }
+    bindBodyTable(table, count, storage, n);
+    table->storage = storage;
+    return 0;
+}
+
+void freeBodyTable(BodyTable *table) {
+    free(table->storage);
+    bindBodyTable(table, 0, NULL, 0);
+}
+
+void bindBodyTable(BodyTable *table, int count, const double *columns, size_t columnStride) {
+    const double **fields[BODY_TABLE_COLUMNS];
+    columnPointers(table, fields);
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++)
+        *fields[k] = columns != NULL ? columns + k * columnStride : NULL;
+    table->count = count;
+    table->storage = NULL;
+}
+
+const double *bodyTableColumn(const BodyTable *table, int column) {
+    BodyTable view = *table;
+    const double **fields[BODY_TABLE_COLUMNS];
+    columnPointers(&view, fields);
+    return *fields[column];
+}
+
+BodyTable bodyTableSlice(const BodyTable *table, int first, int count) {
+    BodyTable view = *table;
+    const double **fields[BODY_TABLE_COLUMNS];
+    columnPointers(&view, fields);
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++)
+        *fields[k] += first;
+    view.count = count;
+    view.storage = NULL;
+    return view;
+}
+
+void gatherBodyTable(const BodyTable *table, const int *rows, int count, double *columns, BodyTable *gathered) {
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++) {
+        const double *source = bodyTableColumn(table, k);
+        double *column = columns + (size_t)k * count;
+        for (int i = 0; i < count; i++)
+            column[i] = source[rows[i]];
+    }
+    bindBodyTable(gathered, count, columns, (size_t)count);
+}
+
+uint64_t bodyTableFingerprint(const BodyTable *table) {
+    uint64_t hash = (FNV_OFFSET ^ (uint64_t)table->count) * FNV_PRIME;
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++) {
+        const double *column = bodyTableColumn(table, k);
+        for (int i = 0; i < table->count; i++) {
+            uint64_t bits;
+            memcpy(&bits, &column[i], sizeof(bits));
+            hash = (hash ^ bits) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+int isPlanarCircularBody(const BodyTable *table, int i) {
+    return table->eccentricity[i] == 0.0 && table->periapsisZ[i] == 0.0 && table->quadratureZ[i] == 0.0 &&
+           table->periapsisX[i] * table->quadratureY[i] - table->periapsisY[i] * table->quadratureX[i] > 0.0;
+}
+
+int compareSortEntry(const void *a, const void *b) {
+    const SortEntry *ea = a;
+    const SortEntry *eb = b;
+    if (ea->key < eb->key)
+        return -1;
+    if (ea->key > eb->key)
+        return 1;
+    return ea->id - eb->id;
+}
+
+int buildBodyTableF(BodyTableF *table, const BodyTable *source) {
+    size_t n = (size_t)(source->count > 0 ? source->count : 1);
+    // The two double columns, then the seven float ones.
+    double *storage = malloc(n * (2 * sizeof(double) + 7 * sizeof(float)));
+    if (storage == NULL)
+        return -1;
+    float *columns = (float *)(storage + 2 * n);
+    const double *fields[7] = {
+        source->eccentricity, source->periapsisX, source->periapsisY, source->periapsisZ,
+        source->quadratureX, source->quadratureY, source->quadratureZ
+    };
+    for (int i = 0; i < source->count; i++) {
+        storage[i] = source->meanMotion[i];
+        storage[n + i] = source->epochPhase[i];
+        for (int k = 0; k < 7; k++)
+            columns[k * n + i] = (float)fields[k][i];
+    }
+    table->count = source->count;
+    table->meanMotion = storage;
+    table->epochPhase = storage + n;
+    table->eccentricity = columns;
+    table->periapsisX = columns + n;
+    table->periapsisY = columns + 2 * n;
+    table->periapsisZ = columns + 3 * n;
+    table->quadratureX = columns + 4 * n;
+    table->quadratureY = columns + 5 * n;
+    table->quadratureZ = columns + 6 * n;
+    table->storage = storage;
+    return 0;
+}
+
+void freeBodyTableF(BodyTableF *table) {
+    free(table->storage);
+    memset(table, 0, sizeof(*table));
+}
+
+BodyTableF bodyTableSliceF(const BodyTableF *table, int first, int count) {
+    BodyTableF view = *table;
+    view.meanMotion += first;
+    view.epochPhase += first;
+    view.eccentricity += first;
+    view.periapsisX += first;
+    view.periapsisY += first;
+    view.periapsisZ += first;
+    view.quadratureX += first;
+    view.quadratureY += first;
+    view.quadratureZ += first;
+    view.count = count;
+    view.storage = NULL;
+    return view;
+}
+
+// Double instantiation: the authoritative kernel behind computeBodyPositions.
+#define REAL double
+#define TABLE BodyTable
+#define KERNEL(name) name
+#define REAL_ROUND_MAGIC ROUND_MAGIC
+#define REAL_KEPLER_TOLERANCE KEPLER_TOLERANCE
+#if defined(__AVX2__)
+#define VREAL __m256d
+#define V_LANES 4
+#define V_SET(x) _mm256_set1_pd(x)
+#define V_ZERO _mm256_setzero_pd
+#define V_LOAD _mm256_loadu_pd
+#define V_STORE _mm256_storeu_pd
+#define V_ADD _mm256_add_pd
+#define V_SUB _mm256_sub_pd
+#define V_MUL _mm256_mul_pd
+#define V_DIV _mm256_div_pd
+#define V_AND _mm256_and_pd
+#define V_XOR _mm256_xor_pd
+#define V_ROUND(x) _mm256_round_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define V_BLEND _mm256_blendv_pd
+#define V_CMP _mm256_cmp_pd
+#define V_MOVEMASK _mm256_movemask_pd
+#define V_ABS_MASK _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL))
+#define V_QUADRANT(q, swap, sinSign, cosSign) quadrantMasks4(q, &swap, &sinSign, &cosSign)
+#define V_MEAN_ANOMALY(table, i, time) meanAnomaly4(table->meanMotion + i, table->epochPhase + i, time)
+
+static inline __m256d meanAnomaly4(const double *meanMotion, const double *epochPhase, __m256d time) {
+    __m256d m = _mm256_add_pd(_mm256_mul_pd(time, _mm256_loadu_pd(meanMotion)), _mm256_loadu_pd(epochPhase));
+    return _mm256_sub_pd(m, _mm256_round_pd(m, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+
+static inline void quadrantMasks4(__m256d q, __m256d *swap, __m256d *sinSign, __m256d *cosSign) {
+    const __m256i bit1 = _mm256_set1_epi64x(2);
+    const __m256i oddBit = _mm256_set1_epi64x(1);
+    __m256i qi = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(q));
+    *swap = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(qi, oddBit), oddBit));
+    *sinSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi, bit1), 62));
+    *cosSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(qi, oddBit), bit1), 62));
+}
+#endif
+#include "ephemeriskernel.h"
+
+// Float instantiation for BodyTableF.
+#define REAL float
+#define TABLE BodyTableF
+#define KERNEL(name) name##F
+#define REAL_ROUND_MAGIC ROUND_MAGIC_FLOAT
+#define REAL_KEPLER_TOLERANCE KEPLER_TOLERANCE_FLOAT
+#if defined(__AVX2__)
+#define VREAL __m256
+#define V_LANES 8
+#define V_SET(x) _mm256_set1_ps((float)(x))
+#define V_ZERO _mm256_setzero_ps
+#define V_LOAD _mm256_loadu_ps
+#define V_STORE _mm256_storeu_ps
+#define V_ADD _mm256_add_ps
+#define V_SUB _mm256_sub_ps
+#define V_MUL _mm256_mul_ps
+#define V_DIV _mm256_div_ps
+#define V_AND _mm256_and_ps
+#define V_XOR _mm256_xor_ps
+#define V_ROUND(x) _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define V_BLEND _mm256_blendv_ps
+#define V_CMP _mm256_cmp_ps
+#define V_MOVEMASK _mm256_movemask_ps
+#define V_ABS_MASK _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))
+#define V_QUADRANT(q, swap, sinSign, cosSign) quadrantMasks8(q, &swap, &sinSign, &cosSign)
+#define V_MEAN_ANOMALY(table, i, time) meanAnomaly8(table->meanMotion + i, table->epochPhase + i, time)
+
+// Reduced in double four lanes at a time, then narrowed.
+static inline __m256 meanAnomaly8(const double *meanMotion, const double *epochPhase, __m256d time) {
+    __m128 low = _mm256_cvtpd_ps(meanAnomaly4(meanMotion, epochPhase, time));
+    __m128 high = _mm256_cvtpd_ps(meanAnomaly4(meanMotion + 4, epochPhase + 4, time));
+    return _mm256_set_m128(high, low);
+}
+
+static inline void quadrantMasks8(__m256 q, __m256 *swap, __m256 *sinSign, __m256 *cosSign) {
+    const __m256i bit1 = _mm256_set1_epi32(2);
+    const __m256i oddBit = _mm256_set1_epi32(1);
+    __m256i qi = _mm256_cvtps_epi32(q);
+    *swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(qi, oddBit), oddBit));
+    *sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(qi, bit1), 30));
+    *cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(qi, oddBit), bit1), 30));
+}
+#endif
+#include "ephemeriskernel.h"
+
+#if defined(__AVX2__)
+const char *ephemerisKernelName(void) {
+    return "avx2";
+}
+#else
+const char *ephemerisKernelName(void) {
+    return "scalar";
+}
+#endif
+
+Vector3D computeBodyPosition(const BodyTable *table, int body, double time) {
+    Vector3D pos;
+    bodyPosition(table, body, time, &pos.x, &pos.y, &pos.z);
+    return pos;
+}
+
+void computeBodyPositions(const BodyTable *table, const double *times, int timeCount,
+                          double *x, double *y, double *z) {
+    computePositions(table, times, timeCount, x, y, z);
+}
+
+void computeBodyPositionsAtTimes(const BodyTable *table, const double *times, double *x, double *y, double *z) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= table->count; i += 4)
+        lanePositions(table, i, meanAnomaly4(table->meanMotion + i, table->epochPhase + i, _mm256_loadu_pd(times + i)),
+                      x, y, z);
+#endif
+    for (; i < table->count; i++)
+        bodyPosition(table, i, times[i], &x[i], &y[i], &z[i]);
+}
+
+void computeBodyPositionsF(const BodyTableF *table, const double *times, int timeCount,
+                           float *x, float *y, float *z) {
+    computePositionsF(table, times, timeCount, x, y, z);
+}
+
+void computeBodyPositionsScalar(const BodyTable *table, const double *times, int timeCount,
+                                double *x, double *y, double *z) {
+    for (int t = 0; t < timeCount; t++) {
+        size_t offset = (size_t)t * table->count;
+        for (int i = 0; i < table->count; i++) {
+            double turns = times[t] * table->meanMotion[i] + table->epochPhase[i];
+            double e = table->eccentricity[i];
+            double E = solveKeplerEquation(2 * PI * (turns - nearbyint(turns)), e);
+            double along = cos(E) - e;
+            double across = sin(E);
+            x[offset + i] = along * table->periapsisX[i] + across * table->quadratureX[i];
+            y[offset + i] = along * table->periapsisY[i] + across * table->quadratureY[i];
+            z[offset + i] = along * table->periapsisZ[i] + across * table->quadratureZ[i];
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include "planet.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// BodyTable is a structure-of-arrays view of a body catalog used by the
+// batched position kernels. Everything the kernels need per body is
+// precomputed once: meanMotion in revolutions per day (1 / orbitalPeriod) so
+// the hot loop needs no divide, and the orbit orientation folded into two
+// scaled in-plane vectors, so a position is
+//   (cos E - e) * periapsis + sin E * quadrature
+// with E the eccentric anomaly. Circular bodies skip the Kepler solve.
+typedef struct {
+    int count;
+    const double *orbitRadius;    // semi-major axis a, in AU
+    const double *meanMotion;     // in revolutions per day
+    const double *epochPhase;     // mean anomaly at time 0, in revolutions
+    const double *eccentricity;
+    const double *periapsisX, *periapsisY, *periapsisZ;     // a * unit vector to periapsis
+    const double *quadratureX, *quadratureY, *quadratureZ;  // b * unit vector 90 degrees ahead
+    double *storage;              // owned column memory, NULL for views
+} BodyTable;
+
+// Number of double columns in a BodyTable, stored in the field order above.
+#define BODY_TABLE_COLUMNS 10
+
+// Builds a table owning its columns from an array of planets.
+// Returns 0 on success, -1 on allocation failure.
+int buildBodyTable(BodyTable *table, const Planet *planets, int count);
+
+// Releases the columns owned by a table built with buildBodyTable.
+void freeBodyTable(BodyTable *table);
+
+// Points table at count bodies whose columns are stored one after another,
+// columnStride doubles apart, in field order. The table does not own them.
+void bindBodyTable(BodyTable *table, int count, const double *columns, size_t columnStride);
+
+// Column k (0 <= k < BODY_TABLE_COLUMNS) of table, in field order.
+const double *bodyTableColumn(const BodyTable *table, int column);
+
+// Returns a non-owning view of count bodies starting at first.
+BodyTable bodyTableSlice(const BodyTable *table, int first, int count);
+
+// Copies the bodies rows[0..count) of table into columns, which must hold
+// BODY_TABLE_COLUMNS * count doubles, and binds gathered to the copy, so
+// scattered candidates can go through the batched kernel together.
+void gatherBodyTable(const BodyTable *table, const int *rows, int count, double *columns, BodyTable *gathered);
+
+// 64-bit FNV-1a over the body count and the bit patterns of every column, so
+// a file derived from one catalog can tell when it is used with another.
+uint64_t bodyTableFingerprint(const BodyTable *table);
+
+// Whether body i of the table is on a circular, prograde orbit in the
+// ecliptic, whose angle about the Sun grows linearly with time. The spatial
+// index's phase sectors and the conjunction finder's direct solve rely on it.
+int isPlanarCircularBody(const BodyTable *table, int i);
+
+// Sort record for qsort with compareSortEntry: by key, then by id, so the
+// order is the same on every platform. Used to order bodies and queries.
+typedef struct {
+    double key;
+    int id;
+} SortEntry;
+
+int compareSortEntry(const void *a, const void *b);
+
+// Single-precision copy of a BodyTable for bulk screening, where memory
+// bandwidth matters more than the last digits: about half the bytes per body
+// and twice the SIMD lanes. Mean motion and epoch phase stay double, so the
+// mean anomaly is reduced to a fraction of a turn before the rest of the
+// kernel runs in float and the error does not grow with time. Positions are
+// within 5e-7 * a of computeBodyPositions (measured up to 4.4e-7 * a for
+// e < 0.99 over +-1e6 days): 1.5e-5 AU, about 2200 km, at Neptune's 30 AU.
+// Screens must widen their thresholds by that much; transfers, arrivals and
+// reported distances stay on the double table.
+typedef struct {
+    int count;
+    const double *meanMotion;
+    const double *epochPhase;
+    const float *eccentricity;
+    const float *periapsisX, *periapsisY, *periapsisZ;
+    const float *quadratureX, *quadratureY, *quadratureZ;
+    void *storage;                // owned column memory, NULL for views
+} BodyTableF;
+
+// Builds a float table owning its columns from a double one.
+// Returns 0 on success, -1 on allocation failure.
+int buildBodyTableF(BodyTableF *table, const BodyTable *source);
+void freeBodyTableF(BodyTableF *table);
+BodyTableF bodyTableSliceF(const BodyTableF *table, int first, int count);
+
+// Evaluates every body of the table at every time in times.
+// Outputs are time-major: entry [t * table->count + b] holds body b at times[t].
+// Uses AVX2 when the build enables it and a scalar kernel otherwise; either
+// stays within 1e-12 * a of computeBodyPositionsScalar (checked by the bench).
+void computeBodyPositions(const BodyTable *table, const double *times, int timeCount,
+                          double *x, double *y, double *z);
+
+// Evaluates body i of the table at times[i], with the same arithmetic as
+// computeBodyPositions; x, y and z hold table->count entries. For candidates
+// gathered from many queries, each at its own time.
+void computeBodyPositionsAtTimes(const BodyTable *table, const double *times, double *x, double *y, double *z);
+
+// computeBodyPositions for a float table; both are instantiated from one kernel source.
+void computeBodyPositionsF(const BodyTableF *table, const double *times, int timeCount,
+                           float *x, float *y, float *z);
+
+// Position of a single body of the table, using the same kernel arithmetic.
+Vector3D computeBodyPosition(const BodyTable *table, int body, double time);
+
+// Reference path: same layout as computeBodyPositions, one getPlanetPosition-style
+// libm evaluation (solveKeplerEquation, sin, cos) per entry. navigator_bench checks the
+// kernels against it.
+void computeBodyPositionsScalar(const BodyTable *table, const double *times, int timeCount,
+                                double *x, double *y, double *z);
+
+// Returns a short name for the kernel compiled into computeBodyPositions.
+const char *ephemerisKernelName(void);
+
+#endif
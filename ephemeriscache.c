@@ -0,0 +1,358 @@
+#include "ephemeriscache.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PI 3.141592653589793
+#define MAX_REFINEMENTS 12         // halvings of the first segment length
+#define CHECKS_PER_COEFFICIENT 2   // verification points per segment, per coefficient
+#define BUILD_GRAIN 64             // bodies per work item
+
+static Vector3D bodyTablePosition(const void *context, int body, double time) {
+    return computeBodyPosition(context, body, time);
+}
+
+EphemerisSource bodyTableSource(const BodyTable *table) {
+    EphemerisSource source = { table->count, table->meanMotion, bodyTablePosition, table, bodyTableFingerprint(table) };
+    return source;
+}
+
+// Sums a Chebyshev series for the three axes at tau in [-1, 1] (Clenshaw's recurrence).
+static inline Vector3D chebyshevSum(const double *c, int n, double tau) {
+    const double *cx = c, *cy = c + n, *cz = c + 2 * n;
+    double twoTau = 2.0 * tau;
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0, z1 = 0.0, z2 = 0.0;
+    for (int j = n - 1; j >= 1; j--) {
+        double x0 = cx[j] + twoTau * x1 - x2;
+        double y0 = cy[j] + twoTau * y1 - y2;
+        double z0 = cz[j] + twoTau * z1 - z2;
+        x2 = x1; x1 = x0;
+        y2 = y1; y1 = y0;
+        z2 = z1; z1 = z0;
+    }
+    Vector3D pos = { cx[0] + tau * x1 - x2, cy[0] + tau * y1 - y2, cz[0] + tau * z1 - z2 };
+    return pos;
+}
+
+typedef struct {
+    const EphemerisSource *source;
+    const EphemerisCacheParameters *parameters;
+    EphemerisCacheBody *bodies;
+    double *coefficients;        // NULL while sizing
+    double *bodyError;
+    double nodes[EPHEMERIS_CACHE_MAX_COEFFICIENTS];   // Chebyshev nodes on [-1, 1]
+    double basis[EPHEMERIS_CACHE_MAX_COEFFICIENTS * EPHEMERIS_CACHE_MAX_COEFFICIENTS];  // T_j(node k)
+} CacheBuild;
+
+// Interpolates body over [start, start + days] at the Chebyshev nodes.
+static void fitSegment(const CacheBuild *build, int body, double start, double days, double *c) {
+    int n = build->parameters->coefficientCount;
+    Vector3D values[EPHEMERIS_CACHE_MAX_COEFFICIENTS];
+    for (int k = 0; k < n; k++)
+        values[k] = build->source->position(build->source->context, body,
+                                            start + 0.5 * days * (build->nodes[k] + 1.0));
+    for (int j = 0; j < n; j++) {
+        double sx = 0.0, sy = 0.0, sz = 0.0;
+        for (int k = 0; k < n; k++) {
+            double t = build->basis[j * n + k];
+            sx += values[k].x * t;
+            sy += values[k].y * t;
+            sz += values[k].z * t;
+        }
+        double scale = (j == 0 ? 1.0 : 2.0) / n;
+        c[j] = sx * scale;
+        c[n + j] = sy * scale;
+        c[2 * n + j] = sz * scale;
+    }
+}
+
+// Largest distance between the fit and the source at evenly spaced points of the segment.
+static double segmentError(const CacheBuild *build, int body, double start, double days, const double *c) {
+    int n = build->parameters->coefficientCount;
+    int checks = CHECKS_PER_COEFFICIENT * n;
+    double worst = 0.0;
+    for (int i = 0; i <= checks; i++) {
+        double tau = -1.0 + 2.0 * i / checks;
+        Vector3D fitted = chebyshevSum(c, n, tau);
+        Vector3D exact = build->source->position(build->source->context, body, start + 0.5 * days * (tau + 1.0));
+        double error = sqrt(calculateDistanceSquared(fitted, exact));
+        if (error > worst)
+            worst = error;
+    }
+    return worst;
+}
+
+// Chooses each body's segment length: the first try comes from its period,
+// then segments are halved until every one of them fits within tolerance.
+static void sizeBodies(void *context, int begin, int end, int worker) {
+    (void)worker;
+    CacheBuild *build = context;
+    const EphemerisCacheParameters *parameters = build->parameters;
+    double span = parameters->endTime - parameters->startTime;
+    double c[3 * EPHEMERIS_CACHE_MAX_COEFFICIENTS];
+    for (int body = begin; body < end; body++) {
+        double motion = build->source->meanMotion != NULL ? build->source->meanMotion[body] : 0.0;
+        double days = motion > 0.0 ? 1.0 / (motion * parameters->segmentsPerOrbit) : span;
+        double count = ceil(span / days);
+        double worst = 0.0;
+        for (int refinement = 0; ; refinement++) {
+            days = span / count;
+            worst = 0.0;
+            for (int s = 0; s < (int)count && worst <= parameters->tolerance; s++) {
+                double start = parameters->startTime + s * days;
+                fitSegment(build, body, start, days, c);
+                double error = segmentError(build, body, start, days, c);
+                if (error > worst)
+                    worst = error;
+            }
+            if (worst <= parameters->tolerance || refinement == MAX_REFINEMENTS || 2 * count > INT32_MAX)
+                break;
+            count *= 2;
+        }
+        build->bodies[body].segmentCount = (int32_t)count;
+        build->bodies[body].segmentRate = count / span;
+        build->bodies[body].reserved = 0;
+        build->bodyError[body] = worst;
+    }
+}
+
+static void fillBodies(void *context, int begin, int end, int worker) {
+    (void)worker;
+    CacheBuild *build = context;
+    const EphemerisCacheParameters *parameters = build->parameters;
+    int n = parameters->coefficientCount;
+    for (int body = begin; body < end; body++) {
+        const EphemerisCacheBody *entry = &build->bodies[body];
+        double days = 1.0 / entry->segmentRate;
+        double *c = build->coefficients + entry->firstCoefficient;
+        for (int s = 0; s < entry->segmentCount; s++, c += 3 * n)
+            fitSegment(build, body, parameters->startTime + s * days, days, c);
+    }
+}
+
+int buildEphemerisCache(EphemerisCache *cache, const EphemerisSource *source,
+                        const EphemerisCacheParameters *parameters, ThreadPool *pool) {
+    memset(cache, 0, sizeof(*cache));
+    int n = parameters->coefficientCount;
+    if (n < 1 || n > EPHEMERIS_CACHE_MAX_COEFFICIENTS || !(parameters->endTime > parameters->startTime) ||
+        !(parameters->segmentsPerOrbit > 0.0) || source->count < 0)
+        return -1;
+    CacheBuild *build = malloc(sizeof(CacheBuild));
+    size_t bodies = (size_t)(source->count > 0 ? source->count : 1);
+    EphemerisCacheBody *table = malloc(bodies * sizeof(EphemerisCacheBody));
+    double *bodyError = malloc(bodies * sizeof(double));
+    if (build == NULL || table == NULL || bodyError == NULL) {
+        free(build);
+        free(table);
+        free(bodyError);
+        return -1;
+    }
+    build->source = source;
+    build->parameters = parameters;
+    build->bodies = table;
+    build->coefficients = NULL;
+    build->bodyError = bodyError;
+    for (int k = 0; k < n; k++) {
+        double angle = PI * (k + 0.5) / n;
+        build->nodes[k] = cos(angle);
+        for (int j = 0; j < n; j++)
+            build->basis[j * n + k] = cos(j * angle);
+    }
+
+    parallelFor(pool, source->count, BUILD_GRAIN, sizeBodies, build);
+
+    uint64_t total = 0;
+    for (int body = 0; body < source->count; body++) {
+        table[body].firstCoefficient = total;
+        total += (uint64_t)table[body].segmentCount * 3 * (uint64_t)n;
+        if (bodyError[body] > cache->maxError)
+            cache->maxError = bodyError[body];
+    }
+    double *coefficients = NULL;
+    if (total <= SIZE_MAX / sizeof(double))
+        coefficients = malloc((size_t)(total > 0 ? total : 1) * sizeof(double));
+    int failed = coefficients == NULL || cache->maxError > parameters->tolerance;
+    if (!failed) {
+        build->coefficients = coefficients;
+        parallelFor(pool, source->count, BUILD_GRAIN, fillBodies, build);
+    }
+    free(bodyError);
+    free(build);
+    if (failed) {
+        free(table);
+        free(coefficients);
+        return -1;
+    }
+
+    cache->bodyCount = source->count;
+    cache->coefficientCount = n;
+    cache->startTime = parameters->startTime;
+    cache->endTime = parameters->endTime;
+    cache->tolerance = parameters->tolerance;
+    cache->sourceFingerprint = source->fingerprint;
+    cache->bodies = table;
+    cache->coefficients = coefficients;
+    cache->bodyStorage = table;
+    cache->coefficientStorage = coefficients;
+    return 0;
+}
+
+void freeEphemerisCache(EphemerisCache *cache) {
+    if (cache->mapping != NULL)
+        munmap(cache->mapping, cache->mappingSize);
+    free(cache->bodyStorage);
+    free(cache->coefficientStorage);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + EPHEMERIS_CACHE_ALIGNMENT - 1) & ~(uint64_t)(EPHEMERIS_CACHE_ALIGNMENT - 1);
+}
+
+static int writePadding(FILE *file, uint64_t *offset, uint64_t target) {
+    static const char zeros[EPHEMERIS_CACHE_ALIGNMENT];
+    if (target > *offset && fwrite(zeros, 1, target - *offset, file) != target - *offset)
+        return -1;
+    *offset = target;
+    return 0;
+}
+
+int writeEphemerisCache(const EphemerisCache *cache, const char *path) {
+    uint64_t total = 0;
+    if (cache->bodyCount > 0) {
+        const EphemerisCacheBody *last = &cache->bodies[cache->bodyCount - 1];
+        total = last->firstCoefficient + (uint64_t)last->segmentCount * 3 * (uint64_t)cache->coefficientCount;
+    }
+    EphemerisCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EPHEMERIS_CACHE_MAGIC, sizeof(header.magic));
+    header.version = EPHEMERIS_CACHE_VERSION;
+    header.headerSize = sizeof(EphemerisCacheHeader);
+    header.bodyCount = (uint64_t)cache->bodyCount;
+    header.coefficientCount = (uint64_t)cache->coefficientCount;
+    header.startTime = cache->startTime;
+    header.endTime = cache->endTime;
+    header.tolerance = cache->tolerance;
+    header.maxError = cache->maxError;
+    header.sourceFingerprint = cache->sourceFingerprint;
+    header.bodiesOffset = alignUp(sizeof(EphemerisCacheHeader));
+    header.coefficientsOffset = alignUp(header.bodiesOffset + header.bodyCount * sizeof(EphemerisCacheBody));
+    header.coefficientTotal = total;
+    header.fileSize = header.coefficientsOffset + total * sizeof(double);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+    uint64_t offset = sizeof(header);
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    failed = failed || writePadding(file, &offset, header.bodiesOffset) != 0;
+    failed = failed || fwrite(cache->bodies, sizeof(EphemerisCacheBody), (size_t)cache->bodyCount, file) !=
+                       (size_t)cache->bodyCount;
+    offset += header.bodyCount * sizeof(EphemerisCacheBody);
+    failed = failed || writePadding(file, &offset, header.coefficientsOffset) != 0;
+    failed = failed || fwrite(cache->coefficients, sizeof(double), (size_t)total, file) != (size_t)total;
+    if (fclose(file) != 0)
+        failed = 1;
+    return failed ? -1 : 0;
+}
+
+static int sectionFits(uint64_t offset, uint64_t count, uint64_t elementSize, size_t fileSize) {
+    if (offset % EPHEMERIS_CACHE_ALIGNMENT != 0 || offset > fileSize)
+        return 0;
+    return count <= (fileSize - offset) / elementSize;
+}
+
+// Every body's segments must lie inside the coefficient section.
+static int bodiesFit(const EphemerisCacheHeader *header, const EphemerisCacheBody *bodies) {
+    uint64_t perSegment = 3 * header->coefficientCount;
+    for (uint64_t i = 0; i < header->bodyCount; i++) {
+        const EphemerisCacheBody *body = &bodies[i];
+        if (body->segmentCount < 1 || !(body->segmentRate > 0.0) ||
+            body->firstCoefficient > header->coefficientTotal ||
+            (uint64_t)body->segmentCount > (header->coefficientTotal - body->firstCoefficient) / perSegment)
+            return 0;
+    }
+    return 1;
+}
+
+int openEphemerisCache(EphemerisCache *cache, const char *path) {
+    memset(cache, 0, sizeof(*cache));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(EphemerisCacheHeader)) {
+        fprintf(stderr, "%s: not an ephemeris cache\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    const EphemerisCacheHeader *header = base;
+    const char *problem = NULL;
+    if (memcmp(header->magic, EPHEMERIS_CACHE_MAGIC, sizeof(header->magic)) != 0)
+        problem = "bad magic";
+    else if (header->version != EPHEMERIS_CACHE_VERSION)
+        problem = "unsupported version";
+    else if (header->headerSize != sizeof(EphemerisCacheHeader) || header->coefficientCount < 1 ||
+             header->coefficientCount > EPHEMERIS_CACHE_MAX_COEFFICIENTS || !(header->endTime > header->startTime))
+        problem = "bad header";
+    else if (header->bodyCount > (uint64_t)0x7fffffff || header->fileSize > size)
+        problem = "truncated file";
+    else if (!sectionFits(header->bodiesOffset, header->bodyCount, sizeof(EphemerisCacheBody), size) ||
+             !sectionFits(header->coefficientsOffset, header->coefficientTotal, sizeof(double), size) ||
+             !bodiesFit(header, (const EphemerisCacheBody *)((const char *)base + header->bodiesOffset)))
+        problem = "section out of range";
+    if (problem != NULL) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        munmap(base, size);
+        return -1;
+    }
+
+    cache->bodyCount = (int)header->bodyCount;
+    cache->coefficientCount = (int)header->coefficientCount;
+    cache->startTime = header->startTime;
+    cache->endTime = header->endTime;
+    cache->tolerance = header->tolerance;
+    cache->maxError = header->maxError;
+    cache->sourceFingerprint = header->sourceFingerprint;
+    cache->bodies = (const EphemerisCacheBody *)((const char *)base + header->bodiesOffset);
+    cache->coefficients = (const double *)((const char *)base + header->coefficientsOffset);
+    cache->mapping = base;
+    cache->mappingSize = size;
+    return 0;
+}
+
+int ephemerisCacheCovers(const EphemerisCache *cache, double time) {
+    return time >= cache->startTime && time <= cache->endTime;
+}
+
+// Coefficients of the segment of body that covers time.
+static inline const double *segmentFor(const EphemerisCache *cache, int body, double time, double *tau) {
+    const EphemerisCacheBody *entry = &cache->bodies[body];
+    double u = (time - cache->startTime) * entry->segmentRate;
+    int segment = u > 0.0 ? (int)u : 0;
+    if (segment >= entry->segmentCount)
+        segment = entry->segmentCount - 1;
+    *tau = 2.0 * (u - segment) - 1.0;
+    return cache->coefficients + entry->firstCoefficient + (size_t)segment * 3 * cache->coefficientCount;
+}
+
+Vector3D evaluateEphemerisCache(const EphemerisCache *cache, int body, double time) {
+    double tau;
+    const double *c = segmentFor(cache, body, time, &tau);
+    return chebyshevSum(c, cache->coefficientCount, tau);
+}
@@ -0,0 +1,104 @@
+#ifndef EPHEMERISCACHE_H
+#define EPHEMERISCACHE_H
+
+#include "planet.h"
+#include "ephemeris.h"
+#include "threadpool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define EPHEMERIS_CACHE_MAGIC "SWCHEBY"  // 8 bytes including the terminator
+#define EPHEMERIS_CACHE_VERSION 2
+#define EPHEMERIS_CACHE_ALIGNMENT 64
+#define EPHEMERIS_CACHE_MAX_COEFFICIENTS 32
+
+// Positions to be fitted: any orbit model that can place body at time.
+// meanMotion (revolutions per day) sets each body's first segment length.
+// fingerprint identifies the model's data and is stored with the cache.
+typedef struct {
+    int count;
+    const double *meanMotion;
+    Vector3D (*position)(const void *context, int body, double time);
+    const void *context;
+    uint64_t fingerprint;
+} EphemerisSource;
+
+// The analytic Kepler model of a BodyTable as a fitting source, fingerprinted
+// with bodyTableFingerprint.
+EphemerisSource bodyTableSource(const BodyTable *table);
+
+typedef struct {
+    double startTime, endTime;   // fitted span, in days
+    double segmentsPerOrbit;     // first try; halved segments until tolerance holds
+    int coefficientCount;        // per axis (polynomial degree + 1), at most EPHEMERIS_CACHE_MAX_COEFFICIENTS
+    double tolerance;            // largest allowed position error, in AU
+} EphemerisCacheParameters;
+
+// Per-body segment table. Segment s of a body covers
+// [startTime + s / segmentRate, startTime + (s + 1) / segmentRate) and holds
+// coefficientCount Chebyshev coefficients for x, then y, then z.
+typedef struct {
+    uint64_t firstCoefficient;   // offset into the coefficient array, in doubles
+    double segmentRate;          // segments per day
+    int32_t segmentCount;
+    int32_t reserved;
+} EphemerisCacheBody;
+
+// On-disk header. The body table and the coefficients follow, each starting
+// on a EPHEMERIS_CACHE_ALIGNMENT boundary.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t bodyCount;
+    uint64_t coefficientCount;   // per axis
+    double startTime, endTime;
+    double tolerance;            // requested bound, in AU
+    double maxError;             // largest error seen when the cache was verified, in AU
+    uint64_t sourceFingerprint;  // EphemerisSource.fingerprint of the fitted source
+    uint64_t bodiesOffset;       // EphemerisCacheBody[bodyCount]
+    uint64_t coefficientsOffset; // double[coefficientTotal]
+    uint64_t coefficientTotal;
+    uint64_t fileSize;
+} EphemerisCacheHeader;
+
+// Piecewise Chebyshev fit of a source over [startTime, endTime]. Evaluating a
+// position costs a few dozen multiply-adds and no trigonometry.
+typedef struct {
+    int bodyCount;
+    int coefficientCount;
+    double startTime, endTime;
+    double tolerance;
+    double maxError;
+    uint64_t sourceFingerprint;
+    const EphemerisCacheBody *bodies;
+    const double *coefficients;
+    void *mapping;               // mapped file, NULL when built in memory
+    size_t mappingSize;
+    void *bodyStorage;           // owned memory when built in memory
+    void *coefficientStorage;
+} EphemerisCache;
+
+// Fits every body of source over the parameters' span, splitting bodies across
+// pool (NULL runs single-threaded). Each segment is checked against the source
+// at 2 * coefficientCount + 1 evenly spaced times, between the fitting nodes,
+// and a body's segments are halved until all of them are within tolerance.
+// Returns 0 on success, -1 on allocation failure or when some body cannot meet
+// the tolerance; cache->maxError holds the largest error either way.
+int buildEphemerisCache(EphemerisCache *cache, const EphemerisSource *source,
+                        const EphemerisCacheParameters *parameters, ThreadPool *pool);
+
+// Writes the cache file. Returns 0 on success, -1 on error.
+int writeEphemerisCache(const EphemerisCache *cache, const char *path);
+
+// Maps and validates a cache file. Returns 0 on success, -1 on error (a reason is printed to stderr).
+int openEphemerisCache(EphemerisCache *cache, const char *path);
+void freeEphemerisCache(EphemerisCache *cache);
+
+// Returns 1 when time lies in the fitted span.
+int ephemerisCacheCovers(const EphemerisCache *cache, double time);
+
+// Position of body at a time inside the fitted span.
+Vector3D evaluateEphemerisCache(const EphemerisCache *cache, int body, double time);
+
+#endif
@@ -0,0 +1,199 @@
+#include "ephemerisexport.h"
+#include "textio.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define EXPORT_CHUNK_ROWS 4096        // rows per work item
+#define EXPORT_CHUNKS_PER_WORKER 2    // chunks in flight per worker
+#define EXPORT_ROW_BYTES 256          // upper bound of a formatted row
+#define EXPORT_TIME_DECIMALS 6
+
+// One chunk's positions and formatted rows.
+typedef struct {
+    OutputBuffer out;
+    double *times;
+    double *x, *y, *z;
+} ExportSlot;
+
+typedef struct {
+    const EphemerisExportRequest *request;
+    const BodyTable *subset;      // the requested bodies, in output order
+    const Planet *names;
+    int *nameLengths;
+    int bodiesPerChunk;
+    int bodyChunks;               // chunks across the bodies of one time
+    int timesPerChunk;
+    long long firstChunk;         // of the current round
+    ExportSlot *slots;
+} ExportJob;
+
+static void formatChunk(ExportJob *job, long long chunk, ExportSlot *slot) {
+    const EphemerisExportRequest *request = job->request;
+    long long firstTime = chunk / job->bodyChunks * job->timesPerChunk;
+    int firstBody = (int)(chunk % job->bodyChunks) * job->bodiesPerChunk;
+    long long remaining = request->timeCount - firstTime;
+    int timeCount = remaining < job->timesPerChunk ? (int)remaining : job->timesPerChunk;
+    int bodyCount = request->bodyCount - firstBody < job->bodiesPerChunk ? request->bodyCount - firstBody
+                                                                          : job->bodiesPerChunk;
+    for (int t = 0; t < timeCount; t++)
+        slot->times[t] = request->startTime + (double)(firstTime + t) * request->step;
+    BodyTable bodies = bodyTableSlice(job->subset, firstBody, bodyCount);
+    computeBodyPositions(&bodies, slot->times, timeCount, slot->x, slot->y, slot->z);
+
+    OutputBuffer *out = &slot->out;
+    out->used = 0;
+    for (int t = 0; t < timeCount; t++) {
+        const double *x = slot->x + (size_t)t * bodyCount;
+        const double *y = slot->y + (size_t)t * bodyCount;
+        const double *z = slot->z + (size_t)t * bodyCount;
+        if (request->format == EXPORT_BINARY) {
+            double *record = (double *)(out->data + out->used);
+            for (int b = 0; b < bodyCount; b++) {
+                record[3 * b] = x[b];
+                record[3 * b + 1] = y[b];
+                record[3 * b + 2] = z[b];
+            }
+            out->used += (size_t)bodyCount * 3 * sizeof(double);
+            continue;
+        }
+        char time[40];
+        int timeLength = formatFixed(time, slot->times[t], EXPORT_TIME_DECIMALS);
+        for (int b = 0; b < bodyCount; b++) {
+            int body = request->bodies[firstBody + b];
+            appendText(out, time, (size_t)timeLength);
+            appendChar(out, ' ');
+            appendText(out, job->names[body].name, (size_t)job->nameLengths[firstBody + b]);
+            appendChar(out, ' ');
+            appendFixed(out, x[b], request->decimals);
+            appendChar(out, ' ');
+            appendFixed(out, y[b], request->decimals);
+            appendChar(out, ' ');
+            appendFixed(out, z[b], request->decimals);
+            appendChar(out, '\n');
+        }
+    }
+}
+
+static void exportChunks(void *context, int begin, int end, int worker) {
+    (void)worker;
+    ExportJob *job = context;
+    for (int i = begin; i < end; i++)
+        formatChunk(job, job->firstChunk + i, &job->slots[i]);
+}
+
+// Copies the requested bodies' columns into a table of their own.
+static int buildSubset(BodyTable *subset, const BodyTable *table, const int *bodies, int count) {
+    size_t n = (size_t)(count > 0 ? count : 1);
+    double *columns = malloc(BODY_TABLE_COLUMNS * n * sizeof(double));
+    if (columns == NULL)
+        return -1;
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++) {
+        const double *source = bodyTableColumn(table, k);
+        for (int i = 0; i < count; i++)
+            columns[k * n + i] = source[bodies[i]];
+    }
+    bindBodyTable(subset, count, columns, n);
+    subset->storage = columns;
+    return 0;
+}
+
+static void writeHeader(const EphemerisExportRequest *request, OutputBuffer *out) {
+    if (request->format == EXPORT_TEXT) {
+        appendString(out, "# time_days body x_au y_au z_au\n");
+        return;
+    }
+    EphemerisExportHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EPHEMERIS_EXPORT_MAGIC, sizeof(EPHEMERIS_EXPORT_MAGIC));
+    header.version = EPHEMERIS_EXPORT_VERSION;
+    size_t ids = ((size_t)request->bodyCount * sizeof(int32_t) + 7) & ~(size_t)7;
+    header.headerSize = (uint32_t)(sizeof(header) + ids);
+    header.bodyCount = (uint64_t)request->bodyCount;
+    header.timeCount = (uint64_t)request->timeCount;
+    header.startTime = request->startTime;
+    header.step = request->step;
+    appendText(out, (const char *)&header, sizeof(header));
+    for (int i = 0; i < request->bodyCount; i++) {
+        int32_t id = request->bodies[i];
+        appendText(out, (const char *)&id, sizeof(id));
+    }
+    static const char padding[8];
+    appendText(out, padding, ids - (size_t)request->bodyCount * sizeof(int32_t));
+}
+
+int exportEphemeris(const BodyTable *table, const Planet *names, const EphemerisExportRequest *request,
+                    int fd, ThreadPool *pool, EphemerisExportStats *stats) {
+    if (stats != NULL)
+        memset(stats, 0, sizeof(*stats));
+    ExportJob job;
+    memset(&job, 0, sizeof(job));
+    job.request = request;
+    job.names = names;
+    job.bodiesPerChunk = request->bodyCount < EXPORT_CHUNK_ROWS ? request->bodyCount : EXPORT_CHUNK_ROWS;
+    if (job.bodiesPerChunk < 1)
+        job.bodiesPerChunk = 1;
+    job.bodyChunks = (request->bodyCount + job.bodiesPerChunk - 1) / job.bodiesPerChunk;
+    job.timesPerChunk = EXPORT_CHUNK_ROWS / job.bodiesPerChunk;
+    long long timeChunks = (request->timeCount + job.timesPerChunk - 1) / job.timesPerChunk;
+    long long chunks = request->bodyCount > 0 && request->timeCount > 0 ? timeChunks * job.bodyChunks : 0;
+    int slotCount = EXPORT_CHUNKS_PER_WORKER * threadPoolSize(pool);
+
+    BodyTable subset;
+    ExportSlot *slots = calloc((size_t)slotCount, sizeof(ExportSlot));
+    job.nameLengths = malloc((size_t)(request->bodyCount > 0 ? request->bodyCount : 1) * sizeof(int));
+    int failed = slots == NULL || job.nameLengths == NULL ||
+                 buildSubset(&subset, table, request->bodies, request->bodyCount) != 0;
+    if (failed) {
+        free(slots);
+        free(job.nameLengths);
+        return -1;
+    }
+    size_t rowsPerChunk = (size_t)job.bodiesPerChunk * job.timesPerChunk;
+    for (int s = 0; s < slotCount && !failed; s++) {
+        ExportSlot *slot = &slots[s];
+        slot->times = malloc((size_t)job.timesPerChunk * sizeof(double));
+        slot->x = malloc(rowsPerChunk * 3 * sizeof(double));
+        failed = slot->times == NULL || slot->x == NULL ||
+                 openOutputBuffer(&slot->out, fd, rowsPerChunk * EXPORT_ROW_BYTES) != 0;
+        if (slot->x != NULL) {
+            slot->y = slot->x + rowsPerChunk;
+            slot->z = slot->y + rowsPerChunk;
+        }
+    }
+    if (!failed) {
+        writeHeader(request, &slots[0].out);
+        if (stats != NULL)
+            stats->bytes += (long long)slots[0].out.used;
+        flushOutputBuffer(&slots[0].out);
+        failed = slots[0].out.failed;
+    }
+    for (int i = 0; i < request->bodyCount && names != NULL; i++)
+        job.nameLengths[i] = (int)strlen(names[request->bodies[i]].name);
+    job.subset = &subset;
+    job.slots = slots;
+
+    // Each round fills every slot in parallel, then writes them out in order.
+    for (long long first = 0; first < chunks && !failed; first += slotCount) {
+        int count = chunks - first < slotCount ? (int)(chunks - first) : slotCount;
+        job.firstChunk = first;
+        parallelFor(pool, count, 1, exportChunks, &job);
+        for (int s = 0; s < count && !failed; s++) {
+            if (stats != NULL)
+                stats->bytes += (long long)slots[s].out.used;
+            flushOutputBuffer(&slots[s].out);
+            failed = slots[s].out.failed;
+        }
+    }
+    if (stats != NULL && !failed)
+        stats->rows = chunks > 0 ? request->timeCount * request->bodyCount : 0;
+
+    for (int s = 0; s < slotCount; s++) {
+        free(slots[s].out.data);
+        free(slots[s].times);
+        free(slots[s].x);
+    }
+    free(slots);
+    free(job.nameLengths);
+    freeBodyTable(&subset);
+    return failed ? -1 : 0;
+}
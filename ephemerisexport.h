@@ -0,0 +1,55 @@
+#ifndef EPHEMERISEXPORT_H
+#define EPHEMERISEXPORT_H
+
+#include "planet.h"
+#include "ephemeris.h"
+#include "threadpool.h"
+#include <stdint.h>
+
+#define EPHEMERIS_EXPORT_MAGIC "SWEPHEM"   // 8 bytes including the terminator
+#define EPHEMERIS_EXPORT_VERSION 1
+
+typedef enum {
+    EXPORT_TEXT,     // one "time name x y z" line per body and time
+    EXPORT_BINARY    // EphemerisExportHeader, then float64 x y z per body and time
+} ExportFormat;
+
+// Bodies of a table at startTime + k * step for k in [0, timeCount), ordered
+// by time and then by the order of bodies.
+typedef struct {
+    const int *bodies;       // ids into the table
+    int bodyCount;
+    double startTime;        // in days
+    double step;
+    long long timeCount;
+    ExportFormat format;
+    int decimals;            // of text positions, at most 9
+} EphemerisExportRequest;
+
+// Header of a binary export. It is followed by the int32 body ids, padded to a
+// multiple of 8 bytes, and then by the records, headerSize bytes into the file.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t bodyCount;
+    uint64_t timeCount;
+    double startTime, step;
+} EphemerisExportHeader;
+
+typedef struct {
+    long long rows;
+    long long bytes;
+} EphemerisExportStats;
+
+// Streams the request's ephemeris to fd. Chunks of rows are evaluated with the
+// batched kernel and formatted in parallel across pool (NULL runs
+// single-threaded), a few per worker at a time, and written in order, so
+// memory does not grow with the length of the output. names supplies the text
+// format's body names, indexed like the table; the binary format does not need
+// them. stats may be NULL.
+// Returns 0 on success, -1 on allocation failure or a write error.
+int exportEphemeris(const BodyTable *table, const Planet *names, const EphemerisExportRequest *request,
+                    int fd, ThreadPool *pool, EphemerisExportStats *stats);
+
+#endif
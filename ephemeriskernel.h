@@ -0,0 +1,188 @@
+// Batched position kernels, written once and instantiated by ephemeris.c for
+// each precision; not a public header. The includer defines:
+//   REAL                   double or float, the type the kernel computes in
+//   TABLE                  BodyTable or BodyTableF
+//   KERNEL(name)           the instantiation's name for a function
+//   REAL_ROUND_MAGIC       1.5 * 2^(mantissa bits): adding and subtracting it rounds to an integer
+//   REAL_KEPLER_TOLERANCE  Newton step at which the Kepler solve stops, in revolutions
+// and, when AVX2 is enabled, the vector type and operations listed above the
+// vector kernel. This file undefines all of them at the end.
+//
+// The mean anomaly is always reduced to [-0.5, 0.5] revolutions in double, so
+// the float instantiation loses no accuracy as time grows; everything after
+// the reduction runs in REAL.
+
+// sin and cos of 2 * PI * u, with u in revolutions.
+// Whole turns are removed exactly, then the quadrant, leaving |r| <= PI/4.
+static inline void KERNEL(sincosRevolutions)(REAL u, REAL *s, REAL *c) {
+    u -= (u + REAL_ROUND_MAGIC) - REAL_ROUND_MAGIC;
+    REAL q = (u * (REAL)4.0 + REAL_ROUND_MAGIC) - REAL_ROUND_MAGIC;
+    REAL r = (u - q * (REAL)0.25) * (REAL)TWO_PI;
+    REAL z = r * r;
+    REAL ps = (((((REAL)SIN_C0 * z + (REAL)SIN_C1) * z + (REAL)SIN_C2) * z + (REAL)SIN_C3) * z
+               + (REAL)SIN_C4) * z + (REAL)SIN_C5;
+    REAL pc = (((((REAL)COS_C0 * z + (REAL)COS_C1) * z + (REAL)COS_C2) * z + (REAL)COS_C3) * z
+               + (REAL)COS_C4) * z + (REAL)COS_C5;
+    REAL sr = r + r * z * ps;
+    REAL cr = (REAL)1.0 - (REAL)0.5 * z + z * z * pc;
+    switch ((int)q & 3) {
+        case 0:  *s = sr;  *c = cr;  break;
+        case 1:  *s = cr;  *c = -sr; break;
+        case 2:  *s = -sr; *c = -cr; break;
+        default: *s = -cr; *c = sr;  break;
+    }
+}
+
+// sin and cos of the eccentric anomaly for mean anomaly m (revolutions, |m| <= 0.5).
+// Kepler's equation in revolutions reads E - e / (2 PI) * sin(2 PI E) = m.
+static inline void KERNEL(eccentricAnomaly)(REAL m, REAL e, REAL *s, REAL *c) {
+    KERNEL(sincosRevolutions)(m, s, c);
+    if (e == (REAL)0.0)
+        return;
+    REAL k = e / (REAL)TWO_PI;
+    REAL E = m + k * *s * ((REAL)1.0 + e * *c);
+    for (int i = 0; i < KEPLER_MAX_ITERATIONS; i++) {
+        KERNEL(sincosRevolutions)(E, s, c);
+        REAL step = (E - k * *s - m) / ((REAL)1.0 - e * *c);
+        E -= step;
+        if ((step < (REAL)0.0 ? -step : step) < REAL_KEPLER_TOLERANCE)
+            break;
+    }
+    KERNEL(sincosRevolutions)(E, s, c);
+}
+
+static inline void KERNEL(bodyPosition)(const TABLE *table, int i, double time, REAL *x, REAL *y, REAL *z) {
+    double m = time * table->meanMotion[i] + table->epochPhase[i];
+    m -= (m + ROUND_MAGIC) - ROUND_MAGIC;
+    REAL e = table->eccentricity[i];
+    REAL s, c;
+    KERNEL(eccentricAnomaly)((REAL)m, e, &s, &c);
+    REAL along = c - e;
+    *x = along * table->periapsisX[i] + s * table->quadratureX[i];
+    *y = along * table->periapsisY[i] + s * table->quadratureY[i];
+    *z = along * table->periapsisZ[i] + s * table->quadratureZ[i];
+}
+
+static void KERNEL(positionsAtTimeScalar)(const TABLE *table, int first, double time, REAL *x, REAL *y, REAL *z) {
+    for (int i = first; i < table->count; i++)
+        KERNEL(bodyPosition)(table, i, time, &x[i], &y[i], &z[i]);
+}
+
+#if defined(__AVX2__)
+// Vector operations, defined by the includer:
+//   VREAL, V_LANES          vector type and its number of lanes
+//   V_SET, V_ZERO, V_LOAD, V_STORE, V_ADD, V_SUB, V_MUL, V_DIV, V_AND, V_XOR,
+//   V_ROUND, V_BLEND, V_CMP, V_MOVEMASK, V_ABS_MASK
+//   V_QUADRANT(q, swap, sinSign, cosSign)   masks of the sincos quadrant fix-up
+//   V_MEAN_ANOMALY(table, i, time)          reduced mean anomaly of lanes i.., from double
+
+// Vector sincosRevolutions.
+static inline void KERNEL(sincosRevolutionsVector)(VREAL u, VREAL *s, VREAL *c) {
+    u = V_SUB(u, V_ROUND(u));
+    VREAL q = V_ROUND(V_MUL(u, V_SET(4.0)));
+    VREAL r = V_MUL(V_SUB(u, V_MUL(q, V_SET(0.25))), V_SET(TWO_PI));
+    VREAL zz = V_MUL(r, r);
+
+    VREAL ps = V_SET(SIN_C0);
+    ps = V_ADD(V_MUL(ps, zz), V_SET(SIN_C1));
+    ps = V_ADD(V_MUL(ps, zz), V_SET(SIN_C2));
+    ps = V_ADD(V_MUL(ps, zz), V_SET(SIN_C3));
+    ps = V_ADD(V_MUL(ps, zz), V_SET(SIN_C4));
+    ps = V_ADD(V_MUL(ps, zz), V_SET(SIN_C5));
+    VREAL pc = V_SET(COS_C0);
+    pc = V_ADD(V_MUL(pc, zz), V_SET(COS_C1));
+    pc = V_ADD(V_MUL(pc, zz), V_SET(COS_C2));
+    pc = V_ADD(V_MUL(pc, zz), V_SET(COS_C3));
+    pc = V_ADD(V_MUL(pc, zz), V_SET(COS_C4));
+    pc = V_ADD(V_MUL(pc, zz), V_SET(COS_C5));
+    VREAL sr = V_ADD(r, V_MUL(V_MUL(r, zz), ps));
+    VREAL cr = V_ADD(V_SUB(V_SET(1.0), V_MUL(V_SET(0.5), zz)), V_MUL(V_MUL(zz, zz), pc));
+
+    // Quadrant fix-up: odd quadrants swap sin/cos, bit 1 of q (resp. q + 1)
+    // flips the sign of sin (resp. cos).
+    VREAL swap, sinSign, cosSign;
+    V_QUADRANT(q, swap, sinSign, cosSign);
+    *s = V_XOR(V_BLEND(sr, cr, swap), sinSign);
+    *c = V_XOR(V_BLEND(cr, sr, swap), cosSign);
+}
+
+// Vector eccentricAnomaly. On entry *s, *c hold sin and cos of m. All lanes
+// iterate until the slowest one converges; converged lanes take tiny steps.
+static inline void KERNEL(eccentricAnomalyVector)(VREAL m, VREAL e, VREAL *s, VREAL *c) {
+    const VREAL one = V_SET(1.0);
+    const VREAL tolerance = V_SET(REAL_KEPLER_TOLERANCE);
+    VREAL k = V_MUL(e, V_SET(1.0 / TWO_PI));
+    VREAL E = V_ADD(m, V_MUL(V_MUL(k, *s), V_ADD(one, V_MUL(e, *c))));
+    for (int i = 0; i < KEPLER_MAX_ITERATIONS; i++) {
+        KERNEL(sincosRevolutionsVector)(E, s, c);
+        VREAL f = V_SUB(V_SUB(E, V_MUL(k, *s)), m);
+        VREAL step = V_DIV(f, V_SUB(one, V_MUL(e, *c)));
+        E = V_SUB(E, step);
+        VREAL pending = V_CMP(V_AND(step, V_ABS_MASK), tolerance, _CMP_NLT_UQ);
+        if (V_MOVEMASK(pending) == 0)
+            break;
+    }
+    KERNEL(sincosRevolutionsVector)(E, s, c);
+}
+
+// Positions of the V_LANES bodies from i, given their reduced mean anomalies m.
+static inline void KERNEL(lanePositions)(const TABLE *table, int i, VREAL m, REAL *x, REAL *y, REAL *z) {
+    VREAL e = V_LOAD(table->eccentricity + i);
+    VREAL s, c;
+    KERNEL(sincosRevolutionsVector)(m, &s, &c);
+    // Circular orbits have E = M; only solve Kepler's equation when a lane needs it.
+    if (V_MOVEMASK(V_CMP(e, V_ZERO(), _CMP_NEQ_UQ)) != 0)
+        KERNEL(eccentricAnomalyVector)(m, e, &s, &c);
+
+    VREAL along = V_SUB(c, e);
+    V_STORE(x + i, V_ADD(V_MUL(along, V_LOAD(table->periapsisX + i)), V_MUL(s, V_LOAD(table->quadratureX + i))));
+    V_STORE(y + i, V_ADD(V_MUL(along, V_LOAD(table->periapsisY + i)), V_MUL(s, V_LOAD(table->quadratureY + i))));
+    V_STORE(z + i, V_ADD(V_MUL(along, V_LOAD(table->periapsisZ + i)), V_MUL(s, V_LOAD(table->quadratureZ + i))));
+}
+
+static void KERNEL(positionsAtTime)(const TABLE *table, double time, REAL *x, REAL *y, REAL *z) {
+    const __m256d t = _mm256_set1_pd(time);
+    int i = 0;
+    for (; i + V_LANES <= table->count; i += V_LANES)
+        KERNEL(lanePositions)(table, i, V_MEAN_ANOMALY(table, i, t), x, y, z);
+    KERNEL(positionsAtTimeScalar)(table, i, time, x, y, z);
+}
+
+#undef VREAL
+#undef V_LANES
+#undef V_SET
+#undef V_ZERO
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_DIV
+#undef V_AND
+#undef V_XOR
+#undef V_ROUND
+#undef V_BLEND
+#undef V_CMP
+#undef V_MOVEMASK
+#undef V_ABS_MASK
+#undef V_QUADRANT
+#undef V_MEAN_ANOMALY
+#else
+static void KERNEL(positionsAtTime)(const TABLE *table, double time, REAL *x, REAL *y, REAL *z) {
+    KERNEL(positionsAtTimeScalar)(table, 0, time, x, y, z);
+}
+#endif
+
+static void KERNEL(computePositions)(const TABLE *table, const double *times, int timeCount,
+                                     REAL *x, REAL *y, REAL *z) {
+    for (int t = 0; t < timeCount; t++) {
+        size_t offset = (size_t)t * table->count;
+        KERNEL(positionsAtTime)(table, times[t], x + offset, y + offset, z + offset);
+    }
+}
+
+#undef REAL
+#undef TABLE
+#undef KERNEL
+#undef REAL_ROUND_MAGIC
+#undef REAL_KEPLER_TOLERANCE
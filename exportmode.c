@@ -0,0 +1,88 @@
+#include "modes.h"
+#include "destinations.h"
+#include "ephemerisexport.h"
+#include "threadpool.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define EPHEMERIS_EXPORT_DECIMALS 9       // in AU, about 0.15 m
+
+int runEphemerisExportMode(char **args, int threads) {
+    EphemerisExportRequest request;
+    request.format = strcmp(args[1], "binary") == 0 ? EXPORT_BINARY : EXPORT_TEXT;
+    request.startTime = atof(args[2]);
+    request.step = atof(args[4]);
+    request.decimals = EPHEMERIS_EXPORT_DECIMALS;
+    double endTime = atof(args[3]);
+    const BodyTable *table = getKnownDestinationsTable();
+    if (table == NULL || (strcmp(args[1], "text") != 0 && request.format != EXPORT_BINARY) ||
+        !(request.step > 0.0) || !(endTime >= request.startTime)) {
+        printf("Error: invalid ephemeris export\n");
+        return 1;
+    }
+    // The small tolerance keeps END itself when the span is a whole number of steps.
+    request.timeCount = (long long)floor((endTime - request.startTime) / request.step + 1e-9) + 1;
+
+    int *bodies = malloc((size_t)knownDestinationsCount * sizeof(int));
+    if (bodies == NULL) {
+        printf("Error: not enough memory\n");
+        return 1;
+    }
+    request.bodies = bodies;
+    request.bodyCount = 0;
+    if (strcmp(args[5], "all") == 0) {
+        for (int i = 0; i < knownDestinationsCount; i++)
+            bodies[request.bodyCount++] = i;
+    } else {
+        for (const char *name = args[5]; *name != '\0';) {
+            const char *comma = strchr(name, ',');
+            size_t length = comma != NULL ? (size_t)(comma - name) : strlen(name);
+            char buffer[sizeof(knownDestinations->name)];
+            Planet *planet = NULL;
+            if (length < sizeof(buffer)) {
+                memcpy(buffer, name, length);
+                buffer[length] = '\0';
+                planet = getDestinationByName(buffer);
+            }
+            if (planet == NULL || request.bodyCount == knownDestinationsCount) {
+                printf("Error: unknown destination %.*s\n", (int)length, name);
+                free(bodies);
+                return 1;
+            }
+            bodies[request.bodyCount++] = (int)(planet - knownDestinations);
+            name += comma != NULL ? length + 1 : length;
+        }
+    }
+
+    int toStdout = strcmp(args[0], "-") == 0;
+    int fd = toStdout ? STDOUT_FILENO : open(args[0], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(args[0]);
+        free(bodies);
+        return 1;
+    }
+    ThreadPool *pool = createThreadPool(threads);
+    EphemerisExportStats stats;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = exportEphemeris(table, knownDestinations, &request, fd, pool, &stats) != 0;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    if (!toStdout && close(fd) != 0)
+        failed = 1;
+    int workers = threadPoolSize(pool);
+    destroyThreadPool(pool);
+    free(bodies);
+    if (failed) {
+        fprintf(stderr, "Error: could not export the ephemeris to %s\n", args[0]);
+        return 1;
+    }
+    // Report on stderr so the export can go to stdout.
+    double seconds = elapsedSeconds(start, stop);
+    fprintf(stderr, "%lld rows, %.1f MB in %.3f s on %d threads (%.0f MB/s)\n", stats.rows,
+            stats.bytes / 1e6, seconds, workers, seconds > 0.0 ? stats.bytes / 1e6 / seconds : 0.0);
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "fleet.h"
+#include "destinations.h"
+#include "navigation.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FLEET_CHUNK 1024      // ships per work item; ~100 KB of columns
+
+// Bytes from one column to the next: one 64-byte aligned column after another.
+static size_t columnBytes(int capacity) {
+    size_t n = (size_t)(capacity > 0 ? capacity : 1);
+    return (n * sizeof(double) + 63) & ~(size_t)63;
+}
+
+int createFleet(Fleet *fleet, int capacity) {
+    memset(fleet, 0, sizeof(*fleet));
+    size_t n = (size_t)(capacity > 0 ? capacity : 1);
+    size_t column = columnBytes(capacity);
+    double *storage = aligned_alloc(64, column * FLEET_COLUMNS);
+    fleet->destinationId = malloc(n * sizeof(int));
+    if (storage == NULL || fleet->destinationId == NULL) {
+        free(storage);
+        free(fleet->destinationId);
+        fleet->destinationId = NULL;
+        return -1;
+    }
+    double **columns[FLEET_COLUMNS] = {
+        &fleet->x, &fleet->y, &fleet->z, &fleet->currentTime,
+        &fleet->originX, &fleet->originY, &fleet->originZ, &fleet->departureTime,
+        &fleet->targetX, &fleet->targetY, &fleet->targetZ, &fleet->arrivalTime
+    };
+    for (int i = 0; i < FLEET_COLUMNS; i++)
+        *columns[i] = (double *)((char *)storage + i * column);
+    fleet->capacity = capacity;
+    return 0;
+}
+
+void freeFleet(Fleet *fleet) {
+    free(fleet->x);    // start of the column storage
+    free(fleet->destinationId);
+    memset(fleet, 0, sizeof(*fleet));
+}
+
+double *fleetColumn(const Fleet *fleet, int k) {
+    return (double *)((char *)fleet->x + (size_t)k * columnBytes(fleet->capacity));
+}
+
+int addShip(Fleet *fleet, Vector3D position, double time) {
+    if (fleet->count == fleet->capacity)
+        return -1;
+    int ship = fleet->count++;
+    fleet->x[ship] = fleet->originX[ship] = fleet->targetX[ship] = position.x;
+    fleet->y[ship] = fleet->originY[ship] = fleet->targetY[ship] = position.y;
+    fleet->z[ship] = fleet->originZ[ship] = fleet->targetZ[ship] = position.z;
+    fleet->currentTime[ship] = fleet->departureTime[ship] = time;
+    fleet->arrivalTime[ship] = INFINITY;
+    fleet->destinationId[ship] = -1;
+    return ship;
+}
+
+void dispatchShip(Fleet *fleet, int ship, Vector3D target, double travelDuration) {
+    fleet->originX[ship] = fleet->x[ship];
+    fleet->originY[ship] = fleet->y[ship];
+    fleet->originZ[ship] = fleet->z[ship];
+    fleet->departureTime[ship] = fleet->currentTime[ship];
+    fleet->targetX[ship] = target.x;
+    fleet->targetY[ship] = target.y;
+    fleet->targetZ[ship] = target.z;
+    fleet->arrivalTime[ship] = fleet->currentTime[ship] + travelDuration;
+    fleet->destinationId[ship] = -1;
+}
+
+// Per-worker counters, padded to a cache line.
+typedef struct {
+    long long inTransit;
+    long long arrived;
+    long long atDestination;
+    long long closePasses;
+    char padding[64 - 4 * sizeof(long long)];
+} FleetCounters;
+
+typedef struct {
+    Fleet *fleet;
+    double time;
+    const DestinationIndex *index;
+    FleetCounters *counters;
+} FleetTick;
+
+static void advanceChunks(void *context, int begin, int end, int worker) {
+    FleetTick *tick = context;
+    Fleet *fleet = tick->fleet;
+    FleetCounters *counters = &tick->counters[worker];
+    Vector3D arrivedAt[FLEET_CHUNK];
+    double arrivedTime[FLEET_CHUNK];
+    int arrivedShip[FLEET_CHUNK];
+    int arrivedId[FLEET_CHUNK];
+
+    for (int chunk = begin; chunk < end; chunk++) {
+        int first = chunk * FLEET_CHUNK;
+        int last = first + FLEET_CHUNK < fleet->count ? first + FLEET_CHUNK : fleet->count;
+        int arrivals = 0;
+        for (int i = first; i < last; i++) {
+            double arrival = fleet->arrivalTime[i];
+            if (arrival == INFINITY) {
+                fleet->currentTime[i] = tick->time;
+                continue;
+            }
+            Vector3D from = { fleet->x[i], fleet->y[i], fleet->z[i] };
+            double fromTime = fleet->currentTime[i];
+            if (tick->time >= arrival) {
+                fleet->x[i] = fleet->targetX[i];
+                fleet->y[i] = fleet->targetY[i];
+                fleet->z[i] = fleet->targetZ[i];
+                fleet->currentTime[i] = arrival;
+                fleet->arrivalTime[i] = INFINITY;
+                arrivedAt[arrivals].x = fleet->x[i];
+                arrivedAt[arrivals].y = fleet->y[i];
+                arrivedAt[arrivals].z = fleet->z[i];
+                arrivedTime[arrivals] = arrival;
+                arrivedShip[arrivals++] = i;
+            } else {
+                double f = (tick->time - fleet->departureTime[i]) / (arrival - fleet->departureTime[i]);
+                fleet->x[i] = fleet->originX[i] + f * (fleet->targetX[i] - fleet->originX[i]);
+                fleet->y[i] = fleet->originY[i] + f * (fleet->targetY[i] - fleet->originY[i]);
+                fleet->z[i] = fleet->originZ[i] + f * (fleet->targetZ[i] - fleet->originZ[i]);
+                fleet->currentTime[i] = tick->time;
+                counters->inTransit++;
+            }
+            Vector3D to = { fleet->x[i], fleet->y[i], fleet->z[i] };
+            counters->closePasses += countClosePasses(tick->index, from, fromTime, to, fleet->currentTime[i]);
+        }
+
+        // Resolve this chunk's arrivals together.
+        determineDestinationIds(tick->index, arrivedAt, arrivedTime, arrivals, arrivedId, NULL);
+        for (int a = 0; a < arrivals; a++) {
+            fleet->destinationId[arrivedShip[a]] = arrivedId[a];
+            counters->atDestination += arrivedId[a] >= 0;
+        }
+        counters->arrived += arrivals;
+    }
+}
+
+int advanceFleet(Fleet *fleet, double time, ThreadPool *pool, FleetTickStats *stats) {
+    FleetTick tick = { fleet, time, prepareKnownDestinations(time), NULL };
+    if (tick.index == NULL)
+        return -1;
+    int workers = threadPoolSize(pool);
+    tick.counters = aligned_alloc(64, (size_t)workers * sizeof(FleetCounters));
+    if (tick.counters == NULL)
+        return -1;
+    memset(tick.counters, 0, (size_t)workers * sizeof(FleetCounters));
+
+    int chunks = (fleet->count + FLEET_CHUNK - 1) / FLEET_CHUNK;
+    parallelFor(pool, chunks, 1, advanceChunks, &tick);
+
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+        for (int w = 0; w < workers; w++) {
+            stats->inTransit += tick.counters[w].inTransit;
+            stats->arrived += tick.counters[w].arrived;
+            stats->atDestination += tick.counters[w].atDestination;
+            stats->closePasses += tick.counters[w].closePasses;
+        }
+    }
+    free(tick.counters);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "planet.h"
+#include "threadpool.h"
+
+#define FLEET_COLUMNS 12      // double columns per ship, in Fleet field order from x to arrivalTime
+
+// Structure-of-arrays store for many ships. A ship in transit moves in a
+// straight line from its origin to its target and arrives at arrivalTime;
+// an idle ship has arrivalTime = INFINITY.
+typedef struct {
+    int count;
+    int capacity;
+    double *x, *y, *z;                      // current position, AU
+    double *currentTime;                    // days
+    double *originX, *originY, *originZ;    // start of the current leg
+    double *departureTime;
+    double *targetX, *targetY, *targetZ;    // end of the current leg
+    double *arrivalTime;
+    int *destinationId;                     // index into knownDestinations, -1 if none
+} Fleet;
+
+typedef struct {
+    long long inTransit;   // ships still travelling after the tick
+    long long arrived;     // ships that arrived during the tick
+    long long atDestination;   // arrivals that resolved to a known destination
+    long long closePasses;     // bodies (and the Sun) ships came near during the tick, arrivals included
+} FleetTickStats;
+
+// Returns 0 on success, -1 on allocation failure.
+int createFleet(Fleet *fleet, int capacity);
+void freeFleet(Fleet *fleet);
+
+// Column k (0 <= k < FLEET_COLUMNS) of the fleet's double columns, which share
+// one allocation: x, y, z, currentTime, originX, ..., arrivalTime.
+double *fleetColumn(const Fleet *fleet, int k);
+
+// Adds an idle ship; returns its id or -1 when the fleet is full.
+int addShip(Fleet *fleet, Vector3D position, double time);
+
+// Sends a ship from its current position to target, arriving travelDuration days from its current time.
+void dispatchShip(Fleet *fleet, int ship, Vector3D target, double travelDuration);
+
+// Advances every ship to time in parallel chunks, sweeps each ship's move for
+// close passes and resolves arrivals against the known destinations. pool may
+// be NULL. stats may be NULL. Returns 0 on success, -1 on allocation failure,
+// in which case no ship has moved.
+int advanceFleet(Fleet *fleet, double time, ThreadPool *pool, FleetTickStats *stats);
+
+#endif
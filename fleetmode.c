@@ -0,0 +1,90 @@
+#include "modes.h"
+#include "destinations.h"
+#include "snapshot.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int runFleetMode(char **args, int threads, const char *snapshotPath, Fleet *result, double *endTime) {
+    int ships = atoi(args[0]);
+    int ticks = atoi(args[1]);
+    double tickDays = atof(args[2]);
+    Planet *earth = getDestinationByName("Earth");
+    if (ships <= 0 || ticks <= 0 || tickDays <= 0.0 || earth == NULL) {
+        printf("Error: invalid fleet simulation\n");
+        return 1;
+    }
+    Fleet fleet;
+    double startTime = 100.0;
+    int resumed = 0;
+    if (snapshotPath != NULL && access(snapshotPath, F_OK) == 0) {
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        MappedSnapshot snapshot;
+        if (openSnapshot(&snapshot, snapshotPath) != 0)
+            return 1;
+        if (snapshot.header->fleetCount > 0) {
+            if (restoreFleet(&snapshot, &fleet, 0) != 0) {
+                printf("Error: not enough memory for %llu ships\n", (unsigned long long)snapshot.header->fleetCount);
+                closeSnapshot(&snapshot);
+                return 1;
+            }
+            startTime = snapshot.header->fleetTime;
+            resumed = 1;
+        }
+        closeSnapshot(&snapshot);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        if (resumed)
+            printf("Resumed %d ships at day %.2f from %s in %.2f ms\n",
+                   fleet.count, startTime, snapshotPath, 1e3 * elapsedSeconds(start, stop));
+    }
+    if (!resumed && createFleet(&fleet, ships) != 0) {
+        printf("Error: not enough memory for %d ships\n", ships);
+        return 1;
+    }
+
+    // Deterministic launch plan: each ship flies to a destination's position at
+    // its arrival time, with arrivals spread across the simulated span.
+    Vector3D home = getPlanetPosition(*earth, startTime);
+    unsigned long long seed = LAUNCH_SEED;
+    for (int i = 0; i < ships && !resumed; i++) {
+        unsigned long long r = nextLaunchRandom(&seed);
+        int ship = addShip(&fleet, home, startTime);
+        int target = (int)(r % (unsigned long long)knownDestinationsCount);
+        double duration = tickDays * (1.0 + (double)((r >> 20) % ((unsigned long long)ticks * 1000)) / 1000.0);
+        dispatchShip(&fleet, ship, getDestinationPosition(target, startTime + duration), duration);
+    }
+
+    ThreadPool *pool = createThreadPool(threads);
+    double totalSeconds = 0.0, worstSeconds = 0.0;
+    FleetTickStats stats = { 0, 0, 0, 0 };
+    long long arrived = 0, atDestination = 0, closePasses = 0;
+    for (int t = 1; t <= ticks; t++) {
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (advanceFleet(&fleet, startTime + t * tickDays, pool, &stats) != 0) {
+            printf("Error: not enough memory to advance %d ships\n", fleet.count);
+            destroyThreadPool(pool);
+            freeFleet(&fleet);
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        double seconds = elapsedSeconds(start, stop);
+        totalSeconds += seconds;
+        if (seconds > worstSeconds)
+            worstSeconds = seconds;
+        arrived += stats.arrived;
+        atDestination += stats.atDestination;
+        closePasses += stats.closePasses;
+    }
+    printf("%d ships, %d ticks on %d threads: %.2f ms/tick average, %.2f ms worst\n",
+           fleet.count, ticks, threadPoolSize(pool), 1e3 * totalSeconds / ticks, 1e3 * worstSeconds);
+    printf("Arrived: %lld (%lld at known destinations), still in transit: %lld\n",
+           arrived, atDestination, stats.inTransit);
+    printf("Close passes on the way: %lld\n", closePasses);
+    destroyThreadPool(pool);
+    *result = fleet;
+    *endTime = startTime + ticks * tickDays;
+    return 0;
+}
@@ -0,0 +1,726 @@
+#include "integrator.h"
+#include "lambert.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define POSITION_CHUNK 1024     // bodies per work item when placing the bodies
+#define SAMPLE_BATCH 256        // bodies sampled per kernel call
+#define SHIP_CHUNK 16           // ships per work item
+#define TREE_LEAF_BODIES 8      // a leaf splits when it holds more
+#define TREE_LAYOUT_BLOCKS 4    // the cells are laid out again every this many blocks
+#define TREE_MAX_DEPTH 32       // below this, leaves never split
+#define TREE_STACK (7 * TREE_MAX_DEPTH + 8)
+#define EMPTY_LEAF -1
+
+struct GravityNode {
+    double centerX, centerY, centerZ, half;   // cube the cell was laid out on
+    double massX, massY, massZ;               // centre of mass
+    double gm;
+    double radius;                            // about the centre of mass, holding every body below
+    double softening2;                        // largest of the bodies below
+    int firstChild;                           // eight consecutive children, -1 for a leaf
+    int body;                                 // a leaf's first body, or EMPTY_LEAF
+    int bodyCount;                            // in a leaf, numbered consecutively once laid out
+};
+
+int buildGravityField(GravityField *field, const Planet *planets, int count) {
+    memset(field, 0, sizeof(*field));
+    field->positionTime = NAN;
+    int massive = 0;
+    for (int i = 0; i < count; i++)
+        massive += planets[i].mass > 0.0;
+    size_t n = (size_t)(massive > 0 ? massive : 1);
+    Planet *selected = malloc(n * sizeof(Planet));
+    field->gm = malloc(n * sizeof(double));
+    field->softening2 = malloc(n * sizeof(double));
+    field->x = malloc(n * sizeof(double));
+    field->y = malloc(n * sizeof(double));
+    field->z = malloc(n * sizeof(double));
+    field->samples = malloc(n * INTEGRATOR_SAMPLES * 3 * sizeof(double));
+    field->nextInLeaf = malloc(n * sizeof(int));
+    if (selected == NULL || field->gm == NULL || field->softening2 == NULL ||
+        field->x == NULL || field->y == NULL || field->z == NULL ||
+        field->samples == NULL || field->nextInLeaf == NULL) {
+        free(selected);
+        freeGravityField(field);
+        return -1;
+    }
+    for (int i = 0, j = 0; i < count; i++) {
+        if (planets[i].mass <= 0.0)
+            continue;
+        selected[j] = planets[i];
+        field->gm[j] = planets[i].mass * SUN_GM;
+        double sphereOfInfluence = planets[i].orbitRadius * pow(planets[i].mass, 0.4);
+        field->softening2[j] = sphereOfInfluence * sphereOfInfluence;
+        j++;
+    }
+    int failed = buildBodyTable(&field->bodies, selected, massive) != 0;
+    free(selected);
+    if (failed) {
+        freeGravityField(field);
+        return -1;
+    }
+    field->count = massive;
+    return 0;
+}
+
+void freeGravityField(GravityField *field) {
+    freeBodyTable(&field->bodies);
+    free(field->gm);
+    free(field->softening2);
+    free(field->x);
+    free(field->y);
+    free(field->z);
+    free(field->samples);
+    free(field->nextInLeaf);
+    free(field->nodes);
+    memset(field, 0, sizeof(*field));
+}
+
+// Body positions come from the batched ephemeris: directly at one time, or at
+// INTEGRATOR_SAMPLES times spanning a block, between which a cubic through the
+// samples stands in for the orbit. The samples are kept body-major, so one
+// body's are adjacent for the tree walk.
+
+typedef struct {
+    GravityField *field;
+    double times[INTEGRATOR_SAMPLES];
+    int timeCount;
+    int continued;              // the first sample is already in place
+} PlacementPass;
+
+static void placeBodies(void *context, int begin, int end, int worker) {
+    (void)worker;
+    PlacementPass *pass = context;
+    GravityField *field = pass->field;
+    int last = end * POSITION_CHUNK < field->count ? end * POSITION_CHUNK : field->count;
+    if (pass->timeCount == 1) {
+        int first = begin * POSITION_CHUNK;
+        BodyTable slice = bodyTableSlice(&field->bodies, first, last - first);
+        computeBodyPositions(&slice, pass->times, 1, field->x + first, field->y + first, field->z + first);
+        return;
+    }
+    // The kernel writes time-major; batches go through the stack and are transposed.
+    double x[INTEGRATOR_SAMPLES * SAMPLE_BATCH], y[INTEGRATOR_SAMPLES * SAMPLE_BATCH], z[INTEGRATOR_SAMPLES * SAMPLE_BATCH];
+    int from = pass->continued ? 1 : 0;
+    for (int first = begin * POSITION_CHUNK; first < last; first += SAMPLE_BATCH) {
+        int n = last - first < SAMPLE_BATCH ? last - first : SAMPLE_BATCH;
+        BodyTable slice = bodyTableSlice(&field->bodies, first, n);
+        computeBodyPositions(&slice, pass->times + from, INTEGRATOR_SAMPLES - from, x, y, z);
+        for (int i = 0; i < n; i++) {
+            double *samples = field->samples + (size_t)(first + i) * INTEGRATOR_SAMPLES * 3;
+            if (from == 1)
+                memcpy(samples, samples + (INTEGRATOR_SAMPLES - 1) * 3, 3 * sizeof(double));
+            for (int k = from; k < INTEGRATOR_SAMPLES; k++) {
+                samples[3 * k] = x[(k - from) * n + i];
+                samples[3 * k + 1] = y[(k - from) * n + i];
+                samples[3 * k + 2] = z[(k - from) * n + i];
+            }
+        }
+    }
+}
+
+// Places every body at time.
+static void placeField(GravityField *field, double time, ThreadPool *pool) {
+    if (field->positionTime == time)
+        return;
+    PlacementPass pass = { field, { time }, 1, 0 };
+    parallelFor(pool, (field->count + POSITION_CHUNK - 1) / POSITION_CHUNK, 1, placeBodies, &pass);
+    field->positionTime = time;
+}
+
+// Samples every body across [blockStart, blockEnd]. A block that starts where
+// the last one ended takes its first sample from the last one's final sample.
+static void sampleBlock(GravityField *field, double blockStart, double blockEnd, int continued, ThreadPool *pool) {
+    PlacementPass pass = { field, { 0.0 }, INTEGRATOR_SAMPLES, continued };
+    for (int k = 0; k < INTEGRATOR_SAMPLES - 1; k++)
+        pass.times[k] = blockStart + (blockEnd - blockStart) * k / (INTEGRATOR_SAMPLES - 1);
+    pass.times[INTEGRATOR_SAMPLES - 1] = blockEnd;
+    parallelFor(pool, (field->count + POSITION_CHUNK - 1) / POSITION_CHUNK, 1, placeBodies, &pass);
+    double drift2 = 0.0;
+    for (int i = 0; i < field->count; i++) {
+        const double *samples = field->samples + (size_t)i * INTEGRATOR_SAMPLES * 3;
+        for (int k = 3; k < INTEGRATOR_SAMPLES * 3; k += 3) {
+            double dx = samples[k] - samples[k - 3], dy = samples[k + 1] - samples[k - 2], dz = samples[k + 2] - samples[k - 1];
+            drift2 = fmax(drift2, dx * dx + dy * dy + dz * dz);
+        }
+    }
+    field->sampleDrift = sqrt(drift2);
+}
+
+// Lagrange weights of the samples at fraction s of the block.
+static void interpolationWeights(double s, double w[INTEGRATOR_SAMPLES]) {
+    w[0] = -4.5 * (s - 1.0 / 3.0) * (s - 2.0 / 3.0) * (s - 1.0);
+    w[1] = 13.5 * s * (s - 2.0 / 3.0) * (s - 1.0);
+    w[2] = -13.5 * s * (s - 1.0 / 3.0) * (s - 1.0);
+    w[3] = 4.5 * s * (s - 1.0 / 3.0) * (s - 2.0 / 3.0);
+}
+
+static inline Vector3D interpolateBody(const GravityField *field, int body, const double *w) {
+    const double *samples = field->samples + (size_t)body * INTEGRATOR_SAMPLES * 3;
+    Vector3D p;
+    p.x = w[0] * samples[0] + w[1] * samples[3] + w[2] * samples[6] + w[3] * samples[9];
+    p.y = w[0] * samples[1] + w[1] * samples[4] + w[2] * samples[7] + w[3] * samples[10];
+    p.z = w[0] * samples[2] + w[1] * samples[5] + w[2] * samples[8] + w[3] * samples[11];
+    return p;
+}
+
+typedef struct {
+    GravityField *field;
+    const double *weights;
+} InterpolationPass;
+
+static void interpolateBodies(void *context, int begin, int end, int worker) {
+    (void)worker;
+    InterpolationPass *pass = context;
+    GravityField *field = pass->field;
+    int last = end * POSITION_CHUNK < field->count ? end * POSITION_CHUNK : field->count;
+    for (int i = begin * POSITION_CHUNK; i < last; i++) {
+        Vector3D p = interpolateBody(field, i, pass->weights);
+        field->x[i] = p.x;
+        field->y[i] = p.y;
+        field->z[i] = p.z;
+    }
+}
+
+// Places every body from the samples with the given weights.
+static void interpolateField(GravityField *field, const double *weights, ThreadPool *pool) {
+    InterpolationPass pass = { field, weights };
+    parallelFor(pool, (field->count + POSITION_CHUNK - 1) / POSITION_CHUNK, 1, interpolateBodies, &pass);
+    field->positionTime = NAN;
+}
+
+// Adds the Sun's pull on a ship at (px, py, pz) and returns its GM / r^3.
+static inline double addSun(double px, double py, double pz, double *ax, double *ay, double *az) {
+    double r2 = px * px + py * py + pz * pz + INTEGRATOR_SUN_SOFTENING * INTEGRATOR_SUN_SOFTENING;
+    double rate = SUN_GM / (r2 * sqrt(r2));
+    *ax -= rate * px;
+    *ay -= rate * py;
+    *az -= rate * pz;
+    return rate;
+}
+
+// Direct sum over the placed bodies. Returns the largest GM / r^3, which sets the step.
+static double directAcceleration(const GravityField *field, Vector3D p, Vector3D *acceleration) {
+    double ax = 0.0, ay = 0.0, az = 0.0;
+    double maxRate = addSun(p.x, p.y, p.z, &ax, &ay, &az);
+    int i = 0;
+#if defined(__AVX2__)
+    __m256d px = _mm256_set1_pd(p.x), py = _mm256_set1_pd(p.y), pz = _mm256_set1_pd(p.z);
+    __m256d sumX = _mm256_setzero_pd(), sumY = _mm256_setzero_pd(), sumZ = _mm256_setzero_pd();
+    __m256d rates = _mm256_setzero_pd();
+    for (; i + 4 <= field->count; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(field->x + i), px);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(field->y + i), py);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(field->z + i), pz);
+        __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz,
+                                     _mm256_loadu_pd(field->softening2 + i))));
+        __m256d rate = _mm256_div_pd(_mm256_loadu_pd(field->gm + i), _mm256_mul_pd(r2, _mm256_sqrt_pd(r2)));
+        sumX = _mm256_fmadd_pd(rate, dx, sumX);
+        sumY = _mm256_fmadd_pd(rate, dy, sumY);
+        sumZ = _mm256_fmadd_pd(rate, dz, sumZ);
+        rates = _mm256_max_pd(rates, rate);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sumX);
+    ax += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, sumY);
+    ay += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, sumZ);
+    az += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, rates);
+    for (int k = 0; k < 4; k++)
+        maxRate = lanes[k] > maxRate ? lanes[k] : maxRate;
+#endif
+    for (; i < field->count; i++) {
+        double dx = field->x[i] - p.x, dy = field->y[i] - p.y, dz = field->z[i] - p.z;
+        double r2 = dx * dx + dy * dy + dz * dz + field->softening2[i];
+        double rate = field->gm[i] / (r2 * sqrt(r2));
+        ax += rate * dx;
+        ay += rate * dy;
+        az += rate * dz;
+        maxRate = rate > maxRate ? rate : maxRate;
+    }
+    acceleration->x = ax;
+    acceleration->y = ay;
+    acceleration->z = az;
+    return maxRate;
+}
+
+Vector3D gravityAcceleration(GravityField *field, Vector3D position, double time) {
+    placeField(field, time, NULL);
+    Vector3D acceleration;
+    directAcceleration(field, position, &acceleration);
+    return acceleration;
+}
+
+// Barnes-Hut octree over the sampled bodies. The cells are laid out on the
+// first sample of every TREE_LAYOUT_BLOCKS-th block and refit (mass, centre of mass, radius) on the
+// sample nearest the current substep. A walk widens every cell by how far a
+// body can have moved since that sample, so cells taken whole stay distant
+// relative to their drift, and interpolates the bodies of the leaves it
+// reaches to the exact substep, so close passes stay accurate.
+
+static inline const double *samplePosition(const GravityField *field, int body, int sample) {
+    return field->samples + ((size_t)body * INTEGRATOR_SAMPLES + (size_t)sample) * 3;
+}
+
+static int addChildren(GravityField *field, int parent) {
+    if (field->nodeCount + 8 > field->nodeCapacity) {
+        int capacity = 2 * field->nodeCapacity;
+        GravityNode *grown = realloc(field->nodes, (size_t)capacity * sizeof(GravityNode));
+        if (grown == NULL)
+            return -1;
+        field->nodes = grown;
+        field->nodeCapacity = capacity;
+    }
+    GravityNode *node = &field->nodes[parent];
+    double half = 0.5 * node->half;
+    for (int k = 0; k < 8; k++) {
+        GravityNode *child = &field->nodes[field->nodeCount + k];
+        memset(child, 0, sizeof(*child));
+        child->centerX = node->centerX + (k & 1 ? half : -half);
+        child->centerY = node->centerY + (k & 2 ? half : -half);
+        child->centerZ = node->centerZ + (k & 4 ? half : -half);
+        child->half = half;
+        child->firstChild = -1;
+        child->body = EMPTY_LEAF;
+    }
+    node->firstChild = field->nodeCount;
+    field->nodeCount += 8;
+    return 0;
+}
+
+static inline int octant(const GravityNode *node, double x, double y, double z) {
+    return (x >= node->centerX) | (y >= node->centerY) << 1 | (z >= node->centerZ) << 2;
+}
+
+// Adds body below cell n, at the given depth, splitting leaves that grow past
+// TREE_LEAF_BODIES.
+static int insertBody(GravityField *field, int n, int depth, int body) {
+    const double *p = samplePosition(field, body, 0);
+    for (;; depth++) {
+        GravityNode *node = &field->nodes[n];
+        if (node->firstChild < 0) {
+            field->nextInLeaf[body] = node->body;
+            node->body = body;
+            node->bodyCount++;
+            // Bodies too close to separate stay together.
+            if (node->bodyCount <= TREE_LEAF_BODIES || depth == TREE_MAX_DEPTH)
+                return 0;
+            int resident = node->body;
+            if (addChildren(field, n) != 0)
+                return -1;
+            node = &field->nodes[n];
+            node->body = EMPTY_LEAF;
+            node->bodyCount = 0;
+            while (resident >= 0) {
+                int next = field->nextInLeaf[resident];
+                if (insertBody(field, n, depth, resident) != 0)
+                    return -1;
+                resident = next;
+            }
+            return 0;
+        }
+        n = node->firstChild + octant(node, p[0], p[1], p[2]);
+    }
+}
+
+// Renumbers the bodies in depth-first leaf order, so each leaf holds a run of
+// consecutive bodies and refits and walks read memory in order. Until now the
+// leaves chain their bodies through nextInLeaf.
+static int sortBodiesByLeaf(GravityField *field) {
+    int n = field->count;
+    int *order = malloc((size_t)n * sizeof(int));
+    double *scratch = malloc((size_t)n * INTEGRATOR_SAMPLES * 3 * sizeof(double));
+    if (order == NULL || scratch == NULL) {
+        free(order);
+        free(scratch);
+        return -1;
+    }
+    int next = 0;
+    int stack[TREE_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        GravityNode *node = &field->nodes[stack[--top]];
+        if (node->firstChild >= 0) {
+            for (int k = 7; k >= 0; k--)
+                stack[top++] = node->firstChild + k;
+            continue;
+        }
+        int first = next;
+        for (int b = node->body; b >= 0; b = field->nextInLeaf[b])
+            order[next++] = b;
+        node->body = node->bodyCount > 0 ? first : EMPTY_LEAF;
+    }
+
+    // The table owns its columns, stored count doubles apart.
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++) {
+        double *column = field->bodies.storage + (size_t)k * n;
+        for (int i = 0; i < n; i++)
+            scratch[i] = column[order[i]];
+        memcpy(column, scratch, (size_t)n * sizeof(double));
+    }
+    double *columns[2] = { field->gm, field->softening2 };
+    for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < n; i++)
+            scratch[i] = columns[c][order[i]];
+        memcpy(columns[c], scratch, (size_t)n * sizeof(double));
+    }
+    for (int i = 0; i < n; i++)
+        memcpy(scratch + (size_t)i * INTEGRATOR_SAMPLES * 3, samplePosition(field, order[i], 0),
+               INTEGRATOR_SAMPLES * 3 * sizeof(double));
+    free(field->samples);
+    field->samples = scratch;
+    free(order);
+    return 0;
+}
+
+// Lays out the cells around the first sample.
+static int buildTree(GravityField *field) {
+    if (field->nodeCapacity == 0) {
+        field->nodes = malloc(1024 * sizeof(GravityNode));
+        if (field->nodes == NULL)
+            return -1;
+        field->nodeCapacity = 1024;
+    }
+    double minX = INFINITY, minY = INFINITY, minZ = INFINITY;
+    double maxX = -INFINITY, maxY = -INFINITY, maxZ = -INFINITY;
+    for (int i = 0; i < field->count; i++) {
+        const double *p = samplePosition(field, i, 0);
+        minX = fmin(minX, p[0]);
+        maxX = fmax(maxX, p[0]);
+        minY = fmin(minY, p[1]);
+        maxY = fmax(maxY, p[1]);
+        minZ = fmin(minZ, p[2]);
+        maxZ = fmax(maxZ, p[2]);
+    }
+    GravityNode *root = &field->nodes[0];
+    memset(root, 0, sizeof(*root));
+    root->centerX = 0.5 * (minX + maxX);
+    root->centerY = 0.5 * (minY + maxY);
+    root->centerZ = 0.5 * (minZ + maxZ);
+    root->half = 0.5 * fmax(maxX - minX, fmax(maxY - minY, maxZ - minZ)) * (1.0 + 1e-9) + 1e-12;
+    root->firstChild = -1;
+    root->body = EMPTY_LEAF;
+    field->nodeCount = 1;
+    for (int i = 0; i < field->count; i++) {
+        if (insertBody(field, 0, 0, i) != 0)
+            return -1;
+    }
+    return sortBodiesByLeaf(field);
+}
+
+// Children always come after their parent, so one backward sweep sees every
+// cell's children before the cell itself.
+static void refitTree(GravityField *field, int sample) {
+    for (int n = field->nodeCount - 1; n >= 0; n--) {
+        GravityNode *node = &field->nodes[n];
+        double gm = 0.0, mx = 0.0, my = 0.0, mz = 0.0, softening2 = 0.0, radius = 0.0;
+        if (node->firstChild < 0) {
+            for (int b = node->body; b < node->body + node->bodyCount; b++) {
+                const double *p = samplePosition(field, b, sample);
+                gm += field->gm[b];
+                mx += field->gm[b] * p[0];
+                my += field->gm[b] * p[1];
+                mz += field->gm[b] * p[2];
+                softening2 = fmax(softening2, field->softening2[b]);
+            }
+        } else {
+            for (int k = 0; k < 8; k++) {
+                const GravityNode *child = &field->nodes[node->firstChild + k];
+                gm += child->gm;
+                mx += child->gm * child->massX;
+                my += child->gm * child->massY;
+                mz += child->gm * child->massZ;
+                softening2 = fmax(softening2, child->softening2);
+            }
+        }
+        if (gm > 0.0) {
+            mx /= gm;
+            my /= gm;
+            mz /= gm;
+        }
+        if (node->firstChild < 0) {
+            for (int b = node->body; b < node->body + node->bodyCount; b++) {
+                const double *p = samplePosition(field, b, sample);
+                double dx = p[0] - mx, dy = p[1] - my, dz = p[2] - mz;
+                radius = fmax(radius, sqrt(dx * dx + dy * dy + dz * dz));
+            }
+        } else {
+            for (int k = 0; k < 8; k++) {
+                const GravityNode *child = &field->nodes[node->firstChild + k];
+                if (child->gm <= 0.0)
+                    continue;
+                double dx = child->massX - mx, dy = child->massY - my, dz = child->massZ - mz;
+                radius = fmax(radius, sqrt(dx * dx + dy * dy + dz * dz) + child->radius);
+            }
+        }
+        node->massX = mx;
+        node->massY = my;
+        node->massZ = mz;
+        node->gm = gm;
+        node->radius = radius;
+        node->softening2 = softening2;
+    }
+}
+
+// Walks the tree, taking cells whole when their diameter, widened by drift
+// (how far a body may have moved since the refit), is under
+// INTEGRATOR_TREE_OPENING times their distance, and the bodies of the leaves
+// reached at their positions for the sample weights w. Returns the largest
+// GM / r^3 met.
+static double treeAcceleration(const GravityField *field, Vector3D p, const double *w, double drift,
+                               Vector3D *acceleration) {
+    double ax = 0.0, ay = 0.0, az = 0.0;
+    double maxRate = addSun(p.x, p.y, p.z, &ax, &ay, &az);
+    const double opening2 = INTEGRATOR_TREE_OPENING * INTEGRATOR_TREE_OPENING;
+    int stack[TREE_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const GravityNode *node = &field->nodes[stack[--top]];
+        double dx = node->massX - p.x, dy = node->massY - p.y, dz = node->massZ - p.z;
+        double d2 = dx * dx + dy * dy + dz * dz;
+        double size = 2.0 * (node->radius + drift);
+        int open = size * size >= opening2 * d2;
+        if (open && node->firstChild >= 0) {
+            for (int k = 0; k < 8; k++) {
+                if (field->nodes[node->firstChild + k].gm > 0.0)
+                    stack[top++] = node->firstChild + k;
+            }
+        } else if (!open && (node->firstChild >= 0 || node->bodyCount > 1)) {
+            double r2 = d2 + node->softening2;
+            double rate = node->gm / (r2 * sqrt(r2));
+            ax += rate * dx;
+            ay += rate * dy;
+            az += rate * dz;
+            maxRate = rate > maxRate ? rate : maxRate;
+        } else {
+            for (int b = node->body; b < node->body + node->bodyCount; b++) {
+                Vector3D position = interpolateBody(field, b, w);
+                double bx = position.x - p.x, by = position.y - p.y, bz = position.z - p.z;
+                double r2 = bx * bx + by * by + bz * bz + field->softening2[b];
+                double rate = field->gm[b] / (r2 * sqrt(r2));
+                ax += rate * bx;
+                ay += rate * by;
+                az += rate * bz;
+                maxRate = rate > maxRate ? rate : maxRate;
+            }
+        }
+    }
+    acceleration->x = ax;
+    acceleration->y = ay;
+    acceleration->z = az;
+    return maxRate;
+}
+
+// Per-worker reductions, one cache line each.
+typedef struct {
+    _Alignas(64) long long nextTick;
+    long long steps;
+    int deepestRung;
+} WorkerState;
+
+typedef struct {
+    GravityField *field;
+    Vector3D *positions, *velocities, *accelerations;
+    double *rates;              // each ship's largest GM / r^3 at its last kick
+    int *rungs;                 // each ship steps blockLength / 2^rung
+    long long *nextTicks;       // when each ship's step ends
+    int count;
+    int useTree;
+    double blockLength;         // in days
+    long long tick;             // current substep, in blockLength / 2^INTEGRATOR_MAX_RUNG
+    int refitSample;            // sample the tree was last refit on, -1 after a layout
+    double drift;               // how far bodies may be from the refit sample
+    double weights[INTEGRATOR_SAMPLES];  // of the samples at tick
+    int kick;                   // 0 for the first accelerations, which only start the steps
+    int closing;                // tick closes a block: steps end but none start
+    WorkerState *workers;
+} PropagationPass;
+
+// Starts ship i's next step at pass->tick: picks the step from its last
+// GM / r^3, then kicks half a step and drifts a whole one. A step longer than
+// the one before may only start on a multiple of its own length, which keeps
+// every step inside the block.
+static void beginStep(PropagationPass *pass, int i, WorkerState *worker) {
+    int rung = 0;
+    if (pass->rates[i] > 0.0) {
+        double ideal = INTEGRATOR_ACCURACY / sqrt(pass->rates[i]);
+        double levels = ceil(log2(pass->blockLength / ideal));
+        rung = levels < 0.0 ? 0 : levels > INTEGRATOR_MAX_RUNG ? INTEGRATOR_MAX_RUNG : (int)levels;
+    }
+    while (rung < INTEGRATOR_MAX_RUNG && pass->tick % (1LL << (INTEGRATOR_MAX_RUNG - rung)) != 0)
+        rung++;
+    double step = ldexp(pass->blockLength, -rung), halfStep = 0.5 * step;
+    Vector3D *v = &pass->velocities[i], *x = &pass->positions[i];
+    const Vector3D *a = &pass->accelerations[i];
+    v->x += halfStep * a->x;
+    v->y += halfStep * a->y;
+    v->z += halfStep * a->z;
+    x->x += step * v->x;
+    x->y += step * v->y;
+    x->z += step * v->z;
+    pass->rungs[i] = rung;
+    pass->nextTicks[i] = pass->tick + (1LL << (INTEGRATOR_MAX_RUNG - rung));
+    worker->steps++;
+    if (rung > worker->deepestRung)
+        worker->deepestRung = rung;
+}
+
+// Ends the steps of the ships due at pass->tick (new accelerations and the
+// second half kick) and starts their next ones.
+static void endSteps(void *context, int begin, int end, int workerIndex) {
+    PropagationPass *pass = context;
+    WorkerState *worker = &pass->workers[workerIndex];
+    int last = end * SHIP_CHUNK < pass->count ? end * SHIP_CHUNK : pass->count;
+    for (int i = begin * SHIP_CHUNK; i < last; i++) {
+        if (pass->nextTicks[i] == pass->tick) {
+            Vector3D *a = &pass->accelerations[i], *v = &pass->velocities[i];
+            pass->rates[i] = pass->useTree ? treeAcceleration(pass->field, pass->positions[i], pass->weights,
+                                                              pass->drift, a)
+                                           : directAcceleration(pass->field, pass->positions[i], a);
+            if (pass->kick) {
+                double halfStep = 0.5 * ldexp(pass->blockLength, -pass->rungs[i]);
+                v->x += halfStep * a->x;
+                v->y += halfStep * a->y;
+                v->z += halfStep * a->z;
+            }
+            if (!pass->closing)
+                beginStep(pass, i, worker);
+        }
+        if (pass->nextTicks[i] < worker->nextTick)
+            worker->nextTick = pass->nextTicks[i];
+    }
+}
+
+// Starts every ship's first step of a block.
+static void beginBlock(void *context, int begin, int end, int workerIndex) {
+    PropagationPass *pass = context;
+    WorkerState *worker = &pass->workers[workerIndex];
+    int last = end * SHIP_CHUNK < pass->count ? end * SHIP_CHUNK : pass->count;
+    for (int i = begin * SHIP_CHUNK; i < last; i++) {
+        beginStep(pass, i, worker);
+        if (pass->nextTicks[i] < worker->nextTick)
+            worker->nextTick = pass->nextTicks[i];
+    }
+}
+
+// Runs one pass over every ship and returns the earliest step end.
+static long long runPass(PropagationPass *pass, ThreadPool *pool, ParallelForBody body) {
+    int workers = threadPoolSize(pool);
+    for (int w = 0; w < workers; w++)
+        pass->workers[w].nextTick = LLONG_MAX;
+    parallelFor(pool, (pass->count + SHIP_CHUNK - 1) / SHIP_CHUNK, 1, body, pass);
+    long long nextTick = LLONG_MAX;
+    for (int w = 0; w < workers; w++)
+        nextTick = pass->workers[w].nextTick < nextTick ? pass->workers[w].nextTick : nextTick;
+    return nextTick;
+}
+
+// Moves the bodies to pass->tick of the sampled block. The direct sum needs
+// every body placed; the tree is laid out afresh when layOut is set and refit
+// when the nearest sample changes (pass->refitSample is reset with each block).
+static void prepareField(PropagationPass *pass, int layOut, ThreadPool *pool) {
+    double s = ldexp((double)pass->tick, -INTEGRATOR_MAX_RUNG);
+    interpolationWeights(s, pass->weights);
+    if (!pass->useTree) {
+        interpolateField(pass->field, pass->weights, pool);
+        return;
+    }
+    if (layOut) {
+        if (buildTree(pass->field) != 0) {
+            pass->useTree = 0;
+            interpolateField(pass->field, pass->weights, pool);
+            return;
+        }
+    }
+    int sample = (int)floor(s * (INTEGRATOR_SAMPLES - 1) + 0.5);
+    if (sample != pass->refitSample) {
+        refitTree(pass->field, sample);
+        pass->refitSample = sample;
+    }
+    pass->drift = pass->field->sampleDrift * fabs(s * (INTEGRATOR_SAMPLES - 1) - sample);
+}
+
+int propagateShips(GravityField *field, Vector3D *positions, Vector3D *velocities, int count,
+                   double startTime, double endTime, ThreadPool *pool, PropagationStats *stats) {
+    if (stats != NULL)
+        memset(stats, 0, sizeof(*stats));
+    if (count <= 0 || !(endTime > startTime))
+        return 0;
+    int workers = threadPoolSize(pool);
+    PropagationPass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.field = field;
+    pass.positions = positions;
+    pass.velocities = velocities;
+    pass.count = count;
+    pass.useTree = field->count >= INTEGRATOR_TREE_MIN_BODIES && count >= INTEGRATOR_TREE_MIN_SHIPS;
+    pass.accelerations = malloc((size_t)count * sizeof(Vector3D));
+    pass.rates = malloc((size_t)count * sizeof(double));
+    pass.rungs = malloc((size_t)count * sizeof(int));
+    pass.nextTicks = malloc((size_t)count * sizeof(long long));
+    pass.workers = aligned_alloc(_Alignof(WorkerState), (size_t)workers * sizeof(WorkerState));
+    int failed = pass.accelerations == NULL || pass.rates == NULL || pass.rungs == NULL ||
+                 pass.nextTicks == NULL || pass.workers == NULL;
+    if (!failed) {
+        memset(pass.workers, 0, (size_t)workers * sizeof(WorkerState));
+        memset(pass.nextTicks, 0, (size_t)count * sizeof(long long));
+
+        // Blocks of at most INTEGRATOR_MAX_STEP that end exactly at endTime.
+        double span = endTime - startTime;
+        long long blocks = (long long)ceil(span / INTEGRATOR_MAX_STEP);
+        const long long blockTicks = 1LL << INTEGRATOR_MAX_RUNG;
+        pass.blockLength = span / (double)blocks;
+        long long substeps = 0;
+        for (long long block = 0; block < blocks; block++) {
+            double blockEnd = block + 1 == blocks ? endTime : startTime + span * (double)(block + 1) / (double)blocks;
+            sampleBlock(field, startTime + span * (double)block / (double)blocks, blockEnd, block > 0, pool);
+            pass.tick = 0;
+            pass.refitSample = -1;
+            prepareField(&pass, block % TREE_LAYOUT_BLOCKS == 0, pool);
+            if (block == 0) {
+                // Accelerations at the start, with no kick.
+                pass.closing = 1;
+                runPass(&pass, pool, endSteps);
+                pass.kick = 1;
+            }
+            long long tick = runPass(&pass, pool, beginBlock);
+            for (;;) {
+                pass.tick = tick;
+                pass.closing = tick == blockTicks;
+                prepareField(&pass, 0, pool);
+                substeps++;
+                if (pass.closing) {
+                    runPass(&pass, pool, endSteps);
+                    break;
+                }
+                tick = runPass(&pass, pool, endSteps);
+            }
+        }
+        if (stats != NULL) {
+            int deepest = 0;
+            for (int w = 0; w < workers; w++) {
+                stats->steps += pass.workers[w].steps;
+                deepest = pass.workers[w].deepestRung > deepest ? pass.workers[w].deepestRung : deepest;
+            }
+            stats->substeps = substeps;
+            stats->smallestStep = ldexp(pass.blockLength, -deepest);
+            stats->usedTree = pass.useTree;
+        }
+    }
+    free(pass.accelerations);
+    free(pass.rates);
+    free(pass.rungs);
+    free(pass.nextTicks);
+    free(pass.workers);
+    return failed ? -1 : 0;
+}
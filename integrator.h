@@ -0,0 +1,71 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "planet.h"
+#include "ephemeris.h"
+#include "threadpool.h"
+
+// Propagates ships as test particles through the gravity of the Sun and of
+// every body with a mass, the bodies following their Keplerian orbits. Time
+// is cut into blocks of at most INTEGRATOR_MAX_STEP days; the batched
+// ephemeris places every body at INTEGRATOR_SAMPLES times per block and a
+// cubic through them places it in between. Each ship takes kick-drift-kick
+// leapfrog steps of about INTEGRATOR_ACCURACY times the shortest dynamical
+// time sqrt(r^3 / GM) it sees, rounded down to a power-of-two fraction of the
+// block, so all ships share each placement of the bodies and a close pass
+// slows only the ship making it. Each body's pull is softened over its sphere
+// of influence, a * mass^(2/5), so a ship leaving a planet's centre escapes as
+// a patched-conic departure would instead of being captured.
+//
+// Accelerations are direct sums, vectorized over bodies. With many bodies and
+// many ships, every ship walks a Barnes-Hut octree over the bodies instead.
+// The tree is laid out every few blocks and refitted to the nearest sample,
+// its cells widened by how far a body moves between samples.
+
+#define INTEGRATOR_ACCURACY 0.002        // step, as a fraction of the shortest dynamical time
+#define INTEGRATOR_MAX_STEP 2.0          // in days; a cubic still follows Mercury to 1e-7 AU
+#define INTEGRATOR_MAX_RUNG 20           // the shortest step is a block / 2^20
+#define INTEGRATOR_SUN_SOFTENING 1e-4    // in AU, well inside the Sun; only guards r = 0
+#define INTEGRATOR_SAMPLES 4             // body positions per block, for cubic interpolation
+#define INTEGRATOR_TREE_OPENING 0.7      // Barnes-Hut: open cells wider than this times their distance
+#define INTEGRATOR_TREE_MIN_BODIES 20000 // the tree only pays off above both of these
+#define INTEGRATOR_TREE_MIN_SHIPS 8
+
+typedef struct GravityNode GravityNode;
+
+typedef struct {
+    int count;                  // bodies with a mass
+    BodyTable bodies;           // their orbits (owned)
+    double *gm;                 // gravitational parameters, AU^3/day^2
+    double *softening2;         // squared softening lengths, AU^2
+    double *x, *y, *z;          // positions at positionTime (NAN when interpolated)
+    double positionTime;
+    double *samples;            // per body, x y z at each sample time of the current block
+    double sampleDrift;         // longest move of a body between consecutive samples, in AU
+    GravityNode *nodes;         // Barnes-Hut tree over the positions
+    int *nextInLeaf;            // next body in the same tree leaf, while laying it out
+    int nodeCount;
+    int nodeCapacity;
+} GravityField;
+
+typedef struct {
+    long long steps;            // summed over ships
+    long long substeps;         // placements of the bodies
+    double smallestStep;        // in days
+    int usedTree;
+} PropagationStats;
+
+// Collects the bodies of planets with a mass. Returns 0 on success, -1 on allocation failure.
+int buildGravityField(GravityField *field, const Planet *planets, int count);
+void freeGravityField(GravityField *field);
+
+// Acceleration (AU/day^2) of a ship at position and time, by direct summation.
+Vector3D gravityAcceleration(GravityField *field, Vector3D position, double time);
+
+// Advances count ships from startTime to endTime in place. Positions in AU,
+// velocities in AU/day. pool may be NULL; stats may be NULL.
+// Returns 0 on success, -1 on allocation failure.
+int propagateShips(GravityField *field, Vector3D *positions, Vector3D *velocities, int count,
+                   double startTime, double endTime, ThreadPool *pool, PropagationStats *stats);
+
+#endif
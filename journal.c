@@ -0,0 +1,278 @@
+#include "journal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct Journal {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;       // records queued, or stopping
+    pthread_cond_t drained;    // the writer took or wrote a batch
+    JournalRecord *pending;    // filled by appendJournal
+    JournalRecord *spare;      // being written by the writer thread
+    int pendingCount;
+    uint64_t nextSequence;
+    uint64_t writtenSequence;  // every record up to this one is written
+    int failed;
+    int stopping;
+};
+
+// FNV-1a over the record's fields before the checksum.
+static uint64_t recordChecksum(const JournalRecord *record) {
+    const unsigned char *bytes = (const unsigned char *)record;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < offsetof(JournalRecord, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static int headerValid(const JournalHeader *header) {
+    return memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == JOURNAL_VERSION && header->recordSize == sizeof(JournalRecord);
+}
+
+// Length of the valid prefix of the records that follow the header: every
+// record's checksum holds and sequences increase by one. Applies the records
+// after afterSequence to state when state is not NULL.
+static size_t scanRecords(const char *data, size_t size, uint64_t afterSequence, ShipState *state,
+                          JournalReplay *replay) {
+    size_t offset = 0;
+    uint64_t previous = 0;
+    while (size - offset >= sizeof(JournalRecord)) {
+        JournalRecord record;
+        memcpy(&record, data + offset, sizeof(record));
+        if (record.checksum != recordChecksum(&record) || record.sequence == 0 ||
+            (previous != 0 && record.sequence != previous + 1))
+            break;
+        if (state != NULL && record.sequence > afterSequence) {
+            state->shipPosition = record.position;
+            resolveCurrentDestination(state, record.time);
+            replay->applied++;
+        }
+        previous = record.sequence;
+        offset += sizeof(JournalRecord);
+    }
+    replay->lastSequence = previous;
+    replay->discarded = size - offset;
+    return offset;
+}
+
+// Maps an existing journal and scans it. Returns the valid file length, or
+// -1 on error. A file too short for a header counts as empty.
+static long long mapAndScan(int fd, const char *path, uint64_t afterSequence, ShipState *state,
+                            JournalReplay *replay) {
+    memset(replay, 0, sizeof(*replay));
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror(path);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    if (size < sizeof(JournalHeader)) {
+        replay->discarded = size;
+        return 0;
+    }
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    if (!headerValid(base)) {
+        fprintf(stderr, "%s: not a ship journal\n", path);
+        munmap(base, size);
+        return -1;
+    }
+    size_t valid = sizeof(JournalHeader) + scanRecords((const char *)base + sizeof(JournalHeader),
+                                                       size - sizeof(JournalHeader), afterSequence, state, replay);
+    munmap(base, size);
+    return (long long)valid;
+}
+
+int replayJournal(const char *path, uint64_t afterSequence, ShipState *state, JournalReplay *replay) {
+    memset(replay, 0, sizeof(*replay));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            return 0;
+        perror(path);
+        return -1;
+    }
+    long long valid = mapAndScan(fd, path, afterSequence, state, replay);
+    close(fd);
+    return valid < 0 ? -1 : 0;
+}
+
+static int writeAll(int fd, const void *data, size_t length) {
+    const char *p = data;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+// Writes whatever has been queued since the last batch, until stopped.
+static void *writerMain(void *arg) {
+    Journal *journal = arg;
+    pthread_mutex_lock(&journal->lock);
+    for (;;) {
+        while (journal->pendingCount == 0 && !journal->stopping)
+            pthread_cond_wait(&journal->wake, &journal->lock);
+        if (journal->pendingCount == 0)
+            break;
+        JournalRecord *batch = journal->pending;
+        int count = journal->pendingCount;
+        uint64_t last = journal->nextSequence - 1;
+        journal->pending = journal->spare;
+        journal->spare = batch;
+        journal->pendingCount = 0;
+        pthread_cond_broadcast(&journal->drained);
+        pthread_mutex_unlock(&journal->lock);
+
+        int failed = writeAll(journal->fd, batch, (size_t)count * sizeof(JournalRecord)) != 0;
+
+        pthread_mutex_lock(&journal->lock);
+        journal->failed |= failed;
+        journal->writtenSequence = last;
+        pthread_cond_broadcast(&journal->drained);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return NULL;
+}
+
+Journal *openJournal(const char *path, uint64_t firstSequence) {
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    JournalReplay scan;
+    long long valid = mapAndScan(fd, path, 0, NULL, &scan);
+    int failed = valid < 0;
+    if (!failed && valid == 0) {
+        // New (or torn before its header was complete): start over with a header.
+        JournalHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = JOURNAL_VERSION;
+        header.recordSize = sizeof(JournalRecord);
+        failed = ftruncate(fd, 0) != 0 || writeAll(fd, &header, sizeof(header)) != 0;
+    } else if (!failed && scan.discarded > 0) {
+        fprintf(stderr, "%s: dropping %llu bytes of torn records\n", path, (unsigned long long)scan.discarded);
+        failed = ftruncate(fd, (off_t)valid) != 0;
+    }
+    Journal *journal = failed ? NULL : calloc(1, sizeof(Journal));
+    if (journal != NULL) {
+        journal->pending = malloc(JOURNAL_BUFFER_RECORDS * sizeof(JournalRecord));
+        journal->spare = malloc(JOURNAL_BUFFER_RECORDS * sizeof(JournalRecord));
+    }
+    if (journal == NULL || journal->pending == NULL || journal->spare == NULL) {
+        if (!failed)
+            fprintf(stderr, "%s: could not open the journal\n", path);
+        if (journal != NULL) {
+            free(journal->pending);
+            free(journal->spare);
+            free(journal);
+        }
+        close(fd);
+        return NULL;
+    }
+
+    journal->fd = fd;
+    journal->nextSequence = scan.lastSequence + 1 > firstSequence ? scan.lastSequence + 1 : firstSequence;
+    journal->writtenSequence = journal->nextSequence - 1;
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->wake, NULL);
+    pthread_cond_init(&journal->drained, NULL);
+    if (pthread_create(&journal->thread, NULL, writerMain, journal) != 0) {
+        fprintf(stderr, "%s: could not start the journal writer\n", path);
+        pthread_mutex_destroy(&journal->lock);
+        pthread_cond_destroy(&journal->wake);
+        pthread_cond_destroy(&journal->drained);
+        free(journal->pending);
+        free(journal->spare);
+        free(journal);
+        close(fd);
+        return NULL;
+    }
+    return journal;
+}
+
+uint64_t appendJournal(Journal *journal, double time, Vector3D position) {
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.time = time;
+    record.position = position;
+
+    pthread_mutex_lock(&journal->lock);
+    while (journal->pendingCount == JOURNAL_BUFFER_RECORDS)
+        pthread_cond_wait(&journal->drained, &journal->lock);
+    record.sequence = journal->nextSequence++;
+    record.checksum = recordChecksum(&record);
+    journal->pending[journal->pendingCount++] = record;
+    if (journal->pendingCount == 1)
+        pthread_cond_signal(&journal->wake);
+    pthread_mutex_unlock(&journal->lock);
+    return record.sequence;
+}
+
+uint64_t journalLastSequence(Journal *journal) {
+    pthread_mutex_lock(&journal->lock);
+    uint64_t last = journal->nextSequence - 1;
+    pthread_mutex_unlock(&journal->lock);
+    return last;
+}
+
+int flushJournal(Journal *journal) {
+    pthread_mutex_lock(&journal->lock);
+    while (journal->writtenSequence != journal->nextSequence - 1)
+        pthread_cond_wait(&journal->drained, &journal->lock);
+    pthread_mutex_unlock(&journal->lock);
+    int failed = fdatasync(journal->fd) != 0;
+    pthread_mutex_lock(&journal->lock);
+    journal->failed |= failed;
+    failed = journal->failed;
+    pthread_mutex_unlock(&journal->lock);
+    return failed ? -1 : 0;
+}
+
+int resetJournal(Journal *journal) {
+    if (flushJournal(journal) != 0)
+        return -1;
+    // Appends keep going to the end of the file, which is now right after the header.
+    if (ftruncate(journal->fd, sizeof(JournalHeader)) != 0 || fdatasync(journal->fd) != 0)
+        return -1;
+    return 0;
+}
+
+int closeJournal(Journal *journal) {
+    pthread_mutex_lock(&journal->lock);
+    journal->stopping = 1;
+    pthread_cond_signal(&journal->wake);
+    pthread_mutex_unlock(&journal->lock);
+    pthread_join(journal->thread, NULL);
+    int failed = journal->failed || fdatasync(journal->fd) != 0;
+    failed |= close(journal->fd) != 0;
+    pthread_mutex_destroy(&journal->lock);
+    pthread_cond_destroy(&journal->wake);
+    pthread_cond_destroy(&journal->drained);
+    free(journal->pending);
+    free(journal->spare);
+    free(journal);
+    return failed ? -1 : 0;
+}
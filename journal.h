@@ -0,0 +1,64 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "navigation.h"
+#include <stdint.h>
+
+#define JOURNAL_MAGIC "SWJOURN"  // 8 bytes including the terminator
+#define JOURNAL_VERSION 1
+#define JOURNAL_BUFFER_RECORDS 4096
+
+// Append-only log of ship state changes between snapshots (see snapshot.h).
+// Each record holds the state a travel command left behind: the new time and
+// position. Replaying one re-resolves the destination, as the command did.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+} JournalHeader;
+
+typedef struct {
+    uint64_t sequence;         // increases by one per record, starting at 1
+    double time;
+    Vector3D position;
+    uint64_t checksum;         // of the fields above; a torn last record fails it
+} JournalRecord;
+
+typedef struct {
+    uint64_t applied;          // records replayed
+    uint64_t lastSequence;     // last valid record in the file, 0 if none
+    uint64_t discarded;        // bytes of torn or corrupt records at the end
+} JournalReplay;
+
+// Applies every valid record after afterSequence to state, in order, stopping
+// at the first torn or corrupt record. A missing file replays nothing.
+// Returns 0 on success, -1 on error (a reason is printed to stderr).
+int replayJournal(const char *path, uint64_t afterSequence, ShipState *state, JournalReplay *replay);
+
+typedef struct Journal Journal;
+
+// Opens path for appending, creating it if needed and cutting off any torn
+// last record. Sequences continue after the file's last record, and start at
+// firstSequence at the least. Returns NULL on error (a reason is printed to stderr).
+Journal *openJournal(const char *path, uint64_t firstSequence);
+
+// Queues a record; a background thread writes queued records in batches, so
+// this only blocks when JOURNAL_BUFFER_RECORDS are already waiting.
+// Returns the record's sequence.
+uint64_t appendJournal(Journal *journal, double time, Vector3D position);
+
+// Sequence of the last appended record, 0 if none.
+uint64_t journalLastSequence(Journal *journal);
+
+// Waits until every appended record is written and synced to disk.
+// Returns 0 on success, -1 if any write failed.
+int flushJournal(Journal *journal);
+
+// Flushes, then drops every record: call after a snapshot has captured them.
+// Sequences keep increasing. Returns 0 on success, -1 on error.
+int resetJournal(Journal *journal);
+
+// Flushes and closes. Returns 0 if every write succeeded.
+int closeJournal(Journal *journal);
+
+#endif
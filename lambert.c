@@ -0,0 +1,85 @@
+#include "lambert.h"
+#include "stats.h"
+#include <math.h>
+
+#define PI 3.141592653589793
+#define LAMBERT_TOLERANCE 1e-10   // relative time-of-flight error
+#define LAMBERT_MAX_ITERATIONS 100
+
+// Stumpff functions C(psi) and S(psi).
+static void stumpff(double psi, double *c2, double *c3) {
+    if (psi > 1e-6) {
+        double s = sqrt(psi);
+        *c2 = (1.0 - cos(s)) / psi;
+        *c3 = (s - sin(s)) / (s * psi);
+    } else if (psi < -1e-6) {
+        double s = sqrt(-psi);
+        *c2 = (1.0 - cosh(s)) / psi;
+        *c3 = (sinh(s) - s) / (s * -psi);
+    } else {
+        *c2 = 0.5 - psi / 24.0;
+        *c3 = 1.0 / 6.0 - psi / 120.0;
+    }
+}
+
+static int solveUniversalVariables(Vector3D r1, Vector3D r2, double timeOfFlight, double gm,
+                                   Vector3D *v1, Vector3D *v2) {
+    double r1n = sqrt(r1.x * r1.x + r1.y * r1.y + r1.z * r1.z);
+    double r2n = sqrt(r2.x * r2.x + r2.y * r2.y + r2.z * r2.z);
+    if (r1n == 0.0 || r2n == 0.0 || timeOfFlight <= 0.0)
+        return -1;
+    double cosDnu = (r1.x * r2.x + r1.y * r2.y + r1.z * r2.z) / (r1n * r2n);
+    // Prograde: the short way when the transfer sweeps counter-clockwise.
+    double crossZ = r1.x * r2.y - r1.y * r2.x;
+    double direction = crossZ >= 0.0 ? 1.0 : -1.0;
+    double a = direction * sqrt(r1n * r2n * (1.0 + cosDnu));
+    if (fabs(a) < 1e-12)
+        return -1;
+
+    double sqrtGm = sqrt(gm);
+    double psi = 0.0, psiLow = -4.0 * PI, psiHigh = 4.0 * PI * PI;
+    double c2, c3, y = 0.0;
+    int converged = 0;
+    for (int i = 0; i < LAMBERT_MAX_ITERATIONS; i++) {
+        stumpff(psi, &c2, &c3);
+        y = r1n + r2n + a * (psi * c3 - 1.0) / sqrt(c2);
+        double t;
+        if (y < 0.0) {
+            // psi is too small for this geometry; treat it as a short flight.
+            t = -1.0;
+        } else {
+            double chi = sqrt(y / c2);
+            t = (chi * chi * chi * c3 + a * sqrt(y)) / sqrtGm;
+            if (fabs(t - timeOfFlight) <= LAMBERT_TOLERANCE * timeOfFlight) {
+                converged = 1;
+                break;
+            }
+        }
+        if (t < timeOfFlight)
+            psiLow = psi;
+        else
+            psiHigh = psi;
+        psi = 0.5 * (psiLow + psiHigh);
+    }
+    if (!converged || y <= 0.0)
+        return -1;
+
+    double f = 1.0 - y / r1n;
+    double g = a * sqrt(y / gm);
+    double gDot = 1.0 - y / r2n;
+    v1->x = (r2.x - f * r1.x) / g;
+    v1->y = (r2.y - f * r1.y) / g;
+    v1->z = (r2.z - f * r1.z) / g;
+    v2->x = (gDot * r2.x - r1.x) / g;
+    v2->y = (gDot * r2.y - r1.y) / g;
+    v2->z = (gDot * r2.z - r1.z) / g;
+    return 0;
+}
+
+int solveLambert(Vector3D r1, Vector3D r2, double timeOfFlight, double gm,
+                 Vector3D *v1, Vector3D *v2) {
+    STATS_BEGIN(STATS_LAMBERT);
+    int result = solveUniversalVariables(r1, r2, timeOfFlight, gm, v1, v2);
+    STATS_END(STATS_LAMBERT);
+    return result;
+}
@@ -0,0 +1,20 @@
+#ifndef LAMBERT_H
+#define LAMBERT_H
+
+#include "planet.h"
+
+// Sun's gravitational parameter in AU^3/day^2, consistent with the
+// 365.25 * a^1.5 period law used by computeHohmannTransferTime.
+#define SUN_GM ((2 * 3.141592653589793 / 365.25) * (2 * 3.141592653589793 / 365.25))
+
+// Kilometres per second in one AU per day.
+#define AU_PER_DAY_IN_KM_PER_S 1731.456836805556
+
+// Solves Lambert's problem for a prograde, zero-revolution transfer from r1
+// to r2 taking timeOfFlight days, using universal variables with bisection.
+// Stores the departure and arrival velocities (AU/day) and returns 0, or
+// returns -1 when no solution exists (e.g. a 180 degree transfer).
+int solveLambert(Vector3D r1, Vector3D r2, double timeOfFlight, double gm,
+                 Vector3D *v1, Vector3D *v2);
+
+#endif
@@ -0,0 +1,311 @@
+// Load generator for the query server (see server.h).
+//
+// Usage: navigator_loadgen PATH|tcp:PORT [--clients N] [--depth N] [--seconds S] [--mix P,N,H,L]
+//
+// Every client is a thread with a connection of its own that keeps depth
+// requests in flight: it writes a window of requests, then tops the window up
+// with as many as the responses it reads. Request kinds are drawn with the mix
+// weights (position, nearest, transfer, lookup); names come from an initial
+// lookup. Latency is from the write of a request to the read of its response.
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOADGEN_MAX_CLIENTS 1024
+#define LOADGEN_MAX_DEPTH 4096        // keeps a window of requests and its responses within the socket buffers
+#define LOADGEN_REQUEST_BYTES 96
+#define LOADGEN_READ_BYTES (256 * 1024)
+#define LOADGEN_NAMES 8               // SERVER_LOOKUP_MAX
+#define LOADGEN_NAME_LENGTH 32
+#define LOADGEN_BUCKETS_PER_OCTAVE 4
+#define LOADGEN_BUCKETS (40 * LOADGEN_BUCKETS_PER_OCTAVE)   // latencies up to 2^40 ns
+
+typedef struct {
+    const char *address;
+    int depth;
+    double seconds;
+    double mix[4];                    // cumulative weights, the last one 1
+} LoadSettings;
+
+typedef struct {
+    const LoadSettings *settings;
+    int client;
+    int failed;
+    long long requests;
+    long long errors;
+    uint64_t histogram[LOADGEN_BUCKETS];
+} LoadClient;
+
+static double nowNanoseconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static uint64_t nextRandom(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static double uniform(uint64_t *state, double low, double high) {
+    return low + (high - low) * (double)(nextRandom(state) >> 11) * 0x1p-53;
+}
+
+static int latencyBucket(double nanoseconds) {
+    int bucket = nanoseconds > 1.0 ? (int)(log2(nanoseconds) * LOADGEN_BUCKETS_PER_OCTAVE) : 0;
+    return bucket < LOADGEN_BUCKETS ? bucket : LOADGEN_BUCKETS - 1;
+}
+
+// Upper bound of the latency below which fraction of the requests fall.
+static double latencyPercentile(const uint64_t *histogram, double fraction) {
+    uint64_t total = 0, seen = 0;
+    for (int b = 0; b < LOADGEN_BUCKETS; b++)
+        total += histogram[b];
+    for (int b = 0; b < LOADGEN_BUCKETS; b++) {
+        seen += histogram[b];
+        if (total > 0 && seen >= fraction * total)
+            return exp2((double)(b + 1) / LOADGEN_BUCKETS_PER_OCTAVE);
+    }
+    return 0.0;
+}
+
+static int connectTo(const char *address) {
+    int fd;
+    if (strncmp(address, "tcp:", 4) == 0) {
+        struct sockaddr_in remote;
+        memset(&remote, 0, sizeof(remote));
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons((uint16_t)atoi(address + 4));
+        remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        if (fd >= 0)
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&remote, sizeof(remote)) == 0)
+            return fd;
+    } else {
+        struct sockaddr_un remote;
+        memset(&remote, 0, sizeof(remote));
+        remote.sun_family = AF_UNIX;
+        strncpy(remote.sun_path, address, sizeof(remote.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&remote, sizeof(remote)) == 0)
+            return fd;
+    }
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+static int writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+// Reads the names of one lookup response ("L count name,name,...").
+static int readNames(int fd, char names[LOADGEN_NAMES][LOADGEN_NAME_LENGTH]) {
+    char line[LOADGEN_NAMES * (LOADGEN_NAME_LENGTH + 1) + 32];
+    size_t used = 0;
+    while (used < sizeof(line) - 1 && (used == 0 || line[used - 1] != '\n')) {
+        ssize_t n = read(fd, line + used, 1);
+        if (n <= 0)
+            return -1;
+        used++;
+    }
+    line[used - 1] = '\0';
+    int count = 0;
+    char *list = strchr(line + 2, ' ');
+    for (char *name = list != NULL ? strtok(list + 1, ",") : NULL; name != NULL && count < LOADGEN_NAMES;
+         name = strtok(NULL, ",")) {
+        strncpy(names[count], name, LOADGEN_NAME_LENGTH - 1);
+        names[count++][LOADGEN_NAME_LENGTH - 1] = '\0';
+    }
+    return count;
+}
+
+static int formatRequest(char *dest, uint64_t *random, const LoadSettings *settings,
+                         char names[LOADGEN_NAMES][LOADGEN_NAME_LENGTH], int nameCount) {
+    double kind = uniform(random, 0.0, 1.0);
+    double time = uniform(random, 0.0, 3650.0);
+    if (kind < settings->mix[0] && nameCount > 0)
+        return snprintf(dest, LOADGEN_REQUEST_BYTES, "P %.3f %s\n", time,
+                        names[nextRandom(random) % (uint64_t)nameCount]);
+    if (kind < settings->mix[1]) {    // also the position requests when no names are known
+        double r = uniform(random, 0.3, 40.0), angle = uniform(random, 0.0, 2 * M_PI);
+        return snprintf(dest, LOADGEN_REQUEST_BYTES, "N %.6f %.6f %.6f %.3f\n", r * cos(angle), r * sin(angle),
+                        uniform(random, -0.1, 0.1), time);
+    }
+    if (kind < settings->mix[2])
+        return snprintf(dest, LOADGEN_REQUEST_BYTES, "H %.4f %.4f\n", uniform(random, 0.3, 40.0),
+                        uniform(random, 0.3, 40.0));
+    return snprintf(dest, LOADGEN_REQUEST_BYTES, "L %c\n", 'A' + (int)(nextRandom(random) % 26));
+}
+
+static void *runClient(void *argument) {
+    LoadClient *client = argument;
+    const LoadSettings *settings = client->settings;
+    int depth = settings->depth;
+    int fd = connectTo(settings->address);
+    char *requests = malloc((size_t)depth * LOADGEN_REQUEST_BYTES);
+    char *input = malloc(LOADGEN_READ_BYTES);
+    double *sentAt = malloc((size_t)depth * sizeof(double));    // ring of the requests in flight
+    char names[LOADGEN_NAMES][LOADGEN_NAME_LENGTH];
+    int nameCount = -1;
+    if (fd >= 0 && requests != NULL && input != NULL && sentAt != NULL && writeAll(fd, "L \n", 3) == 0)
+        nameCount = readNames(fd, names);
+    if (nameCount < 0) {
+        client->failed = 1;
+        goto done;
+    }
+
+    uint64_t random = 0x9E3779B97F4A7C15ull * (uint64_t)(client->client + 1);
+    double deadline = nowNanoseconds() + settings->seconds * 1e9;
+    int inFlight = 0, oldest = 0;
+    int sending = 1, atLineStart = 1;
+    while (sending || inFlight > 0) {
+        if (sending) {
+            size_t length = 0;
+            double now = nowNanoseconds();
+            for (; inFlight < depth; inFlight++) {
+                length += (size_t)formatRequest(requests + length, &random, settings, names, nameCount);
+                sentAt[(oldest + inFlight) % depth] = now;
+            }
+            if (length > 0 && writeAll(fd, requests, length) != 0) {
+                client->failed = 1;
+                break;
+            }
+            sending = now < deadline;
+        }
+        ssize_t n = read(fd, input, LOADGEN_READ_BYTES);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            client->failed = 1;
+            break;
+        }
+        double now = nowNanoseconds();
+        for (ssize_t i = 0; i < n; i++) {
+            if (atLineStart && input[i] == 'E')
+                client->errors++;
+            atLineStart = input[i] == '\n';
+            if (!atLineStart)
+                continue;
+            client->histogram[latencyBucket(now - sentAt[oldest])]++;
+            client->requests++;
+            oldest = (oldest + 1) % depth;
+            inFlight--;
+        }
+    }
+
+done:
+    if (fd >= 0)
+        close(fd);
+    free(requests);
+    free(input);
+    free(sentAt);
+    return NULL;
+}
+
+static void formatLatency(char *dest, size_t size, double nanoseconds) {
+    if (nanoseconds < 1e3)
+        snprintf(dest, size, "%.0f ns", nanoseconds);
+    else if (nanoseconds < 1e6)
+        snprintf(dest, size, "%.1f us", nanoseconds * 1e-3);
+    else
+        snprintf(dest, size, "%.2f ms", nanoseconds * 1e-6);
+}
+
+int main(int argc, char **argv) {
+    LoadSettings settings = { NULL, 64, 5.0, { 0.4, 0.8, 0.9, 1.0 } };
+    int clients = 8, usage = 0;
+    for (int i = 1; i < argc && !usage; i++) {
+        if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            settings.depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            settings.seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc) {
+            double weights[4] = { 0 }, total = 0.0;
+            if (sscanf(argv[++i], "%lf,%lf,%lf,%lf", &weights[0], &weights[1], &weights[2], &weights[3]) != 4)
+                usage = 1;
+            for (int k = 0; k < 4; k++)
+                settings.mix[k] = total += weights[k] > 0.0 ? weights[k] : 0.0;
+            for (int k = 0; k < 4 && total > 0.0; k++)
+                settings.mix[k] /= total;
+        } else if (argv[i][0] != '-' && settings.address == NULL) {
+            settings.address = argv[i];
+        } else {
+            usage = 1;
+        }
+    }
+    if (usage || settings.address == NULL || clients < 1 || clients > LOADGEN_MAX_CLIENTS || settings.depth < 1 ||
+        settings.depth > LOADGEN_MAX_DEPTH || !(settings.seconds > 0.0) || !(settings.mix[3] > 0.0)) {
+        fprintf(stderr, "Usage: %s PATH|tcp:PORT [--clients N] [--depth N] [--seconds S] [--mix P,N,H,L]\n"
+                        "  at most %d clients and a depth of %d\n",
+                argv[0], LOADGEN_MAX_CLIENTS, LOADGEN_MAX_DEPTH);
+        return 1;
+    }
+
+    LoadClient *state = calloc((size_t)clients, sizeof(LoadClient));
+    pthread_t *threads = malloc((size_t)clients * sizeof(pthread_t));
+    if (state == NULL || threads == NULL) {
+        fprintf(stderr, "Error: not enough memory\n");
+        return 1;
+    }
+    double start = nowNanoseconds();
+    int started = 0;
+    for (; started < clients; started++) {
+        state[started].settings = &settings;
+        state[started].client = started;
+        if (pthread_create(&threads[started], NULL, runClient, &state[started]) != 0)
+            break;
+    }
+    for (int c = 0; c < started; c++)
+        pthread_join(threads[c], NULL);
+    double seconds = (nowNanoseconds() - start) * 1e-9;
+
+    long long requests = 0, errors = 0;
+    int failed = clients - started;
+    uint64_t histogram[LOADGEN_BUCKETS] = { 0 };
+    for (int c = 0; c < started; c++) {
+        requests += state[c].requests;
+        errors += state[c].errors;
+        failed += state[c].failed;
+        for (int b = 0; b < LOADGEN_BUCKETS; b++)
+            histogram[b] += state[c].histogram[b];
+    }
+    char p50[16], p99[16], p999[16];
+    formatLatency(p50, sizeof(p50), latencyPercentile(histogram, 0.5));
+    formatLatency(p99, sizeof(p99), latencyPercentile(histogram, 0.99));
+    formatLatency(p999, sizeof(p999), latencyPercentile(histogram, 0.999));
+    printf("%d clients, depth %d: %lld requests in %.2f s (%.0f requests/s), %lld errors\n",
+           started, settings.depth, requests, seconds, requests / seconds, errors);
+    printf("Latency p50 %s, p99 %s, p99.9 %s (bucket upper bounds)\n", p50, p99, p999);
+    if (failed > 0)
+        fprintf(stderr, "%d clients failed to connect or lost their connection\n", failed);
+    free(state);
+    free(threads);
+    return failed > 0 ? 1 : 0;
+}
@@ -1,22 +1,336 @@
 #include "navigation.h"
 #include "planet.h"
 #include "destinations.h"  // If you want to use printDestinations() or getDestinationByName() elsewhere.
+#include "batch.h"
+#include "fleet.h"
+#include "routeplanner.h"
+#include "journal.h"
+#include "modes.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "textio.h"
+#include "threadpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define LOOKUP_MAX_MATCHES 10
+
+// Looks up a destination by exact name (ignoring case), falling back to a prefix search.
+void lookUpDestination(void) {
+    char name[64];
+    printf("\nDestination name or prefix: ");
+    if (scanf(" %63[^\n]", name) != 1)
+        return;
+    Planet *match = getDestinationByNameIgnoreCase(name);
+    if (match != NULL) {
+        printf("%s - Orbit Radius: %.3f AU, Orbital Period: %.2f days\n",
+               match->name, match->orbitRadius, match->orbitalPeriod);
+        return;
+    }
+    int ids[LOOKUP_MAX_MATCHES];
+    int found = findDestinationsByPrefix(name, ids, LOOKUP_MAX_MATCHES);
+    if (found == 0) {
+        printf("No destination matches '%s'.\n", name);
+        return;
+    }
+    for (int i = 0; i < found; i++) {
+        Planet *p = &knownDestinations[ids[i]];
+        printf("%d. %s - Orbit Radius: %.3f AU, Orbital Period: %.2f days\n",
+               ids[i] + 1, p->name, p->orbitRadius, p->orbitalPeriod);
+    }
+    if (found == LOOKUP_MAX_MATCHES)
+        printf("(showing the first %d matches)\n", LOOKUP_MAX_MATCHES);
+}
+
+#define ROUTE_BUCKET_DAYS 10.0
+
+static RoutePlanner routePlanner;
+static int routePlannerReady = 0;
+
+// Prompts for two destinations and prints the fastest or cheapest itinerary from the current time.
+void planRouteConsole(ShipState *state) {
+    char fromName[64], toName[64], objective;
+    printf("\nFrom destination: ");
+    if (scanf(" %63[^\n]", fromName) != 1)
+        return;
+    printf("To destination: ");
+    if (scanf(" %63[^\n]", toName) != 1)
+        return;
+    printf("Optimise for (F)astest or (C)heapest delta-v: ");
+    if (scanf(" %c", &objective) != 1)
+        return;
+
+    Planet *from = getDestinationByNameIgnoreCase(fromName);
+    Planet *to = getDestinationByNameIgnoreCase(toName);
+    if (from == NULL || to == NULL) {
+        printf("Unknown destination '%s'.\n", from == NULL ? fromName : toName);
+        return;
+    }
+    if (!routePlannerReady) {
+        if (createRoutePlanner(&routePlanner, knownDestinations, knownDestinationsCount, ROUTE_BUCKET_DAYS) != 0) {
+            printf("Error: not enough memory for the route planner.\n");
+            return;
+        }
+        routePlannerReady = 1;
+    }
+
+    Route route;
+    RouteObjective goal = (objective == 'C' || objective == 'c') ? ROUTE_CHEAPEST : ROUTE_FASTEST;
+    if (planRoute(&routePlanner, (int)(from - knownDestinations), (int)(to - knownDestinations),
+                  state->currentTime, goal, &route) != 0) {
+        printf("No route found.\n");
+        return;
+    }
+    for (int i = 0; i < route.legCount; i++) {
+        RouteLeg *leg = &route.legs[i];
+        printf("%d. %s -> %s: depart day %.2f, arrive day %.2f, delta-v %.2f km/s\n",
+               i + 1, knownDestinations[leg->from].name, knownDestinations[leg->to].name,
+               leg->departureTime, leg->arrivalTime, leg->deltaV);
+    }
+    printf("Arrival: day %.2f, total delta-v %.2f km/s\n", route.arrivalTime, route.deltaV);
+}
+
+// State persistence (--snapshot FILE, --journal FILE): the ship state is
+// restored from the snapshot plus the journal records written after it, every
+// travel is journaled, and a new snapshot replaces both on request and at exit.
+static const char *snapshotPath = NULL;
+static Journal *stateJournal = NULL;
+static uint64_t snapshotSequence = 0;   // last journal record included in the state
+
+// Loads the snapshot (if it exists) and replays the journal tail into state.
+// Returns 0 on success, -1 on error.
+int restoreShipState(ShipState *state, const char *journalPath) {
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int restored = 0;
+    if (snapshotPath != NULL && access(snapshotPath, F_OK) == 0) {
+        MappedSnapshot snapshot;
+        if (openSnapshot(&snapshot, snapshotPath) != 0)
+            return -1;
+        *state = *snapshot.state;
+        snapshotSequence = snapshot.header->journalSequence;
+        closeSnapshot(&snapshot);
+        restored = 1;
+    }
+    JournalReplay replay = { 0, 0, 0 };
+    if (journalPath != NULL) {
+        if (replayJournal(journalPath, snapshotSequence, state, &replay) != 0)
+            return -1;
+        stateJournal = openJournal(journalPath, snapshotSequence + 1);
+        if (stateJournal == NULL)
+            return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    if (restored || replay.applied > 0)
+        fprintf(stderr, "Restored ship state (%s + %llu journal records) in %.2f ms\n",
+               restored ? snapshotPath : "no snapshot", (unsigned long long)replay.applied,
+               1e3 * elapsedSeconds(start, stop));
+    return 0;
+}
+
+// Writes state and fleet to the snapshot and empties the journal it supersedes.
+// A NULL fleet keeps the fleet of the previous snapshot, if any. Does nothing
+// without --snapshot. Returns 0 on success, -1 on error.
+int saveShipState(const ShipState *state, const Fleet *fleet, double fleetTime) {
+    if (snapshotPath == NULL)
+        return 0;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Fleet previous;
+    int keepPrevious = 0;
+    if (fleet == NULL && access(snapshotPath, F_OK) == 0) {
+        MappedSnapshot snapshot;
+        if (openSnapshot(&snapshot, snapshotPath) == 0) {
+            fleetTime = snapshot.header->fleetTime;
+            keepPrevious = snapshot.header->fleetCount > 0 && restoreFleet(&snapshot, &previous, 0) == 0;
+            closeSnapshot(&snapshot);
+        }
+        fleet = keepPrevious ? &previous : NULL;
+    }
+    if (stateJournal != NULL)
+        snapshotSequence = journalLastSequence(stateJournal);
+    int failed = writeSnapshot(snapshotPath, state, snapshotSequence, fleet, fleetTime) != 0;
+    if (keepPrevious)
+        freeFleet(&previous);
+    if (failed) {
+        fprintf(stderr, "Error: could not write snapshot %s\n", snapshotPath);
+        return -1;
+    }
+    if (stateJournal != NULL && resetJournal(stateJournal) != 0) {
+        fprintf(stderr, "Error: could not reset the journal\n");
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    fprintf(stderr, "Snapshot written to %s in %.2f ms\n", snapshotPath, 1e3 * elapsedSeconds(start, stop));
+    return 0;
+}
+
+// Saves the final state and closes the journal. Returns 0 on success, -1 on error.
+int finishShipState(const ShipState *state) {
+    int failed = saveShipState(state, NULL, 0.0) != 0;
+    if (stateJournal != NULL) {
+        failed |= closeJournal(stateJournal) != 0;
+        stateJournal = NULL;
+    }
+    return failed ? -1 : 0;
+}
+
+// --batch [FILE]: runs a command stream from FILE (or stdin for '-') against
+// the console's ship state and journal, and exits.
+static int runBatchMode(const char *path, ShipState *state) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    BatchStats stats;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = runBatch(fd, STDOUT_FILENO, state, stateJournal, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    if (fd != STDIN_FILENO)
+        close(fd);
+    double seconds = elapsedSeconds(start, stop);
+    fprintf(stderr, "batch: %lld commands, %lld errors in %.3f s (%.0f commands/s)\n",
+            stats.commands, stats.errors, seconds, seconds > 0.0 ? stats.commands / seconds : 0.0);
+    if (finishShipState(state) != 0)
+        failed = 1;
+    return failed ? 1 : 0;
+}
 
 void printMenu(void) {
     printf("\n--- Navigation Console ---\n");
     printf("I > Space-Time Information\n");
     printf("D > Display Known Destinations\n");
+    printf("L > Look Up Destination by Name\n");
     printf("F > Formulae\n");
     printf("H > Hohmann Transfer Time\n");
+    printf("R > Route Planner\n");
+    printf("S > Statistics\n");
     printf("T > TRAVEL SYSTEM\n");
+    printf("W > Write Snapshot\n");
     printf("M > Menu\n");
     printf("0 > Quit\n");
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+    // Command-line options.
+    char **porkchopArgs = NULL;
+    const char *batchPath = NULL;
+    const char *serveAddress = NULL;
+    char **fleetArgs = NULL;
+    char **ephemerisBuildArgs = NULL;
+    char **ephemerisExportArgs = NULL;
+    char **propagateArgs = NULL;
+    char **dispersionArgs = NULL;
+    char **conjunctionArgs = NULL;
+    char **voyagesArgs = NULL;
+    const char *ephemerisPath = NULL;
+    const char *descriptionsPath = NULL;
+    const char *statsPath = NULL;
+    const char *journalPath = NULL;
+    double statsInterval = STATS_DEFAULT_DUMP_SECONDS;
+    int threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--catalog") == 0 && i + 1 < argc) {
+            if (loadDestinationCatalog(argv[++i]) != 0) {
+                printf("Error: could not load catalog %s\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batchPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "-";
+        } else if (strcmp(argv[i], "--fleet") == 0 && i + FLEET_ARGUMENTS < argc) {
+            fleetArgs = &argv[i + 1];
+            i += FLEET_ARGUMENTS;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (strcmp(argv[i], "--nbody") == 0) {
+            setTravelModel(TRAVEL_NBODY);
+        } else if (strcmp(argv[i], "--propagate") == 0 && i + PROPAGATE_ARGUMENTS < argc) {
+            propagateArgs = &argv[i + 1];
+            i += PROPAGATE_ARGUMENTS;
+        } else if (strcmp(argv[i], "--dispersion") == 0 && i + DISPERSION_ARGUMENTS < argc) {
+            dispersionArgs = &argv[i + 1];
+            i += DISPERSION_ARGUMENTS;
+        } else if (strcmp(argv[i], "--conjunctions") == 0 && i + CONJUNCTION_ARGUMENTS < argc) {
+            conjunctionArgs = &argv[i + 1];
+            i += CONJUNCTION_ARGUMENTS;
+        } else if (strcmp(argv[i], "--voyages") == 0 && i + VOYAGES_ARGUMENTS < argc) {
+            voyagesArgs = &argv[i + 1];
+            i += VOYAGES_ARGUMENTS;
+        } else if (strcmp(argv[i], "--ephemeris") == 0 && i + 1 < argc) {
+            ephemerisPath = argv[++i];
+        } else if (strcmp(argv[i], "--descriptions") == 0 && i + 1 < argc) {
+            descriptionsPath = argv[++i];
+        } else if (strcmp(argv[i], "--build-ephemeris") == 0 && i + EPHEMERIS_BUILD_ARGUMENTS < argc) {
+            ephemerisBuildArgs = &argv[i + 1];
+            i += EPHEMERIS_BUILD_ARGUMENTS;
+        } else if (strcmp(argv[i], "--export-ephemeris") == 0 && i + EPHEMERIS_EXPORT_ARGUMENTS < argc) {
+            ephemerisExportArgs = &argv[i + 1];
+            i += EPHEMERIS_EXPORT_ARGUMENTS;
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (strcmp(argv[i], "--stats-file") == 0 && i + 1 < argc) {
+            statsPath = argv[++i];
+        } else if (strcmp(argv[i], "--stats-interval") == 0 && i + 1 < argc) {
+            statsInterval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--porkchop") == 0 && i + PORKCHOP_ARGUMENTS < argc) {
+            porkchopArgs = &argv[i + 1];
+            i += PORKCHOP_ARGUMENTS;
+        } else {
+            printf("Usage: %s [--catalog FILE] [--ephemeris FILE] [--descriptions FILE] [--threads N] [--batch [FILE]] [--nbody]\n"
+                   "       [--snapshot FILE] [--journal FILE] [--stats-file FILE] [--stats-interval SECONDS]\n"
+                   "       [--fleet SHIPS TICKS TICK_DAYS] [--propagate SHIPS DAYS] [--build-ephemeris FILE START END]\n"
+                   "       [--porkchop FROM TO DEP_START DEP_END DEP_STEPS TOF_MIN TOF_MAX TOF_STEPS OUTPUT]\n"
+                   "       [--export-ephemeris FILE text|binary START END STEP all|NAME,...] [--serve PATH|tcp:PORT]\n"
+                   "       [--dispersion FROM TO DEPARTURE DURATION DEPARTURE_SIGMA DURATION_SIGMA AIM_SIGMA SAMPLES SEED]\n"
+                   "       [--conjunctions START END DISTANCE FILE] [--voyages SHIPS DAYS]\n",
+                   argv[0]);
+            exit(1);
+        }
+    }
+    // Statistics are dumped every statsInterval seconds and once more at exit.
+    if (statsPath != NULL) {
+        if (startStatsDump(statsPath, statsInterval) != 0)
+            exit(1);
+        atexit(stopStatsDump);
+    }
+    // The cache must match the destinations, so it is loaded after any catalog.
+    if (ephemerisPath != NULL && loadDestinationEphemeris(ephemerisPath) != 0) {
+        printf("Error: could not load ephemeris cache %s\n", ephemerisPath);
+        exit(1);
+    }
+    // Descriptions name their destinations, so they too follow any catalog.
+    if (descriptionsPath != NULL && loadDestinationDescriptions(descriptionsPath) < 0) {
+        printf("Error: could not load destination descriptions %s\n", descriptionsPath);
+        exit(1);
+    }
+    if (ephemerisBuildArgs != NULL)
+        return runEphemerisBuildMode(ephemerisBuildArgs, threads);
+    if (ephemerisExportArgs != NULL)
+        return runEphemerisExportMode(ephemerisExportArgs, threads);
+    if (porkchopArgs != NULL)
+        return runPorkchopMode(porkchopArgs, threads);
+    if (propagateArgs != NULL)
+        return runPropagateMode(propagateArgs, threads);
+    if (dispersionArgs != NULL)
+        return runDispersionMode(dispersionArgs, threads);
+    if (conjunctionArgs != NULL)
+        return runConjunctionsMode(conjunctionArgs, threads);
+    if (voyagesArgs != NULL)
+        return runVoyagesMode(voyagesArgs);
+    if (serveAddress != NULL)
+        return runServeMode(serveAddress, threads);
+
     // Retrieve Earth from the destinations module.
     Planet *earth = getDestinationByName("Earth");
     if (earth == NULL) {
@@ -29,12 +343,32 @@ int main(void) {
     
     // Initialize your ship state using Earth.
     ShipState state;
+    memset(&state, 0, sizeof(state));
     state.currentTime = 100.0;
     state.shipPosition = getPlanetPosition(*earth, state.currentTime);
-    strcpy(state.currentDestination.name, earth->name);
-    strcpy(state.currentDestination.description, "Earth: our vibrant blue home planet.");
+    state.currentDestination.id = (int)(earth - knownDestinations);
     state.currentDestination.position = state.shipPosition;
     state.currentDestination.arrivalTime = state.currentTime;
+
+    if ((snapshotPath != NULL || journalPath != NULL) && restoreShipState(&state, journalPath) != 0) {
+        printf("Error: could not restore the ship state\n");
+        exit(1);
+    }
+    if (fleetArgs != NULL) {
+        // The fleet is saved with the snapshot; the console state rides along unchanged.
+        Fleet fleet;
+        double fleetTime;
+        int status = runFleetMode(fleetArgs, threads, snapshotPath, &fleet, &fleetTime);
+        if (status == 0) {
+            status = saveShipState(&state, &fleet, fleetTime) != 0;
+            freeFleet(&fleet);
+        }
+        if (stateJournal != NULL && closeJournal(stateJournal) != 0)
+            status = 1;
+        return status;
+    }
+    if (batchPath != NULL)
+        return runBatchMode(batchPath, &state);
     
     printf("\nYou are on << Mineral-Raider-1 >>\n");
     printInfo(&state);
@@ -47,18 +381,32 @@ int main(void) {
         
         if (choice == 'D' || choice == 'd') {
             printDestinations();
+        } else if (choice == 'L' || choice == 'l') {
+            lookUpDestination();
         } else if (choice == 'F' || choice == 'f') {
             printFormulae();
         } else if (choice == 'H' || choice == 'h') {
             hohmannTransferTime(&state);
+        } else if (choice == 'R' || choice == 'r') {
+            planRouteConsole(&state);
+        } else if (choice == 'S' || choice == 's') {
+            printStats(stdout);
         } else if (choice == 'T' || choice == 't') {
             travelSystemExecute(&state);
+            if (stateJournal != NULL)
+                appendJournal(stateJournal, state.currentTime, state.shipPosition);
+        } else if (choice == 'W' || choice == 'w') {
+            if (snapshotPath != NULL)
+                saveShipState(&state, NULL, 0.0);
+            else
+                printf("No snapshot file; start with --snapshot FILE.\n");
         } else if (choice == 'I' || choice == 'i') {
             printInfo(&state);
         } else if (choice == 'M' || choice == 'm') {
             printMenu();
         } else if (choice == '0') {
             printf("Exiting Navigation Console. Safe travels!\n");
+            finishShipState(&state);
             break;
         } else {
             printf("Invalid choice. Please try again.\n");
@@ -0,0 +1,90 @@
+#ifndef MODES_H
+#define MODES_H
+
+#include "fleet.h"
+#include <time.h>
+
+// Command-line modes of space_navigator. Each runs on the arguments that
+// follow its option, prints its report and returns the process exit status.
+
+static inline double elapsedSeconds(struct timespec start, struct timespec stop) {
+    return (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+#define LAUNCH_SEED 88172645463325252ull
+
+// Marsaglia's xorshift64, behind the deterministic launch plans of the simulation modes.
+static inline unsigned long long nextLaunchRandom(unsigned long long *seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
+
+#define PORKCHOP_ARGUMENTS 9
+
+// --porkchop FROM TO DEP_START DEP_END DEP_STEPS TOF_MIN TOF_MAX TOF_STEPS OUTPUT:
+// writes the delta-v of a grid of Lambert transfers to OUTPUT and reports the cheapest.
+int runPorkchopMode(char **args, int threads);
+
+#define FLEET_ARGUMENTS 3
+
+// --fleet SHIPS TICKS TICK_DAYS: launches SHIPS ships from Earth towards random
+// known destinations and reports the cost of each simulation tick. A fleet
+// saved in the snapshot at snapshotPath (may be NULL) is resumed instead. On
+// success the advanced fleet is stored in *result, for the caller to save and
+// free, and its time in *endTime.
+int runFleetMode(char **args, int threads, const char *snapshotPath, Fleet *result, double *endTime);
+
+#define EPHEMERIS_BUILD_ARGUMENTS 3
+
+// --build-ephemeris FILE START END: fits a Chebyshev cache of the known
+// destinations over [START, END] days, verifies it and writes it to FILE.
+int runEphemerisBuildMode(char **args, int threads);
+
+#define PROPAGATE_ARGUMENTS 2
+
+// --propagate SHIPS DAYS: launches SHIPS ships from Earth on Sun-only Lambert
+// arcs to random known destinations, propagates them for DAYS days through the
+// gravity of every destination with a mass and reports the cost and how far
+// the other bodies pulled the ships off their arcs.
+int runPropagateMode(char **args, int threads);
+
+#define EPHEMERIS_EXPORT_ARGUMENTS 6
+
+// --export-ephemeris FILE text|binary START END STEP BODIES: writes the
+// positions of BODIES (comma-separated names, or "all") every STEP days from
+// START to END to FILE ('-' for stdout).
+int runEphemerisExportMode(char **args, int threads);
+
+#define DISPERSION_ARGUMENTS 9
+
+// --dispersion FROM TO DEPARTURE DURATION DEPARTURE_SIGMA DURATION_SIGMA AIM_SIGMA SAMPLES SEED:
+// flies SAMPLES copies of the transfer from FROM on day DEPARTURE to TO's
+// position DURATION days later, each with normally distributed errors in the
+// departure day, the travel time and the commanded position (sigmas in days,
+// days and AU), and reports where they arrived. The same SEED gives the same
+// report on any number of threads.
+int runDispersionMode(char **args, int threads);
+
+#define CONJUNCTION_ARGUMENTS 4
+
+// --conjunctions START END DISTANCE FILE: lists every pair of known
+// destinations that comes within DISTANCE AU of each other between days START
+// and END, with the time and distance of the closest approach, to FILE ("-"
+// for standard output) as "time_days,distance_au,first,second" lines.
+int runConjunctionsMode(char **args, int threads);
+
+#define VOYAGES_ARGUMENTS 2
+
+// --voyages SHIPS DAYS: each of SHIPS ships leaves Earth after a random
+// layover and flies between random known destinations for DAYS days, on the
+// event scheduler rather than a fixed tick: the clock jumps from one
+// departure or arrival to the next, events due at the same time are
+// dispatched together, and each arrival is resolved like the console's.
+int runVoyagesMode(char **args);
+
+// --serve ADDRESS: answers queries on a Unix socket path or tcp:PORT until interrupted.
+int runServeMode(const char *address, int threads);
+
+#endif
@@ -0,0 +1,120 @@
+#include "nameindex.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static inline unsigned char foldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+// FNV-1a over the case-folded name. Never returns 0, which marks empty slots.
+static uint32_t hashFolded(const char *name, size_t maxLength) {
+    uint32_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < maxLength && name[i] != '\0'; i++) {
+        hash ^= foldCase((unsigned char)name[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+// qsort has no context argument; the planets being sorted are parked here.
+static const Planet *sortPlanets;
+
+static int compareFoldedNames(const void *a, const void *b) {
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    int order = strncasecmp(sortPlanets[ia].name, sortPlanets[ib].name, sizeof(sortPlanets[ia].name));
+    return order != 0 ? order : ia - ib;
+}
+
+int buildNameIndex(NameIndex *index, const Planet *planets, int count) {
+    uint32_t capacity = 16;
+    // Keep the load factor at or below one half.
+    while (capacity < 2 * (uint32_t)count)
+        capacity *= 2;
+    index->planets = planets;
+    index->count = count;
+    index->mask = capacity - 1;
+    index->hashes = calloc(capacity, sizeof(uint32_t));
+    index->slots = malloc(capacity * sizeof(int));
+    index->sortedIds = malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    if (index->hashes == NULL || index->slots == NULL || index->sortedIds == NULL) {
+        freeNameIndex(index);
+        return -1;
+    }
+
+    // Insert in id order so the first match along a probe sequence is the lowest id.
+    for (int id = 0; id < count; id++) {
+        uint32_t hash = hashFolded(planets[id].name, sizeof(planets[id].name));
+        uint32_t slot = hash & index->mask;
+        while (index->hashes[slot] != 0)
+            slot = (slot + 1) & index->mask;
+        index->hashes[slot] = hash;
+        index->slots[slot] = id;
+        index->sortedIds[id] = id;
+    }
+
+    sortPlanets = planets;
+    qsort(index->sortedIds, (size_t)count, sizeof(int), compareFoldedNames);
+    sortPlanets = NULL;
+    return 0;
+}
+
+void freeNameIndex(NameIndex *index) {
+    free(index->hashes);
+    free(index->slots);
+    free(index->sortedIds);
+    index->hashes = NULL;
+    index->slots = NULL;
+    index->sortedIds = NULL;
+    index->count = 0;
+}
+
+static int probe(const NameIndex *index, const char *name, int ignoreCase) {
+    if (index->hashes == NULL)
+        return -1;
+    size_t length = sizeof(index->planets[0].name);
+    uint32_t hash = hashFolded(name, length);
+    for (uint32_t slot = hash & index->mask; index->hashes[slot] != 0; slot = (slot + 1) & index->mask) {
+        if (index->hashes[slot] != hash)
+            continue;
+        const char *candidate = index->planets[index->slots[slot]].name;
+        int order = ignoreCase ? strncasecmp(candidate, name, length) : strncmp(candidate, name, length);
+        if (order == 0)
+            return index->slots[slot];
+    }
+    return -1;
+}
+
+int findName(const NameIndex *index, const char *name) {
+    return probe(index, name, 0);
+}
+
+int findNameIgnoreCase(const NameIndex *index, const char *name) {
+    return probe(index, name, 1);
+}
+
+int findNamesByPrefix(const NameIndex *index, const char *prefix, int *ids, int maxIds) {
+    if (index->sortedIds == NULL)
+        return 0;
+    size_t length = strlen(prefix);
+    int lo = 0, hi = index->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strncasecmp(index->planets[index->sortedIds[mid]].name, prefix, length) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int found = 0;
+    for (int i = lo; i < index->count && found < maxIds; i++) {
+        int id = index->sortedIds[i];
+        if (strncasecmp(index->planets[id].name, prefix, length) != 0)
+            break;
+        ids[found++] = id;
+    }
+    return found;
+}
@@ -0,0 +1,33 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include "planet.h"
+#include <stdint.h>
+
+// Open-addressing hash table over destination names.
+// Hashes are computed on the case-folded name so one table serves exact and
+// case-insensitive lookups; a sorted id list serves prefix lookups.
+typedef struct {
+    const Planet *planets;
+    int count;
+    uint32_t mask;        // capacity - 1, capacity is a power of two
+    uint32_t *hashes;     // folded hash per slot, 0 marks an empty slot
+    int *slots;           // planet id per slot
+    int *sortedIds;       // ids ordered by case-folded name
+} NameIndex;
+
+// Builds the index over count planets. Returns 0 on success, -1 on allocation failure.
+int buildNameIndex(NameIndex *index, const Planet *planets, int count);
+void freeNameIndex(NameIndex *index);
+
+// Returns the lowest id whose name matches exactly, or -1.
+int findName(const NameIndex *index, const char *name);
+
+// Returns the lowest id whose name matches ignoring ASCII case, or -1.
+int findNameIgnoreCase(const NameIndex *index, const char *name);
+
+// Stores up to maxIds ids whose names start with prefix (ignoring case),
+// in case-folded name order. Returns the number of ids stored.
+int findNamesByPrefix(const NameIndex *index, const char *prefix, int *ids, int maxIds);
+
+#endif
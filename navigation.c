@@ -1,5 +1,9 @@
 #include "navigation.h"
 #include "planet.h"
+#include "destinations.h"
+#include "integrator.h"
+#include "lambert.h"
+#include "stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -7,6 +11,18 @@
 
 #define THRESHOLD 0.1  // in AU
 #define PI 3.141592653589793
+#define SUN_RADIUS 0.00465    // in AU
+#define TRAVEL_SWEEP_LEG 8.0  // in days; N-body travel is swept as straight chords this long
+
+static TravelModel travelModel = TRAVEL_DIRECT;
+
+void setTravelModel(TravelModel model) {
+    travelModel = model;
+}
+
+static Vector3D propagateTravel(const ShipState *state, Vector3D target, double travelDuration,
+                                SweptEncounter *passes, int capacity, int *passCount);
+static void printPasses(const SweptEncounter *passes, int count, double arrivalTime);
 
 // Prints ship status info with custom formatting.
 void printInfo(ShipState *state) {
@@ -19,8 +35,9 @@ void printInfo(ShipState *state) {
            state->shipPosition.x, state->shipPosition.y, state->shipPosition.z);
     printf("\n-L- Destination data: \n");
     printf("  Distance from the Sun: %.4f AU\n", distanceFromSun);
-    printf("  Name: %s\n", state->currentDestination.name);
-    printf("  Description: %s\n", state->currentDestination.description);
+    const char *description = getDestinationDescription(state->currentDestination.id);
+    printf("  Name: %s\n", getDestinationName(state->currentDestination.id));
+    printf("  Description: %s\n", description != NULL ? description : "Not available");
     printf("\n<-> Oxygen levels: Not available\n");
     printf("@^@ Fuel levels: Not available\n");
     printf("-+- Food levels: Unknown\n");
@@ -28,29 +45,37 @@ void printInfo(ShipState *state) {
 
 // Prints the orbital formulae.
 void printFormulae(void) {
-    printf("\nANGLE = 2 * PI * (time / planet.orbitalPeriod)\n");
-    printf("X = planet.orbitRadius * cos(ANGLE)\n");
-    printf("Y = planet.orbitRadius * sin(ANGLE)\n");
-    printf("Z = 0.0 (2D approximation: movement in the ecliptic plane only)\n");
+    printf("\nM = 2 * PI * (time / planet.orbitalPeriod) + planet.meanAnomalyAtEpoch\n");
+    printf("E - e * sin(E) = M (Kepler's equation, solved by Newton iteration)\n");
+    printf("POSITION = a * (cos(E) - e) * P + a * sqrt(1 - e^2) * sin(E) * Q\n");
+    printf("P, Q = in-plane unit vectors to periapsis and 90 degrees ahead, rotated by\n");
+    printf("       the argument of periapsis, inclination and ascending node\n");
+    printf("Circular orbits (e = 0, no inclination) reduce to X = a * cos(M), Y = a * sin(M), Z = 0\n");
 }
 
 // Computes Hohmann transfer time (in days) between two orbits.
 // Returns 0 if radii are nearly identical.
 double computeHohmannTransferTime(double r1, double r2) {
-    if (fabs(r1 - r2) < 1e-6)
-        return 0.0;
-    double a_transfer = (r1 + r2) / 2.0;
-    double period_transfer = 365.25 * pow(a_transfer, 1.5);
-    return period_transfer / 2.0;
+    STATS_BEGIN(STATS_HOHMANN_TRANSFER);
+    double transferTime = 0.0;
+    if (fabs(r1 - r2) >= 1e-6) {
+        double a_transfer = (r1 + r2) / 2.0;
+        double period_transfer = 365.25 * pow(a_transfer, 1.5);
+        transferTime = period_transfer / 2.0;
+    }
+    STATS_END(STATS_HOHMANN_TRANSFER);
+    return transferTime;
 }
 
 // Computes phasing time for same-orbit transfers based on angular difference.
 double computePhasingTime(Vector3D current, Vector3D target, double orbitalPeriod) {
+    STATS_BEGIN(STATS_PHASING_TIME);
     double angleCurrent = atan2(current.y, current.x);
     double angleTarget  = atan2(target.y, target.x);
     double dtheta = fabs(angleTarget - angleCurrent);
     if (dtheta > PI)
         dtheta = 2 * PI - dtheta;
+    STATS_END(STATS_PHASING_TIME);
     return (dtheta / (2 * PI)) * orbitalPeriod;
 }
 
@@ -92,9 +117,13 @@ void travelSystemExecute(ShipState *state) {
   scanf("%lf", &travelDuration);
   
   // Update the ship's state.
-  state->shipPosition = playerCalculated;
-  state->currentTime += travelDuration;  // Add travel duration to current time.
-  updateCurrentDestination(state, state->currentTime);
+  SweptEncounter passes[TRAVEL_MAX_PASSES];
+  int passCount = executeTravel(state, playerCalculated, travelDuration, passes, TRAVEL_MAX_PASSES);
+  if (travelModel == TRAVEL_NBODY)
+      printf("Gravity carried the ship %.6f AU from the calculated position.\n",
+             calculateDistance(state->shipPosition, playerCalculated));
+  printPasses(passes, passCount, state->currentTime);
+  printf("You have arrived at %s.\n", getDestinationName(state->currentDestination.id));
 }
 
 
@@ -102,43 +131,144 @@ void travelSystemExecute(ShipState *state) {
 #include "destinations.h" // Include your destinations module
 
 void determineDestination(Vector3D pos, double time, ShipState *state) {
-    // Loop over all known destinations.
-    Planet *destinationFound = NULL;
-    for (int i = 0; i < knownDestinationsCount; i++) {
-        Vector3D destPos = getPlanetPosition(knownDestinations[i], time);
-        double d = calculateDistance(pos, destPos);
-        if (d < THRESHOLD) {
-            destinationFound = &knownDestinations[i];
-            break;
-        }
-    }
+    STATS_BEGIN(STATS_DETERMINE_DESTINATION);
+    // Resolve the nearest known destination within THRESHOLD through the spatial index.
+    const DestinationIndex *index = getKnownDestinationsIndex(time);
+    int id = index != NULL ? findNearestDestination(index, pos, time, THRESHOLD, NULL) : -1;
+    state->currentDestination.id = id >= 0 ? id : DESTINATION_NONE;
+    state->currentDestination.position = id >= 0 ? getDestinationPosition(id, time) : pos;
+    state->currentDestination.arrivalTime = time;
+    STATS_END(STATS_DETERMINE_DESTINATION);
+}
 
-    if (destinationFound != NULL) {
-         strcpy(state->currentDestination.name, destinationFound->name);
-         // For description, you might hard-code some or call a helper function.
-         if (strcmp(destinationFound->name, "Earth") == 0) {
-             strcpy(state->currentDestination.description, "Earth: our vibrant blue home planet.");
-         } else if (strcmp(destinationFound->name, "Mars") == 0) {
-             strcpy(state->currentDestination.description, "Mars: the Red Planet, a potential destination for exploration.");
-         } else if (strcmp(destinationFound->name, "Saturn") == 0) {
-             strcpy(state->currentDestination.description, "Saturn: adorned with magnificent rings.");
-         } else {
-             strcpy(state->currentDestination.description, "A known celestial destination.");
-         }
-         state->currentDestination.position = getPlanetPosition(*destinationFound, time);
-         state->currentDestination.arrivalTime = time;
-    } else {
-         strcpy(state->currentDestination.name, "Unknown");
-         strcpy(state->currentDestination.description, "You have arrived at an unknown celestial destination.");
-         state->currentDestination.position = pos;
-         state->currentDestination.arrivalTime = time;
+
+// Bulk form of determineDestination's lookup: ids[i] is the nearest known
+// destination within THRESHOLD of positions[i] at times[i], or -1, and
+// distances[i] its distance when distances is not NULL. The queries go
+// through the index as one batch (see findNearestDestinationBatch).
+void determineDestinationIds(const DestinationIndex *index, const Vector3D *positions,
+                             const double *times, int count, int *ids, double *distances) {
+    if (index != NULL) {
+        findNearestDestinationBatch(index, positions, times, count, THRESHOLD, ids, distances);
+        return;
     }
+    for (int i = 0; i < count; i++)
+        ids[i] = -1;
 }
 
+// Updates the current destination in the ShipState without console output.
+void resolveCurrentDestination(ShipState *state, double arrivalTime) {
+    state->currentTime = arrivalTime;
+    determineDestination(state->shipPosition, state->currentTime, state);
+}
 
 // Updates the current destination in the ShipState.
 void updateCurrentDestination(ShipState *state, double arrivalTime) {
-    state->currentTime = arrivalTime;
-    determineDestination(state->shipPosition, state->currentTime, state);
-    printf("You have arrived at %s.\n", state->currentDestination.name);
+    resolveCurrentDestination(state, arrivalTime);
+    printf("You have arrived at %s.\n", getDestinationName(state->currentDestination.id));
+}
+
+// Prints the close passes before arrival; the arrival itself is announced separately.
+static void printPasses(const SweptEncounter *passes, int count, double arrivalTime) {
+    int stored = count < TRAVEL_MAX_PASSES ? count : TRAVEL_MAX_PASSES;
+    for (int i = 0; i < stored && passes[i].time < arrivalTime; i++) {
+        if (passes[i].id == SWEPT_SUN && passes[i].distance < SUN_RADIUS)
+            printf("Day %.2f: the ship plunged through the Sun.\n", passes[i].time);
+        else
+            printf("Day %.2f: passed %.4f AU from %s.\n", passes[i].time, passes[i].distance,
+                   passes[i].id == SWEPT_SUN ? "the Sun" : knownDestinations[passes[i].id].name);
+    }
+    if (count > stored)
+        printf("... and %d more close passes.\n", count - stored);
+}
+
+// Adds the close passes of a straight transit to the count already in passes.
+// A pass the previous transit recorded at its end, fromTime, that continues
+// into this one is merged with it, keeping the closer of the two.
+static int sweepTransit(Vector3D from, double fromTime, Vector3D to, double toTime,
+                        SweptEncounter *passes, int capacity, int count) {
+    const DestinationIndex *index = getKnownDestinationsIndex(toTime);
+    if (index == NULL)
+        return count;
+    SweptEncounter found[TRAVEL_MAX_PASSES];
+    STATS_BEGIN(STATS_SWEEP_TRANSIT);
+    int foundCount = findSweptEncounters(index, from, fromTime, to, toTime, THRESHOLD, TRAVEL_MAX_PASSES, found);
+    STATS_END(STATS_SWEEP_TRANSIT);
+    for (int i = 0; i < foundCount; i++) {
+        if (i >= TRAVEL_MAX_PASSES) {
+            count++;
+            continue;
+        }
+        int merged = 0;
+        int stored = count < capacity ? count : capacity;
+        for (int j = stored - 1; j >= 0 && passes[j].time == fromTime && !merged; j--) {
+            if (passes[j].id == found[i].id) {
+                if (found[i].distance < passes[j].distance)
+                    passes[j] = found[i];
+                merged = 1;
+            }
+        }
+        if (!merged) {
+            if (count < capacity)
+                passes[count] = found[i];
+            count++;
+        }
+    }
+    return count;
+}
+
+int countClosePasses(const DestinationIndex *index, Vector3D from, double fromTime, Vector3D to, double toTime) {
+    return index != NULL ? findSweptEncounters(index, from, fromTime, to, toTime, THRESHOLD, 0, NULL) : 0;
+}
+
+// N-body travel: leaves the ship's position on the Sun-only Lambert arc to
+// target (or a straight line when there is none) and propagates it through the
+// known destinations' gravity, sweeping each TRAVEL_SWEEP_LEG-day chord of the
+// path for close passes. Returns where the ship is after travelDuration, or
+// target if it could not be propagated.
+static Vector3D propagateTravel(const ShipState *state, Vector3D target, double travelDuration,
+                                SweptEncounter *passes, int capacity, int *passCount) {
+    GravityField *field = getKnownDestinationsGravity();
+    double departureTime = state->currentTime, arrivalTime = departureTime + travelDuration;
+    *passCount = 0;
+    if (field == NULL || !(travelDuration > 0.0)) {
+        *passCount = sweepTransit(state->shipPosition, departureTime, target, arrivalTime, passes, capacity, 0);
+        return target;
+    }
+    Vector3D position = state->shipPosition, velocity, arrivalVelocity;
+    if (solveLambert(position, target, travelDuration, SUN_GM, &velocity, &arrivalVelocity) != 0) {
+        velocity.x = (target.x - position.x) / travelDuration;
+        velocity.y = (target.y - position.y) / travelDuration;
+        velocity.z = (target.z - position.z) / travelDuration;
+    }
+    int legs = (int)ceil(travelDuration / TRAVEL_SWEEP_LEG);
+    for (int leg = 0; leg < legs; leg++) {
+        double legStart = departureTime + leg * TRAVEL_SWEEP_LEG;
+        double legEnd = leg == legs - 1 ? arrivalTime : legStart + TRAVEL_SWEEP_LEG;
+        Vector3D legFrom = position;
+        if (propagateShips(field, &position, &velocity, 1, legStart, legEnd, NULL, NULL) != 0) {
+            *passCount = sweepTransit(legFrom, legStart, target, arrivalTime, passes, capacity, *passCount);
+            return target;
+        }
+        *passCount = sweepTransit(legFrom, legStart, position, legEnd, passes, capacity, *passCount);
+    }
+    return position;
+}
+
+// Applies a travel command: move to position (or wherever gravity takes the
+// ship on its way there), advance the clock by travelDuration and resolve the
+// arrival, without console output.
+int executeTravel(ShipState *state, Vector3D position, double travelDuration,
+                  SweptEncounter *passes, int capacity) {
+    int passCount;
+    if (travelModel == TRAVEL_NBODY) {
+        state->shipPosition = propagateTravel(state, position, travelDuration, passes, capacity, &passCount);
+    } else {
+        // The ship flies straight to the commanded position.
+        passCount = sweepTransit(state->shipPosition, state->currentTime, position,
+                                 state->currentTime + travelDuration, passes, capacity, 0);
+        state->shipPosition = position;
+    }
+    resolveCurrentDestination(state, state->currentTime + travelDuration);
+    return passCount;
 }
@@ -2,20 +2,32 @@
 #define NAVIGATION_H
 
 #include "planet.h"
+#include "spatialindex.h"
 
-// ShipState structure encapsulates the ship's state.
+// ShipState structure encapsulates the ship's state. The destination is kept
+// as an id into knownDestinations (or DESTINATION_NONE); its name and
+// description are looked up only when printed.
 typedef struct {
     double currentTime;
     Vector3D shipPosition;
     struct {
-        char name[64];
-        char description[256];
+        int id;
         Vector3D position;
         double arrivalTime;
     } currentDestination;
 } ShipState;
 
+// How travel moves the ship: straight to the commanded position, or through
+// the gravity of the Sun and the known destinations (see integrator.h).
+typedef enum {
+    TRAVEL_DIRECT,
+    TRAVEL_NBODY
+} TravelModel;
+
+#define TRAVEL_MAX_PASSES 16  // close passes kept per travel command
+
 // Function prototypes for navigation functions.
+void setTravelModel(TravelModel model);
 void printInfo(ShipState *state);
 void printFormulae(void);
 double computeHohmannTransferTime(double r1, double r2);
@@ -24,5 +36,16 @@ void hohmannTransferTime(ShipState *state);
 void travelSystemExecute(ShipState *state);
 void determineDestination(Vector3D pos, double time, ShipState *state);
 void updateCurrentDestination(ShipState *state, double arrivalTime);
+void resolveCurrentDestination(ShipState *state, double arrivalTime);
+// Applies a travel command without console output. Fills passes with up to
+// capacity of the bodies (and the Sun) the ship came within the arrival
+// threshold of on its way, earliest first, the destination reached on arrival
+// included, and returns how many there were.
+int executeTravel(ShipState *state, Vector3D position, double travelDuration,
+                  SweptEncounter *passes, int capacity);
+void determineDestinationIds(const DestinationIndex *index, const Vector3D *positions,
+                             const double *times, int count, int *ids, double *distances);
+// Number of close passes of a ship moving in a straight line from `from` to `to`.
+int countClosePasses(const DestinationIndex *index, Vector3D from, double fromTime, Vector3D to, double toTime);
 
 #endif
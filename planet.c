@@ -1,16 +1,141 @@
 #include "planet.h"
+#include "stats.h"
 #include <math.h>
 #define PI 3.141592653589793
 
+#define DEGREES (PI / 180.0)
+
+void getPlanetOrbitFrame(Planet planet, Vector3D *p, Vector3D *q) {
+    double cosNode = cos(planet.ascendingNode * DEGREES), sinNode = sin(planet.ascendingNode * DEGREES);
+    double cosArg = cos(planet.argumentOfPeriapsis * DEGREES), sinArg = sin(planet.argumentOfPeriapsis * DEGREES);
+    double cosInc = cos(planet.inclination * DEGREES), sinInc = sin(planet.inclination * DEGREES);
+    p->x = cosNode * cosArg - sinNode * sinArg * cosInc;
+    p->y = sinNode * cosArg + cosNode * sinArg * cosInc;
+    p->z = sinArg * sinInc;
+    q->x = -cosNode * sinArg - sinNode * cosArg * cosInc;
+    q->y = -sinNode * sinArg + cosNode * cosArg * cosInc;
+    q->z = cosArg * sinInc;
+}
+
+double solveKeplerEquation(double meanAnomaly, double eccentricity) {
+    double e = eccentricity;
+    if (e == 0.0)
+        return meanAnomaly;
+    double E = meanAnomaly + e * sin(meanAnomaly) * (1.0 + e * cos(meanAnomaly));
+    for (int i = 0; i < KEPLER_MAX_ITERATIONS; i++) {
+        double step = (E - e * sin(E) - meanAnomaly) / (1.0 - e * cos(E));
+        E -= step;
+        if (fabs(step) < KEPLER_TOLERANCE * 2 * PI)
+            break;
+    }
+    return E;
+}
+
+// Mean anomaly at time, reduced to [-PI, PI] so the Newton solve stays well conditioned.
+static double meanAnomalyAt(Planet planet, double time) {
+    double turns = time / planet.orbitalPeriod + planet.meanAnomalyAtEpoch / 360.0;
+    return 2 * PI * (turns - nearbyint(turns));
+}
+
+// A circular orbit in the ecliptic needs neither the orbit frame nor Kepler's
+// equation: the body sits at its mean longitude, node + periapsis + mean
+// anomaly, reduced to [-PI, PI] like the mean anomaly.
+static int isCircularEcliptic(Planet planet) {
+    return planet.eccentricity == 0.0 && planet.inclination == 0.0;
+}
+
+static double meanLongitudeAt(Planet planet, double time) {
+    double turns = time / planet.orbitalPeriod +
+                   (planet.meanAnomalyAtEpoch + planet.ascendingNode + planet.argumentOfPeriapsis) / 360.0;
+    return 2 * PI * (turns - nearbyint(turns));
+}
+
 Vector3D getPlanetPosition(Planet planet, double time) {
-    double angle = 2 * PI * (time / planet.orbitalPeriod);
+    STATS_BEGIN(STATS_PLANET_POSITION);
     Vector3D pos;
-    pos.x = planet.orbitRadius * cos(angle);
-    pos.y = planet.orbitRadius * sin(angle);
-    pos.z = 0.0;
+    if (isCircularEcliptic(planet)) {
+        double longitude = meanLongitudeAt(planet, time);
+        pos.x = planet.orbitRadius * cos(longitude);
+        pos.y = planet.orbitRadius * sin(longitude);
+        pos.z = 0.0;
+        STATS_END(STATS_PLANET_POSITION);
+        return pos;
+    }
+    double e = planet.eccentricity;
+    double E = solveKeplerEquation(meanAnomalyAt(planet, time), e);
+    double along = planet.orbitRadius * (cos(E) - e);
+    double across = planet.orbitRadius * sqrt(1.0 - e * e) * sin(E);
+    Vector3D p, q;
+    getPlanetOrbitFrame(planet, &p, &q);
+    pos.x = along * p.x + across * q.x;
+    pos.y = along * p.y + across * q.y;
+    pos.z = along * p.z + across * q.z;
+    STATS_END(STATS_PLANET_POSITION);
     return pos;
 }
 
+Vector3D getPlanetVelocity(Planet planet, double time) {
+    Vector3D vel;
+    if (isCircularEcliptic(planet)) {
+        double longitude = meanLongitudeAt(planet, time);
+        double speed = 2 * PI * planet.orbitRadius / planet.orbitalPeriod;
+        vel.x = -speed * sin(longitude);
+        vel.y = speed * cos(longitude);
+        vel.z = 0.0;
+        return vel;
+    }
+    double e = planet.eccentricity;
+    double E = solveKeplerEquation(meanAnomalyAt(planet, time), e);
+    // dE/dt = n / (1 - e cos E)
+    double rate = 2 * PI / planet.orbitalPeriod / (1.0 - e * cos(E));
+    double along = -planet.orbitRadius * sin(E) * rate;
+    double across = planet.orbitRadius * sqrt(1.0 - e * e) * cos(E) * rate;
+    Vector3D p, q;
+    getPlanetOrbitFrame(planet, &p, &q);
+    vel.x = along * p.x + across * q.x;
+    vel.y = along * p.y + across * q.y;
+    vel.z = along * p.z + across * q.z;
+    return vel;
+}
+
 double calculateDistance(Vector3D a, Vector3D b) {
-    return sqrt(pow(b.x - a.x, 2) + pow(b.y - a.y, 2) + pow(b.z - a.z, 2));
+    return sqrt(calculateDistanceSquared(a, b));
+}
+
+double calculateDistanceSquared(Vector3D a, Vector3D b) {
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double dz = b.z - a.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+double segmentDistanceFromOrigin(Vector3D a, Vector3D b, double *fraction) {
+    Vector3D d = { b.x - a.x, b.y - a.y, b.z - a.z };
+    double length2 = d.x * d.x + d.y * d.y + d.z * d.z;
+    double f = length2 > 0.0 ? -(a.x * d.x + a.y * d.y + a.z * d.z) / length2 : 0.0;
+    f = f < 0.0 ? 0.0 : (f > 1.0 ? 1.0 : f);
+    *fraction = f;
+    Vector3D p = { a.x + f * d.x, a.y + f * d.y, a.z + f * d.z };
+    return sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+}
+
+void calculateDistancesSquared(Vector3D origin, const double *x, const double *y, const double *z,
+                               int count, double *out) {
+    for (int i = 0; i < count; i++) {
+        double dx = x[i] - origin.x;
+        double dy = y[i] - origin.y;
+        double dz = z[i] - origin.z;
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+void calculateDistancesSquaredF(Vector3D origin, const float *x, const float *y, const float *z,
+                                int count, float *out) {
+    float ox = (float)origin.x, oy = (float)origin.y, oz = (float)origin.z;
+    for (int i = 0; i < count; i++) {
+        float dx = x[i] - ox;
+        float dy = y[i] - oy;
+        float dz = z[i] - oz;
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
 }
@@ -7,13 +7,47 @@ typedef struct {
     double z;
 } Vector3D;
 
+// Keplerian orbit about the Sun. Elements left at zero give a circular orbit
+// in the ecliptic that starts on the +x axis at time 0.
 typedef struct {
     char name[32];
-    double orbitRadius;    // in AU
-    double orbitalPeriod;  // in days
+    double orbitRadius;          // semi-major axis, in AU
+    double orbitalPeriod;        // in days
+    double eccentricity;         // 0 <= e < 1
+    double inclination;          // in degrees
+    double ascendingNode;        // longitude of the ascending node, in degrees
+    double argumentOfPeriapsis;  // in degrees
+    double meanAnomalyAtEpoch;   // mean anomaly at time 0, in degrees
+    double mass;                 // in solar masses; 0 for bodies too small to attract ships
 } Planet;
 
+#define KEPLER_MAX_ITERATIONS 16
+#define KEPLER_TOLERANCE 1e-10   // Newton step at which the solve stops, in revolutions
+
 Vector3D getPlanetPosition(Planet planet, double time);
+// Velocity along the orbit at the given time (AU/day).
+Vector3D getPlanetVelocity(Planet planet, double time);
+
+// Unit vectors spanning the orbit plane: p points at periapsis, q is 90 degrees
+// ahead in the direction of motion.
+void getPlanetOrbitFrame(Planet planet, Vector3D *p, Vector3D *q);
+
+// Eccentric anomaly E (radians) solving E - e sin E = meanAnomaly, by Newton
+// iteration from a third-order series guess.
+double solveKeplerEquation(double meanAnomaly, double eccentricity);
+
 double calculateDistance(Vector3D a, Vector3D b);
+double calculateDistanceSquared(Vector3D a, Vector3D b);
+
+// Distance from the origin to the segment from a to b; *fraction receives the
+// position of the nearest point along it, from 0 at a to 1 at b.
+double segmentDistanceFromOrigin(Vector3D a, Vector3D b, double *fraction);
+
+// Batched squared distance from origin to count points stored as x/y/z columns.
+void calculateDistancesSquared(Vector3D origin, const double *x, const double *y, const double *z,
+                               int count, double *out);
+// Same in float, for positions from computeBodyPositionsF (see ephemeris.h).
+void calculateDistancesSquaredF(Vector3D origin, const float *x, const float *y, const float *z,
+                                int count, float *out);
 
 #endif
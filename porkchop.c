@@ -0,0 +1,88 @@
+#include "porkchop.h"
+#include "lambert.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    PorkchopPlot *plot;
+    Planet departure;
+    Planet arrival;
+} PorkchopJob;
+
+static double velocityDifference(Vector3D a, Vector3D b) {
+    return sqrt(calculateDistanceSquared(a, b)) * AU_PER_DAY_IN_KM_PER_S;
+}
+
+static void computeRows(void *context, int begin, int end, int worker) {
+    (void)worker;
+    PorkchopJob *job = context;
+    const PorkchopGrid *grid = &job->plot->grid;
+    for (int row = begin; row < end; row++) {
+        double departureTime = grid->departureStart + row * grid->departureStep;
+        Vector3D r1 = getPlanetPosition(job->departure, departureTime);
+        Vector3D planetV1 = getPlanetVelocity(job->departure, departureTime);
+        size_t offset = (size_t)row * grid->timeOfFlightCount;
+        for (int col = 0; col < grid->timeOfFlightCount; col++) {
+            double timeOfFlight = grid->timeOfFlightStart + col * grid->timeOfFlightStep;
+            double arrivalTime = departureTime + timeOfFlight;
+            Vector3D r2 = getPlanetPosition(job->arrival, arrivalTime);
+            Vector3D v1, v2;
+            if (solveLambert(r1, r2, timeOfFlight, SUN_GM, &v1, &v2) == 0) {
+                job->plot->departureDeltaV[offset + col] = velocityDifference(v1, planetV1);
+                job->plot->arrivalDeltaV[offset + col] =
+                    velocityDifference(v2, getPlanetVelocity(job->arrival, arrivalTime));
+            } else {
+                job->plot->departureDeltaV[offset + col] = NAN;
+                job->plot->arrivalDeltaV[offset + col] = NAN;
+            }
+        }
+    }
+}
+
+int computePorkchopPlot(PorkchopPlot *plot, Planet departure, Planet arrival,
+                        PorkchopGrid grid, ThreadPool *pool) {
+    size_t cells = (size_t)grid.departureCount * grid.timeOfFlightCount;
+    plot->grid = grid;
+    plot->departureDeltaV = malloc((cells > 0 ? cells : 1) * sizeof(double));
+    plot->arrivalDeltaV = malloc((cells > 0 ? cells : 1) * sizeof(double));
+    if (plot->departureDeltaV == NULL || plot->arrivalDeltaV == NULL) {
+        freePorkchopPlot(plot);
+        return -1;
+    }
+    PorkchopJob job = { plot, departure, arrival };
+    parallelFor(pool, grid.departureCount, 1, computeRows, &job);
+    return 0;
+}
+
+void freePorkchopPlot(PorkchopPlot *plot) {
+    free(plot->departureDeltaV);
+    free(plot->arrivalDeltaV);
+    plot->departureDeltaV = NULL;
+    plot->arrivalDeltaV = NULL;
+}
+
+int writePorkchopPlot(const PorkchopPlot *plot, const char *path) {
+    PorkchopFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PORKCHOP_MAGIC, sizeof(PORKCHOP_MAGIC));
+    header.version = PORKCHOP_VERSION;
+    header.departureCount = (uint64_t)plot->grid.departureCount;
+    header.timeOfFlightCount = (uint64_t)plot->grid.timeOfFlightCount;
+    header.departureStart = plot->grid.departureStart;
+    header.departureStep = plot->grid.departureStep;
+    header.timeOfFlightStart = plot->grid.timeOfFlightStart;
+    header.timeOfFlightStep = plot->grid.timeOfFlightStep;
+
+    size_t cells = (size_t)plot->grid.departureCount * plot->grid.timeOfFlightCount;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1 ||
+                 fwrite(plot->departureDeltaV, sizeof(double), cells, file) != cells ||
+                 fwrite(plot->arrivalDeltaV, sizeof(double), cells, file) != cells;
+    if (fclose(file) != 0)
+        failed = 1;
+    return failed ? -1 : 0;
+}
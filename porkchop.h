@@ -0,0 +1,51 @@
+#ifndef PORKCHOP_H
+#define PORKCHOP_H
+
+#include "planet.h"
+#include "threadpool.h"
+#include <stdint.h>
+
+#define PORKCHOP_MAGIC "SWPORK"   // 8 bytes including the terminator
+#define PORKCHOP_VERSION 1
+
+// Departure-date x time-of-flight grid. Row i departs at
+// departureStart + i * departureStep; column j flies for
+// timeOfFlightStart + j * timeOfFlightStep days.
+typedef struct {
+    double departureStart, departureStep;   // in days
+    double timeOfFlightStart, timeOfFlightStep;
+    int departureCount;
+    int timeOfFlightCount;
+} PorkchopGrid;
+
+// Results are row-major, departureCount x timeOfFlightCount, in km/s.
+// Cells without a Lambert solution hold NaN.
+typedef struct {
+    PorkchopGrid grid;
+    double *departureDeltaV;
+    double *arrivalDeltaV;
+} PorkchopPlot;
+
+// Header of the dense matrix file written by writePorkchopPlot. It is followed
+// by the departure and arrival delta-v matrices as float64, row-major.
+// A cell's transfer time is timeOfFlightStart + column * timeOfFlightStep.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t departureCount;
+    uint64_t timeOfFlightCount;
+    double departureStart, departureStep;
+    double timeOfFlightStart, timeOfFlightStep;
+} PorkchopFileHeader;
+
+// Evaluates every cell of grid for a transfer from departure to arrival,
+// splitting rows across pool (NULL runs single-threaded). Returns 0 on success, -1 on allocation failure.
+int computePorkchopPlot(PorkchopPlot *plot, Planet departure, Planet arrival,
+                        PorkchopGrid grid, ThreadPool *pool);
+void freePorkchopPlot(PorkchopPlot *plot);
+
+// Writes the plot as a dense matrix file. Returns 0 on success, -1 on error.
+int writePorkchopPlot(const PorkchopPlot *plot, const char *path);
+
+#endif
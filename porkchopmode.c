@@ -0,0 +1,70 @@
+#include "modes.h"
+#include "destinations.h"
+#include "porkchop.h"
+#include "threadpool.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Grid step for count samples spanning [first, last].
+static double gridStep(double first, double last, int count) {
+    return count > 1 ? (last - first) / (count - 1) : 0.0;
+}
+
+int runPorkchopMode(char **args, int threads) {
+    Planet *from = getDestinationByName(args[0]);
+    Planet *to = getDestinationByName(args[1]);
+    if (from == NULL || to == NULL) {
+        printf("Error: unknown destination %s\n", from == NULL ? args[0] : args[1]);
+        return 1;
+    }
+    PorkchopGrid grid;
+    grid.departureStart = atof(args[2]);
+    grid.departureCount = atoi(args[4]);
+    grid.departureStep = gridStep(grid.departureStart, atof(args[3]), grid.departureCount);
+    grid.timeOfFlightStart = atof(args[5]);
+    grid.timeOfFlightCount = atoi(args[7]);
+    grid.timeOfFlightStep = gridStep(grid.timeOfFlightStart, atof(args[6]), grid.timeOfFlightCount);
+    if (grid.departureCount <= 0 || grid.timeOfFlightCount <= 0 || grid.timeOfFlightStart <= 0.0) {
+        printf("Error: invalid porkchop grid\n");
+        return 1;
+    }
+
+    ThreadPool *pool = createThreadPool(threads);
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    PorkchopPlot plot;
+    int failed = computePorkchopPlot(&plot, *from, *to, grid, pool);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    int workers = threadPoolSize(pool);
+    destroyThreadPool(pool);
+    if (failed || writePorkchopPlot(&plot, args[8]) != 0) {
+        printf("Error: could not produce porkchop plot %s\n", args[8]);
+        if (!failed)
+            freePorkchopPlot(&plot);
+        return 1;
+    }
+
+    // Report the cheapest cell.
+    size_t cells = (size_t)grid.departureCount * grid.timeOfFlightCount;
+    size_t best = cells;
+    for (size_t i = 0; i < cells; i++) {
+        double total = plot.departureDeltaV[i] + plot.arrivalDeltaV[i];
+        if (!isnan(total) && (best == cells || total < plot.departureDeltaV[best] + plot.arrivalDeltaV[best]))
+            best = i;
+    }
+    double seconds = elapsedSeconds(start, stop);
+    printf("%s -> %s: %zu cells in %.3f s on %d threads, written to %s\n",
+           from->name, to->name, cells, seconds, workers, args[8]);
+    if (best < cells) {
+        int row = (int)(best / grid.timeOfFlightCount), col = (int)(best % grid.timeOfFlightCount);
+        printf("Minimum delta-v: %.3f km/s (depart %.2f km/s, arrive %.2f km/s), "
+               "departure day %.2f, transfer time %.2f days\n",
+               plot.departureDeltaV[best] + plot.arrivalDeltaV[best],
+               plot.departureDeltaV[best], plot.arrivalDeltaV[best],
+               grid.departureStart + row * grid.departureStep,
+               grid.timeOfFlightStart + col * grid.timeOfFlightStep);
+    }
+    freePorkchopPlot(&plot);
+    return 0;
+}
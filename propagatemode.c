@@ -0,0 +1,70 @@
+#include "modes.h"
+#include "destinations.h"
+#include "integrator.h"
+#include "lambert.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int runPropagateMode(char **args, int threads) {
+    int ships = atoi(args[0]);
+    double days = atof(args[1]);
+    Planet *earth = getDestinationByName("Earth");
+    GravityField *field = getKnownDestinationsGravity();
+    if (ships <= 0 || !(days > 0.0) || earth == NULL || field == NULL) {
+        printf("Error: invalid propagation\n");
+        return 1;
+    }
+    Vector3D *positions = malloc((size_t)ships * sizeof(Vector3D));
+    Vector3D *velocities = malloc((size_t)ships * sizeof(Vector3D));
+    Vector3D *targets = malloc((size_t)ships * sizeof(Vector3D));
+    if (positions == NULL || velocities == NULL || targets == NULL) {
+        printf("Error: not enough memory for %d ships\n", ships);
+        free(positions);
+        free(velocities);
+        free(targets);
+        return 1;
+    }
+    double startTime = 100.0;
+    Vector3D home = getPlanetPosition(*earth, startTime);
+    unsigned long long seed = LAUNCH_SEED;
+    for (int i = 0; i < ships; i++) {
+        int target = (int)(nextLaunchRandom(&seed) % (unsigned long long)knownDestinationsCount);
+        Vector3D arrivalVelocity;
+        positions[i] = home;
+        targets[i] = getDestinationPosition(target, startTime + days);
+        if (solveLambert(home, targets[i], days, SUN_GM, &velocities[i], &arrivalVelocity) != 0) {
+            velocities[i].x = (targets[i].x - home.x) / days;
+            velocities[i].y = (targets[i].y - home.y) / days;
+            velocities[i].z = (targets[i].z - home.z) / days;
+        }
+    }
+
+    ThreadPool *pool = createThreadPool(threads);
+    PropagationStats stats;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = propagateShips(field, positions, velocities, ships, startTime, startTime + days, pool, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    if (failed) {
+        printf("Error: not enough memory to propagate %d ships\n", ships);
+    } else {
+        double totalMiss = 0.0, worstMiss = 0.0;
+        for (int i = 0; i < ships; i++) {
+            double miss = calculateDistance(positions[i], targets[i]);
+            totalMiss += miss;
+            worstMiss = miss > worstMiss ? miss : worstMiss;
+        }
+        printf("%d ships, %.2f days through %d attracting bodies on %d threads: %.3f s\n",
+               ships, days, field->count, threadPoolSize(pool), elapsedSeconds(start, stop));
+        printf("%lld ship steps, %lld body placements (smallest step %.3g days)%s\n",
+               stats.steps, stats.substeps, stats.smallestStep,
+               stats.usedTree ? ", Barnes-Hut tree" : "");
+        printf("Deflection from the Sun-only arc: %.6f AU average, %.6f AU worst\n", totalMiss / ships, worstMiss);
+    }
+    destroyThreadPool(pool);
+    free(positions);
+    free(velocities);
+    free(targets);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,403 @@
+#include "routeplanner.h"
+#include "navigation.h"
+#include "lambert.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.141592653589793
+#define ROUTE_CACHE_INITIAL 1024
+#define ROUTE_CACHE_MAX (1u << 22)  // entries kept before the cache is flushed
+
+typedef struct {
+    double radius;
+    int body;
+} RadiusEntry;
+
+static int compareRadiusEntry(const void *a, const void *b) {
+    const RadiusEntry *ea = a, *eb = b;
+    if (ea->radius != eb->radius)
+        return ea->radius < eb->radius ? -1 : 1;
+    return ea->body - eb->body;
+}
+
+int createRoutePlanner(RoutePlanner *planner, const Planet *bodies, int count, double bucketDays) {
+    memset(planner, 0, sizeof(*planner));
+    planner->bodies = bodies;
+    planner->count = count;
+    planner->bucketDays = bucketDays > 0.0 ? bucketDays : 1.0;
+    size_t n = (size_t)(count > 0 ? count : 1);
+    planner->cache = malloc(ROUTE_CACHE_INITIAL * sizeof(TransferCacheEntry));
+    planner->primary = malloc(n * sizeof(double));
+    planner->secondary = malloc(n * sizeof(double));
+    planner->previous = malloc(n * sizeof(int));
+    planner->legDeparture = malloc(n * sizeof(double));
+    planner->heap = malloc(n * sizeof(int));
+    planner->heapPosition = malloc(n * sizeof(int));
+    planner->byRadius = malloc(n * sizeof(int));
+    planner->radiusRank = malloc(n * sizeof(int));
+    RadiusEntry *order = malloc(n * sizeof(RadiusEntry));
+    if (planner->cache == NULL || planner->primary == NULL || planner->secondary == NULL ||
+        planner->previous == NULL || planner->legDeparture == NULL || planner->heap == NULL ||
+        planner->heapPosition == NULL || planner->byRadius == NULL || planner->radiusRank == NULL ||
+        order == NULL) {
+        free(order);
+        freeRoutePlanner(planner);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        order[i].radius = bodies[i].orbitRadius;
+        order[i].body = i;
+    }
+    qsort(order, (size_t)count, sizeof(RadiusEntry), compareRadiusEntry);
+    for (int r = 0; r < count; r++) {
+        planner->byRadius[r] = order[r].body;
+        planner->radiusRank[order[r].body] = r;
+    }
+    free(order);
+    planner->cacheMask = ROUTE_CACHE_INITIAL - 1;
+    for (uint32_t i = 0; i <= planner->cacheMask; i++)
+        planner->cache[i].from = -1;
+    return 0;
+}
+
+void freeRoutePlanner(RoutePlanner *planner) {
+    free(planner->cache);
+    free(planner->primary);
+    free(planner->secondary);
+    free(planner->previous);
+    free(planner->legDeparture);
+    free(planner->heap);
+    free(planner->heapPosition);
+    free(planner->byRadius);
+    free(planner->radiusRank);
+    memset(planner, 0, sizeof(*planner));
+}
+
+static double circularSpeed(double radius) {
+    return sqrt(SUN_GM / radius);
+}
+
+// Delta-v of a Hohmann transfer between circular orbits of radii r1 and r2, in km/s.
+static double hohmannDeltaV(double r1, double r2) {
+    double transferAxis = (r1 + r2) / 2.0;
+    double burn1 = fabs(sqrt(SUN_GM * (2.0 / r1 - 1.0 / transferAxis)) - circularSpeed(r1));
+    double burn2 = fabs(circularSpeed(r2) - sqrt(SUN_GM * (2.0 / r2 - 1.0 / transferAxis)));
+    return (burn1 + burn2) * AU_PER_DAY_IN_KM_PER_S;
+}
+
+// Whether a body's orbit is one computeTransfer models: circular and in the ecliptic.
+static int isRoutableBody(const Planet *body) {
+    return body->eccentricity == 0.0 && body->inclination == 0.0;
+}
+
+// Fills entry with the first transfer window from 'from' to 'to' at or after
+// time. Transfers are Hohmann transfers between circular orbits in the
+// ecliptic; a hop from or to any other orbit, or between two bodies on the
+// same orbit, has no transfer and gets an infinite flight time and delta-v.
+static void computeTransfer(const RoutePlanner *planner, int from, int to, double time,
+                            TransferCacheEntry *entry) {
+    Planet a = planner->bodies[from];
+    Planet b = planner->bodies[to];
+    entry->departureTime = time;
+    entry->windowPeriod = 0.0;
+    if (!isRoutableBody(&a) || !isRoutableBody(&b) || fabs(a.orbitRadius - b.orbitRadius) < 1e-6) {
+        entry->flightTime = INFINITY;
+        entry->deltaV = INFINITY;
+        return;
+    }
+    Vector3D posA = getPlanetPosition(a, time);
+    Vector3D posB = getPlanetPosition(b, time);
+
+    double flightTime = computeHohmannTransferTime(a.orbitRadius, b.orbitRadius);
+    entry->flightTime = flightTime;
+    entry->deltaV = hohmannDeltaV(a.orbitRadius, b.orbitRadius);
+
+    // The target must lead by half a turn minus its own motion during the flight.
+    // Angles are in revolutions; the lead changes at the relative mean motion.
+    double requiredLead = 0.5 - flightTime / b.orbitalPeriod;
+    double lead = (atan2(posB.y, posB.x) - atan2(posA.y, posA.x)) / (2 * PI);
+    double relativeMotion = 1.0 / b.orbitalPeriod - 1.0 / a.orbitalPeriod;
+    if (relativeMotion == 0.0)
+        return;
+    double turns = (requiredLead - lead) * (relativeMotion > 0.0 ? 1.0 : -1.0);
+    turns -= floor(turns);
+    entry->windowPeriod = 1.0 / fabs(relativeMotion);
+    entry->departureTime = time + turns * entry->windowPeriod;
+}
+
+static uint32_t hashTransferKey(int from, int to, int64_t bucket) {
+    uint64_t key = ((uint64_t)(uint32_t)from * 0x9E3779B97F4A7C15ull) ^
+                   ((uint64_t)(uint32_t)to * 0xC2B2AE3D27D4EB4Full) ^
+                   ((uint64_t)bucket * 0x165667B19E3779F9ull);
+    key ^= key >> 29;
+    return (uint32_t)(key ^ (key >> 32));
+}
+
+static TransferCacheEntry *findSlot(TransferCacheEntry *cache, uint32_t mask, int from, int to, int64_t bucket) {
+    uint32_t slot = hashTransferKey(from, to, bucket) & mask;
+    while (cache[slot].from != -1 &&
+           (cache[slot].from != from || cache[slot].to != to || cache[slot].bucket != bucket))
+        slot = (slot + 1) & mask;
+    return &cache[slot];
+}
+
+// Doubles the cache, or flushes it once it reaches ROUTE_CACHE_MAX entries.
+static void growCache(RoutePlanner *planner) {
+    uint32_t capacity = planner->cacheMask + 1;
+    if (capacity >= ROUTE_CACHE_MAX) {
+        for (uint32_t i = 0; i < capacity; i++)
+            planner->cache[i].from = -1;
+        planner->cacheSize = 0;
+        return;
+    }
+    TransferCacheEntry *grown = malloc(2 * (size_t)capacity * sizeof(TransferCacheEntry));
+    if (grown == NULL) {
+        for (uint32_t i = 0; i < capacity; i++)
+            planner->cache[i].from = -1;
+        planner->cacheSize = 0;
+        return;
+    }
+    uint32_t mask = 2 * capacity - 1;
+    for (uint32_t i = 0; i <= mask; i++)
+        grown[i].from = -1;
+    for (uint32_t i = 0; i < capacity; i++) {
+        TransferCacheEntry *entry = &planner->cache[i];
+        if (entry->from != -1)
+            *findSlot(grown, mask, entry->from, entry->to, entry->bucket) = *entry;
+    }
+    free(planner->cache);
+    planner->cache = grown;
+    planner->cacheMask = mask;
+}
+
+// Returns the departure time and fills the leg cost for a hop leaving at or after time.
+static double lookupTransfer(RoutePlanner *planner, int from, int to, double time,
+                             double *flightTime, double *deltaV) {
+    int64_t bucket = (int64_t)floor(time / planner->bucketDays);
+    TransferCacheEntry *entry = findSlot(planner->cache, planner->cacheMask, from, to, bucket);
+    if (entry->from == -1) {
+        planner->cacheMisses++;
+        if (2 * (planner->cacheSize + 1) > planner->cacheMask + 1) {
+            growCache(planner);
+            entry = findSlot(planner->cache, planner->cacheMask, from, to, bucket);
+        }
+        entry->from = from;
+        entry->to = to;
+        entry->bucket = bucket;
+        computeTransfer(planner, from, to, bucket * planner->bucketDays, entry);
+        planner->cacheSize++;
+    } else {
+        planner->cacheHits++;
+    }
+
+    *flightTime = entry->flightTime;
+    *deltaV = entry->deltaV;
+    if (entry->windowPeriod == 0.0)
+        return time;
+    double departure = entry->departureTime;
+    if (departure < time)
+        departure += ceil((time - departure) / entry->windowPeriod) * entry->windowPeriod;
+    return departure;
+}
+
+// Indexed binary heap ordered by (primary, secondary).
+static int heapLess(const RoutePlanner *planner, int a, int b) {
+    if (planner->primary[a] != planner->primary[b])
+        return planner->primary[a] < planner->primary[b];
+    return planner->secondary[a] < planner->secondary[b];
+}
+
+static void heapSwap(RoutePlanner *planner, int i, int j) {
+    int a = planner->heap[i], b = planner->heap[j];
+    planner->heap[i] = b;
+    planner->heap[j] = a;
+    planner->heapPosition[b] = i;
+    planner->heapPosition[a] = j;
+}
+
+static void heapUp(RoutePlanner *planner, int i) {
+    while (i > 0 && heapLess(planner, planner->heap[i], planner->heap[(i - 1) / 2])) {
+        heapSwap(planner, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heapDown(RoutePlanner *planner, int size, int i) {
+    for (;;) {
+        int best = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && heapLess(planner, planner->heap[left], planner->heap[best]))
+            best = left;
+        if (right < size && heapLess(planner, planner->heap[right], planner->heap[best]))
+            best = right;
+        if (best == i)
+            return;
+        heapSwap(planner, i, best);
+        i = best;
+    }
+}
+
+// Offers v the route through u, queueing or raising v when it improves.
+static void relaxHop(RoutePlanner *planner, RouteObjective objective, int u, int v, int *heapSize) {
+    double *arrival = objective == ROUTE_FASTEST ? planner->primary : planner->secondary;
+    double *cost = objective == ROUTE_FASTEST ? planner->secondary : planner->primary;
+    double flightTime, deltaV;
+    double departure = lookupTransfer(planner, u, v, arrival[u], &flightTime, &deltaV);
+    if (isinf(flightTime))
+        return;
+    double newArrival = departure + flightTime;
+    double newCost = cost[u] + deltaV;
+    int better = objective == ROUTE_FASTEST
+        ? (newArrival < arrival[v] || (newArrival == arrival[v] && newCost < cost[v]))
+        : (newCost < cost[v] || (newCost == cost[v] && newArrival < arrival[v]));
+    if (!better)
+        return;
+    arrival[v] = newArrival;
+    cost[v] = newCost;
+    planner->previous[v] = u;
+    planner->legDeparture[v] = departure;
+    if (planner->heapPosition[v] == -1) {
+        planner->heap[*heapSize] = v;
+        planner->heapPosition[v] = (*heapSize)++;
+    }
+    heapUp(planner, planner->heapPosition[v]);
+}
+
+// Lower bound on the objective's primary measure at v of a hop from u: the
+// hop's Hohmann flight time or delta-v on top of u's own.
+static double hopBound(const RoutePlanner *planner, RouteObjective objective, int u, int v) {
+    double from = planner->bodies[u].orbitRadius, to = planner->bodies[v].orbitRadius;
+    return planner->primary[u] + (objective == ROUTE_FASTEST ? computeHohmannTransferTime(from, to)
+                                                             : hohmannDeltaV(from, to));
+}
+
+// Lower bound on the objective's measure of the last hop of any route into
+// 'to': its flight time from the innermost orbit, or its delta-v from the
+// cheapest orbit to reach it from. Hohmann delta-v is the same both ways, so
+// that orbit is the nearest on either side or, past the peak of the delta-v
+// at about 15.6 times the radius, the outermost.
+static double lastHopBound(const RoutePlanner *planner, RouteObjective objective, int to) {
+    double radius = planner->bodies[to].orbitRadius;
+    int count = planner->count;
+    if (objective == ROUTE_FASTEST)
+        return computeHohmannTransferTime(planner->bodies[planner->byRadius[0]].orbitRadius, radius);
+    double bound = INFINITY;
+    int rank = planner->radiusRank[to];
+    for (int side = -1; side <= 1; side += 2) {
+        int r = rank + side;
+        while (r >= 0 && r < count && fabs(planner->bodies[planner->byRadius[r]].orbitRadius - radius) < 1e-6)
+            r += side;
+        if (r >= 0 && r < count)
+            bound = fmin(bound, hohmannDeltaV(planner->bodies[planner->byRadius[r]].orbitRadius, radius));
+    }
+    double outermost = planner->bodies[planner->byRadius[count - 1]].orbitRadius;
+    if (outermost - radius >= 1e-6)
+        bound = fmin(bound, hohmannDeltaV(outermost, radius));
+    return bound;
+}
+
+// Lower bound on the objective's measure of the rest of any route from v to
+// 'to', v != 'to'. Past the last hop, a cheapest route also needs at least
+// the cheapest impulsive transfer between the two orbits: a Hohmann transfer,
+// or a bi-parabolic one costing (sqrt(2) - 1) times the sum of the circular
+// speeds when that is less; a chain of hops is one such transfer.
+static double remainingBound(const RoutePlanner *planner, RouteObjective objective, int v, int to, double lastHop) {
+    if (objective == ROUTE_FASTEST)
+        return lastHop;
+    double from = planner->bodies[v].orbitRadius, radius = planner->bodies[to].orbitRadius;
+    double parabolic = (sqrt(2.0) - 1.0) * (circularSpeed(from) + circularSpeed(radius)) * AU_PER_DAY_IN_KM_PER_S;
+    return fmax(lastHop, fmin(hohmannDeltaV(from, radius), parabolic));
+}
+
+// Relaxes the hops from u to the bodies of radius rank first, first + step,
+// ... up to but not including stop, until a route through one, its
+// hopBound plus lastHop, can no longer beat the best route to 'to' found so
+// far. Returns the rank it stopped at. The walk must go the way hopBound
+// grows, so that every body after that one is out of reach too.
+static int relaxWalk(RoutePlanner *planner, RouteObjective objective, int u, int to, double lastHop, int first,
+                     int stop, int step, int *heapSize) {
+    int r = first;
+    for (; r != stop; r += step) {
+        int v = planner->byRadius[r];
+        double bound = hopBound(planner, objective, u, v);
+        if (bound + lastHop > planner->primary[to])
+            break;
+        if (v != to && planner->heapPosition[v] != -2 &&
+            bound + remainingBound(planner, objective, v, to, lastHop) <= planner->primary[to])
+            relaxHop(planner, objective, u, v, heapSize);
+    }
+    return r;
+}
+
+int planRoute(RoutePlanner *planner, int from, int to, double startTime,
+              RouteObjective objective, Route *route) {
+    // Time-dependent Dijkstra: the implicit form of the time-expanded graph,
+    // valid because waiting is allowed (a later start never arrives earlier).
+    int count = planner->count;
+    if (!isRoutableBody(&planner->bodies[from]) || !isRoutableBody(&planner->bodies[to]))
+        return -1;
+    double *arrival = objective == ROUTE_FASTEST ? planner->primary : planner->secondary;
+    double *cost = objective == ROUTE_FASTEST ? planner->secondary : planner->primary;
+    for (int i = 0; i < count; i++) {
+        arrival[i] = INFINITY;
+        cost[i] = INFINITY;
+        planner->previous[i] = -1;
+        planner->heapPosition[i] = -1;   // -1 not queued, -2 settled
+    }
+    arrival[from] = startTime;
+    cost[from] = 0.0;
+    double lastHop = lastHopBound(planner, objective, to);
+    int heapSize = 0;
+    planner->heap[heapSize] = from;
+    planner->heapPosition[from] = heapSize++;
+
+    while (heapSize > 0) {
+        int u = planner->heap[0];
+        heapSwap(planner, 0, --heapSize);
+        heapDown(planner, heapSize, 0);
+        planner->heapPosition[u] = -2;
+        if (u == to)
+            break;
+        if (planner->primary[u] + remainingBound(planner, objective, u, to, lastHop) > planner->primary[to])
+            continue;
+        // The hops from u: 'to', then every body whose Hohmann hop could
+        // still beat the best route to 'to', walked in radius order. The
+        // flight time grows with the target radius, so those are the bodies
+        // from the innermost out and from u out, up to the first out of reach.
+        // The delta-v grows both ways from u's radius up to a peak at about
+        // 15.6 times it, then falls towards the escape burn; the bodies past
+        // the peak are walked from the outermost in.
+        if (planner->heapPosition[to] != -2)
+            relaxHop(planner, objective, u, to, &heapSize);
+        int rank = planner->radiusRank[u];
+        if (objective == ROUTE_FASTEST) {
+            relaxWalk(planner, objective, u, to, lastHop, 0, rank, 1, &heapSize);
+            relaxWalk(planner, objective, u, to, lastHop, rank + 1, count, 1, &heapSize);
+        } else {
+            relaxWalk(planner, objective, u, to, lastHop, rank - 1, -1, -1, &heapSize);
+            int stop = relaxWalk(planner, objective, u, to, lastHop, rank + 1, count, 1, &heapSize);
+            if (stop < count)
+                relaxWalk(planner, objective, u, to, lastHop, count - 1, stop, -1, &heapSize);
+        }
+    }
+
+    // Walk back from the destination to count the legs, then fill them in order.
+    int legs = 0;
+    for (int v = to; v != from; v = planner->previous[v]) {
+        if (planner->previous[v] < 0 || ++legs > ROUTE_MAX_LEGS)
+            return -1;
+    }
+    route->legCount = legs;
+    route->arrivalTime = arrival[to];
+    route->deltaV = cost[to];
+    for (int v = to, i = legs - 1; v != from; v = planner->previous[v], i--) {
+        int u = planner->previous[v];
+        RouteLeg *leg = &route->legs[i];
+        leg->from = u;
+        leg->to = v;
+        leg->departureTime = planner->legDeparture[v];
+        leg->arrivalTime = arrival[v];
+        leg->deltaV = cost[v] - cost[u];
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef ROUTEPLANNER_H
+#define ROUTEPLANNER_H
+
+#include "planet.h"
+#include <stdint.h>
+
+#define ROUTE_MAX_LEGS 32
+
+typedef enum {
+    ROUTE_FASTEST,    // minimise arrival time
+    ROUTE_CHEAPEST    // minimise total delta-v, then arrival time
+} RouteObjective;
+
+// One hop: wait at 'from' until departureTime, then transfer to 'to'.
+typedef struct {
+    int from;
+    int to;
+    double departureTime;   // in days
+    double arrivalTime;     // in days
+    double deltaV;          // in km/s
+} RouteLeg;
+
+typedef struct {
+    int legCount;
+    RouteLeg legs[ROUTE_MAX_LEGS];
+    double arrivalTime;
+    double deltaV;
+} Route;
+
+// Memoized cost of hopping between two bodies, keyed by departure-time bucket.
+typedef struct {
+    int from;               // -1 marks an empty slot
+    int to;
+    int64_t bucket;
+    double departureTime;   // first transfer window at or after the bucket start
+    double windowPeriod;    // time between windows, 0 when there is no wait
+    double flightTime;
+    double deltaV;
+} TransferCacheEntry;
+
+typedef struct {
+    const Planet *bodies;
+    int count;
+    double bucketDays;
+    TransferCacheEntry *cache;
+    uint32_t cacheMask;
+    uint32_t cacheSize;
+    uint64_t cacheHits;
+    uint64_t cacheMisses;
+    // Dijkstra scratch, one entry per body.
+    double *primary;
+    double *secondary;
+    int *previous;
+    double *legDeparture;
+    int *heap;
+    int *heapPosition;
+    // Bodies in order of orbit radius, and each body's place in that order.
+    int *byRadius;
+    int *radiusRank;
+} RoutePlanner;
+
+// Prepares a planner over count bodies. Transfer costs are cached per
+// (from, to, floor(departure / bucketDays)). Returns 0 on success, -1 on allocation failure.
+int createRoutePlanner(RoutePlanner *planner, const Planet *bodies, int count, double bucketDays);
+void freeRoutePlanner(RoutePlanner *planner);
+
+// Finds the best sequence of hops from body 'from' to body 'to' leaving no
+// earlier than startTime. Each hop is a Hohmann transfer flown at its next
+// phasing window, so each hop joins two bodies on circular orbits in the
+// ecliptic with different radii; eccentric and inclined bodies are never on
+// a route.
+// The search is exact. It only skips hops, and bodies, that a lower bound
+// from the Hohmann flight time or delta-v between the orbit radii proves
+// cannot beat the best route to 'to' found so far.
+// Returns 0 on success, -1 if either end is not on such an orbit or no route
+// fits in ROUTE_MAX_LEGS.
+int planRoute(RoutePlanner *planner, int from, int to, double startTime,
+              RouteObjective objective, Route *route);
+
+#endif
@@ -0,0 +1,200 @@
+#include "scheduler.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCHEDULER_MIN_BUCKETS 16
+#define SCHEDULER_INITIAL_EVENTS 1024
+#define SCHEDULER_INITIAL_WIDTH 1.0     // in days
+#define SCHEDULER_WIDTH_GAPS 3.0        // bucket width in mean gaps between pending events
+#define SCHEDULER_SCANS_PER_EVENT 8     // empty buckets passed per event taken before the width is re-estimated
+
+struct QueuedEvent {
+    double time;
+    int kind;
+    int actor;
+    int next;              // next event in the bucket or the free list, -1 at the end
+};
+
+static long long slotOf(const Scheduler *scheduler, double time) {
+    return (long long)floor(time / scheduler->width);
+}
+
+static int *bucketOf(Scheduler *scheduler, long long slot) {
+    return &scheduler->buckets[slot & (scheduler->bucketCount - 1)];
+}
+
+// Links event e into its bucket after every event at or before its time.
+// Events mostly come later than those already filed, and many ships share a
+// time, so the bucket's tail is tried first.
+static void fileEvent(Scheduler *scheduler, int e) {
+    QueuedEvent *events = scheduler->events;
+    int *head = bucketOf(scheduler, slotOf(scheduler, events[e].time));
+    int *tail = head + scheduler->bucketCount;
+    events[e].next = -1;
+    if (*head < 0 || events[*tail].time <= events[e].time) {
+        if (*head < 0)
+            *head = e;
+        else
+            events[*tail].next = e;
+        *tail = e;
+        return;
+    }
+    int *link = head;
+    while (events[*link].time <= events[e].time)
+        link = &events[*link].next;
+    events[e].next = *link;
+    *link = e;
+}
+
+// Rebuilds the calendar with bucketCount buckets, sized from the spread of the
+// pending events. On allocation failure the old calendar is kept; it stays
+// correct, only slower.
+static void resizeCalendar(Scheduler *scheduler, int bucketCount) {
+    int *buckets = malloc(2 * (size_t)bucketCount * sizeof(int));
+    if (buckets == NULL)
+        return;
+    // Chain every event in bucket order, which keeps equal times in scheduling order.
+    QueuedEvent *events = scheduler->events;
+    int first = -1, last = -1;
+    double earliest = INFINITY, latest = -INFINITY;
+    for (int b = 0; b < scheduler->bucketCount; b++) {
+        for (int e = scheduler->buckets[b]; e >= 0; e = events[e].next) {
+            if (last >= 0)
+                events[last].next = e;
+            else
+                first = e;
+            last = e;
+            earliest = events[e].time < earliest ? events[e].time : earliest;
+            latest = events[e].time > latest ? events[e].time : latest;
+        }
+    }
+    if (last >= 0)
+        events[last].next = -1;
+    free(scheduler->buckets);
+    scheduler->buckets = buckets;
+    scheduler->bucketCount = bucketCount;
+    for (int b = 0; b < 2 * bucketCount; b++)
+        buckets[b] = -1;
+    if (scheduler->pending > 1 && latest > earliest) {
+        double width = SCHEDULER_WIDTH_GAPS * (latest - earliest) / (double)scheduler->pending;
+        // Keep slot numbers well inside 64 bits.
+        double floorWidth = 1e-9 * fmax(fmax(fabs(earliest), fabs(latest)), 1.0);
+        scheduler->width = width > floorWidth ? width : floorWidth;
+    }
+    scheduler->slot = slotOf(scheduler, scheduler->time);
+    scheduler->bucketsScanned = 0;
+    scheduler->eventsTaken = 0;
+    for (int e = first, next; e >= 0; e = next) {
+        next = events[e].next;
+        fileEvent(scheduler, e);
+    }
+}
+
+int createScheduler(Scheduler *scheduler, double startTime) {
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->time = startTime;
+    scheduler->freeList = -1;
+    scheduler->bucketCount = SCHEDULER_MIN_BUCKETS;
+    scheduler->width = SCHEDULER_INITIAL_WIDTH;
+    scheduler->buckets = malloc(2 * SCHEDULER_MIN_BUCKETS * sizeof(int));
+    if (scheduler->buckets == NULL)
+        return -1;
+    for (int b = 0; b < 2 * SCHEDULER_MIN_BUCKETS; b++)
+        scheduler->buckets[b] = -1;
+    scheduler->slot = slotOf(scheduler, startTime);
+    return 0;
+}
+
+void freeScheduler(Scheduler *scheduler) {
+    free(scheduler->events);
+    free(scheduler->buckets);
+    memset(scheduler, 0, sizeof(*scheduler));
+}
+
+int scheduleEvent(Scheduler *scheduler, double time, int kind, int actor) {
+    if (scheduler->freeList < 0) {
+        int capacity = scheduler->capacity > 0 ? 2 * scheduler->capacity : SCHEDULER_INITIAL_EVENTS;
+        QueuedEvent *events = realloc(scheduler->events, (size_t)capacity * sizeof(QueuedEvent));
+        if (events == NULL)
+            return -1;
+        for (int e = scheduler->capacity; e < capacity; e++)
+            events[e].next = e + 1 < capacity ? e + 1 : -1;
+        scheduler->events = events;
+        scheduler->freeList = scheduler->capacity;
+        scheduler->capacity = capacity;
+    }
+    int e = scheduler->freeList;
+    QueuedEvent *event = &scheduler->events[e];
+    scheduler->freeList = event->next;
+    event->time = time >= scheduler->time ? time : scheduler->time;
+    event->kind = kind;
+    event->actor = actor;
+    fileEvent(scheduler, e);
+    scheduler->pending++;
+    if (scheduler->pending > 2 * (long long)scheduler->bucketCount)
+        resizeCalendar(scheduler, 2 * scheduler->bucketCount);
+    return 0;
+}
+
+// Unlinks the first event of the bucket at scheduler->slot and returns it to the free list.
+static void takeHead(Scheduler *scheduler, ScheduledEvent *out) {
+    int *head = bucketOf(scheduler, scheduler->slot);
+    QueuedEvent *event = &scheduler->events[*head];
+    out->time = event->time;
+    out->kind = event->kind;
+    out->actor = event->actor;
+    int e = *head;
+    *head = event->next;
+    if (*head < 0)
+        head[scheduler->bucketCount] = -1;
+    event->next = scheduler->freeList;
+    scheduler->freeList = e;
+    scheduler->pending--;
+}
+
+// Moves scheduler->slot to the bucket holding the earliest pending event.
+static void findEarliest(Scheduler *scheduler) {
+    const QueuedEvent *events = scheduler->events;
+    // Scan one year of buckets for an event due in it.
+    for (int n = 0; n < scheduler->bucketCount; n++, scheduler->slot++) {
+        int head = *bucketOf(scheduler, scheduler->slot);
+        if (head >= 0 && slotOf(scheduler, events[head].time) <= scheduler->slot) {
+            scheduler->bucketsScanned += n;
+            return;
+        }
+    }
+    scheduler->bucketsScanned += scheduler->bucketCount;
+    // Nothing is due within a year: jump straight to the earliest bucket head.
+    int earliest = -1;
+    for (int b = 0; b < scheduler->bucketCount; b++) {
+        int head = scheduler->buckets[b];
+        if (head >= 0 && (earliest < 0 || events[head].time < events[earliest].time))
+            earliest = head;
+    }
+    scheduler->slot = slotOf(scheduler, events[earliest].time);
+}
+
+int nextEventBatch(Scheduler *scheduler, ScheduledEvent *batch, int capacity) {
+    if (scheduler->pending == 0 || capacity <= 0)
+        return 0;
+    findEarliest(scheduler);
+    takeHead(scheduler, &batch[0]);
+    scheduler->time = batch[0].time;
+    // Events at the same time share a bucket and follow one another in it.
+    int count = 1;
+    while (count < capacity) {
+        int head = *bucketOf(scheduler, scheduler->slot);
+        if (head < 0 || scheduler->events[head].time != scheduler->time)
+            break;
+        takeHead(scheduler, &batch[count++]);
+    }
+    scheduler->eventsTaken += count;
+    if (scheduler->bucketCount > SCHEDULER_MIN_BUCKETS &&
+        scheduler->pending < (long long)scheduler->bucketCount / 2)
+        resizeCalendar(scheduler, scheduler->bucketCount / 2);
+    // The events have spread out since the width was chosen: choose it again.
+    else if (scheduler->bucketsScanned > SCHEDULER_SCANS_PER_EVENT * scheduler->eventsTaken + scheduler->bucketCount)
+        resizeCalendar(scheduler, scheduler->bucketCount);
+    return count;
+}
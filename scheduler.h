@@ -0,0 +1,55 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Discrete-event scheduler. Pending events are kept in a calendar queue: a
+// ring of buckets, each covering `width` days of one "year" of
+// bucketCount * width days and holding its events sorted by time. Scheduling
+// files an event in the bucket of its day; taking the next event scans
+// forward from the clock's bucket for one due in the current year. The ring
+// is resized, and the width re-estimated from the pending events, whenever
+// the number of events leaves [bucketCount / 2, 2 * bucketCount] or the scan
+// passes too many empty buckets per event, which keeps both operations O(1)
+// amortized while events are spread evenly in time.
+// The clock jumps from one event time to the next; events at the same time
+// come out together, in the order they were scheduled.
+
+typedef struct QueuedEvent QueuedEvent;
+
+// An event as handed back to the caller.
+typedef struct {
+    double time;           // in days
+    int kind;              // caller-defined
+    int actor;             // caller-defined, e.g. a ship
+} ScheduledEvent;
+
+typedef struct {
+    double time;           // the clock: time of the events last taken
+    long long pending;
+    // Event storage; free slots are chained through `next`.
+    QueuedEvent *events;
+    int capacity;
+    int freeList;
+    // The calendar.
+    int *buckets;          // first event of each bucket, -1 if empty, then the last ones
+    int bucketCount;       // power of two
+    double width;          // days per bucket
+    long long slot;        // floor(time / width) of the bucket the scan resumes at
+    long long bucketsScanned;  // empty buckets passed since the last resize
+    long long eventsTaken;     // events taken since the last resize
+} Scheduler;
+
+// Starts the clock at startTime with no events. Returns 0 on success, -1 on allocation failure.
+int createScheduler(Scheduler *scheduler, double startTime);
+void freeScheduler(Scheduler *scheduler);
+
+// Schedules an event; times before the clock are moved up to it.
+// Returns 0 on success, -1 on allocation failure.
+int scheduleEvent(Scheduler *scheduler, double time, int kind, int actor);
+
+// Advances the clock to the earliest pending event and moves up to capacity
+// of the events due then into batch, in scheduling order. Further events at
+// the same time stay pending for the next call. Returns how many were moved,
+// 0 when nothing is pending.
+int nextEventBatch(Scheduler *scheduler, ScheduledEvent *batch, int capacity);
+
+#endif
@@ -0,0 +1,21 @@
+#include "modes.h"
+#include "server.h"
+#include <stdio.h>
+
+int runServeMode(const char *address, int threads) {
+    ServerStats stats;
+    fprintf(stderr, "Serving on %s; interrupt to stop.\n", address);
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = runServer(address, threads, &stats) != 0;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    if (failed) {
+        fprintf(stderr, "Error: could not serve on %s\n", address);
+        return 1;
+    }
+    double seconds = elapsedSeconds(start, stop);
+    fprintf(stderr, "server: %lld connections, %lld requests (%lld errors) in %lld rounds on %d threads, "
+            "%.0f requests/s over %.1f s\n", stats.connections, stats.requests, stats.errors, stats.rounds,
+            stats.workers, seconds > 0.0 ? stats.requests / seconds : 0.0, seconds);
+    return 0;
+}
@@ -0,0 +1,668 @@
+#include "server.h"
+#include "destinations.h"
+#include "navigation.h"
+#include "stats.h"
+#include "textio.h"
+#include "threadpool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_INPUT_CAPACITY (64 * 1024)   // per connection; longer lines are rejected
+#define SERVER_OUTPUT_LIMIT (1 << 20)       // queued response bytes before a connection is paused
+#define SERVER_ROUND_REQUESTS 16384         // lines taken per round across all connections
+#define SERVER_CHUNK_REQUESTS 256           // lines per work item
+#define SERVER_RESPONSE_BYTES 384           // upper bound of a response line
+#define SERVER_EVENTS 256
+#define SERVER_BACKLOG 128
+#define SERVER_DECIMALS 6
+
+typedef struct {
+    int fd;
+    char *input;
+    size_t inputUsed;
+    size_t parsed;           // bytes of input taken into the current round
+    int skippingLongLine;
+    int closing;             // the client shut down its side
+    int failed;              // an I/O error or allocation failure; dropped at the end of the round
+    char *output;
+    size_t outputUsed, outputSent, outputCapacity;
+    uint32_t events;         // registered with epoll
+    int slot;                // in Server.connections
+} Connection;
+
+// One line taken into a round, and where its response was formatted.
+typedef struct {
+    Connection *connection;
+    const char *line, *end;  // NULL line: a line too long to buffer
+    int chunk;
+    int offset, length;      // in the chunk's output
+} ServerRequest;
+
+typedef struct {
+    OutputBuffer out;
+    long long errors;
+    double nearestTimes;     // sum over the chunk's nearest queries
+    int nearestCount;
+} ServerChunk;
+
+typedef struct {
+    int listener;
+    int epoll;
+    Connection **connections;
+    int connectionCount, connectionCapacity;
+    ServerRequest *requests;
+    int requestCount;
+    ServerChunk *chunks;
+    const DestinationIndex *index;
+    long long rounds;
+    ServerStats *stats;
+} Server;
+
+enum { REQUEST_POSITION, REQUEST_NEAREST, REQUEST_TRANSFER, REQUEST_LOOKUP, REQUEST_ERROR };
+
+typedef struct {
+    int kind;
+    double values[6];
+    const char *text, *textEnd;    // name or prefix; error message
+} ParsedRequest;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+static const char *skipBlanks(const char *cursor, const char *end) {
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+        cursor++;
+    return cursor;
+}
+
+// End of the text on [begin, end) without trailing blanks.
+static const char *trimEnd(const char *begin, const char *end) {
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        end--;
+    return end;
+}
+
+static void parseError(ParsedRequest *request, const char *message) {
+    request->kind = REQUEST_ERROR;
+    request->text = message;
+    request->textEnd = message + strlen(message);
+}
+
+static void parseRequest(const char *line, const char *end, ParsedRequest *request) {
+    if (line == NULL) {
+        parseError(request, "line too long");
+        return;
+    }
+    end = trimEnd(line, end);
+    line = skipBlanks(line, end);
+    if (line == end) {
+        parseError(request, "empty request");
+        return;
+    }
+    char command = *line++;
+    double *values = request->values;
+    int parsed = 0;
+    switch (command) {
+        case 'P': case 'p':
+            if (!parseDouble(&line, end, &values[0]) || line == end || (*line != ' ' && *line != '\t')) {
+                parseError(request, "usage: P time name");
+                return;
+            }
+            request->kind = REQUEST_POSITION;
+            request->text = skipBlanks(line, end);
+            request->textEnd = end;
+            return;
+        case 'N': case 'n':
+            request->kind = REQUEST_NEAREST;
+            while (parsed < 4 && parseDouble(&line, end, &values[parsed]))
+                parsed++;
+            if (parsed != 4 || skipBlanks(line, end) != end)
+                parseError(request, "usage: N x y z time");
+            return;
+        case 'H': case 'h':
+            request->kind = REQUEST_TRANSFER;
+            while (parsed < 6 && parseDouble(&line, end, &values[parsed]))
+                parsed++;
+            if ((parsed != 2 && parsed != 6) || skipBlanks(line, end) != end)
+                parseError(request, "usage: H r1 r2 [x y tx ty]");
+            else if (parsed == 2)
+                values[2] = NAN;    // Hohmann only
+            return;
+        case 'L': case 'l':
+            if (line < end && *line != ' ' && *line != '\t') {
+                parseError(request, "usage: L [prefix]");
+                return;
+            }
+            request->kind = REQUEST_LOOKUP;
+            request->text = skipBlanks(line, end);
+            request->textEnd = end;
+            return;
+        default:
+            parseError(request, "unknown request");
+    }
+}
+
+// Copies a name of at most size - 1 bytes into buffer. Returns 0 if it is longer.
+static int copyName(char *buffer, size_t size, const char *name, const char *end) {
+    size_t length = (size_t)(end - name);
+    if (length >= size)
+        return 0;
+    memcpy(buffer, name, length);
+    buffer[length] = '\0';
+    return 1;
+}
+
+// nearestId and nearestDistance answer a nearest-destination request.
+static void writeResponse(const ParsedRequest *request, int nearestId, double nearestDistance, OutputBuffer *out,
+                          ServerChunk *chunk) {
+    const double *values = request->values;
+    char name[sizeof(knownDestinations->name)];
+    switch (request->kind) {
+        case REQUEST_POSITION: {
+            Planet *planet = NULL;
+            if (copyName(name, sizeof(name), request->text, request->textEnd)) {
+                planet = getDestinationByName(name);
+                if (planet == NULL)
+                    planet = getDestinationByNameIgnoreCase(name);
+            }
+            if (planet == NULL) {
+                appendString(out, "E unknown destination\n");
+                chunk->errors++;
+                return;
+            }
+            Vector3D p = getDestinationPosition((int)(planet - knownDestinations), values[0]);
+            appendText(out, "P ", 2);
+            appendFixed(out, p.x, SERVER_DECIMALS);
+            appendChar(out, ' ');
+            appendFixed(out, p.y, SERVER_DECIMALS);
+            appendChar(out, ' ');
+            appendFixed(out, p.z, SERVER_DECIMALS);
+            appendChar(out, '\n');
+            return;
+        }
+        case REQUEST_NEAREST: {
+            if (nearestId < 0) {
+                appendString(out, "N -1\n");
+                return;
+            }
+            appendText(out, "N ", 2);
+            appendFixed(out, nearestDistance, SERVER_DECIMALS);
+            appendChar(out, ' ');
+            appendString(out, knownDestinations[nearestId].name);
+            appendChar(out, '\n');
+            return;
+        }
+        case REQUEST_TRANSFER: {
+            double days;
+            if (!isnan(values[2]) && fabs(values[0] - values[1]) < 1e-6) {
+                Vector3D current = { values[2], values[3], 0.0 };
+                Vector3D target = { values[4], values[5], 0.0 };
+                days = computePhasingTime(current, target, 365.25 * pow(values[0], 1.5));
+            } else {
+                days = computeHohmannTransferTime(values[0], values[1]);
+            }
+            appendText(out, "H ", 2);
+            appendFixed(out, days, SERVER_DECIMALS);
+            appendChar(out, '\n');
+            return;
+        }
+        case REQUEST_LOOKUP: {
+            int ids[SERVER_LOOKUP_MAX];
+            int found = 0;
+            if (copyName(name, sizeof(name), request->text, request->textEnd))
+                found = findDestinationsByPrefix(name, ids, SERVER_LOOKUP_MAX);
+            appendText(out, "L ", 2);
+            appendInt(out, found);
+            for (int i = 0; i < found; i++) {
+                appendChar(out, i == 0 ? ' ' : ',');
+                appendString(out, knownDestinations[ids[i]].name);
+            }
+            appendChar(out, '\n');
+            return;
+        }
+        default:
+            appendText(out, "E ", 2);
+            appendText(out, request->text, (size_t)(request->textEnd - request->text));
+            appendChar(out, '\n');
+            chunk->errors++;
+    }
+}
+
+// Answers one chunk of a round's requests into the chunk's output.
+static void answerChunk(Server *server, int c) {
+    ServerChunk *chunk = &server->chunks[c];
+    int first = c * SERVER_CHUNK_REQUESTS;
+    int count = server->requestCount - first < SERVER_CHUNK_REQUESTS ? server->requestCount - first
+                                                                      : SERVER_CHUNK_REQUESTS;
+    ParsedRequest parsed[SERVER_CHUNK_REQUESTS];
+    Vector3D positions[SERVER_CHUNK_REQUESTS];
+    double times[SERVER_CHUNK_REQUESTS];
+    int ids[SERVER_CHUNK_REQUESTS];
+    double distances[SERVER_CHUNK_REQUESTS];
+    int nearest = 0;
+    for (int i = 0; i < count; i++) {
+        const ServerRequest *request = &server->requests[first + i];
+        parseRequest(request->line, request->end, &parsed[i]);
+        if (parsed[i].kind == REQUEST_NEAREST) {
+            positions[nearest] = (Vector3D){ parsed[i].values[0], parsed[i].values[1], parsed[i].values[2] };
+            times[nearest++] = parsed[i].values[3];
+        }
+    }
+    // Every nearest query of the chunk in one batch, which also yields the distances reported.
+    if (nearest > 0)
+        determineDestinationIds(server->index, positions, times, nearest, ids, distances);
+    chunk->nearestCount = nearest;
+    chunk->nearestTimes = 0.0;
+    for (int i = 0; i < nearest; i++)
+        chunk->nearestTimes += times[i];
+
+    OutputBuffer *out = &chunk->out;
+    out->used = 0;
+    chunk->errors = 0;
+    nearest = 0;
+    for (int i = 0; i < count; i++) {
+        ServerRequest *request = &server->requests[first + i];
+        request->offset = (int)out->used;
+        if (parsed[i].kind == REQUEST_NEAREST) {
+            writeResponse(&parsed[i], ids[nearest], distances[nearest], out, chunk);
+            nearest++;
+        } else {
+            writeResponse(&parsed[i], -1, 0.0, out, chunk);
+        }
+        request->length = (int)out->used - request->offset;
+    }
+}
+
+static void answerChunks(void *context, int begin, int end, int worker) {
+    (void)worker;
+    for (int c = begin; c < end; c++)
+        answerChunk(context, c);
+}
+
+static int setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void updateInterest(Server *server, Connection *connection) {
+    uint32_t events = 0;
+    if (!connection->closing && connection->inputUsed < SERVER_INPUT_CAPACITY)
+        events |= EPOLLIN;
+    if (connection->outputSent < connection->outputUsed)
+        events |= EPOLLOUT;
+    if (events == connection->events)
+        return;
+    struct epoll_event event = { .events = events, .data.ptr = connection };
+    epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->events = events;
+}
+
+static void closeConnection(Server *server, Connection *connection) {
+    close(connection->fd);    // also leaves the epoll set
+    Connection *last = server->connections[--server->connectionCount];
+    server->connections[connection->slot] = last;
+    last->slot = connection->slot;
+    free(connection->input);
+    free(connection->output);
+    free(connection);
+}
+
+static void acceptConnections(Server *server) {
+    for (;;) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return;    // EAGAIN once the queue is empty; anything else is retried on the next event
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));    // fails harmlessly on Unix sockets
+        if (server->connectionCount == server->connectionCapacity) {
+            int capacity = server->connectionCapacity > 0 ? 2 * server->connectionCapacity : 64;
+            Connection **grown = realloc(server->connections, (size_t)capacity * sizeof(Connection *));
+            if (grown == NULL) {
+                close(fd);
+                continue;
+            }
+            server->connections = grown;
+            server->connectionCapacity = capacity;
+        }
+        Connection *connection = calloc(1, sizeof(Connection));
+        char *input = malloc(SERVER_INPUT_CAPACITY);
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = connection };
+        if (connection == NULL || input == NULL || setNonBlocking(fd) != 0 ||
+            epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            free(connection);
+            free(input);
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->input = input;
+        connection->events = EPOLLIN;
+        connection->slot = server->connectionCount;
+        server->connections[server->connectionCount++] = connection;
+        if (server->stats != NULL)
+            server->stats->connections++;
+    }
+}
+
+// Reads what fits in the input buffer. Returns -1 if the connection failed.
+static int readInput(Connection *connection) {
+    while (connection->inputUsed < SERVER_INPUT_CAPACITY) {
+        STATS_BEGIN_TIMED(STATS_INPUT_READ);
+        ssize_t n = read(connection->fd, connection->input + connection->inputUsed,
+                         SERVER_INPUT_CAPACITY - connection->inputUsed);
+        STATS_END(STATS_INPUT_READ);
+        if (n > 0) {
+            connection->inputUsed += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            connection->closing = 1;
+            return 0;
+        }
+        if (errno == EINTR)
+            continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    return 0;
+}
+
+// Sends queued responses until the socket is full. Returns -1 if the connection failed.
+static int writeOutput(Connection *connection) {
+    while (connection->outputSent < connection->outputUsed) {
+        STATS_BEGIN_TIMED(STATS_OUTPUT_FLUSH);
+        ssize_t n = send(connection->fd, connection->output + connection->outputSent,
+                         connection->outputUsed - connection->outputSent, MSG_NOSIGNAL);
+        STATS_END(STATS_OUTPUT_FLUSH);
+        if (n > 0) {
+            connection->outputSent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    connection->outputUsed = connection->outputSent = 0;
+    return 0;
+}
+
+static int queueOutput(Connection *connection, const char *data, size_t length) {
+    if (connection->outputUsed + length > connection->outputCapacity && connection->outputSent > 0) {
+        // Drop what was sent before growing.
+        memmove(connection->output, connection->output + connection->outputSent,
+                connection->outputUsed - connection->outputSent);
+        connection->outputUsed -= connection->outputSent;
+        connection->outputSent = 0;
+    }
+    if (connection->outputUsed + length > connection->outputCapacity) {
+        size_t capacity = connection->outputCapacity > 0 ? connection->outputCapacity : 4096;
+        while (capacity < connection->outputUsed + length)
+            capacity *= 2;
+        char *grown = realloc(connection->output, capacity);
+        if (grown == NULL)
+            return -1;
+        connection->output = grown;
+        connection->outputCapacity = capacity;
+    }
+    memcpy(connection->output + connection->outputUsed, data, length);
+    connection->outputUsed += length;
+    return 0;
+}
+
+static int addRequest(Server *server, Connection *connection, const char *line, const char *end) {
+    ServerRequest *request = &server->requests[server->requestCount++];
+    request->connection = connection;
+    request->line = line;
+    request->end = end;
+    return server->requestCount < SERVER_ROUND_REQUESTS;
+}
+
+// Takes the connection's complete lines into the round while there is room,
+// skipping blank ones. Returns 1 if lines are left for a later round.
+static int takeLines(Server *server, Connection *connection) {
+    if (connection->outputUsed - connection->outputSent > SERVER_OUTPUT_LIMIT)
+        return 0;    // resumes once the client reads its responses
+    char *input = connection->input;
+    size_t limit = connection->inputUsed;
+    while (server->requestCount < SERVER_ROUND_REQUESTS) {
+        char *line = input + connection->parsed;
+        char *newline = memchr(line, '\n', limit - connection->parsed);
+        if (newline == NULL) {
+            if (connection->parsed == 0 && limit == SERVER_INPUT_CAPACITY) {
+                // A single line filled the buffer: reject it and drop the rest of it.
+                if (!connection->skippingLongLine)
+                    addRequest(server, connection, NULL, NULL);
+                connection->skippingLongLine = 1;
+                connection->parsed = limit;
+            } else if (connection->closing && connection->parsed < limit) {
+                // The last line of a client that shut down without a newline.
+                if (!connection->skippingLongLine && trimEnd(line, input + limit) > skipBlanks(line, input + limit))
+                    addRequest(server, connection, line, input + limit);
+                connection->parsed = limit;
+            }
+            return 0;
+        }
+        connection->parsed = (size_t)(newline + 1 - input);
+        if (connection->skippingLongLine) {
+            connection->skippingLongLine = 0;
+            continue;
+        }
+        if (trimEnd(line, newline) > skipBlanks(line, newline))
+            addRequest(server, connection, line, newline);
+    }
+    return memchr(input + connection->parsed, '\n', limit - connection->parsed) != NULL ||
+           (connection->closing && connection->parsed < limit);
+}
+
+// Answers the requests taken into the round and queues the responses.
+static void runRound(Server *server, ThreadPool *pool) {
+    int chunks = (server->requestCount + SERVER_CHUNK_REQUESTS - 1) / SERVER_CHUNK_REQUESTS;
+    STATS_BEGIN_TIMED(STATS_SERVER_ROUND);
+    parallelFor(pool, chunks, 1, answerChunks, server);
+    STATS_END(STATS_SERVER_ROUND);
+
+    double nearestTimes = 0.0;
+    int nearestCount = 0;
+    for (int c = 0; c < chunks; c++) {
+        nearestTimes += server->chunks[c].nearestTimes;
+        nearestCount += server->chunks[c].nearestCount;
+        if (server->stats != NULL)
+            server->stats->errors += server->chunks[c].errors;
+    }
+    // The index follows the nearest queries, one round behind.
+    if (nearestCount > 0) {
+        const DestinationIndex *index = getKnownDestinationsIndex(nearestTimes / nearestCount);
+        if (index != NULL)
+            server->index = index;
+    }
+    for (int i = 0; i < server->requestCount; i++) {
+        const ServerRequest *request = &server->requests[i];
+        Connection *connection = request->connection;
+        if (queueOutput(connection, server->chunks[request->chunk].out.data + request->offset,
+                        (size_t)request->length) != 0)
+            connection->failed = 1;
+    }
+    server->rounds++;
+    if (server->stats != NULL) {
+        server->stats->requests += server->requestCount;
+        server->stats->rounds++;
+    }
+}
+
+static int listenOn(const char *address) {
+    int fd;
+    if (strncmp(address, "tcp:", 4) == 0) {
+        int port = atoi(address + 4);
+        struct sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_port = htons((uint16_t)port);
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        if (fd < 0 || port <= 0 || port > 65535 ||
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0)
+            goto failed;
+    } else {
+        struct sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(local.sun_path)) {
+            fprintf(stderr, "%s: socket path too long\n", address);
+            return -1;
+        }
+        strcpy(local.sun_path, address);
+        // A socket left behind by an earlier server is replaced; any other file is not.
+        struct stat status;
+        if (lstat(address, &status) == 0 && S_ISSOCK(status.st_mode))
+            unlink(address);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0)
+            goto failed;
+    }
+    if (listen(fd, SERVER_BACKLOG) != 0 || setNonBlocking(fd) != 0)
+        goto failed;
+    return fd;
+
+failed:
+    perror(address);
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+int runServer(const char *address, int threads, ServerStats *stats) {
+    if (stats != NULL)
+        memset(stats, 0, sizeof(*stats));
+    // Build everything the workers read before any of them run.
+    if (getKnownDestinationsTable() == NULL)
+        return -1;
+    getDestinationByName("");
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.stats = stats;
+    server.index = getKnownDestinationsIndex(0.0);
+    int chunkCount = SERVER_ROUND_REQUESTS / SERVER_CHUNK_REQUESTS;
+    server.requests = malloc(SERVER_ROUND_REQUESTS * sizeof(ServerRequest));
+    server.chunks = calloc((size_t)chunkCount, sizeof(ServerChunk));
+    int failed = server.index == NULL || server.requests == NULL || server.chunks == NULL;
+    for (int c = 0; c < chunkCount && !failed; c++)
+        failed = openOutputBuffer(&server.chunks[c].out, -1, SERVER_CHUNK_REQUESTS * SERVER_RESPONSE_BYTES) != 0;
+    server.listener = failed ? -1 : listenOn(address);
+    server.epoll = server.listener >= 0 ? epoll_create1(0) : -1;
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (server.epoll < 0 || epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &event) != 0)
+        failed = 1;
+
+    // SIGINT and SIGTERM are only delivered while waiting for events, so none is missed.
+    sigset_t blocked, waiting;
+    struct sigaction stop, previousInt, previousTerm;
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = requestStop;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigprocmask(SIG_BLOCK, &blocked, &waiting);
+    sigdelset(&waiting, SIGINT);
+    sigdelset(&waiting, SIGTERM);
+    sigaction(SIGINT, &stop, &previousInt);
+    sigaction(SIGTERM, &stop, &previousTerm);
+    stopRequested = 0;
+    // Created with the signals blocked, so the workers never take them.
+    ThreadPool *pool = failed ? NULL : createThreadPool(threads);
+    if (pool == NULL)
+        failed = 1;
+    else if (stats != NULL)
+        stats->workers = threadPoolSize(pool);
+
+    struct epoll_event events[SERVER_EVENTS];
+    int pending = 0;    // lines were left over from the last round
+    while (!failed && !stopRequested) {
+        int ready = epoll_pwait(server.epoll, events, SERVER_EVENTS, pending ? 0 : -1, &waiting);
+        if (ready < 0 && errno != EINTR)
+            failed = 1;
+        for (int e = 0; e < ready; e++) {
+            Connection *connection = events[e].data.ptr;
+            if (connection == NULL) {
+                acceptConnections(&server);
+                continue;
+            }
+            if ((events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && readInput(connection) != 0)
+                connection->failed = 1;
+            if ((events[e].events & EPOLLOUT) && writeOutput(connection) != 0)
+                connection->failed = 1;
+        }
+
+        // Take lines round-robin from a rotating start so no client is starved.
+        server.requestCount = 0;
+        pending = 0;
+        int count = server.connectionCount;
+        int start = count > 0 ? (int)(server.rounds % count) : 0;
+        for (int k = 0; k < count; k++) {
+            Connection *connection = server.connections[(start + k) % count];
+            if (!connection->failed && takeLines(&server, connection))
+                pending = 1;
+        }
+        for (int i = 0; i < server.requestCount; i++)
+            server.requests[i].chunk = i / SERVER_CHUNK_REQUESTS;
+        if (server.requestCount > 0)
+            runRound(&server, pool);
+
+        for (int k = server.connectionCount - 1; k >= 0; k--) {
+            Connection *connection = server.connections[k];
+            if (connection->parsed > 0) {
+                memmove(connection->input, connection->input + connection->parsed,
+                        connection->inputUsed - connection->parsed);
+                connection->inputUsed -= connection->parsed;
+                connection->parsed = 0;
+            }
+            if (!connection->failed && writeOutput(connection) != 0)
+                connection->failed = 1;
+            int finished = connection->closing && connection->inputUsed == 0 &&
+                           connection->outputSent == connection->outputUsed;
+            if (connection->failed || finished)
+                closeConnection(&server, connection);
+            else
+                updateInterest(&server, connection);
+        }
+    }
+
+    destroyThreadPool(pool);
+    sigaction(SIGINT, &previousInt, NULL);
+    sigaction(SIGTERM, &previousTerm, NULL);
+    sigprocmask(SIG_UNBLOCK, &blocked, NULL);
+    while (server.connectionCount > 0)
+        closeConnection(&server, server.connections[0]);
+    if (server.epoll >= 0)
+        close(server.epoll);
+    if (server.listener >= 0) {
+        close(server.listener);
+        if (strncmp(address, "tcp:", 4) != 0)
+            unlink(address);
+    }
+    for (int c = 0; c < chunkCount && server.chunks != NULL; c++)
+        free(server.chunks[c].out.data);
+    free(server.chunks);
+    free(server.requests);
+    free(server.connections);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// Local query server. Clients send one request per line and get one response
+// line per request, in the order sent, so any number of requests may be in
+// flight on a connection:
+//   P time name             position of a destination      -> P x y z
+//   N x y z time            nearest destination within the
+//                           arrival threshold              -> N distance name, or N -1
+//   H r1 r2 [x y tx ty]     Hohmann transfer time, or the
+//                           phasing time from (x, y) to
+//                           (tx, ty) when r1 == r2         -> H days
+//   L [prefix]              destinations whose names start
+//                           with prefix, ignoring case     -> L count name,name,...
+//   (malformed or unknown request)                         -> E message
+// Names run to the end of the line; L lists at most SERVER_LOOKUP_MAX of them.
+//
+// A single thread multiplexes the connections with epoll. Each round it reads
+// whatever the clients sent, hands every complete line to the pool in chunks,
+// and queues the responses back in order. The nearest-destination queries of a
+// chunk are answered as one batch through the destination index (see
+// findNearestDestinationBatch), which orders them by shell and longitude and
+// evaluates their candidates together.
+
+#define SERVER_LOOKUP_MAX 8
+
+typedef struct {
+    long long connections;
+    long long requests;
+    long long errors;
+    long long rounds;
+    int workers;
+} ServerStats;
+
+// Serves address, a filesystem path for a Unix domain socket or "tcp:PORT"
+// for a TCP port on 127.0.0.1, until SIGINT or SIGTERM. Requests are answered
+// by a pool of the given number of threads (see createThreadPool), created
+// here so that only the listening thread takes the signals. stats may be NULL.
+// Returns 0 after a signal, -1 if the address could not be served.
+int runServer(const char *address, int threads, ServerStats *stats);
+
+#endif
@@ -0,0 +1,178 @@
+#include "snapshot.h"
+#include "destinations.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+// Header, state, then per column its data and padding, then the ids and padding.
+#define SNAPSHOT_MAX_PIECES (1 + 2 * FLEET_COLUMNS + 2)
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + SNAPSHOT_ALIGNMENT - 1) & ~(uint64_t)(SNAPSHOT_ALIGNMENT - 1);
+}
+
+// writev until every piece is written, resuming after partial writes.
+static int writeAllPieces(int fd, struct iovec *pieces, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, pieces, count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        while (count > 0 && (size_t)n >= pieces->iov_len) {
+            n -= (ssize_t)pieces->iov_len;
+            pieces++;
+            count--;
+        }
+        if (count > 0) {
+            pieces->iov_base = (char *)pieces->iov_base + n;
+            pieces->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+int writeSnapshot(const char *path, const ShipState *state, uint64_t journalSequence,
+                  const Fleet *fleet, double fleetTime) {
+    static const char zeros[SNAPSHOT_ALIGNMENT];
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.stateSize = sizeof(ShipState);
+    header.stateOffset = alignUp(sizeof(SnapshotHeader));
+    header.journalSequence = journalSequence;
+    header.catalogCount = (uint64_t)knownDestinationsCount;
+    header.catalogFingerprint = getKnownDestinationsFingerprint();
+    header.fleetTime = fleetTime;
+    header.fleetCount = fleet != NULL ? (uint64_t)fleet->count : 0;
+    header.fleetColumnCount = FLEET_COLUMNS;
+    header.fleetColumnsOffset = alignUp(header.stateOffset + header.stateSize);
+    header.fleetColumnStride = alignUp(header.fleetCount * sizeof(double));
+    header.fleetIdsOffset = header.fleetColumnsOffset + FLEET_COLUMNS * header.fleetColumnStride;
+    header.fileSize = alignUp(header.fleetIdsOffset + header.fleetCount * sizeof(int32_t));
+
+    // The header and the state go out of one small buffer; the fleet columns straight from the fleet.
+    char *head = calloc(1, header.fleetColumnsOffset);
+    if (head == NULL)
+        return -1;
+    memcpy(head, &header, sizeof(header));
+    memcpy(head + header.stateOffset, state, sizeof(ShipState));
+    struct iovec pieces[SNAPSHOT_MAX_PIECES];
+    int count = 0;
+    pieces[count++] = (struct iovec){ head, header.fleetColumnsOffset };
+    size_t columnBytes = header.fleetCount * sizeof(double);
+    size_t idBytes = header.fleetCount * sizeof(int32_t);
+    if (header.fleetCount > 0) {
+        for (int k = 0; k < FLEET_COLUMNS; k++) {
+            pieces[count++] = (struct iovec){ fleetColumn(fleet, k), columnBytes };
+            pieces[count++] = (struct iovec){ (void *)zeros, header.fleetColumnStride - columnBytes };
+        }
+        pieces[count++] = (struct iovec){ fleet->destinationId, idBytes };
+    }
+    pieces[count++] = (struct iovec){ (void *)zeros, header.fileSize - header.fleetIdsOffset - idBytes };
+
+    // Write beside the old snapshot and rename over it once synced.
+    size_t length = strlen(path);
+    char *temporary = malloc(length + 5);
+    int fd = -1;
+    if (temporary != NULL) {
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", 5);
+        fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    int failed = fd < 0 || writeAllPieces(fd, pieces, count) != 0 || fdatasync(fd) != 0;
+    if (fd >= 0 && close(fd) != 0)
+        failed = 1;
+    if (!failed)
+        failed = rename(temporary, path) != 0;
+    else if (fd >= 0)
+        unlink(temporary);
+    free(temporary);
+    free(head);
+    return failed ? -1 : 0;
+}
+
+int openSnapshot(MappedSnapshot *snapshot, const char *path) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SnapshotHeader)) {
+        fprintf(stderr, "%s: not a state snapshot\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    // Populated up front: restoring reads every page anyway.
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    const SnapshotHeader *header = base;
+    const char *problem = NULL;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0)
+        problem = "bad magic";
+    else if (header->version != SNAPSHOT_VERSION)
+        problem = "unsupported version";
+    else if (header->headerSize != sizeof(SnapshotHeader) || header->stateSize != sizeof(ShipState) ||
+             header->fleetColumnCount != FLEET_COLUMNS)
+        problem = "record layout mismatch";
+    else if (header->catalogCount != (uint64_t)knownDestinationsCount ||
+             header->catalogFingerprint != getKnownDestinationsFingerprint())
+        problem = "taken with a different destination catalog";
+    else if (header->fileSize > size || header->fleetCount > (uint64_t)0x7fffffff)
+        problem = "truncated file";
+    else if (header->stateOffset % SNAPSHOT_ALIGNMENT != 0 || header->stateOffset + header->stateSize > size ||
+             header->fleetColumnsOffset % SNAPSHOT_ALIGNMENT != 0 || header->fleetColumnsOffset > size ||
+             header->fleetColumnStride % SNAPSHOT_ALIGNMENT != 0 ||
+             header->fleetColumnStride / sizeof(double) < header->fleetCount ||
+             header->fleetColumnStride > (size - header->fleetColumnsOffset) / FLEET_COLUMNS ||
+             header->fleetIdsOffset != header->fleetColumnsOffset + FLEET_COLUMNS * header->fleetColumnStride ||
+             header->fleetCount > (size - header->fleetIdsOffset) / sizeof(int32_t))
+        problem = "section out of range";
+    if (problem != NULL) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        munmap(base, size);
+        return -1;
+    }
+
+    snapshot->base = base;
+    snapshot->size = size;
+    snapshot->header = header;
+    snapshot->state = (const ShipState *)((const char *)base + header->stateOffset);
+    return 0;
+}
+
+void closeSnapshot(MappedSnapshot *snapshot) {
+    if (snapshot->base != NULL)
+        munmap(snapshot->base, snapshot->size);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+int restoreFleet(const MappedSnapshot *snapshot, Fleet *fleet, int capacity) {
+    const SnapshotHeader *header = snapshot->header;
+    int count = (int)header->fleetCount;
+    if (count == 0 || createFleet(fleet, capacity > count ? capacity : count) != 0)
+        return -1;
+    const char *columns = (const char *)snapshot->base + header->fleetColumnsOffset;
+    for (int k = 0; k < FLEET_COLUMNS; k++)
+        memcpy(fleetColumn(fleet, k), columns + k * header->fleetColumnStride, (size_t)count * sizeof(double));
+    memcpy(fleet->destinationId, (const char *)snapshot->base + header->fleetIdsOffset,
+           (size_t)count * sizeof(int32_t));
+    fleet->count = count;
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "navigation.h"
+#include "fleet.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAPSHOT_MAGIC "SWSNAPS"  // 8 bytes including the terminator
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_ALIGNMENT 64     // every section starts on a cache line
+
+// On-disk header of a state snapshot. All offsets are from the start of the
+// file. The ShipState is stored verbatim; a fleet, when present, is stored as
+// FLEET_COLUMNS double[fleetCount] columns followed by the destination ids,
+// so the whole file is written with one gathered write and read with one map.
+// Destination ids only mean something against the catalog they index, so the
+// header records it and a snapshot taken under another catalog is refused.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t stateSize;         // sizeof(ShipState) of the writer
+    uint64_t stateOffset;
+    uint64_t journalSequence;   // last journal record the state includes
+    uint64_t catalogCount;      // knownDestinationsCount of the writer
+    uint64_t catalogFingerprint;  // getKnownDestinationsFingerprint() of the writer
+    double fleetTime;           // simulation time the fleet was advanced to
+    uint64_t fleetCount;        // 0 when no fleet was saved
+    uint64_t fleetColumnCount;  // FLEET_COLUMNS of the writer
+    uint64_t fleetColumnsOffset;
+    uint64_t fleetColumnStride; // bytes from the start of one column to the next
+    uint64_t fleetIdsOffset;    // int32_t[fleetCount]
+    uint64_t fileSize;
+} SnapshotHeader;
+
+// A snapshot file mapped into memory.
+typedef struct {
+    void *base;
+    size_t size;
+    const SnapshotHeader *header;
+    const ShipState *state;
+} MappedSnapshot;
+
+// Writes state and, unless fleet is NULL, the fleet to path, replacing any
+// previous snapshot atomically once the new one is on disk.
+// Returns 0 on success, -1 on error.
+int writeSnapshot(const char *path, const ShipState *state, uint64_t journalSequence,
+                  const Fleet *fleet, double fleetTime);
+
+// Maps and validates a snapshot file. Returns 0 on success, -1 on error (a reason is printed to stderr).
+int openSnapshot(MappedSnapshot *snapshot, const char *path);
+void closeSnapshot(MappedSnapshot *snapshot);
+
+// Creates fleet from the snapshot's ships, with room for capacity ships (at
+// least the saved count). Returns 0 on success, -1 when the snapshot holds no
+// fleet or on allocation failure.
+int restoreFleet(const MappedSnapshot *snapshot, Fleet *fleet, int capacity);
+
+#endif
@@ -0,0 +1,963 @@
+#include "spatialindex.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.141592653589793
+#define ANNULUS_MAX_BODIES 64  // bodies per radial bucket
+#define PHASE_MARGIN 1e-9      // in revolutions, absorbs rounding in the phase mapping
+#define SWEEP_DISTANCE_TOLERANCE 1e-6  // in AU; closest approaches are found to within this
+#define SWEEP_STACK 524                // pending intervals of one swept candidate, for any finite sag (see sweepCandidate)
+#define NEAREST_BATCH 32               // candidates evaluated together by the batched kernel
+#define NEAREST_MIN_BATCH 4            // fewer pending candidates are evaluated one by one
+#define NEAREST_GROUP 256              // queries findNearestDestinationBatch orders and resolves together
+#define BAND_CELL_BODIES 2             // bodies per cell of a band's anomaly-longitude grid, on average
+#define BAND_MAX_GRID 32               // rows and columns of that grid at most
+#define CLASS_MIN_BODIES 16384         // non-circular bodies per eccentricity class at least
+#define BAND_SIZE_FACTOR 3             // bodies per band, times the square root of its class's size
+
+static double fractionalPart(double value) {
+    return value - floor(value);
+}
+
+// Longitude of periapsis (node + argument of periapsis) and the largest gap
+// between the body's ecliptic longitude and its longitude counted along the
+// orbit from there, both in revolutions. The gap, the reduction to the
+// ecliptic, is at most asin(tan^2(i / 2)). Retrograde orbits get a gap of 0.5,
+// which disables the phase filter.
+static void periapsisLongitude(const BodyTable *table, int i, double *longitude, double *reduction) {
+    double a = table->orbitRadius[i];
+    double e = table->eccentricity[i];
+    double b = a * sqrt(1.0 - e * e);
+    Vector3D p = { table->periapsisX[i] / a, table->periapsisY[i] / a, table->periapsisZ[i] / a };
+    Vector3D q = { table->quadratureX[i] / b, table->quadratureY[i] / b, table->quadratureZ[i] / b };
+    Vector3D h = { p.y * q.z - p.z * q.y, p.z * q.x - p.x * q.z, p.x * q.y - p.y * q.x };
+    double cosInclination = h.z;
+    *longitude = 0.0;
+    *reduction = 0.5;
+    if (cosInclination <= 0.0)
+        return;
+    double node = h.x != 0.0 || h.y != 0.0 ? atan2(h.x, -h.y) : 0.0;
+    double nodeX = cos(node), nodeY = sin(node);
+    // Argument of periapsis, measured in the orbit plane from the ascending
+    // node; ahead is (h x node) . p with the node in the ecliptic.
+    double ahead = -h.z * nodeY * p.x + h.z * nodeX * p.y + (h.x * nodeY - h.y * nodeX) * p.z;
+    double argument = atan2(ahead, nodeX * p.x + nodeY * p.y);
+    *longitude = fractionalPart((node + argument) / (2 * PI));
+    *reduction = asin((1.0 - cosInclination) / (1.0 + cosInclination)) / (2 * PI) + PHASE_MARGIN;
+}
+
+// Mean longitude at time 0 (longitude of periapsis + mean anomaly) and the
+// largest gap between it and the body's ecliptic longitude, both in
+// revolutions: 2 asin(e) for the equation of the centre plus the reduction to
+// the ecliptic. Very eccentric orbits get a slack of 0.5 as well.
+static void meanLongitude(const BodyTable *table, int i, double *longitude, double *slack) {
+    double reduction;
+    periapsisLongitude(table, i, longitude, &reduction);
+    *longitude += table->epochPhase[i];
+    double gap = reduction + asin(table->eccentricity[i]) / PI;
+    *slack = gap < 0.5 ? gap : 0.5;
+}
+
+static int compareBandPeriapsis(const void *a, const void *b) {
+    const IndexAnnulus *ba = a;
+    const IndexAnnulus *bb = b;
+    if (ba->radiusMin != bb->radiusMin)
+        return ba->radiusMin < bb->radiusMin ? -1 : 1;
+    return ba->begin - bb->begin;
+}
+
+// Lays out the bodies entries[begin, end) of one band: the band's ranges,
+// then its grid of mean anomaly by mean longitude, both at the epoch, cell by
+// cell, each cell's bodies in order of mean longitude.
+static void buildBand(DestinationIndex *index, const BodyTable *table, SortEntry *entries, int begin, int end,
+                      int *cellCount) {
+    IndexAnnulus *band = &index->bands[index->bandCount++];
+    int grid = (int)sqrt((double)(end - begin) / BAND_CELL_BODIES);
+    grid = grid < BAND_MAX_GRID ? (grid > 1 ? grid : 1) : BAND_MAX_GRID;
+    band->begin = begin;
+    band->end = end;
+    band->radiusMin = INFINITY;
+    band->radiusMax = 0.0;
+    band->axisMin = entries[begin].key;
+    band->axisMax = entries[end - 1].key;
+    band->eccentricityMin = INFINITY;
+    band->eccentricityMax = 0.0;
+    band->motionMin = INFINITY;
+    band->motionMax = -INFINITY;
+    band->reduction = 0.0;
+    band->grid = grid;
+    band->cellBase = *cellCount;
+    for (int i = begin; i < end; i++) {
+        int id = entries[i].id;
+        double motion = table->meanMotion[id];
+        double e = table->eccentricity[id];
+        double periapsis = table->orbitRadius[id] * (1.0 - e);
+        double apoapsis = table->orbitRadius[id] * (1.0 + e);
+        double longitude, reduction;
+        periapsisLongitude(table, id, &longitude, &reduction);
+        longitude = fractionalPart(index->epoch * motion + table->epochPhase[id] + longitude);
+        if (periapsis < band->radiusMin)
+            band->radiusMin = periapsis;
+        if (apoapsis > band->radiusMax)
+            band->radiusMax = apoapsis;
+        if (e < band->eccentricityMin)
+            band->eccentricityMin = e;
+        if (e > band->eccentricityMax)
+            band->eccentricityMax = e;
+        if (motion < band->motionMin)
+            band->motionMin = motion;
+        if (motion > band->motionMax)
+            band->motionMax = motion;
+        if (reduction > band->reduction)
+            band->reduction = reduction;
+        int row = (int)(fractionalPart(index->epoch * motion + table->epochPhase[id]) * grid);
+        int column = (int)(longitude * grid);
+        entries[i].key = (row < grid ? row : grid - 1) * grid + (column < grid ? column : grid - 1) + longitude;
+    }
+    qsort(entries + begin, (size_t)(end - begin), sizeof(SortEntry), compareSortEntry);
+    // cellStart[cellBase + c] is the first slot of cell c, in row-major order.
+    for (int c = 0, i = begin; c <= grid * grid; c++) {
+        while (i < end && entries[i].key < c)
+            i++;
+        index->cellStart[band->cellBase + c] = i;
+    }
+    *cellCount += grid * grid + 1;
+}
+
+int buildDestinationIndex(DestinationIndex *index, const BodyTable *table, double epoch) {
+    memset(index, 0, sizeof(*index));
+    int count = table->count;
+    int annulusCapacity = count / ANNULUS_MAX_BODIES + 1;
+    int bandCapacity = annulusCapacity + INDEX_ECCENTRICITY_CLASSES;
+    size_t n = (size_t)(count > 0 ? count : 1);
+    SortEntry *entries = malloc(n * sizeof(SortEntry));
+    double *columns = malloc(BODY_TABLE_COLUMNS * n * sizeof(double));
+    index->annuli = malloc((size_t)annulusCapacity * sizeof(IndexAnnulus));
+    index->bands = malloc((size_t)bandCapacity * sizeof(IndexAnnulus));
+    index->bandReach = malloc((size_t)bandCapacity * sizeof(double));
+    index->cellStart = malloc((n / BAND_CELL_BODIES + 2 * (size_t)bandCapacity) * sizeof(int));
+    index->bodyIds = malloc(n * sizeof(int));
+    index->orbits = malloc(n * sizeof(SlotOrbit));
+    if (entries == NULL || columns == NULL || index->annuli == NULL || index->bands == NULL ||
+        index->bandReach == NULL || index->cellStart == NULL || index->bodyIds == NULL ||
+        index->orbits == NULL) {
+        free(entries);
+        free(columns);
+        freeDestinationIndex(index);
+        return -1;
+    }
+    index->epoch = epoch;
+    index->count = count;
+
+    // Circular bodies first, keyed by orbit radius; then the rest, prograde
+    // ones by eccentricity and retrograde ones after them.
+    int circular = 0;
+    for (int i = 0; i < count; i++)
+        circular += isPlanarCircularBody(table, i);
+    for (int i = 0, slot = 0, other = circular; i < count; i++) {
+        if (isPlanarCircularBody(table, i)) {
+            entries[slot].key = table->orbitRadius[i];
+            entries[slot++].id = i;
+            continue;
+        }
+        double longitude, reduction;
+        periapsisLongitude(table, i, &longitude, &reduction);
+        entries[other].key = table->eccentricity[i] + (reduction >= 0.5 ? 1.0 : 0.0);
+        entries[other++].id = i;
+    }
+    qsort(entries, (size_t)circular, sizeof(SortEntry), compareSortEntry);
+    qsort(entries + circular, (size_t)(count - circular), sizeof(SortEntry), compareSortEntry);
+
+    for (int begin = 0; begin < circular; begin += ANNULUS_MAX_BODIES) {
+        int end = begin + ANNULUS_MAX_BODIES < circular ? begin + ANNULUS_MAX_BODIES : circular;
+        IndexAnnulus *annulus = &index->annuli[index->annulusCount++];
+        memset(annulus, 0, sizeof(*annulus));
+        annulus->begin = begin;
+        annulus->end = end;
+        annulus->radiusMin = entries[begin].key;
+        annulus->radiusMax = entries[end - 1].key;
+        annulus->axisMin = annulus->radiusMin;
+        annulus->axisMax = annulus->radiusMax;
+        annulus->motionMin = INFINITY;
+        annulus->motionMax = -INFINITY;
+
+        // Within the annulus, sort by phase at the epoch.
+        for (int i = begin; i < end; i++) {
+            int id = entries[i].id;
+            double motion = table->meanMotion[id];
+            if (motion < annulus->motionMin)
+                annulus->motionMin = motion;
+            if (motion > annulus->motionMax)
+                annulus->motionMax = motion;
+            double longitude, slack;
+            meanLongitude(table, id, &longitude, &slack);
+            entries[i].key = fractionalPart(epoch * motion + longitude);
+        }
+        qsort(entries + begin, (size_t)(end - begin), sizeof(SortEntry), compareSortEntry);
+    }
+
+    // Equal classes of the rest, each in bands by semi-major axis. Small
+    // catalogs get fewer classes: their bands would span most of the orbits anyway.
+    int others = count - circular, cellCount = 0;
+    int classes = others / CLASS_MIN_BODIES;
+    classes = classes < INDEX_ECCENTRICITY_CLASSES ? (classes > 1 ? classes : 1) : INDEX_ECCENTRICITY_CLASSES;
+    for (int c = 0; c < INDEX_ECCENTRICITY_CLASSES; c++) {
+        int classBegin = circular + (int)((long long)others * (c < classes ? c : classes) / classes);
+        int classEnd = circular + (int)((long long)others * (c < classes ? c + 1 : classes) / classes);
+        for (int i = classBegin; i < classEnd; i++)
+            entries[i].key = table->orbitRadius[entries[i].id];
+        qsort(entries + classBegin, (size_t)(classEnd - classBegin), sizeof(SortEntry), compareSortEntry);
+        int bandSize = (int)(BAND_SIZE_FACTOR * sqrt((double)(classEnd - classBegin)));
+        bandSize = bandSize > ANNULUS_MAX_BODIES ? bandSize : ANNULUS_MAX_BODIES;
+        int firstBand = index->bandCount;
+        for (int begin = classBegin; begin < classEnd; begin += bandSize)
+            buildBand(index, table, entries, begin, begin + bandSize < classEnd ? begin + bandSize : classEnd,
+                      &cellCount);
+        // Order the class's bands by periapsis and record how far out each prefix reaches.
+        qsort(index->bands + firstBand, (size_t)(index->bandCount - firstBand), sizeof(IndexAnnulus),
+              compareBandPeriapsis);
+        for (int b = firstBand; b < index->bandCount; b++) {
+            double reach = b > firstBand ? index->bandReach[b - 1] : 0.0;
+            index->bandReach[b] = index->bands[b].radiusMax > reach ? index->bands[b].radiusMax : reach;
+        }
+        index->bandClassEnd[c] = index->bandCount;
+    }
+
+    // Copy the source columns into slot order so candidates are read sequentially.
+    for (int k = 0; k < BODY_TABLE_COLUMNS; k++) {
+        const double *source = bodyTableColumn(table, k);
+        for (int slot = 0; slot < count; slot++)
+            columns[k * n + slot] = source[entries[slot].id];
+    }
+    for (int slot = 0; slot < count; slot++) {
+        int id = entries[slot].id;
+        double longitude, slack;
+        meanLongitude(table, id, &longitude, &slack);
+        SlotOrbit *orbit = &index->orbits[slot];
+        index->bodyIds[slot] = id;
+        orbit->axis = table->orbitRadius[id];
+        orbit->eccentricity = table->eccentricity[id];
+        orbit->meanMotion = table->meanMotion[id];
+        orbit->anomaly = table->epochPhase[id];
+        orbit->longitude = fractionalPart(epoch * table->meanMotion[id] + longitude);
+        orbit->slack = slot < circular ? 0.0 : slack;
+    }
+    bindBodyTable(&index->slots, count, columns, n);
+    index->slots.storage = columns;
+    free(entries);
+    return 0;
+}
+
+void freeDestinationIndex(DestinationIndex *index) {
+    free(index->annuli);
+    free(index->bands);
+    free(index->bandReach);
+    free(index->cellStart);
+    free(index->bodyIds);
+    free(index->orbits);
+    freeBodyTable(&index->slots);
+    index->annuli = NULL;
+    index->bands = NULL;
+    index->bandReach = NULL;
+    index->cellStart = NULL;
+    index->bodyIds = NULL;
+    index->orbits = NULL;
+    index->count = 0;
+    index->annulusCount = 0;
+    index->bandCount = 0;
+}
+
+// First slot in [begin, end) whose epoch phase is >= phase.
+static int lowerBoundPhase(const DestinationIndex *index, int begin, int end, double phase) {
+    while (begin < end) {
+        int mid = begin + (end - begin) / 2;
+        if (index->orbits[mid].longitude < phase)
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+    return begin;
+}
+
+// First band of class c, and the end of the class's bands whose periapsis is
+// at most radius. Walking back from there, a band can reach down to radius r
+// only while bandReach >= r.
+static int firstBandOfClass(const DestinationIndex *index, int c) {
+    return c > 0 ? index->bandClassEnd[c - 1] : 0;
+}
+
+static int bandsWithPeriapsisBelow(const DestinationIndex *index, int c, double radius) {
+    int lo = firstBandOfClass(index, c), hi = index->bandClassEnd[c];
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (index->bands[mid].radiusMin <= radius)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+typedef struct NearestSet NearestSet;
+
+// Candidates waiting to be evaluated, possibly from several queries, each
+// with the query's time and the set it goes to.
+typedef struct {
+    int count;
+    int slots[NEAREST_BATCH];
+    double times[NEAREST_BATCH];
+    NearestSet *sets[NEAREST_BATCH];
+} CandidateBatch;
+
+// One nearest-body query. Keeps the k nearest candidates in ascending order
+// of distance; the search limit, and the sector it implies, shrink once k
+// have been found.
+struct NearestSet {
+    Vector3D pos;
+    double time;
+    double dt;                     // time - epoch
+    double shipPhase;              // in revolutions
+    double rho, r;                 // distance from the Sun's axis and from the Sun
+    int k;
+    int found;
+    int *ids;
+    double *distances;
+    double limit, limitSquared;
+    double halfWidth;              // of the sector that can lie within limit, in revolutions
+    CandidateBatch *batch;         // where its candidates wait, shared by a batch of queries
+};
+
+// Half-width in revolutions of the sector, seen from the Sun, of the points within limit of a ship rho from its axis.
+static double sectorHalfWidth(double rho, double limit) {
+    return rho > limit ? asin(limit / rho) / (2 * PI) + PHASE_MARGIN : 0.5;
+}
+
+static void initNearestSet(NearestSet *set, const DestinationIndex *index, Vector3D pos, double time,
+                           double maxDistance, int k, int *ids, double *distances, CandidateBatch *batch) {
+    set->pos = pos;
+    set->time = time;
+    set->dt = time - index->epoch;
+    set->shipPhase = atan2(pos.y, pos.x) / (2 * PI);
+    set->rho = sqrt(pos.x * pos.x + pos.y * pos.y);
+    set->r = sqrt(set->rho * set->rho + pos.z * pos.z);
+    set->k = k;
+    set->found = 0;
+    set->ids = ids;
+    set->distances = distances;
+    set->limit = maxDistance;
+    set->limitSquared = maxDistance * maxDistance;
+    set->halfWidth = sectorHalfWidth(set->rho, maxDistance);
+    set->batch = batch;
+}
+
+static void addCandidate(const DestinationIndex *index, int slot, double d2, NearestSet *set) {
+    if (d2 >= set->limitSquared)
+        return;
+    double d = sqrt(d2);
+    int i = set->found < set->k ? set->found++ : set->k - 1;
+    while (i > 0 && set->distances[i - 1] > d) {
+        set->distances[i] = set->distances[i - 1];
+        set->ids[i] = set->ids[i - 1];
+        i--;
+    }
+    set->distances[i] = d;
+    set->ids[i] = index->bodyIds[slot];
+    if (set->found == set->k) {
+        set->limit = set->distances[set->k - 1];
+        set->limitSquared = set->limit * set->limit;
+        set->halfWidth = sectorHalfWidth(set->rho, set->limit);
+    }
+}
+
+// Evaluates the waiting candidates, in one batched kernel call unless there
+// are only a few, and hands each to its query's set in the order they came.
+static void flushCandidates(const DestinationIndex *index, CandidateBatch *batch) {
+    double columns[BODY_TABLE_COLUMNS * NEAREST_BATCH];
+    double x[NEAREST_BATCH], y[NEAREST_BATCH], z[NEAREST_BATCH];
+    if (batch->count < NEAREST_MIN_BATCH) {
+        for (int i = 0; i < batch->count; i++) {
+            Vector3D body = computeBodyPosition(&index->slots, batch->slots[i], batch->times[i]);
+            x[i] = body.x;
+            y[i] = body.y;
+            z[i] = body.z;
+        }
+    } else {
+        BodyTable gathered;
+        gatherBodyTable(&index->slots, batch->slots, batch->count, columns, &gathered);
+        computeBodyPositionsAtTimes(&gathered, batch->times, x, y, z);
+    }
+    for (int i = 0; i < batch->count; i++) {
+        NearestSet *set = batch->sets[i];
+        double dx = x[i] - set->pos.x, dy = y[i] - set->pos.y, dz = z[i] - set->pos.z;
+        addCandidate(index, batch->slots[i], dx * dx + dy * dy + dz * dz, set);
+    }
+    batch->count = 0;
+}
+
+static void testCandidate(const DestinationIndex *index, int slot, NearestSet *set) {
+    CandidateBatch *batch = set->batch;
+    batch->slots[batch->count] = slot;
+    batch->times[batch->count] = set->time;
+    batch->sets[batch->count++] = set;
+    if (batch->count == NEAREST_BATCH)
+        flushCandidates(index, batch);
+}
+
+// Tests the bodies of [begin, end) whose periapsis-apoapsis shell comes within
+// the limit of centre (the ship's distance from the Sun, or from its axis for
+// circular bodies), whose mean anomaly folded into [0, 0.5] is between
+// anomalyLo and anomalyHi, and whose own longitude can be within the sector.
+static void scanSlots(const DestinationIndex *index, int begin, int end, double centre, double anomalyLo,
+                      double anomalyHi, NearestSet *set) {
+    int anyAnomaly = anomalyLo <= 0.0 && anomalyHi >= 0.5;
+    for (int slot = begin; slot < end; slot++) {
+        const SlotOrbit *orbit = &index->orbits[slot];
+        double a = orbit->axis, e = orbit->eccentricity;
+        if (a * (1.0 - e) > centre + set->limit || a * (1.0 + e) < centre - set->limit)
+            continue;
+        double offset = orbit->longitude + orbit->meanMotion * set->dt - set->shipPhase;
+        if (fabs(offset - nearbyint(offset)) > set->halfWidth + orbit->slack)
+            continue;
+        if (!anyAnomaly) {
+            double anomaly = orbit->anomaly + orbit->meanMotion * set->time;
+            anomaly = fabs(anomaly - nearbyint(anomaly));
+            if (anomaly < anomalyLo || anomaly > anomalyHi)
+                continue;
+            // Two steps of E = M + e sin E from E = M leave E within e^3 of
+            // the eccentric anomaly, and the distance a (1 - e cos E) within a e^4.
+            double m = 2 * PI * anomaly;
+            double E = m + e * sin(m + e * sin(m));
+            double distance = a * (1.0 - e * cos(E)), error = a * e * e * e * e;
+            if (distance - error > centre + set->limit || distance + error < centre - set->limit)
+                continue;
+        }
+        testCandidate(index, slot, set);
+    }
+}
+
+// Slot ranges of [begin, end) whose epoch phase lies in the window of width
+// revolutions from start, wrapping at 1. Stores up to two [begin, end) pairs
+// in ranges and returns how many.
+static int phaseRanges(const DestinationIndex *index, int begin, int end, double start, double width, int *ranges) {
+    if (width >= 1.0) {
+        ranges[0] = begin;
+        ranges[1] = end;
+        return 1;
+    }
+    start = fractionalPart(start);
+    double stop = start + width;
+    int first = lowerBoundPhase(index, begin, end, start);
+    ranges[0] = first;
+    if (stop <= 1.0) {
+        ranges[1] = lowerBoundPhase(index, first, end, stop);
+        return 1;
+    }
+    ranges[1] = end;
+    ranges[2] = begin;
+    ranges[3] = lowerBoundPhase(index, begin, first, stop - 1.0);
+    return 2;
+}
+
+// Smallest and largest phase shift, -motion * dt, of an annulus or band
+// between the epoch offsets dtLo and dtHi: a body now at phase p was at
+// phase p - n * dt at the epoch.
+static void phaseShifts(const IndexAnnulus *annulus, double dtLo, double dtHi, double *shiftLo, double *shiftHi) {
+    double shifts[4] = { -annulus->motionMin * dtLo, -annulus->motionMax * dtLo,
+                         -annulus->motionMin * dtHi, -annulus->motionMax * dtHi };
+    *shiftLo = shifts[0];
+    *shiftHi = shifts[0];
+    for (int k = 1; k < 4; k++) {
+        *shiftLo = shifts[k] < *shiftLo ? shifts[k] : *shiftLo;
+        *shiftHi = shifts[k] > *shiftHi ? shifts[k] : *shiftHi;
+    }
+}
+
+// Slot ranges of an annulus whose bodies' longitude can fall within halfWidth
+// of shipPhase at some time between the epoch offsets dtLo and dtHi.
+// Stores up to two [begin, end) pairs in ranges and returns how many.
+static int sectorRanges(const DestinationIndex *index, const IndexAnnulus *annulus, double shipPhase,
+                        double halfWidth, double dtLo, double dtHi, int ranges[4]) {
+    double shiftLo, shiftHi;
+    phaseShifts(annulus, dtLo, dtHi, &shiftLo, &shiftHi);
+    return phaseRanges(index, annulus->begin, annulus->end, shipPhase - halfWidth + shiftLo,
+                       2 * halfWidth + (shiftHi - shiftLo), ranges);
+}
+
+// Largest (largest != 0) or smallest value of ratio / e over the band's eccentricities.
+static double overEccentricity(const IndexAnnulus *band, double ratio, int largest) {
+    double far = ratio / band->eccentricityMax;
+    double near = band->eccentricityMin > 0.0 ? ratio / band->eccentricityMin
+                                              : (ratio > 0.0 ? INFINITY : (ratio < 0.0 ? -INFINITY : 0.0));
+    return (near > far) == (largest != 0) ? near : far;
+}
+
+// True anomaly, in radians, at the eccentric anomaly E in [0, pi].
+static double trueAnomaly(double E, double e) {
+    return 2 * atan2(sqrt(1.0 + e) * sin(0.5 * E), sqrt(1.0 - e) * cos(0.5 * E));
+}
+
+// An arc of mean anomaly at the epoch, the bounds of the mean anomaly folded
+// into [0, 0.5] on it at the query time, and how far the mean longitude at
+// the epoch of a body on it can be from the body's ecliptic longitude at the
+// query time, give or take the reduction to the ecliptic: lag to lag +
+// lagWidth. All in revolutions.
+typedef struct {
+    double start, width;
+    double anomalyLo, anomalyHi;
+    double lag, lagWidth;
+} AnomalyArc;
+
+// First row of a band's grid an arc reaches, and how many rows it spans.
+static void arcRows(const IndexAnnulus *band, const AnomalyArc *arc, int *row, int *rows) {
+    int grid = band->grid;
+    double start = fractionalPart(arc->start);
+    int first = (int)(start * grid);
+    *row = first < grid ? first : grid - 1;
+    *rows = arc->width >= 1.0 ? grid : (int)floor((start + arc->width) * grid) - *row + 1;
+    *rows = *rows < grid ? *rows : grid;
+}
+
+// Arc of mean anomalies at the query time from low to high, mapped back to
+// the epoch, for bodies whose equation of the centre (true less mean
+// anomaly) runs from centreLo to centreHi there.
+static AnomalyArc anomalyArc(double low, double high, double centreLo, double centreHi, double shiftLo,
+                             double spread) {
+    double folded = fmin(fabs(low), fabs(high));
+    AnomalyArc arc = { low + shiftLo, high - low + spread, low < 0.0 && high > 0.0 ? 0.0 : folded,
+                       fmin(fmax(fabs(low), fabs(high)), 0.5), shiftLo - centreHi, centreHi - centreLo + spread };
+    return arc;
+}
+
+// Arcs of mean anomaly holding the bodies of a band that can be between
+// radiusLo and radiusHi from the Sun at some time between the epoch offsets
+// dtLo and dtHi. A body's distance a (1 - e cos E) only falls in that range
+// for eccentric anomalies E within +-[E1, E2], bounded over the band's
+// semi-major axes and eccentricities; those are mean anomalies within
+// +-[m1, m2] (M = E - e sin E) and true anomalies within +-[v1, v2]. The
+// equation of the centre is at most 2 asin(e) either way. Arcs that reach the
+// same row of the band's grid are merged so that no cell is visited twice.
+// Stores up to two arcs and returns how many.
+static int anomalyArcs(const IndexAnnulus *band, double radiusLo, double radiusHi, double dtLo, double dtHi,
+                       AnomalyArc arcs[2]) {
+    double shiftLo, shiftHi;
+    phaseShifts(band, dtLo, dtHi, &shiftLo, &shiftHi);
+    double spread = shiftHi - shiftLo;
+    double centre = asin(band->eccentricityMax) / PI + PHASE_MARGIN;
+    AnomalyArc whole = anomalyArc(0.0, 1.0, -centre, centre, shiftLo, spread);
+    if (band->eccentricityMax <= 0.0) {
+        arcs[0] = whole;
+        return 1;
+    }
+    // cos E = (1 - r / a) / e, smallest for the smallest a and largest for the largest.
+    double cosMin = overEccentricity(band, 1.0 - radiusHi / band->axisMin, 0);
+    double cosMax = overEccentricity(band, 1.0 - radiusLo / band->axisMax, 1);
+    if (cosMin > 1.0 || cosMax < -1.0)
+        return 0;
+    double low = cosMax < 1.0 ? acos(cosMax) : 0.0;
+    double high = cosMin > -1.0 ? acos(cosMin) : PI;
+    // Over [0, pi], M grows with E and falls with e; the true anomaly grows with both.
+    double m1 = (low - band->eccentricityMax * sin(low)) / (2 * PI) - PHASE_MARGIN;
+    double m2 = (high - band->eccentricityMin * sin(high)) / (2 * PI) + PHASE_MARGIN;
+    double v1 = trueAnomaly(low, band->eccentricityMin) / (2 * PI) - PHASE_MARGIN;
+    double v2 = trueAnomaly(high, band->eccentricityMax) / (2 * PI) + PHASE_MARGIN;
+    // The arcs +-[m1, m2], widened by the spread, meet around 0 and around half a revolution.
+    int meetAtZero = 2 * m1 <= spread, meetAtHalf = 2 * m2 >= 1.0 - spread;
+    if (!meetAtZero && !meetAtHalf) {
+        // Ahead of periapsis the true anomaly leads the mean anomaly, behind it it trails.
+        AnomalyArc ahead = anomalyArc(m1, m2, fmax(v1 - m2, 0.0), fmin(v2 - m1, centre), shiftLo, spread);
+        AnomalyArc behind = anomalyArc(-m2, -m1, fmax(m1 - v2, -centre), fmin(m2 - v1, 0.0), shiftLo, spread);
+        int aheadRow, aheadRows, behindRow, behindRows;
+        arcRows(band, &ahead, &aheadRow, &aheadRows);
+        arcRows(band, &behind, &behindRow, &behindRows);
+        int grid = band->grid;
+        if ((behindRow - aheadRow + grid) % grid >= aheadRows && (aheadRow - behindRow + grid) % grid >= behindRows) {
+            arcs[0] = ahead;
+            arcs[1] = behind;
+            return 2;
+        }
+        meetAtZero = 2 * m2 <= 1.0 - 2 * m1;
+        meetAtHalf = !meetAtZero;
+    }
+    if (meetAtZero && meetAtHalf)
+        arcs[0] = whole;
+    else if (meetAtZero)
+        arcs[0] = anomalyArc(-m2, m2, -fmin(v2, centre), fmin(v2, centre), shiftLo, spread);
+    else
+        arcs[0] = anomalyArc(m1, 1.0 - m1, -centre, centre, shiftLo, spread);
+    return 1;
+}
+
+// Slot ranges of a band's grid cells that can hold a body of arc whose
+// ecliptic longitude comes within reach of phase. Stores up to two
+// [begin, end) pairs per row in ranges and returns how many.
+static int arcRanges(const DestinationIndex *index, const IndexAnnulus *band, const AnomalyArc *arc, double phase,
+                     double reach, int *ranges) {
+    int grid = band->grid;
+    int row, rows;
+    arcRows(band, arc, &row, &rows);
+    int columns[4] = { 0, grid - 1, 0, 0 };
+    int pieces = 1;
+    double width = arc->lagWidth + 2 * reach;
+    if (width < 1.0) {
+        double start = fractionalPart(phase - reach + arc->lag);
+        int first = (int)(start * grid);
+        int last = (int)floor((start + width) * grid);
+        first = first < grid ? first : grid - 1;
+        if (last < grid) {
+            columns[0] = first;
+            columns[1] = last;
+        } else if (last - grid < first) {
+            columns[0] = first;
+            columns[2] = 0;
+            columns[3] = last - grid;
+            pieces = 2;
+        }
+    }
+    const int *cells = index->cellStart + band->cellBase;
+    int count = 0;
+    for (int k = 0; k < rows; k++) {
+        int r = (row + k) % grid;
+        for (int p = 0; p < pieces; p++) {
+            ranges[2 * count] = cells[r * grid + columns[2 * p]];
+            ranges[2 * count + 1] = cells[r * grid + columns[2 * p + 1] + 1];
+            count += ranges[2 * count] < ranges[2 * count + 1];
+        }
+    }
+    return count;
+}
+
+// Scans the bodies of an annulus that can be within the limit at the query time.
+static void scanSector(const DestinationIndex *index, const IndexAnnulus *annulus, double centre, NearestSet *set) {
+    int ranges[4];
+    int count = sectorRanges(index, annulus, set->shipPhase, set->halfWidth, set->dt, set->dt, ranges);
+    for (int r = 0; r < count; r++)
+        scanSlots(index, ranges[2 * r], ranges[2 * r + 1], centre, 0.0, 0.5, set);
+}
+
+// Scans the bodies of a band that can be within the limit at the query time:
+// those whose distance from the Sun can come within the limit of the ship's
+// and whose longitude, on that part of the orbit, can be within the sector.
+static void scanBand(const DestinationIndex *index, const IndexAnnulus *band, NearestSet *set) {
+    AnomalyArc arcs[2];
+    int arcCount = anomalyArcs(band, set->r - set->limit, set->r + set->limit, set->dt, set->dt, arcs);
+    for (int a = 0; a < arcCount; a++) {
+        int ranges[4 * BAND_MAX_GRID];
+        int count = arcRanges(index, band, &arcs[a], set->shipPhase, set->halfWidth + band->reduction, ranges);
+        for (int r = 0; r < count; r++)
+            scanSlots(index, ranges[2 * r], ranges[2 * r + 1], set->r, arcs[a].anomalyLo, arcs[a].anomalyHi, set);
+    }
+}
+
+// Walks the annuli and bands that can hold a body within the set's limit,
+// queueing their candidates on the set's batch.
+static void searchNearest(const DestinationIndex *index, NearestSet *set) {
+    // Circular bodies stay in the ecliptic, so a ship too far above it cannot reach them.
+    if (fabs(set->pos.z) < set->limit) {
+        // First annulus that can reach the ship's radius.
+        int lo = 0, hi = index->annulusCount;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (index->annuli[mid].radiusMax < set->rho - set->limit)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (int a = lo; a < index->annulusCount && index->annuli[a].radiusMin <= set->rho + set->limit; a++)
+            scanSector(index, &index->annuli[a], set->rho, set);
+    }
+
+    // Bands whose periapsis-apoapsis shell reaches the ship's distance from the Sun.
+    for (int c = 0; c < INDEX_ECCENTRICITY_CLASSES; c++) {
+        int first = firstBandOfClass(index, c);
+        for (int b = bandsWithPeriapsisBelow(index, c, set->r + set->limit) - 1;
+             b >= first && index->bandReach[b] >= set->r - set->limit; b--) {
+            if (index->bands[b].radiusMax >= set->r - set->limit)
+                scanBand(index, &index->bands[b], set);
+        }
+    }
+}
+
+int findNearestDestinations(const DestinationIndex *index, Vector3D pos, double time,
+                            double maxDistance, int k, int *ids, double *distances) {
+    if (k <= 0 || index->count == 0)
+        return 0;
+    CandidateBatch batch;
+    NearestSet set;
+    batch.count = 0;
+    initNearestSet(&set, index, pos, time, maxDistance, k, ids, distances, &batch);
+    searchNearest(index, &set);
+    if (batch.count > 0)
+        flushCandidates(index, &batch);
+    return set.found;
+}
+
+int findNearestDestination(const DestinationIndex *index, Vector3D pos, double time,
+                           double maxDistance, double *distance) {
+    int id;
+    double d;
+    if (findNearestDestinations(index, pos, time, maxDistance, 1, &id, &d) == 0)
+        return -1;
+    if (distance != NULL)
+        *distance = d;
+    return id;
+}
+
+void findNearestDestinationBatch(const DestinationIndex *index, const Vector3D *positions, const double *times,
+                                 int count, double maxDistance, int *ids, double *distances) {
+    NearestSet sets[NEAREST_GROUP];
+    SortEntry order[NEAREST_GROUP];
+    double nearest[NEAREST_GROUP];
+    CandidateBatch batch;
+    batch.count = 0;
+    for (int first = 0; first < count; first += NEAREST_GROUP) {
+        int size = count - first < NEAREST_GROUP ? count - first : NEAREST_GROUP;
+        for (int i = 0; i < size; i++) {
+            ids[first + i] = -1;
+            initNearestSet(&sets[i], index, positions[first + i], times[first + i], maxDistance, 1, &ids[first + i],
+                           distances != NULL ? &distances[first + i] : &nearest[i], &batch);
+            // Shell of width maxDistance first, then longitude: neighbouring
+            // queries walk the same annuli, bands and sectors.
+            order[i].key = (maxDistance > 0.0 ? floor(sets[i].r / maxDistance) : 0.0) +
+                           fractionalPart(sets[i].shipPhase);
+            order[i].id = i;
+        }
+        if (index->count == 0)
+            continue;
+        // A handful of bodies are cheaper to walk than the queries are to sort.
+        if (index->count > NEAREST_GROUP)
+            qsort(order, (size_t)size, sizeof(SortEntry), compareSortEntry);
+        for (int n = 0; n < size; n++)
+            searchNearest(index, &sets[order[n].id]);
+        // The sets are reused by the next group.
+        if (batch.count > 0)
+            flushCandidates(index, &batch);
+    }
+}
+
+// One swept search. encounters holds the capacity earliest found so far, in time order.
+typedef struct {
+    const DestinationIndex *index;
+    Vector3D from;
+    Vector3D velocity;              // the ship's, AU/day
+    double fromTime, toTime;
+    double shipSpeed;
+    double radiusMin, radiusMax;    // distances from the Sun the transit covers
+    double maxDistance;
+    int capacity;
+    int found;
+    SweptEncounter *encounters;
+} SweptQuery;
+
+static void recordEncounter(SweptQuery *query, int id, double time, double distance) {
+    query->found++;
+    int i = query->found <= query->capacity ? query->found - 1 : query->capacity;
+    while (i > 0 && query->encounters[i - 1].time > time) {
+        if (i < query->capacity)
+            query->encounters[i] = query->encounters[i - 1];
+        i--;
+    }
+    if (i < query->capacity) {
+        query->encounters[i].id = id;
+        query->encounters[i].time = time;
+        query->encounters[i].distance = distance;
+    }
+}
+
+static Vector3D shipAt(const SweptQuery *query, double time) {
+    double dt = time - query->fromTime;
+    Vector3D ship = { query->from.x + dt * query->velocity.x, query->from.y + dt * query->velocity.y,
+                      query->from.z + dt * query->velocity.z };
+    return ship;
+}
+
+typedef struct {
+    double begin, end;
+    Vector3D beginBody, endBody;
+    int level;                      // halvings from the whole transit
+} SweepInterval;
+
+// Closest approach of one candidate whose orbit shell reaches the transit's
+// distances from the Sun. Over an interval of length L a body strays from the
+// chord between its end positions by at most accelerationMax * L^2 / 8, and
+// the ship's motion is exactly linear, so the distance cannot drop below the
+// closest approach of ship and chord less that sag. Intervals whose bound
+// cannot beat the best distance seen, or maxDistance, are dropped; the rest
+// are halved until the sag is below SWEEP_DISTANCE_TOLERANCE, evaluating the
+// distance at each chord's closest approach on the way. A halving quarters
+// the sag, which fixes the number of levels up front; searched depth first,
+// the stack holds at most one pending interval per level and the two halves
+// just split, and bringing even a sag of DBL_MAX AU under the tolerance takes
+// (1024 + 20) / 2 levels, so SWEEP_STACK never runs out.
+static void sweepCandidate(SweptQuery *query, int slot) {
+    const BodyTable *slots = &query->index->slots;
+    double a = slots->orbitRadius[slot];
+    double e = slots->eccentricity[slot];
+    if (a * (1.0 - e) > query->radiusMax + query->maxDistance || a * (1.0 + e) < query->radiusMin - query->maxDistance)
+        return;
+    double motion = 2 * PI * slots->meanMotion[slot];
+    double speedMax = query->shipSpeed + motion * a * sqrt((1.0 + e) / (1.0 - e));
+    double accelerationMax = motion * motion * a / ((1.0 - e) * (1.0 - e));
+
+    double transit = query->toTime - query->fromTime;
+    double sagMax = 0.125 * accelerationMax * transit * transit;
+    if (!isfinite(sagMax))
+        return;
+    int levels = 0;
+    for (double sag = sagMax; sag > SWEEP_DISTANCE_TOLERANCE; sag *= 0.25)
+        levels++;
+
+    SweepInterval stack[SWEEP_STACK];
+    int top = 0;
+    stack[top].begin = query->fromTime;
+    stack[top].end = query->toTime;
+    stack[top].level = 0;
+    stack[top].beginBody = computeBodyPosition(slots, slot, query->fromTime);
+    double best = calculateDistance(query->from, stack[top].beginBody), bestTime = query->fromTime;
+    // Nothing this far away can close in during the transit.
+    if (best - speedMax * transit >= query->maxDistance)
+        return;
+    stack[top].endBody = computeBodyPosition(slots, slot, query->toTime);
+    top++;
+    while (top > 0) {
+        SweepInterval interval = stack[--top];
+        double length = interval.end - interval.begin;
+        Vector3D shipBegin = shipAt(query, interval.begin), shipEnd = shipAt(query, interval.end);
+        Vector3D relativeBegin = { shipBegin.x - interval.beginBody.x, shipBegin.y - interval.beginBody.y,
+                                   shipBegin.z - interval.beginBody.z };
+        Vector3D relativeEnd = { shipEnd.x - interval.endBody.x, shipEnd.y - interval.endBody.y,
+                                 shipEnd.z - interval.endBody.z };
+        double fraction;
+        double chord = segmentDistanceFromOrigin(relativeBegin, relativeEnd, &fraction);
+        double sag = 0.125 * accelerationMax * length * length;
+        if (chord - sag >= (best < query->maxDistance ? best : query->maxDistance))
+            continue;
+        double closest = fraction < 1.0 ? interval.begin + fraction * length : interval.end;
+        double distance = calculateDistance(shipAt(query, closest), computeBodyPosition(slots, slot, closest));
+        if (distance < best) {
+            best = distance;
+            bestTime = closest;
+        }
+        if (interval.level == levels)
+            continue;
+        double middle = interval.begin + 0.5 * length;
+        Vector3D middleBody = computeBodyPosition(slots, slot, middle);
+        SweepInterval early = { interval.begin, middle, interval.beginBody, middleBody, interval.level + 1 };
+        SweepInterval late = { middle, interval.end, middleBody, interval.endBody, interval.level + 1 };
+        // Search the half holding the chord's closest approach first so best tightens early.
+        stack[top++] = fraction < 0.5 ? late : early;
+        stack[top++] = fraction < 0.5 ? early : late;
+    }
+    if (best < query->maxDistance && bestTime > query->fromTime)
+        recordEncounter(query, query->index->bodyIds[slot], bestTime, best);
+}
+
+static void sweepSector(SweptQuery *query, const IndexAnnulus *annulus, double shipPhase, double halfWidth) {
+    int ranges[4];
+    int count = sectorRanges(query->index, annulus, shipPhase, halfWidth, query->fromTime - query->index->epoch,
+                             query->toTime - query->index->epoch, ranges);
+    for (int r = 0; r < count; r++) {
+        for (int slot = ranges[2 * r]; slot < ranges[2 * r + 1]; slot++)
+            sweepCandidate(query, slot);
+    }
+}
+
+// Sweeps the bodies of a band whose distance from the Sun can reach the
+// transit's and whose longitude, within its phase slack, can pass through the
+// transit's sector on the way.
+static void sweepBand(SweptQuery *query, const IndexAnnulus *band, double shipPhase, double halfWidth) {
+    const DestinationIndex *index = query->index;
+    double dtLo = query->fromTime - index->epoch, dtHi = query->toTime - index->epoch;
+    AnomalyArc arcs[2];
+    int arcCount = anomalyArcs(band, query->radiusMin - query->maxDistance, query->radiusMax + query->maxDistance,
+                               dtLo, dtHi, arcs);
+    for (int a = 0; a < arcCount; a++) {
+        int ranges[4 * BAND_MAX_GRID];
+        int count = arcRanges(index, band, &arcs[a], shipPhase, halfWidth + band->reduction, ranges);
+        for (int r = 0; r < count; r++) {
+            for (int slot = ranges[2 * r]; slot < ranges[2 * r + 1]; slot++) {
+                const SlotOrbit *orbit = &index->orbits[slot];
+                double reach = halfWidth + orbit->slack;
+                double width = 2 * reach + orbit->meanMotion * (dtHi - dtLo);
+                double start = orbit->longitude + orbit->meanMotion * dtLo - shipPhase - reach;
+                // Some whole number of revolutions lies in [start, start + width].
+                if (width < 1.0 && fractionalPart(-start) > width)
+                    continue;
+                sweepCandidate(query, slot);
+            }
+        }
+    }
+}
+
+int findSweptEncounters(const DestinationIndex *index, Vector3D from, double fromTime, Vector3D to, double toTime,
+                        double maxDistance, int capacity, SweptEncounter *encounters) {
+    double span = toTime - fromTime;
+    SweptQuery query = { index, from, { 0.0, 0.0, 0.0 }, fromTime, toTime, 0.0, 0.0, 0.0, maxDistance,
+                         capacity, 0, encounters };
+    if (span > 0.0) {
+        query.velocity.x = (to.x - from.x) / span;
+        query.velocity.y = (to.y - from.y) / span;
+        query.velocity.z = (to.z - from.z) / span;
+        query.shipSpeed = sqrt(query.velocity.x * query.velocity.x + query.velocity.y * query.velocity.y +
+                               query.velocity.z * query.velocity.z);
+    } else {
+        to = from;
+        query.toTime = fromTime;
+    }
+
+    // The Sun stays at the origin.
+    double fraction;
+    double r = segmentDistanceFromOrigin(from, to, &fraction);
+    if (r < maxDistance && fraction > 0.0)
+        recordEncounter(&query, SWEPT_SUN, fraction < 1.0 ? fromTime + fraction * span : query.toTime, r);
+    if (index->count == 0)
+        return query.found;
+
+    // Distances from the Sun, and in the ecliptic plane, that the transit covers.
+    double rMin = r;
+    double rMax = sqrt(from.x * from.x + from.y * from.y + from.z * from.z);
+    double rTo = sqrt(to.x * to.x + to.y * to.y + to.z * to.z);
+    rMax = rTo > rMax ? rTo : rMax;
+    query.radiusMin = rMin;
+    query.radiusMax = rMax;
+    Vector3D fromPlane = { from.x, from.y, 0.0 }, toPlane = { to.x, to.y, 0.0 };
+    double rhoMin = segmentDistanceFromOrigin(fromPlane, toPlane, &fraction);
+    double rhoFrom = sqrt(from.x * from.x + from.y * from.y), rhoTo = sqrt(to.x * to.x + to.y * to.y);
+    double rhoMax = rhoTo > rhoFrom ? rhoTo : rhoFrom;
+
+    // A segment clear of the Sun turns through less than half a revolution
+    // between its ends, and every point within maxDistance of it lies within
+    // asin(maxDistance / rhoMin) of that wedge.
+    double shipPhase = 0.0, halfWidth = 0.5;
+    if (rhoMin > maxDistance) {
+        double phaseFrom = atan2(from.y, from.x), phaseTo = atan2(to.y, to.x);
+        double turn = phaseTo - phaseFrom;
+        turn -= turn > PI ? 2 * PI : (turn < -PI ? -2 * PI : 0.0);
+        shipPhase = (phaseFrom + 0.5 * turn) / (2 * PI);
+        halfWidth = (0.5 * fabs(turn) + asin(maxDistance / rhoMin)) / (2 * PI) + PHASE_MARGIN;
+    }
+
+    // Circular bodies stay in the ecliptic.
+    double zMin = from.z * to.z <= 0.0 ? 0.0 : fmin(fabs(from.z), fabs(to.z));
+    if (zMin < maxDistance) {
+        int lo = 0, hi = index->annulusCount;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (index->annuli[mid].radiusMax < rhoMin - maxDistance)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (int a = lo; a < index->annulusCount && index->annuli[a].radiusMin <= rhoMax + maxDistance; a++)
+            sweepSector(&query, &index->annuli[a], shipPhase, halfWidth);
+    }
+    for (int c = 0; c < INDEX_ECCENTRICITY_CLASSES; c++) {
+        int first = firstBandOfClass(index, c);
+        for (int b = bandsWithPeriapsisBelow(index, c, rMax + maxDistance) - 1;
+             b >= first && index->bandReach[b] >= rMin - maxDistance; b--) {
+            if (index->bands[b].radiusMax >= rMin - maxDistance)
+                sweepBand(&query, &index->bands[b], shipPhase, halfWidth);
+        }
+    }
+    return query.found;
+}
@@ -0,0 +1,116 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include "planet.h"
+#include "ephemeris.h"
+
+// One radial annulus or band of the index. Bodies in [begin, end) of an
+// annulus are sorted by their mean longitude at the index epoch. For a band
+// the radius range covers the smallest periapsis to the largest apoapsis, and
+// the bodies are laid out on a grid x grid grid of mean anomaly (rows) by
+// mean longitude (columns), both at the epoch, cell by cell.
+typedef struct {
+    int begin;
+    int end;
+    double radiusMin, radiusMax;   // in AU
+    double axisMin, axisMax;       // semi-major axes, in AU
+    double eccentricityMin, eccentricityMax;
+    double motionMin, motionMax;   // in revolutions per day
+    double reduction;              // largest reduction to the ecliptic of a band's bodies, in revolutions
+    int grid;                      // of a band; cell c starts at slot cellStart[cellBase + c]
+    int cellBase;
+} IndexAnnulus;
+
+// Time-aware nearest-body index.
+// Circular orbits in the ecliptic are bucketed into annuli by orbit radius and
+// sorted by phase at the epoch. A query at time t maps the ship's angular
+// sector back to the epoch using each annulus's mean-motion range, so no body
+// outside the candidate sectors is touched. Queries far from the epoch get
+// wider sectors; rebuild with a new epoch when that happens.
+// Eccentric or inclined orbits have no fixed radius: a body's distance from
+// the Sun, a (1 - e cos E), follows its mean anomaly, and its ecliptic
+// longitude is its longitude of periapsis plus its true anomaly, give or take
+// the reduction to the ecliptic. They are split into up to
+// INDEX_ECCENTRICITY_CLASSES classes of equal size by eccentricity
+// (retrograde orbits last) and kept in bands by semi-major axis within each
+// class. A query turns a band's ranges of a and e into the arcs of mean
+// anomaly on which its bodies can come within the limit of the ship's
+// distance from the Sun, and the true anomalies they have there; the first
+// pick the rows of the band's grid, the second, with the ship's sector, the
+// columns. Bands hold a few times the square root of their class's size, so
+// a query looks at O(sqrt n) bands and a few cells of each. A class's bands
+// are ordered by periapsis with a running maximum of the apoapsis, so a query
+// walks only the bands whose shells can reach it. Retrograde orbits are only
+// filtered by distance from the Sun.
+#define INDEX_ECCENTRICITY_CLASSES 16
+
+// The elements the scans test of one slot, side by side, all angles in revolutions.
+typedef struct {
+    double axis;                   // semi-major axis, in AU
+    double eccentricity;
+    double meanMotion;             // in revolutions per day
+    double anomaly;                // mean anomaly at time 0
+    double longitude;              // mean longitude at the index epoch, [0, 1)
+    double slack;                  // largest gap between the ecliptic and the mean longitude, 0 for circular orbits
+} SlotOrbit;
+
+typedef struct {
+    double epoch;                  // in days
+    int count;
+    int annulusCount;
+    IndexAnnulus *annuli;          // circular bodies, slots [0, annuli[annulusCount - 1].end)
+    int bandCount;
+    IndexAnnulus *bands;           // other bodies, following the circular slots
+    double *bandReach;             // largest radiusMax of this and the earlier bands of its class
+    int bandClassEnd[INDEX_ECCENTRICITY_CLASSES];  // class c holds bands [bandClassEnd[c - 1], bandClassEnd[c])
+    int *cellStart;                // first slot of each cell of the bands' grids, and one past the last
+    int *bodyIds;                  // index into the source BodyTable
+    SlotOrbit *orbits;             // what the scans test of each slot
+    BodyTable slots;               // the source columns reordered by slot
+} DestinationIndex;
+
+// Builds the index over table at the given epoch. Returns 0 on success, -1 on allocation failure.
+int buildDestinationIndex(DestinationIndex *index, const BodyTable *table, double epoch);
+void freeDestinationIndex(DestinationIndex *index);
+
+// Returns the id of the body nearest to pos at time within maxDistance, or -1.
+// The distance is stored in *distance when it is not NULL.
+int findNearestDestination(const DestinationIndex *index, Vector3D pos, double time,
+                           double maxDistance, double *distance);
+
+// Fills ids/distances with up to k bodies within maxDistance, nearest first.
+// Returns the number of bodies found.
+int findNearestDestinations(const DestinationIndex *index, Vector3D pos, double time,
+                            double maxDistance, int k, int *ids, double *distances);
+
+// findNearestDestination for count queries at once, each at its own time:
+// ids[i] is the body nearest to positions[i] at times[i] within maxDistance,
+// or -1, and distances[i] its distance when distances is not NULL. The
+// queries are ordered by shell and longitude so that neighbours walk the same
+// annuli, bands and sectors, and the candidates of all of them are evaluated
+// together in full kernel batches. Results are those of findNearestDestination.
+void findNearestDestinationBatch(const DestinationIndex *index, const Vector3D *positions, const double *times,
+                                 int count, double maxDistance, int *ids, double *distances);
+
+// A close pass found by findSweptEncounters.
+typedef struct {
+    int id;                        // index into the source BodyTable, or SWEPT_SUN
+    double time;                   // of closest approach, in days
+    double distance;               // at closest approach, in AU
+} SweptEncounter;
+
+#define SWEPT_SUN -1
+
+// Finds every body, and the Sun, that comes within maxDistance of a ship
+// moving in a straight line from `from` at fromTime to `to` at toTime, with
+// the time and distance of each closest approach. A closest approach at
+// fromTime is left out: it is the body the ship is leaving, or one the
+// previous segment of a longer path already reported. Bodies are culled by
+// their orbit shells and phase sectors over the whole transit before the
+// distance is searched, so the cost follows the number of near candidates.
+// Stores the capacity earliest encounters in time order and returns how many
+// there were.
+int findSweptEncounters(const DestinationIndex *index, Vector3D from, double fromTime, Vector3D to, double toTime,
+                        double maxDistance, int capacity, SweptEncounter *encounters);
+
+#endif
@@ -0,0 +1,362 @@
+#include "stats.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STATS_CALIBRATION_SECONDS 0.01
+
+static const char *const probeNames[STATS_PROBE_COUNT] = {
+    "determine_destination",
+    "planet_position",
+    "hohmann_transfer",
+    "phasing_time",
+    "lambert",
+    "sweep_transit",
+    "batch_command",
+    "server_round",
+    "input_read",
+    "output_flush",
+    "catalog_load",
+};
+
+#if defined(NAVIGATOR_STATS)
+
+static double monotonicSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+_Thread_local StatsThread *statsThread;
+
+// Active threads' counters, counters of exited threads waiting for reuse, and
+// the totals those exited threads left behind.
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t statsOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t statsKey;
+static StatsThread *activeThreads;
+static StatsThread *freeThreads;
+static StatsTotals retiredTotals[STATS_PROBE_COUNT];
+static uint64_t startTicks;
+static double startSeconds;
+
+static void addCounters(StatsTotals *totals, const StatsCounters *counters) {
+    totals->calls += atomic_load_explicit(&counters->calls, memory_order_relaxed);
+    totals->samples += atomic_load_explicit(&counters->samples, memory_order_relaxed);
+    totals->ticks += atomic_load_explicit(&counters->ticks, memory_order_relaxed);
+    uint64_t maxTicks = atomic_load_explicit(&counters->maxTicks, memory_order_relaxed);
+    if (maxTicks > totals->maxTicks)
+        totals->maxTicks = maxTicks;
+    for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++)
+        totals->histogram[b] += atomic_load_explicit(&counters->histogram[b], memory_order_relaxed);
+}
+
+// Thread exit: folds the thread's counters into the retired totals and keeps the block for reuse.
+static void retireThread(void *value) {
+    StatsThread *thread = value;
+    pthread_mutex_lock(&statsLock);
+    for (int p = 0; p < STATS_PROBE_COUNT; p++)
+        addCounters(&retiredTotals[p], &thread->probes[p]);
+    for (StatsThread **link = &activeThreads; *link != NULL; link = &(*link)->next) {
+        if (*link == thread) {
+            *link = thread->next;
+            break;
+        }
+    }
+    thread->next = freeThreads;
+    freeThreads = thread;
+    pthread_mutex_unlock(&statsLock);
+}
+
+static void initializeStats(void) {
+    pthread_key_create(&statsKey, retireThread);
+    startTicks = statsTimestamp();
+    startSeconds = monotonicSeconds();
+}
+
+StatsThread *statsAttachThread(void) {
+    pthread_once(&statsOnce, initializeStats);
+    pthread_mutex_lock(&statsLock);
+    StatsThread *thread = freeThreads;
+    if (thread != NULL) {
+        freeThreads = thread->next;
+    } else {
+        thread = aligned_alloc(64, (sizeof(StatsThread) + 63) / 64 * 64);
+        if (thread == NULL) {
+            pthread_mutex_unlock(&statsLock);
+            abort();
+        }
+    }
+    memset(thread, 0, sizeof(*thread));
+    thread->next = activeThreads;
+    activeThreads = thread;
+    pthread_mutex_unlock(&statsLock);
+    pthread_setspecific(statsKey, thread);
+    statsThread = thread;
+    return thread;
+}
+
+static int histogramBucket(uint64_t ticks) {
+    int bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+    return bucket < STATS_HISTOGRAM_BUCKETS ? bucket : STATS_HISTOGRAM_BUCKETS - 1;
+}
+
+void statsRecord(StatsProbe probe, uint64_t ticks) {
+    StatsCounters *counters = &statsThread->probes[probe];
+    atomic_store_explicit(&counters->samples,
+                          atomic_load_explicit(&counters->samples, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&counters->ticks,
+                          atomic_load_explicit(&counters->ticks, memory_order_relaxed) + ticks, memory_order_relaxed);
+    if (ticks > atomic_load_explicit(&counters->maxTicks, memory_order_relaxed))
+        atomic_store_explicit(&counters->maxTicks, ticks, memory_order_relaxed);
+    _Atomic uint64_t *bucket = &counters->histogram[histogramBucket(ticks)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+// Ticks per second, measured against the monotonic clock since the first probe.
+static double tickRate(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ticks0 = startTicks;
+    double seconds0 = startSeconds;
+    if (monotonicSeconds() - seconds0 < STATS_CALIBRATION_SECONDS) {
+        // Too soon after start for a precise ratio: measure a short interval.
+        ticks0 = statsTimestamp();
+        seconds0 = monotonicSeconds();
+        while (monotonicSeconds() - seconds0 < STATS_CALIBRATION_SECONDS)
+            ;
+    }
+    uint64_t ticks = statsTimestamp();
+    double seconds = monotonicSeconds();
+    return (double)(ticks - ticks0) / (seconds - seconds0);
+#else
+    return 1e9;
+#endif
+}
+
+int statsEnabled(void) {
+    return 1;
+}
+
+double collectStats(StatsTotals totals[STATS_PROBE_COUNT]) {
+    pthread_once(&statsOnce, initializeStats);
+    pthread_mutex_lock(&statsLock);
+    memcpy(totals, retiredTotals, sizeof(retiredTotals));
+    for (const StatsThread *thread = activeThreads; thread != NULL; thread = thread->next) {
+        for (int p = 0; p < STATS_PROBE_COUNT; p++)
+            addCounters(&totals[p], &thread->probes[p]);
+    }
+    pthread_mutex_unlock(&statsLock);
+    return tickRate();
+}
+
+#else
+
+int statsEnabled(void) {
+    return 0;
+}
+
+double collectStats(StatsTotals totals[STATS_PROBE_COUNT]) {
+    memset(totals, 0, STATS_PROBE_COUNT * sizeof(StatsTotals));
+    return 0.0;
+}
+
+#endif
+
+// Ticks below which a fraction q of the timed calls fell, interpolated inside its log2 bucket.
+static double histogramQuantile(const StatsTotals *totals, double q) {
+    double target = q * (double)totals->samples;
+    double seen = 0.0;
+    for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+        double count = (double)totals->histogram[b];
+        if (count > 0.0 && seen + count >= target) {
+            double low = b == 0 ? 0.0 : ldexp(1.0, b - 1), high = ldexp(1.0, b);
+            return low + (high - low) * (target - seen) / count;
+        }
+        seen += count;
+    }
+    return (double)totals->maxTicks;
+}
+
+static void formatDuration(char *dest, size_t size, double seconds) {
+    if (seconds < 1e-6)
+        snprintf(dest, size, "%.0f ns", seconds * 1e9);
+    else if (seconds < 1e-3)
+        snprintf(dest, size, "%.2f us", seconds * 1e6);
+    else if (seconds < 1.0)
+        snprintf(dest, size, "%.2f ms", seconds * 1e3);
+    else
+        snprintf(dest, size, "%.2f s", seconds);
+}
+
+void printStats(FILE *out) {
+    if (!statsEnabled()) {
+        fprintf(out, "Statistics are compiled out; rebuild with NAVIGATOR_STATS defined.\n");
+        return;
+    }
+    StatsTotals totals[STATS_PROBE_COUNT];
+    double rate = collectStats(totals);
+    fprintf(out, "\n%-22s %12s %9s %10s %10s %10s %10s\n",
+            "Probe", "Calls", "Timed", "Mean", "p50", "p99", "Max");
+    for (int p = 0; p < STATS_PROBE_COUNT; p++) {
+        const StatsTotals *t = &totals[p];
+        if (t->calls == 0)
+            continue;
+        char mean[16] = "-", p50[16] = "-", p99[16] = "-", max[16] = "-";
+        if (t->samples > 0) {
+            formatDuration(mean, sizeof(mean), (double)t->ticks / t->samples / rate);
+            formatDuration(p50, sizeof(p50), histogramQuantile(t, 0.5) / rate);
+            formatDuration(p99, sizeof(p99), histogramQuantile(t, 0.99) / rate);
+            formatDuration(max, sizeof(max), (double)t->maxTicks / rate);
+        }
+        fprintf(out, "%-22s %12llu %9llu %10s %10s %10s %10s\n", probeNames[p],
+                (unsigned long long)t->calls, (unsigned long long)t->samples, mean, p50, p99, max);
+    }
+    fprintf(out, "One call in %d is timed (every I/O call); timer rate %.3f GHz.\n", STATS_SAMPLE_INTERVAL, rate * 1e-9);
+}
+
+void writeStatsText(FILE *out) {
+    StatsTotals totals[STATS_PROBE_COUNT];
+    double rate = collectStats(totals);
+    fprintf(out, "# HELP navigator_stats_enabled Whether hot-path probes are compiled in.\n");
+    fprintf(out, "# TYPE navigator_stats_enabled gauge\n");
+    fprintf(out, "navigator_stats_enabled %d\n", statsEnabled());
+    if (!statsEnabled())
+        return;
+
+    fprintf(out, "# HELP navigator_timer_ticks_per_second Rate of the timer behind the latency histograms.\n");
+    fprintf(out, "# TYPE navigator_timer_ticks_per_second gauge\n");
+    fprintf(out, "navigator_timer_ticks_per_second %.0f\n", rate);
+
+    fprintf(out, "# HELP navigator_calls_total Calls through each instrumented path.\n");
+    fprintf(out, "# TYPE navigator_calls_total counter\n");
+    for (int p = 0; p < STATS_PROBE_COUNT; p++)
+        fprintf(out, "navigator_calls_total{probe=\"%s\"} %llu\n", probeNames[p], (unsigned long long)totals[p].calls);
+
+    fprintf(out, "# HELP navigator_latency_seconds Latency of timed calls (one in %d, every I/O call).\n", STATS_SAMPLE_INTERVAL);
+    fprintf(out, "# TYPE navigator_latency_seconds histogram\n");
+    for (int p = 0; p < STATS_PROBE_COUNT; p++) {
+        const StatsTotals *t = &totals[p];
+        int last = 0;
+        for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+            if (t->histogram[b] != 0)
+                last = b;
+        }
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= last && t->samples > 0; b++) {
+            cumulative += t->histogram[b];
+            fprintf(out, "navigator_latency_seconds_bucket{probe=\"%s\",le=\"%.3g\"} %llu\n",
+                    probeNames[p], ldexp(1.0, b) / rate, (unsigned long long)cumulative);
+        }
+        fprintf(out, "navigator_latency_seconds_bucket{probe=\"%s\",le=\"+Inf\"} %llu\n",
+                probeNames[p], (unsigned long long)t->samples);
+        fprintf(out, "navigator_latency_seconds_sum{probe=\"%s\"} %.9g\n", probeNames[p], (double)t->ticks / rate);
+        fprintf(out, "navigator_latency_seconds_count{probe=\"%s\"} %llu\n",
+                probeNames[p], (unsigned long long)t->samples);
+    }
+
+    fprintf(out, "# HELP navigator_latency_max_seconds Slowest timed call.\n");
+    fprintf(out, "# TYPE navigator_latency_max_seconds gauge\n");
+    for (int p = 0; p < STATS_PROBE_COUNT; p++)
+        fprintf(out, "navigator_latency_max_seconds{probe=\"%s\"} %.9g\n",
+                probeNames[p], (double)totals[p].maxTicks / rate);
+}
+
+// Periodic dump thread.
+static pthread_mutex_t dumpLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dumpWake;
+static pthread_t dumpThread;
+static int dumpRunning = 0;
+static int dumpStopping = 0;
+static char *dumpPath;
+static double dumpInterval;
+
+// Writes to a temporary file and renames it over path so readers never see a partial dump.
+static int writeStatsFile(const char *path) {
+    size_t length = strlen(path);
+    char *temporary = malloc(length + 5);
+    if (temporary == NULL)
+        return -1;
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", 5);
+    FILE *out = fopen(temporary, "w");
+    int failed = out == NULL;
+    if (!failed) {
+        writeStatsText(out);
+        failed = fclose(out) != 0 || rename(temporary, path) != 0;
+    }
+    free(temporary);
+    return failed ? -1 : 0;
+}
+
+static void *dumpMain(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&dumpLock);
+    while (!dumpStopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        double whole = floor(dumpInterval);
+        deadline.tv_sec += (time_t)whole;
+        deadline.tv_nsec += (long)((dumpInterval - whole) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!dumpStopping && pthread_cond_timedwait(&dumpWake, &dumpLock, &deadline) == 0)
+            ;
+        pthread_mutex_unlock(&dumpLock);
+        writeStatsFile(dumpPath);
+        pthread_mutex_lock(&dumpLock);
+    }
+    pthread_mutex_unlock(&dumpLock);
+    return NULL;
+}
+
+int startStatsDump(const char *path, double intervalSeconds) {
+    if (!statsEnabled()) {
+        fprintf(stderr, "Statistics are compiled out; rebuild with NAVIGATOR_STATS defined.\n");
+        return -1;
+    }
+    if (dumpRunning || !(intervalSeconds > 0.0)) {
+        fprintf(stderr, "Invalid statistics dump interval\n");
+        return -1;
+    }
+    if (writeStatsFile(path) != 0) {
+        perror(path);
+        return -1;
+    }
+    dumpPath = strdup(path);
+    if (dumpPath == NULL)
+        return -1;
+    dumpInterval = intervalSeconds;
+    dumpStopping = 0;
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&dumpWake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    if (pthread_create(&dumpThread, NULL, dumpMain, NULL) != 0) {
+        pthread_cond_destroy(&dumpWake);
+        free(dumpPath);
+        dumpPath = NULL;
+        fprintf(stderr, "Could not start the statistics dump thread\n");
+        return -1;
+    }
+    dumpRunning = 1;
+    return 0;
+}
+
+void stopStatsDump(void) {
+    if (!dumpRunning)
+        return;
+    pthread_mutex_lock(&dumpLock);
+    dumpStopping = 1;
+    pthread_cond_signal(&dumpWake);
+    pthread_mutex_unlock(&dumpLock);
+    pthread_join(dumpThread, NULL);
+    pthread_cond_destroy(&dumpWake);
+    dumpRunning = 0;
+    free(dumpPath);
+    dumpPath = NULL;
+}
@@ -0,0 +1,139 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Hot-path instrumentation. Every probe counts its calls per thread, and one
+// call in STATS_SAMPLE_INTERVAL is timed with the cycle counter into a log2
+// histogram, which keeps the cost to a counter increment on most calls; probes
+// around I/O time every call. Probes compile to nothing unless NAVIGATOR_STATS
+// is defined, and the report functions then say that statistics are unavailable.
+
+#define STATS_SAMPLE_INTERVAL 64          // power of two
+#define STATS_HISTOGRAM_BUCKETS 48        // bucket b holds [2^(b-1), 2^b) ticks
+#define STATS_DEFAULT_DUMP_SECONDS 10.0
+
+typedef enum {
+    STATS_DETERMINE_DESTINATION,
+    STATS_PLANET_POSITION,
+    STATS_HOHMANN_TRANSFER,
+    STATS_PHASING_TIME,
+    STATS_LAMBERT,
+    STATS_SWEEP_TRANSIT,
+    STATS_BATCH_COMMAND,
+    STATS_SERVER_ROUND,
+    STATS_INPUT_READ,
+    STATS_OUTPUT_FLUSH,
+    STATS_CATALOG_LOAD,
+    STATS_PROBE_COUNT
+} StatsProbe;
+
+// Totals of one probe over every thread, past and present.
+typedef struct {
+    uint64_t calls;
+    uint64_t samples;                     // timed calls
+    uint64_t ticks;                       // sum over timed calls
+    uint64_t maxTicks;
+    uint64_t histogram[STATS_HISTOGRAM_BUCKETS];
+} StatsTotals;
+
+// Returns 1 when probes are compiled in.
+int statsEnabled(void);
+
+// Adds up every thread's counters. Returns the tick rate (ticks per second) used to convert timings.
+double collectStats(StatsTotals totals[STATS_PROBE_COUNT]);
+
+// Human-readable table for the console.
+void printStats(FILE *out);
+
+// Prometheus text exposition format.
+void writeStatsText(FILE *out);
+
+// Rewrites path every intervalSeconds from a background thread, replacing it
+// atomically. Returns 0 on success, -1 on error (a reason is printed to stderr).
+int startStatsDump(const char *path, double intervalSeconds);
+// Writes a last dump and stops the thread. Does nothing when no dump is running.
+void stopStatsDump(void);
+
+#if defined(NAVIGATOR_STATS)
+
+#include <stdatomic.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Per-thread counters. Only the owning thread writes them; relaxed atomics let
+// readers add them up while it runs.
+typedef struct {
+    _Atomic uint64_t calls;
+    _Atomic uint64_t samples;
+    _Atomic uint64_t ticks;
+    _Atomic uint64_t maxTicks;
+    _Atomic uint64_t histogram[STATS_HISTOGRAM_BUCKETS];
+} StatsCounters;
+
+typedef struct StatsThread {
+    StatsCounters probes[STATS_PROBE_COUNT];
+    struct StatsThread *next;
+} StatsThread;
+
+extern _Thread_local StatsThread *statsThread;
+
+// Registers the calling thread's counters on its first probe.
+StatsThread *statsAttachThread(void);
+// Slow path of statsEnd for timed calls.
+void statsRecord(StatsProbe probe, uint64_t ticks);
+
+static inline uint64_t statsTimestamp(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+#endif
+}
+
+// Counts a call and returns a start timestamp when this call is sampled, 0 otherwise.
+static inline uint64_t statsBegin(StatsProbe probe) {
+    StatsThread *thread = statsThread;
+    if (thread == NULL)
+        thread = statsAttachThread();
+    _Atomic uint64_t *calls = &thread->probes[probe].calls;
+    uint64_t count = atomic_load_explicit(calls, memory_order_relaxed) + 1;
+    atomic_store_explicit(calls, count, memory_order_relaxed);
+    if (count & (STATS_SAMPLE_INTERVAL - 1))
+        return 0;
+    return statsTimestamp();
+}
+
+// Counts a call and always times it, for paths slow enough (system calls, file
+// loads) that two timer reads do not matter.
+static inline uint64_t statsBeginTimed(StatsProbe probe) {
+    statsBegin(probe);
+    return statsTimestamp() | 1;
+}
+
+static inline void statsEnd(StatsProbe probe, uint64_t start) {
+    if (start != 0)
+        statsRecord(probe, statsTimestamp() - start);
+}
+
+// STATS_BEGIN (sampled) or STATS_BEGIN_TIMED (every call) opens a probe in the
+// current scope; STATS_END closes it and must be reached on every path out of the scope.
+#define STATS_BEGIN(probe) uint64_t statsStart_##probe = statsBegin(probe)
+#define STATS_BEGIN_TIMED(probe) uint64_t statsStart_##probe = statsBeginTimed(probe)
+#define STATS_END(probe) statsEnd(probe, statsStart_##probe)
+
+#else
+
+#define STATS_BEGIN(probe) ((void)0)
+#define STATS_BEGIN_TIMED(probe) ((void)0)
+#define STATS_END(probe) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+#include "stringarena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_BYTES (64 * 1024)  // longer strings get a block of their own
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+struct StringArenaBlock {
+    StringArenaBlock *next;
+    size_t used, capacity;
+    char data[];
+};
+
+// FNV-1a. Never returns 0, which marks empty slots.
+static uint32_t hashText(const char *text, size_t length) {
+    uint32_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= FNV_PRIME;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+void initStringArena(StringArena *arena) {
+    memset(arena, 0, sizeof(*arena));
+}
+
+void freeStringArena(StringArena *arena) {
+    while (arena->blocks != NULL) {
+        StringArenaBlock *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    free(arena->hashes);
+    free(arena->strings);
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Doubles the hash set, keeping the load factor at or below one half.
+static int growSet(StringArena *arena) {
+    uint32_t capacity = arena->mask != 0 ? 2 * (arena->mask + 1) : 64;
+    uint32_t *hashes = calloc(capacity, sizeof(uint32_t));
+    const char **strings = malloc(capacity * sizeof(const char *));
+    if (hashes == NULL || strings == NULL) {
+        free(hashes);
+        free(strings);
+        return -1;
+    }
+    uint32_t mask = capacity - 1;
+    for (uint32_t slot = 0; arena->mask != 0 && slot <= arena->mask; slot++) {
+        if (arena->hashes[slot] == 0)
+            continue;
+        uint32_t target = arena->hashes[slot] & mask;
+        while (hashes[target] != 0)
+            target = (target + 1) & mask;
+        hashes[target] = arena->hashes[slot];
+        strings[target] = arena->strings[slot];
+    }
+    free(arena->hashes);
+    free(arena->strings);
+    arena->hashes = hashes;
+    arena->strings = strings;
+    arena->mask = mask;
+    return 0;
+}
+
+// Copies a string into the newest block, starting a new one when it is full.
+static const char *storeText(StringArena *arena, const char *text, size_t length) {
+    StringArenaBlock *block = arena->blocks;
+    if (block == NULL || block->capacity - block->used < length + 1) {
+        size_t capacity = length + 1 > ARENA_BLOCK_BYTES ? length + 1 : ARENA_BLOCK_BYTES;
+        block = malloc(sizeof(StringArenaBlock) + capacity);
+        if (block == NULL)
+            return NULL;
+        block->used = 0;
+        block->capacity = capacity;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    char *copy = block->data + block->used;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    block->used += length + 1;
+    arena->bytes += length + 1;
+    return copy;
+}
+
+const char *internString(StringArena *arena, const char *text, size_t length) {
+    if (2 * (arena->count + 1) > (size_t)arena->mask + 1 && growSet(arena) != 0)
+        return NULL;
+    uint32_t hash = hashText(text, length);
+    uint32_t slot = hash & arena->mask;
+    for (; arena->hashes[slot] != 0; slot = (slot + 1) & arena->mask) {
+        const char *candidate = arena->strings[slot];
+        if (arena->hashes[slot] == hash && strncmp(candidate, text, length) == 0 && candidate[length] == '\0')
+            return candidate;
+    }
+    const char *copy = storeText(arena, text, length);
+    if (copy == NULL)
+        return NULL;
+    arena->hashes[slot] = hash;
+    arena->strings[slot] = copy;
+    arena->count++;
+    return copy;
+}
@@ -0,0 +1,28 @@
+#ifndef STRINGARENA_H
+#define STRINGARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Append-only store of interned strings. Each distinct string is copied once
+// into large blocks and keeps its address until the arena is freed, so holders
+// keep plain pointers and equal strings share one copy.
+typedef struct StringArenaBlock StringArenaBlock;
+
+typedef struct {
+    StringArenaBlock *blocks;     // newest first
+    uint32_t mask;                // capacity - 1 of the hash set, 0 before the first string
+    uint32_t *hashes;             // per slot, 0 marks an empty slot
+    const char **strings;         // per slot
+    size_t count;                 // distinct strings
+    size_t bytes;                 // stored, terminators included
+} StringArena;
+
+void initStringArena(StringArena *arena);
+void freeStringArena(StringArena *arena);
+
+// Returns the arena's copy of the length bytes at text, NUL-terminated,
+// storing it if it is new. Returns NULL on allocation failure.
+const char *internString(StringArena *arena, const char *text, size_t length);
+
+#endif
@@ -0,0 +1,205 @@
+#include "textio.h"
+#include "stats.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_EXACT_MANTISSA 9007199254740992ull  // 2^53
+#define FIXED_LIMIT 1e18                        // scaled values must fit in a uint64
+
+static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+int parseDouble(const char **cursor, const char *end, double *value) {
+    const char *p = *cursor;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    const char *start = p;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0, sawDigit = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, sawDigit = 1) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, sawDigit = 1) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!sawDigit)
+        return 0;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int expNegative = 0, expValue = 0, expDigits = 0;
+        if (q < end && (*q == '-' || *q == '+'))
+            expNegative = *q++ == '-';
+        for (; q < end && *q >= '0' && *q <= '9'; q++, expDigits++) {
+            if (expValue < 10000)
+                expValue = expValue * 10 + (*q - '0');
+        }
+        if (expDigits > 0) {
+            exponent += expNegative ? -expValue : expValue;
+            p = q;
+        }
+    }
+
+    if (mantissa <= MAX_EXACT_MANTISSA && exponent >= -22 && exponent <= 22) {
+        // Both operands are exact doubles, so one rounding gives the correct result.
+        double result = (double)mantissa;
+        result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+        *value = negative ? -result : result;
+    } else {
+        char buffer[128];
+        size_t length = (size_t)(p - start) < sizeof(buffer) - 1 ? (size_t)(p - start) : sizeof(buffer) - 1;
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        *value = strtod(buffer, NULL);
+    }
+    *cursor = p;
+    return 1;
+}
+
+int openOutputBuffer(OutputBuffer *out, int fd, size_t capacity) {
+    if (capacity < OUTPUT_MIN_CAPACITY)
+        capacity = OUTPUT_MIN_CAPACITY;
+    out->data = malloc(capacity);
+    out->used = 0;
+    out->capacity = capacity;
+    out->fd = fd;
+    out->failed = 0;
+    return out->data != NULL ? 0 : -1;
+}
+
+void flushOutputBuffer(OutputBuffer *out) {
+    STATS_BEGIN_TIMED(STATS_OUTPUT_FLUSH);
+    size_t written = 0;
+    while (written < out->used && !out->failed) {
+        ssize_t n = write(out->fd, out->data + written, out->used - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            out->failed = 1;
+        else
+            written += (size_t)n;
+    }
+    out->used = 0;
+    STATS_END(STATS_OUTPUT_FLUSH);
+}
+
+int closeOutputBuffer(OutputBuffer *out) {
+    flushOutputBuffer(out);
+    free(out->data);
+    out->data = NULL;
+    out->capacity = 0;
+    return out->failed ? -1 : 0;
+}
+
+// Makes room for length more bytes.
+static inline char *reserve(OutputBuffer *out, size_t length) {
+    if (out->used + length > out->capacity)
+        flushOutputBuffer(out);
+    return out->data + out->used;
+}
+
+void appendChar(OutputBuffer *out, char c) {
+    *reserve(out, 1) = c;
+    out->used++;
+}
+
+void appendText(OutputBuffer *out, const char *text, size_t length) {
+    if (length > out->capacity) {
+        flushOutputBuffer(out);
+        OutputBuffer direct = { (char *)text, length, length, out->fd, out->failed };
+        flushOutputBuffer(&direct);
+        out->failed = direct.failed;
+        return;
+    }
+    memcpy(reserve(out, length), text, length);
+    out->used += length;
+}
+
+void appendString(OutputBuffer *out, const char *text) {
+    appendText(out, text, strlen(text));
+}
+
+// Writes the decimal digits of value backwards ending at end; returns the first digit.
+static char *formatUnsigned(char *end, uint64_t value) {
+    do {
+        *--end = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+void appendInt(OutputBuffer *out, long long value) {
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    char *start = formatUnsigned(end, magnitude);
+    if (value < 0)
+        *--start = '-';
+    appendText(out, start, (size_t)(end - start));
+}
+
+int formatFixed(char *dest, double value, int decimals) {
+    if (decimals < 0)
+        decimals = 0;
+    if (decimals > 9)
+        decimals = 9;
+    double scale = powersOfTen[decimals];
+    if (!(fabs(value) * scale < FIXED_LIMIT))
+        return snprintf(dest, FIXED_MAX_LENGTH, "%.17g", value);
+
+    // Scale only the fraction, which the subtraction leaves exact: scaling the
+    // whole value would round it to 53 bits before the decimals are rounded.
+    double magnitude = fabs(value);
+    double integral = floor(magnitude);
+    uint64_t whole = (uint64_t)integral;
+    uint64_t fraction = (uint64_t)nearbyint((magnitude - integral) * scale);
+    if (fraction >= (uint64_t)scale) {
+        fraction -= (uint64_t)scale;
+        whole++;
+    }
+    int negative = value < 0 && (whole != 0 || fraction != 0);
+
+    char digits[40];
+    char *end = digits + sizeof(digits);
+    char *p = end;
+    if (decimals > 0) {
+        for (int i = 0; i < decimals; i++) {
+            *--p = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        *--p = '.';
+    }
+    p = formatUnsigned(p, whole);
+    if (negative)
+        *--p = '-';
+    int length = (int)(end - p);
+    memcpy(dest, p, (size_t)length);
+    dest[length] = '\0';
+    return length;
+}
+
+void appendFixed(OutputBuffer *out, double value, int decimals) {
+    char *dest = reserve(out, FIXED_MAX_LENGTH);
+    out->used += (size_t)formatFixed(dest, value, decimals);
+}
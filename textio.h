@@ -0,0 +1,44 @@
+#ifndef TEXTIO_H
+#define TEXTIO_H
+
+#include <stddef.h>
+
+// Parses a decimal floating-point number starting at *cursor (leading blanks
+// skipped), advancing *cursor past it. Numbers with at most 19 significant
+// digits and a small exponent are converted exactly without strtod.
+// Returns 1 on success, 0 if no number starts at *cursor.
+int parseDouble(const char **cursor, const char *end, double *value);
+
+// Output accumulated in a large buffer and written to a file descriptor in bulk.
+typedef struct {
+    char *data;
+    size_t used;
+    size_t capacity;
+    int fd;
+    int failed;    // set once a write fails
+} OutputBuffer;
+
+#define OUTPUT_MIN_CAPACITY 64   // in bytes; room for any one appended number
+
+// Capacities below OUTPUT_MIN_CAPACITY are raised to it, so a formatted
+// number always fits after a flush. Returns 0 on success, -1 on allocation failure.
+int openOutputBuffer(OutputBuffer *out, int fd, size_t capacity);
+// Flushes and releases the buffer. Returns 0 if every write succeeded.
+int closeOutputBuffer(OutputBuffer *out);
+void flushOutputBuffer(OutputBuffer *out);
+
+void appendChar(OutputBuffer *out, char c);
+void appendText(OutputBuffer *out, const char *text, size_t length);
+void appendString(OutputBuffer *out, const char *text);
+void appendInt(OutputBuffer *out, long long value);
+
+// Appends value with a fixed number of decimals (at most 9), like printf("%.*f").
+// Values too large to scale into 64 bits and non-finite values are written with %.17g.
+void appendFixed(OutputBuffer *out, double value, int decimals);
+
+#define FIXED_MAX_LENGTH 32      // formatFixed output, terminator included
+
+// Formats value like appendFixed into dest (at least FIXED_MAX_LENGTH bytes). Returns the length.
+int formatFixed(char *dest, double value, int decimals);
+
+#endif
@@ -0,0 +1,208 @@
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A worker's remaining items, packed as (begin << 32) | end so the owner and
+// thieves can update both bounds with one compare-and-swap.
+typedef struct {
+    _Atomic uint64_t range;
+    char padding[64 - sizeof(uint64_t)];
+} WorkerRange;
+
+struct ThreadPool {
+    int size;
+    pthread_t *threads;
+    WorkerRange *ranges;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint64_t generation;    // bumped for every job
+    int running;            // helper threads still inside the current job
+    int stopping;
+    ParallelForBody body;
+    void *context;
+    int grain;
+};
+
+typedef struct {
+    ThreadPool *pool;
+    int worker;
+} WorkerStart;
+
+static inline uint64_t packRange(uint32_t begin, uint32_t end) {
+    return ((uint64_t)begin << 32) | end;
+}
+
+static inline uint32_t rangeBegin(uint64_t range) {
+    return (uint32_t)(range >> 32);
+}
+
+static inline uint32_t rangeEnd(uint64_t range) {
+    return (uint32_t)range;
+}
+
+// Takes up to grain items from the front of the worker's own range.
+static int takeOwn(ThreadPool *pool, int worker, uint32_t *begin, uint32_t *end) {
+    _Atomic uint64_t *slot = &pool->ranges[worker].range;
+    uint64_t range = atomic_load(slot);
+    for (;;) {
+        uint32_t b = rangeBegin(range), e = rangeEnd(range);
+        if (b >= e)
+            return 0;
+        uint32_t stop = e - b > (uint32_t)pool->grain ? b + (uint32_t)pool->grain : e;
+        if (atomic_compare_exchange_weak(slot, &range, packRange(stop, e))) {
+            *begin = b;
+            *end = stop;
+            return 1;
+        }
+    }
+}
+
+// Moves the back half of another worker's range into this worker's range.
+static int steal(ThreadPool *pool, int worker) {
+    for (int offset = 1; offset < pool->size; offset++) {
+        int victim = (worker + offset) % pool->size;
+        _Atomic uint64_t *slot = &pool->ranges[victim].range;
+        uint64_t range = atomic_load(slot);
+        for (;;) {
+            uint32_t b = rangeBegin(range), e = rangeEnd(range);
+            if (b >= e)
+                break;
+            uint32_t mid = b + (e - b) / 2;
+            if (atomic_compare_exchange_weak(slot, &range, packRange(b, mid))) {
+                atomic_store(&pool->ranges[worker].range, packRange(mid, e));
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void runJob(ThreadPool *pool, int worker) {
+    uint32_t begin, end;
+    for (;;) {
+        while (takeOwn(pool, worker, &begin, &end))
+            pool->body(pool->context, (int)begin, (int)end, worker);
+        if (!steal(pool, worker))
+            return;
+    }
+}
+
+static void *workerMain(void *arg) {
+    WorkerStart *start = arg;
+    ThreadPool *pool = start->pool;
+    int worker = start->worker;
+    free(start);
+
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->generation == seen)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stopping)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        runJob(pool, worker);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool *createThreadPool(int threads) {
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int)online : 1;
+    }
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (pool == NULL)
+        return NULL;
+    pool->size = threads;
+    pool->threads = calloc((size_t)threads, sizeof(pthread_t));
+    pool->ranges = aligned_alloc(64, (size_t)threads * sizeof(WorkerRange));
+    if (pool->threads == NULL || pool->ranges == NULL) {
+        free(pool->threads);
+        free(pool->ranges);
+        free(pool);
+        return NULL;
+    }
+    for (int i = 0; i < threads; i++)
+        atomic_init(&pool->ranges[i].range, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // Worker 0 is whichever thread calls parallelFor.
+    for (int i = 1; i < threads; i++) {
+        WorkerStart *start = malloc(sizeof(WorkerStart));
+        if (start != NULL) {
+            start->pool = pool;
+            start->worker = i;
+        }
+        if (start == NULL || pthread_create(&pool->threads[i], NULL, workerMain, start) != 0) {
+            free(start);
+            pool->size = i;
+            break;
+        }
+    }
+    return pool;
+}
+
+void destroyThreadPool(ThreadPool *pool) {
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->size; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool->ranges);
+    free(pool);
+}
+
+int threadPoolSize(const ThreadPool *pool) {
+    return pool != NULL ? pool->size : 1;
+}
+
+void parallelFor(ThreadPool *pool, int count, int grain, ParallelForBody body, void *context) {
+    if (count <= 0)
+        return;
+    if (grain < 1)
+        grain = 1;
+    if (pool == NULL || pool->size == 1 || count <= grain) {
+        body(context, 0, count, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->body = body;
+    pool->context = context;
+    pool->grain = grain;
+    for (int i = 0; i < pool->size; i++) {
+        uint32_t begin = (uint32_t)((int64_t)count * i / pool->size);
+        uint32_t end = (uint32_t)((int64_t)count * (i + 1) / pool->size);
+        atomic_store(&pool->ranges[i].range, packRange(begin, end));
+    }
+    pool->running = pool->size - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    runJob(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
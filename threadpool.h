@@ -0,0 +1,27 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Work-stealing thread pool for data-parallel loops.
+// Each parallelFor splits [0, count) evenly across the workers. A worker takes
+// grain-sized chunks from the front of its own range, and when that runs dry it
+// steals the back half of another worker's range. The calling thread works as
+// worker 0. A pool runs one parallelFor at a time.
+
+typedef struct ThreadPool ThreadPool;
+
+// Processes items [begin, end) on the given worker (0 <= worker < threadPoolSize).
+typedef void (*ParallelForBody)(void *context, int begin, int end, int worker);
+
+// Creates a pool with the given number of threads, or one per online CPU when threads <= 0.
+// Returns NULL on failure.
+ThreadPool *createThreadPool(int threads);
+void destroyThreadPool(ThreadPool *pool);
+
+// Number of workers, including the calling thread.
+int threadPoolSize(const ThreadPool *pool);
+
+// Runs body over [0, count) in chunks of at most grain items and returns when all are done.
+// A NULL pool runs the whole range on the calling thread.
+void parallelFor(ThreadPool *pool, int count, int grain, ParallelForBody body, void *context);
+
+#endif
@@ -0,0 +1,102 @@
+#include "modes.h"
+#include "destinations.h"
+#include "navigation.h"
+#include "scheduler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VOYAGE_TIME_STEP 0.0625       // in days; event times are whole multiples, exact in binary
+#define VOYAGE_MIN_FLIGHT 160         // in time steps: 10 days
+#define VOYAGE_FLIGHT_SPREAD 8000     // flights last up to 500 days longer
+#define VOYAGE_LAYOVER_SPREAD 480     // layovers last up to 30 days
+#define VOYAGE_BATCH 4096             // events dispatched per clock jump at most
+
+enum { VOYAGE_DEPARTURE, VOYAGE_ARRIVAL };
+
+int runVoyagesMode(char **args) {
+    int ships = atoi(args[0]);
+    double days = atof(args[1]);
+    Planet *earth = getDestinationByName("Earth");
+    if (ships <= 0 || !(days > 0.0) || earth == NULL) {
+        printf("Error: invalid voyage simulation\n");
+        return 1;
+    }
+    ShipState *states = malloc((size_t)ships * sizeof(ShipState));
+    Vector3D *targets = malloc((size_t)ships * sizeof(Vector3D));
+    ScheduledEvent *batch = malloc(VOYAGE_BATCH * sizeof(ScheduledEvent));
+    Scheduler scheduler;
+    double startTime = 100.0, endTime = startTime + days;
+    int failed = states == NULL || targets == NULL || batch == NULL || createScheduler(&scheduler, startTime) != 0;
+    if (failed) {
+        printf("Error: not enough memory for %d ships\n", ships);
+        free(states);
+        free(targets);
+        free(batch);
+        return 1;
+    }
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Vector3D home = getPlanetPosition(*earth, startTime);
+    unsigned long long seed = LAUNCH_SEED;
+    for (int i = 0; i < ships && !failed; i++) {
+        memset(&states[i], 0, sizeof(ShipState));
+        states[i].currentTime = startTime;
+        states[i].shipPosition = home;
+        states[i].currentDestination.id = (int)(earth - knownDestinations);
+        states[i].currentDestination.position = home;
+        states[i].currentDestination.arrivalTime = startTime;
+        double layover = (double)(nextLaunchRandom(&seed) % VOYAGE_LAYOVER_SPREAD) * VOYAGE_TIME_STEP;
+        failed = scheduleEvent(&scheduler, startTime + layover, VOYAGE_DEPARTURE, i) != 0;
+    }
+    long long events = 0, jumps = 0, departures = 0, arrivals = 0, atDestination = 0, pendingMax = 0;
+    int largestBatch = 0;
+    double lastTime = -INFINITY;
+    for (int count; !failed && (count = nextEventBatch(&scheduler, batch, VOYAGE_BATCH)) > 0 &&
+                    scheduler.time <= endTime;) {
+        double time = scheduler.time;
+        jumps += time != lastTime;
+        lastTime = time;
+        events += count;
+        largestBatch = count > largestBatch ? count : largestBatch;
+        pendingMax = scheduler.pending + count > pendingMax ? scheduler.pending + count : pendingMax;
+        for (int e = 0; e < count && !failed; e++) {
+            int ship = batch[e].actor;
+            if (batch[e].kind == VOYAGE_DEPARTURE) {
+                unsigned long long r = nextLaunchRandom(&seed);
+                int target = (int)(r % (unsigned long long)knownDestinationsCount);
+                double flight = (double)(VOYAGE_MIN_FLIGHT + (r >> 20) % VOYAGE_FLIGHT_SPREAD) * VOYAGE_TIME_STEP;
+                targets[ship] = getDestinationPosition(target, time + flight);
+                failed = scheduleEvent(&scheduler, time + flight, VOYAGE_ARRIVAL, ship) != 0;
+                departures++;
+            } else {
+                ShipState *state = &states[ship];
+                state->shipPosition = targets[ship];
+                resolveCurrentDestination(state, time);
+                atDestination += state->currentDestination.id != DESTINATION_NONE;
+                arrivals++;
+                double layover = (double)(nextLaunchRandom(&seed) % VOYAGE_LAYOVER_SPREAD) * VOYAGE_TIME_STEP;
+                failed = scheduleEvent(&scheduler, time + layover, VOYAGE_DEPARTURE, ship) != 0;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    freeScheduler(&scheduler);
+    free(states);
+    free(targets);
+    free(batch);
+    if (failed) {
+        printf("Error: not enough memory to schedule %d ships\n", ships);
+        return 1;
+    }
+    double seconds = elapsedSeconds(start, stop);
+    printf("%d ships over %.2f days: %lld events in %.3f s (%.0f events/s), up to %lld pending\n",
+           ships, days, events, seconds, seconds > 0.0 ? events / seconds : 0.0, pendingMax);
+    printf("Departures: %lld, arrivals: %lld (%lld at known destinations)\n", departures, arrivals, atDestination);
+    printf("The clock jumped %lld times, dispatching up to %d events at once; "
+           "stepping it every %g days would take %.0f ticks\n",
+           jumps, largestBatch, VOYAGE_TIME_STEP, ceil(days / VOYAGE_TIME_STEP));
+    return 0;
+}